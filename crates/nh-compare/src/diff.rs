@@ -1,9 +1,13 @@
 //! Snapshot diffing and RNG trace comparison.
 //!
 //! Compares two `GameSnapshot`s field-by-field, producing a list of
-//! `StateDiff` entries with severity classification.
+//! `StateDiff` entries with severity classification. Level snapshots are
+//! maintained incrementally from `LevelDelta`s and compared the same way.
 
-use crate::snapshot::{GameSnapshot, ItemSnapshot, MonsterSnapshot, RngTraceEntry};
+use crate::snapshot::{
+    CellSnapshot, FloorObjectSnapshot, GameSnapshot, ItemSnapshot, LevelDelta, LevelSnapshot,
+    MonsterSnapshot, RngTraceEntry,
+};
 use serde::{Deserialize, Serialize};
 
 /// How important a difference is for convergence.
@@ -210,7 +214,7 @@ pub fn diff_snapshots(rust: &GameSnapshot, c: &GameSnapshot) -> Vec<StateDiff> {
         rust.monsters.len() as i32,
         c.monsters.len() as i32,
     );
-    diff_monsters(&mut diffs, &rust.monsters, &c.monsters);
+    diff_monsters(&mut diffs, "monster", &rust.monsters, &c.monsters);
 
     diffs
 }
@@ -263,10 +267,15 @@ fn diff_items(diffs: &mut Vec<StateDiff>, rust: &[ItemSnapshot], c: &[ItemSnapsh
     }
 }
 
-fn diff_monsters(diffs: &mut Vec<StateDiff>, rust: &[MonsterSnapshot], c: &[MonsterSnapshot]) {
+fn diff_monsters(
+    diffs: &mut Vec<StateDiff>,
+    path: &str,
+    rust: &[MonsterSnapshot],
+    c: &[MonsterSnapshot],
+) {
     let count = rust.len().min(c.len());
     for i in 0..count {
-        let prefix = format!("monster[{}]", i);
+        let prefix = format!("{}[{}]", path, i);
         if rust[i].monster_type != c[i].monster_type {
             diffs.push(StateDiff {
                 severity: Severity::Major,
@@ -294,6 +303,157 @@ fn diff_monsters(diffs: &mut Vec<StateDiff>, rust: &[MonsterSnapshot], c: &[Mons
     }
 }
 
+/// Apply a level delta to a cached snapshot.
+///
+/// A full delta replaces the snapshot. Any other delta must be the next one
+/// in sequence for the same level, otherwise the cache has missed changes
+/// and an error is returned; the snapshot is left untouched in that case.
+pub fn apply_level_delta(level: &mut LevelSnapshot, delta: &LevelDelta) -> Result<(), String> {
+    let ncells = if delta.full { delta.width * delta.height } else { level.cells.len() };
+    if let Some(&(index, _)) = delta.cells.iter().find(|(i, _)| *i >= ncells) {
+        return Err(format!("Delta cell {} outside a level of {} cells", index, ncells));
+    }
+
+    if delta.full {
+        *level = LevelSnapshot {
+            dnum: delta.dnum,
+            dlevel: delta.dlevel,
+            width: delta.width,
+            height: delta.height,
+            cells: vec![CellSnapshot::default(); delta.width * delta.height],
+            seq: delta.seq,
+            ..LevelSnapshot::default()
+        };
+    } else {
+        if (delta.dnum, delta.dlevel) != (level.dnum, level.dlevel) {
+            return Err(format!(
+                "Delta for level {}:{} applied to cached level {}:{}",
+                delta.dnum, delta.dlevel, level.dnum, level.dlevel
+            ));
+        }
+        if delta.seq != level.seq.wrapping_add(1) {
+            return Err(format!(
+                "Missed level deltas: cached seq {}, got {}",
+                level.seq, delta.seq
+            ));
+        }
+        level.seq = delta.seq;
+    }
+
+    for &(index, cell) in &delta.cells {
+        level.cells[index] = cell;
+    }
+    for id in &delta.objects_gone {
+        level.objects.remove(id);
+    }
+    for (id, obj) in &delta.objects {
+        level.objects.insert(*id, obj.clone());
+    }
+    for id in &delta.monsters_gone {
+        level.monsters.remove(id);
+    }
+    for (id, mon) in &delta.monsters {
+        level.monsters.insert(*id, mon.clone());
+    }
+    Ok(())
+}
+
+/// Compare two level snapshots.
+///
+/// Object and monster ids are engine-local, so floor objects and monsters
+/// are matched by position and type rather than by id.
+pub fn diff_levels(rust: &LevelSnapshot, c: &LevelSnapshot) -> Vec<StateDiff> {
+    let mut diffs = Vec::new();
+
+    if (rust.dnum, rust.dlevel) != (c.dnum, c.dlevel) {
+        diffs.push(StateDiff {
+            severity: Severity::Critical,
+            field: "level.id".into(),
+            rust_value: format!("{}:{}", rust.dnum, rust.dlevel),
+            c_value: format!("{}:{}", c.dnum, c.dlevel),
+        });
+        return diffs;
+    }
+    if (rust.width, rust.height) != (c.width, c.height) {
+        diffs.push(StateDiff {
+            severity: Severity::Critical,
+            field: "level.size".into(),
+            rust_value: format!("{}x{}", rust.width, rust.height),
+            c_value: format!("{}x{}", c.width, c.height),
+        });
+        return diffs;
+    }
+
+    for (i, (r, cv)) in rust.cells.iter().zip(&c.cells).enumerate() {
+        if r == cv {
+            continue;
+        }
+        let prefix = format!("level.cell({},{})", i % rust.width, i / rust.width);
+        if r.typ != cv.typ {
+            diffs.push(StateDiff {
+                severity: Severity::Major,
+                field: format!("{}.typ", prefix),
+                rust_value: r.typ.to_string(),
+                c_value: cv.typ.to_string(),
+            });
+        }
+        if r.door_mask != cv.door_mask {
+            diffs.push(StateDiff {
+                severity: Severity::Major,
+                field: format!("{}.door_mask", prefix),
+                rust_value: r.door_mask.to_string(),
+                c_value: cv.door_mask.to_string(),
+            });
+        }
+        if r.lit != cv.lit || r.roomno != cv.roomno {
+            diffs.push(StateDiff {
+                severity: Severity::Minor,
+                field: format!("{}.lit_roomno", prefix),
+                rust_value: format!("({},{})", r.lit, r.roomno),
+                c_value: format!("({},{})", cv.lit, cv.roomno),
+            });
+        }
+    }
+
+    let key = |o: &FloorObjectSnapshot| (o.x, o.y, o.object_type, o.quantity);
+    let mut rust_objects: Vec<_> = rust.objects.values().collect();
+    let mut c_objects: Vec<_> = c.objects.values().collect();
+    rust_objects.sort_by_key(|o| key(o));
+    c_objects.sort_by_key(|o| key(o));
+    diff_field(
+        &mut diffs,
+        Severity::Major,
+        "level.objects.count",
+        rust_objects.len() as i32,
+        c_objects.len() as i32,
+    );
+    for (i, (r, cv)) in rust_objects.iter().zip(&c_objects).enumerate() {
+        if r != cv {
+            diffs.push(StateDiff {
+                severity: Severity::Major,
+                field: format!("level.objects[{}]", i),
+                rust_value: format!("{:?}", r),
+                c_value: format!("{:?}", cv),
+            });
+        }
+    }
+
+    let mut rust_monsters: Vec<_> = rust.monsters.values().cloned().collect();
+    let mut c_monsters: Vec<_> = c.monsters.values().cloned().collect();
+    rust_monsters.sort_by_key(|m| (m.x, m.y, m.monster_type));
+    c_monsters.sort_by_key(|m| (m.x, m.y, m.monster_type));
+    diff_field(
+        &mut diffs,
+        Severity::Major,
+        "level.monsters.count",
+        rust_monsters.len() as i32,
+        c_monsters.len() as i32,
+    );
+    diff_monsters(&mut diffs, "level.monsters", &rust_monsters, &c_monsters);
+
+    diffs
+}
+
 /// Point of divergence in RNG traces.
 #[derive(Debug, Clone, Serialize, Deserialize)]
 pub struct RngDivergence {
@@ -430,6 +590,75 @@ mod tests {
         assert_eq!(diffs[0].field, "player.x");
     }
 
+    fn wall(x: usize) -> (usize, CellSnapshot) {
+        (x, CellSnapshot { typ: 1, lit: false, door_mask: 0, roomno: 0 })
+    }
+
+    fn small_level(seq: u32, full: bool) -> LevelDelta {
+        LevelDelta { seq, full, dnum: 0, dlevel: 1, width: 4, height: 2, ..LevelDelta::default() }
+    }
+
+    fn jackal(x: i32) -> MonsterSnapshot {
+        MonsterSnapshot {
+            monster_type: 3,
+            x,
+            y: 1,
+            hp: 3,
+            hp_max: 3,
+            peaceful: false,
+            sleeping: false,
+            alive: true,
+        }
+    }
+
+    #[test]
+    fn test_level_deltas_rebuild_snapshot() {
+        let mut level = LevelSnapshot::default();
+        let mut base = small_level(0, true);
+        base.cells = vec![wall(0), wall(5)];
+        base.monsters = vec![(7, jackal(1))];
+        apply_level_delta(&mut level, &base).unwrap();
+        assert_eq!(level.cells.len(), 8);
+        assert_eq!(level.cell(1, 1).unwrap().typ, 1);
+
+        let mut step = small_level(1, false);
+        step.monsters = vec![(7, jackal(2)), (9, jackal(3))];
+        apply_level_delta(&mut level, &step).unwrap();
+        let mut step = small_level(2, false);
+        step.monsters_gone = vec![9];
+        apply_level_delta(&mut level, &step).unwrap();
+        assert_eq!(level.monsters.len(), 1);
+        assert_eq!(level.monsters[&7].x, 2);
+
+        // A skipped delta leaves the cache as it was
+        let before = level.clone();
+        assert!(apply_level_delta(&mut level, &small_level(4, false)).is_err());
+        assert_eq!(level, before);
+    }
+
+    #[test]
+    fn test_level_diff_is_by_position() {
+        let mut rust = LevelSnapshot::default();
+        let mut base = small_level(0, true);
+        base.monsters = vec![(1, jackal(2))];
+        apply_level_delta(&mut rust, &base).unwrap();
+
+        let mut c = rust.clone();
+        c.monsters = [(44, jackal(2))].into_iter().collect();
+        assert!(diff_levels(&rust, &c).is_empty());
+
+        c.cells[3] = wall(3).1;
+        let diffs = diff_levels(&rust, &c);
+        assert_eq!(diffs.len(), 1);
+        assert_eq!(diffs[0].field, "level.cell(3,0).typ");
+
+        let mut c = rust.clone();
+        c.monsters.insert(45, jackal(3));
+        let diffs = diff_levels(&rust, &c);
+        assert_eq!(diffs[0].field, "level.monsters.count");
+        assert!(diffs.iter().all(|d| d.field.starts_with("level.")));
+    }
+
     #[test]
     fn test_rng_trace_match() {
         let trace = vec![
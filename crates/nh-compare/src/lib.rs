@@ -1,8 +1,10 @@
 //! Convergence comparison framework for nethack-rs vs NetHack C 3.6.7.
 //!
 //! Provides structured snapshot capture, diffing with severity classification,
-//! RNG trace comparison, and convergence reporting.
+//! RNG trace comparison, per-turn lockstep digests, and convergence
+//! reporting.
 
 pub mod diff;
+pub mod lockstep;
 pub mod report;
 pub mod snapshot;
@@ -0,0 +1,343 @@
+//! Streaming lockstep comparison.
+//!
+//! Rather than snapshotting and diffing both engines every turn, each side
+//! keeps a rolling hash of its RNG calls (`nh_rng::hash_rng_call`) and
+//! produces a cheap state hash after every turn. `Lockstep` compares those
+//! per-turn digests and stops at the first turn they disagree; only then
+//! does the caller take full snapshots for `Lockstep::divergence` to diff.
+//!
+//! `state_hash` must match `ffi_state_hash()` in nh-test's `nethack_ffi.c`
+//! (the fold is described next to `nh_ffi_step_digest` in
+//! `nethack_ffi_types.h`), so the C digests from `exec_cmds` compare
+//! directly against a Rust `GameState`.
+
+use nh_rng::{HASH_SEED, hash_word};
+use serde::{Deserialize, Serialize};
+
+use crate::diff::{StateDiff, diff_snapshots};
+use crate::snapshot::GameSnapshot;
+
+/// One engine's state after a turn.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Serialize, Deserialize)]
+pub struct TurnDigest {
+    pub turn: u64,
+    /// RNG calls since the engine was seeded
+    pub rng_calls: u64,
+    /// Rolling hash of those calls
+    pub rng_hash: u64,
+    /// `state_hash` of the engine after the turn
+    pub state_hash: u64,
+}
+
+/// Part of the digest that first differed, in the order they are checked.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+pub enum Mismatch {
+    RngCalls,
+    RngHash,
+    Turn,
+    State,
+}
+
+impl core::fmt::Display for Mismatch {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        match self {
+            Mismatch::RngCalls => write!(f, "RNG call count"),
+            Mismatch::RngHash => write!(f, "RNG call sequence"),
+            Mismatch::Turn => write!(f, "turn counter"),
+            Mismatch::State => write!(f, "game state"),
+        }
+    }
+}
+
+impl TurnDigest {
+    /// First field that differs from `other`.
+    pub fn mismatch(&self, other: &TurnDigest) -> Option<Mismatch> {
+        if self.rng_calls != other.rng_calls {
+            Some(Mismatch::RngCalls)
+        } else if self.rng_hash != other.rng_hash {
+            Some(Mismatch::RngHash)
+        } else if self.turn != other.turn {
+            Some(Mismatch::Turn)
+        } else if self.state_hash != other.state_hash {
+            Some(Mismatch::State)
+        } else {
+            None
+        }
+    }
+}
+
+#[inline]
+fn hash_int(h: u64, v: i64) -> u64 {
+    hash_word(h, v as u64)
+}
+
+/// Hash of the state compared every turn: the turn (truncated to 32 bits,
+/// as C stores it), player position, HP and depth, and each live
+/// monster's position and HP. Monsters are summed, so their order does
+/// not matter.
+pub fn state_hash(
+    turn: u64,
+    x: i32,
+    y: i32,
+    hp: i32,
+    hp_max: i32,
+    depth: i32,
+    monsters: impl IntoIterator<Item = (i32, i32, i32)>,
+) -> u64 {
+    let mons = monsters.into_iter().fold(0u64, |sum, (mx, my, mhp)| {
+        let m = hash_int(
+            hash_int(hash_int(HASH_SEED, mx as i64), my as i64),
+            mhp as i64,
+        );
+        sum.wrapping_add(m)
+    });
+    let mut h = hash_int(HASH_SEED, turn as u32 as i64);
+    for v in [x, y, hp, hp_max, depth] {
+        h = hash_int(h, v as i64);
+    }
+    hash_word(h, mons)
+}
+
+/// `state_hash` of a snapshot, counting only its live monsters.
+/// `dungeon_level` stands in for the depth, which it equals in the main
+/// dungeon.
+pub fn snapshot_state_hash(snapshot: &GameSnapshot) -> u64 {
+    let p = &snapshot.player;
+    state_hash(
+        snapshot.turn,
+        p.x,
+        p.y,
+        p.hp,
+        p.hp_max,
+        p.dungeon_level,
+        snapshot
+            .monsters
+            .iter()
+            .filter(|m| m.alive)
+            .map(|m| (m.x, m.y, m.hp)),
+    )
+}
+
+/// First turn where the two engines disagreed.
+#[derive(Debug, Clone, Serialize, Deserialize)]
+pub struct LockstepDivergence {
+    /// Zero-based index of the turn; every earlier turn matched
+    pub step: usize,
+    pub mismatch: Mismatch,
+    pub rust: TurnDigest,
+    pub c: TurnDigest,
+    /// Field diffs of the snapshots taken at the divergence
+    pub diffs: Vec<StateDiff>,
+}
+
+impl core::fmt::Display for LockstepDivergence {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        writeln!(
+            f,
+            "Diverged at step {} ({} differs): rust turn {} after {} RNG calls, c turn {} after {}",
+            self.step,
+            self.mismatch,
+            self.rust.turn,
+            self.rust.rng_calls,
+            self.c.turn,
+            self.c.rng_calls
+        )?;
+        for diff in &self.diffs {
+            writeln!(f, "  {}", diff)?;
+        }
+        Ok(())
+    }
+}
+
+/// Per-turn digest comparator.
+///
+/// Feed it one pair of digests per turn with `step`; once it reports a
+/// mismatch it keeps reporting it without comparing further turns.
+#[derive(Debug, Clone, Default)]
+pub struct Lockstep {
+    matched: usize,
+    first: Option<(Mismatch, TurnDigest, TurnDigest)>,
+}
+
+impl Lockstep {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Compare one turn. Returns the mismatch of the first diverging turn.
+    pub fn step(&mut self, rust: &TurnDigest, c: &TurnDigest) -> Option<Mismatch> {
+        if let Some((mismatch, _, _)) = self.first {
+            return Some(mismatch);
+        }
+        match rust.mismatch(c) {
+            Some(mismatch) => {
+                self.first = Some((mismatch, *rust, *c));
+                Some(mismatch)
+            }
+            None => {
+                self.matched += 1;
+                None
+            }
+        }
+    }
+
+    /// Turns that matched before the divergence, if any.
+    pub fn matched(&self) -> usize {
+        self.matched
+    }
+
+    pub fn diverged(&self) -> bool {
+        self.first.is_some()
+    }
+
+    /// Report the divergence, diffing snapshots taken right after it.
+    /// `None` while every turn has matched.
+    pub fn divergence(&self, rust: &GameSnapshot, c: &GameSnapshot) -> Option<LockstepDivergence> {
+        let (mismatch, rust_digest, c_digest) = self.first?;
+        Some(LockstepDivergence {
+            step: self.matched,
+            mismatch,
+            rust: rust_digest,
+            c: c_digest,
+            diffs: diff_snapshots(rust, c),
+        })
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::snapshot::*;
+
+    fn snapshot(source: &str, hp: i32, monsters: Vec<MonsterSnapshot>) -> GameSnapshot {
+        GameSnapshot {
+            turn: 7,
+            player: PlayerSnapshot {
+                x: 10,
+                y: 5,
+                hp,
+                hp_max: 16,
+                energy: 4,
+                energy_max: 4,
+                armor_class: 10,
+                gold: 0,
+                exp_level: 1,
+                nutrition: 900,
+                strength: 16,
+                intelligence: 10,
+                wisdom: 10,
+                dexterity: 10,
+                constitution: 10,
+                charisma: 10,
+                alive: true,
+                dungeon_level: 1,
+                dungeon_num: 0,
+                status_effects: vec![],
+            },
+            inventory: vec![],
+            monsters,
+            source: source.into(),
+        }
+    }
+
+    fn monster(x: i32, y: i32, hp: i32, alive: bool) -> MonsterSnapshot {
+        MonsterSnapshot {
+            monster_type: 0,
+            x,
+            y,
+            hp,
+            hp_max: hp,
+            peaceful: false,
+            sleeping: false,
+            alive,
+        }
+    }
+
+    #[test]
+    fn test_state_hash_ignores_monster_order_and_dead_monsters() {
+        let a = snapshot(
+            "rust",
+            16,
+            vec![monster(3, 4, 5, true), monster(8, 2, 1, true)],
+        );
+        let b = snapshot(
+            "c",
+            16,
+            vec![
+                monster(8, 2, 1, true),
+                monster(1, 1, 9, false),
+                monster(3, 4, 5, true),
+            ],
+        );
+        assert_eq!(snapshot_state_hash(&a), snapshot_state_hash(&b));
+
+        let moved = snapshot(
+            "c",
+            16,
+            vec![monster(3, 4, 5, true), monster(8, 3, 1, true)],
+        );
+        assert_ne!(snapshot_state_hash(&a), snapshot_state_hash(&moved));
+        // Swapping coordinates between monsters is still a change
+        let swapped = snapshot(
+            "c",
+            16,
+            vec![monster(4, 3, 5, true), monster(8, 2, 1, true)],
+        );
+        assert_ne!(snapshot_state_hash(&a), snapshot_state_hash(&swapped));
+    }
+
+    #[test]
+    fn test_lockstep_stops_at_first_mismatch() {
+        let digest = |turn, rng_calls, state_hash| TurnDigest {
+            turn,
+            rng_calls,
+            rng_hash: nh_rng::hash_rng_call(HASH_SEED, nh_rng::RNG_FN_RN2, 10, rng_calls),
+            state_hash,
+        };
+        let mut lockstep = Lockstep::new();
+        assert_eq!(lockstep.step(&digest(1, 3, 9), &digest(1, 3, 9)), None);
+        assert_eq!(
+            lockstep.step(&digest(2, 5, 9), &digest(2, 5, 8)),
+            Some(Mismatch::State)
+        );
+        // Later turns are not compared
+        assert_eq!(
+            lockstep.step(&digest(3, 7, 9), &digest(3, 8, 9)),
+            Some(Mismatch::State)
+        );
+        assert_eq!(lockstep.matched(), 1);
+
+        let rust = snapshot("rust", 16, vec![]);
+        let c = snapshot("c", 12, vec![]);
+        let report = lockstep.divergence(&rust, &c).unwrap();
+        assert_eq!((report.step, report.mismatch), (1, Mismatch::State));
+        assert_eq!(report.c.state_hash, 8);
+        assert!(report.diffs.iter().any(|d| d.field == "player.hp"));
+    }
+
+    #[test]
+    fn test_rng_mismatch_is_reported_before_state() {
+        let a = TurnDigest {
+            turn: 1,
+            rng_calls: 4,
+            rng_hash: 1,
+            state_hash: 1,
+        };
+        let b = TurnDigest {
+            rng_hash: 2,
+            state_hash: 2,
+            ..a
+        };
+        assert_eq!(a.mismatch(&b), Some(Mismatch::RngHash));
+        assert_eq!(
+            a.mismatch(&TurnDigest { rng_calls: 5, ..b }),
+            Some(Mismatch::RngCalls)
+        );
+        assert_eq!(a.mismatch(&a), None);
+        assert!(
+            Lockstep::new()
+                .divergence(&snapshot("rust", 1, vec![]), &snapshot("c", 1, vec![]))
+                .is_none()
+        );
+    }
+}
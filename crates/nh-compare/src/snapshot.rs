@@ -3,6 +3,8 @@
 //! Snapshots capture a normalized view of game state that can be compared
 //! across both engines regardless of internal representation differences.
 
+use std::collections::BTreeMap;
+
 use serde::{Deserialize, Serialize};
 
 /// Complete game state snapshot at a point in time.
@@ -56,7 +58,7 @@ pub struct ItemSnapshot {
 }
 
 /// Monster snapshot.
-#[derive(Debug, Clone, Serialize, Deserialize)]
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 pub struct MonsterSnapshot {
     /// Monster type index
     pub monster_type: i16,
@@ -69,6 +71,77 @@ pub struct MonsterSnapshot {
     pub alive: bool,
 }
 
+/// One map cell.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Serialize, Deserialize)]
+pub struct CellSnapshot {
+    /// Terrain type (`levltyp`)
+    pub typ: u8,
+    pub lit: bool,
+    pub door_mask: u8,
+    pub roomno: u8,
+}
+
+/// Object lying on the level floor.
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct FloorObjectSnapshot {
+    pub object_type: i16,
+    pub x: i32,
+    pub y: i32,
+    pub quantity: i32,
+    pub enchantment: i8,
+    pub buc: String,
+}
+
+/// Cells, floor objects and monsters of the current level.
+///
+/// Kept up to date from `LevelDelta`s with `diff::apply_level_delta`, so a
+/// comparison only has to ship what changed since the last step.
+#[derive(Debug, Clone, Default, PartialEq, Serialize, Deserialize)]
+pub struct LevelSnapshot {
+    pub dnum: i32,
+    pub dlevel: i32,
+    pub width: usize,
+    pub height: usize,
+    /// Row-major (`y * width + x`)
+    pub cells: Vec<CellSnapshot>,
+    /// Floor objects by object id
+    pub objects: BTreeMap<u32, FloorObjectSnapshot>,
+    /// Monsters by monster id
+    pub monsters: BTreeMap<u32, MonsterSnapshot>,
+    /// `seq` of the last delta applied
+    pub seq: u32,
+}
+
+impl LevelSnapshot {
+    pub fn cell(&self, x: usize, y: usize) -> Option<&CellSnapshot> {
+        if x >= self.width || y >= self.height {
+            return None;
+        }
+        self.cells.get(y * self.width + x)
+    }
+}
+
+/// Level changes since the previous delta.
+#[derive(Debug, Clone, Default, Serialize, Deserialize)]
+pub struct LevelDelta {
+    /// Deltas since the baseline
+    pub seq: u32,
+    /// Baseline: lists the whole level and replaces the cached snapshot
+    pub full: bool,
+    pub dnum: i32,
+    pub dlevel: i32,
+    pub width: usize,
+    pub height: usize,
+    /// Changed cells by row-major index
+    pub cells: Vec<(usize, CellSnapshot)>,
+    /// New or changed floor objects by id
+    pub objects: Vec<(u32, FloorObjectSnapshot)>,
+    pub objects_gone: Vec<u32>,
+    /// New or changed monsters by id
+    pub monsters: Vec<(u32, MonsterSnapshot)>,
+    pub monsters_gone: Vec<u32>,
+}
+
 /// RNG trace entry for comparing random number generation sequences.
 #[derive(Debug, Clone, Serialize, Deserialize)]
 pub struct RngTraceEntry {
@@ -0,0 +1,109 @@
+//! Level deltas: a snapshot rebuilt from C's per-step deltas must match a
+//! full binary export of the same level after every step.
+
+use nh_compare::diff::{apply_level_delta, diff_levels};
+use nh_compare::snapshot::{
+    CellSnapshot, FloorObjectSnapshot, LevelDelta, LevelSnapshot, MonsterSnapshot,
+};
+use nh_core::CGameEngineTrait;
+use nh_test::ffi::CGameEngineSubprocess as CGameEngine;
+use nh_test::ffi::game_engine::{CLevelCell, CLevelDelta, CLevelExport, CLevelMonster, CLevelObject};
+use serial_test::serial;
+
+fn cell(c: &CLevelCell) -> CellSnapshot {
+    CellSnapshot { typ: c.typ, lit: c.lit != 0, door_mask: c.doormask, roomno: c.roomno }
+}
+
+fn object(o: &CLevelObject) -> FloorObjectSnapshot {
+    FloorObjectSnapshot {
+        object_type: o.otyp,
+        x: o.x as i32,
+        y: o.y as i32,
+        quantity: o.quan,
+        enchantment: o.spe,
+        buc: match o.buc {
+            1 => "Blessed".into(),
+            -1 => "Cursed".into(),
+            _ => "Uncursed".into(),
+        },
+    }
+}
+
+fn monster(m: &CLevelMonster) -> MonsterSnapshot {
+    MonsterSnapshot {
+        monster_type: m.mnum,
+        x: m.x as i32,
+        y: m.y as i32,
+        hp: m.hp,
+        hp_max: m.hpmax,
+        peaceful: m.peaceful != 0,
+        sleeping: m.asleep != 0,
+        alive: true,
+    }
+}
+
+fn level_delta(d: &CLevelDelta) -> LevelDelta {
+    let hdr = d.header();
+    LevelDelta {
+        seq: hdr.seq,
+        full: d.is_full(),
+        dnum: hdr.dnum as i32,
+        dlevel: hdr.dlevel as i32,
+        width: hdr.width as usize,
+        height: hdr.height as usize,
+        cells: d.cells().iter().map(|c| (c.index as usize, cell(&c.cell))).collect(),
+        objects: d.objects().iter().map(|o| (o.o_id, object(o))).collect(),
+        objects_gone: d.objects_gone().to_vec(),
+        monsters: d.monsters().iter().map(|m| (m.m_id, monster(m))).collect(),
+        monsters_gone: d.monsters_gone().to_vec(),
+    }
+}
+
+fn level_snapshot(e: &CLevelExport) -> LevelSnapshot {
+    let hdr = e.header();
+    LevelSnapshot {
+        dnum: hdr.dnum as i32,
+        dlevel: hdr.dlevel as i32,
+        width: e.width(),
+        height: e.height(),
+        cells: e.cells().iter().map(cell).collect(),
+        objects: e.objects().iter().map(|o| (o.o_id, object(o))).collect(),
+        monsters: e.monsters().iter().map(|m| (m.m_id, monster(m))).collect(),
+        seq: 0,
+    }
+}
+
+#[test]
+#[serial]
+fn test_deltas_track_full_export() {
+    let mut engine = CGameEngine::new();
+    engine.init("Valkyrie", "Human", 0, 0).expect("C engine init failed");
+    engine.reset(42).expect("C engine reset failed");
+    if engine.generate_and_place().is_err() {
+        // The stub engine has no levels to track
+        return;
+    }
+    engine.reset_level_delta().unwrap();
+
+    let mut cached = LevelSnapshot::default();
+    let base = engine.export_level_delta().unwrap();
+    assert!(base.is_full());
+    apply_level_delta(&mut cached, &level_delta(&base)).unwrap();
+
+    let mut delta_bytes = 0;
+    for (step, cmd) in "lljjhhkk.s.s".chars().enumerate() {
+        let _ = engine.exec_cmd(cmd);
+        if engine.is_dead() {
+            break;
+        }
+        let delta = engine.export_level_delta().unwrap();
+        delta_bytes += delta.as_bytes().len();
+        apply_level_delta(&mut cached, &level_delta(&delta))
+            .unwrap_or_else(|e| panic!("step {}: {}", step, e));
+
+        let full = level_snapshot(&engine.export_level_bin().unwrap());
+        let diffs = diff_levels(&cached, &full);
+        assert!(diffs.is_empty(), "step {} ({}): {:?}", step, cmd, diffs);
+    }
+    println!("{} delta bytes vs {} per full export", delta_bytes, base.as_bytes().len());
+}
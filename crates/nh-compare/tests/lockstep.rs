@@ -0,0 +1,199 @@
+//! Lockstep tests — compare per-turn RNG and state digests of both engines
+//! and only diff full snapshots at the first turn they disagree.
+
+use nh_compare::lockstep::{Lockstep, TurnDigest, state_hash};
+use nh_compare::snapshot::{GameSnapshot, MonsterSnapshot, PlayerSnapshot};
+use nh_core::action::Command;
+use nh_core::player::{Gender, Race, Role};
+use nh_core::{CGameEngineTrait, GameLoop, GameRng, GameState};
+use nh_test::ffi::CGameEngineSubprocess as CGameEngine;
+use nh_test::ffi::game_engine::CStepDigest;
+use serial_test::serial;
+
+fn c_turn_digest(d: &CStepDigest) -> TurnDigest {
+    TurnDigest {
+        turn: d.turn as u64,
+        rng_calls: d.rng_calls,
+        rng_hash: d.rng_hash,
+        state_hash: d.state_hash,
+    }
+}
+
+fn rust_turn_digest(gs: &GameState) -> TurnDigest {
+    let p = &gs.player;
+    TurnDigest {
+        turn: gs.turns,
+        rng_calls: gs.rng.call_count(),
+        rng_hash: gs.rng.rng_hash(),
+        state_hash: state_hash(
+            gs.turns,
+            p.pos.x as i32,
+            p.pos.y as i32,
+            p.hp,
+            p.hp_max,
+            p.level.depth(),
+            gs.current_level
+                .monsters
+                .iter()
+                .filter(|m| m.state.alive)
+                .map(|m| (m.x as i32, m.y as i32, m.hp)),
+        ),
+    }
+}
+
+/// The fields the lockstep diff looks at; the rest stay at their defaults.
+fn player_snapshot(x: i32, y: i32, hp: i32, hp_max: i32, dungeon_level: i32) -> PlayerSnapshot {
+    PlayerSnapshot {
+        x,
+        y,
+        hp,
+        hp_max,
+        energy: 0,
+        energy_max: 0,
+        armor_class: 0,
+        gold: 0,
+        exp_level: 0,
+        nutrition: 0,
+        strength: 0,
+        intelligence: 0,
+        wisdom: 0,
+        dexterity: 0,
+        constitution: 0,
+        charisma: 0,
+        alive: hp > 0,
+        dungeon_level,
+        dungeon_num: 0,
+        status_effects: vec![],
+    }
+}
+
+fn rust_snapshot(gs: &GameState) -> GameSnapshot {
+    let p = &gs.player;
+    GameSnapshot {
+        turn: gs.turns,
+        player: player_snapshot(p.pos.x as i32, p.pos.y as i32, p.hp, p.hp_max, p.level.depth()),
+        inventory: vec![],
+        monsters: gs
+            .current_level
+            .monsters
+            .iter()
+            .map(|m| MonsterSnapshot {
+                monster_type: m.monster_type,
+                x: m.x as i32,
+                y: m.y as i32,
+                hp: m.hp,
+                hp_max: m.hp_max,
+                peaceful: m.state.peaceful,
+                sleeping: m.state.sleeping,
+                alive: m.state.alive,
+            })
+            .collect(),
+        source: "rust".into(),
+    }
+}
+
+fn c_snapshot(engine: &CGameEngine) -> GameSnapshot {
+    let s = engine.snapshot().expect("C snapshot failed");
+    GameSnapshot {
+        turn: s.turn_count,
+        player: player_snapshot(s.x, s.y, s.hp, s.hp_max, s.dungeon_depth),
+        inventory: vec![],
+        monsters: s
+            .monsters
+            .iter()
+            .map(|m| MonsterSnapshot {
+                monster_type: -1,
+                x: m.x,
+                y: m.y,
+                hp: m.hp,
+                hp_max: m.max_hp,
+                peaceful: m.peaceful,
+                sleeping: m.asleep,
+                alive: true,
+            })
+            .collect(),
+        source: "c".into(),
+    }
+}
+
+/// The C state hash folds exactly what its snapshot reports.
+#[test]
+#[serial]
+fn test_c_state_hash_matches_snapshot() {
+    let mut c_engine = CGameEngine::new();
+    c_engine.init("Valkyrie", "Human", 1, 0).expect("C init failed");
+    c_engine.reset(42).expect("C reset failed");
+    c_engine.generate_and_place().expect("C level generation failed");
+
+    for cmd in "hjkl..s".chars() {
+        let batch = c_engine.exec_cmds(&cmd.to_string(), true).expect("C step failed");
+        let digest = batch.digests[0];
+        let s = c_engine.snapshot().expect("C snapshot failed");
+        let expected = state_hash(
+            s.turn_count,
+            s.x,
+            s.y,
+            s.hp,
+            s.hp_max,
+            s.dungeon_depth,
+            s.monsters.iter().map(|m| (m.x, m.y, m.hp)),
+        );
+        assert_eq!(digest.state_hash, expected, "after '{}'", cmd);
+        assert_eq!(c_engine.step_digest().unwrap().state_hash, expected);
+    }
+}
+
+/// Rest in lockstep and report the first turn the digests disagree, with
+/// the snapshot diff taken at that turn.
+#[test]
+#[serial]
+fn test_lockstep_rest() {
+    let seed = 42u64;
+
+    let mut c_engine = CGameEngine::new();
+    c_engine.init("Valkyrie", "Human", 1, 0).expect("C init failed");
+    c_engine.reset(seed).expect("C reset failed");
+
+    let (cx, cy) = c_engine.position();
+    let mut rust_state = GameState::new_with_identity(
+        GameRng::new(seed),
+        "Hero".into(),
+        Role::Valkyrie,
+        Race::Human,
+        Gender::Female,
+        Role::Valkyrie.default_alignment(),
+    );
+    rust_state.player.pos.x = cx as i8;
+    rust_state.player.pos.y = cy as i8;
+    // C FFI places player at (0,0) on Stone — skip invariant checks
+    rust_state.skip_invariant_checks = true;
+    let mut rust_loop = GameLoop::new(rust_state);
+
+    // Both hashes start from here
+    rust_loop.state_mut().rng.enable_hashing();
+    c_engine.reset_rng_hash().expect("C hash reset failed");
+
+    let num_turns = 50;
+    let mut lockstep = Lockstep::new();
+    for _ in 0..num_turns {
+        rust_loop.tick(Command::Rest);
+        let batch = c_engine.exec_cmds(".", true).expect("C rest failed");
+        let c_digest = c_turn_digest(&batch.digests[0]);
+        if lockstep.step(&rust_turn_digest(rust_loop.state()), &c_digest).is_some() {
+            break;
+        }
+    }
+
+    match lockstep.divergence(&rust_snapshot(rust_loop.state()), &c_snapshot(&c_engine)) {
+        Some(divergence) => {
+            assert_eq!(divergence.step, lockstep.matched());
+            print!("{}", divergence);
+        }
+        None => {
+            assert_eq!(lockstep.matched(), num_turns);
+            println!("No divergence across {} turns of resting", num_turns);
+        }
+    }
+
+    // This test reports but doesn't fail — divergence is expected until convergence improves.
+}
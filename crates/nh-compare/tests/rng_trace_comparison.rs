@@ -17,8 +17,8 @@ fn parse_c_trace(json: &str) -> Vec<RngTraceEntry> {
         .map(|e| RngTraceEntry {
             seq: e["seq"].as_u64().unwrap_or(0),
             func: e["func"].as_str().unwrap_or("").to_string(),
-            arg: e["arg"].as_u64().unwrap_or(0),
-            result: e["result"].as_u64().unwrap_or(0),
+            arg: e["arg"].as_i64().unwrap_or(0) as u64,
+            result: e["result"].as_i64().unwrap_or(0) as u64,
         })
         .collect()
 }
@@ -7,7 +7,7 @@ mod attack_type;
 mod damage_type;
 mod mhitm;
 mod mhitu;
-mod uhitm;
+pub mod uhitm;
 
 #[cfg(not(feature = "std"))]
 use crate::compat::*;
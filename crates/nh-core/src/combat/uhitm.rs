@@ -23,8 +23,10 @@ use super::{
     effect_severity_from_skill, execute_ranged_attack, flanking_damage_bonus, roll_special_effect,
     select_monster_target, should_trigger_special_effect, weapon_vs_armor_bonus,
 };
+use crate::data::monsters::MONSTERS;
+use crate::data::objects::{OBJECTS, ObjectType, P_AXE, P_NONE, P_PICK_AXE, P_SPEAR};
 use crate::monster::{Monster, MonsterFlags};
-use crate::object::{Material, Object};
+use crate::object::{Material, Object, ObjectClass};
 use crate::player::{AlignmentType, You};
 use crate::rng::GameRng;
 
@@ -107,6 +109,9 @@ pub fn greatest_erosion(obj: &Object) -> u8 {
 /// Maximum erosion level
 pub const MAX_ERODE: u8 = 3;
 
+/// Weight a heavy iron ball gains per step of extra damage (IRON_BALL_W_INCR)
+pub const IRON_BALL_W_INCR: i32 = 160;
+
 /// Try to erode a weapon from combat.
 ///
 /// Returns true if the weapon was further eroded.
@@ -194,74 +199,164 @@ pub fn buc_damage_bonus(weapon: &Object, target: &Monster, rng: &mut GameRng) ->
 
 /// Calculate base weapon damage against a target monster.
 ///
-/// Based on dmgval() in weapon.c.
-/// Includes base dice, enchantment, erosion penalty, blessed bonus,
-/// and silver bonus. Does NOT include strength, skill, or artifact bonuses.
+/// Based on dmgval() in weapon.c: the table's small or large die, the
+/// per-type extras, enchantment for weapons and weapon-tools, thick hide,
+/// the blessed/axe/silver bonuses, and finally erosion. Does NOT include
+/// strength, skill, or artifact bonuses. Returns 0 for a cream pie or when
+/// enchantment or thick hide cancels the damage, as the C does.
 ///
 /// Parameters:
 /// - `weapon`: The weapon being used
 /// - `weapon_material`: Material of the weapon (from ObjClassDef)
 /// - `target`: The target monster
-/// - `is_large`: Whether to use large monster damage (based on MonsterSize)
+/// - `is_large`: Whether to use large monster damage (bigmonst())
 /// - `rng`: Random number generator
 pub fn dmgval(
     weapon: &Object,
     weapon_material: Material,
     target: &Monster,
-    _is_large: bool,
+    is_large: bool,
     rng: &mut GameRng,
 ) -> i32 {
-    // Base weapon damage from dice
-    let dice_num = if weapon.damage_dice > 0 {
-        weapon.damage_dice
-    } else {
-        1
-    };
-    let dice_sides = if weapon.damage_sides > 0 {
+    let otyp = weapon.object_type;
+    let def = OBJECTS.get(otyp as usize);
+    let name = def.map_or("", |d| d.name);
+    let is = |t: ObjectType| otyp == t as i16;
+
+    if is(ObjectType::CreamPie) {
+        return 0;
+    }
+
+    // Objects built by hand (tests, scripted items) may carry their die on
+    // the object rather than in the table, so fall back to damage_sides.
+    let small = if weapon.damage_sides > 0 {
         weapon.damage_sides
     } else {
-        6
+        def.map_or(0, |d| d.w_small_damage)
     };
+    let large = def.map_or(0, |d| d.w_large_damage);
+    let sides = if is_large && large > 0 { large } else { small };
 
-    let mut tmp = rng.dice(dice_num as u32, dice_sides as u32) as i32;
+    let mut tmp = if sides > 0 {
+        rng.rnd(sides as u32) as i32
+    } else {
+        0
+    };
 
-    // Enchantment bonus (only positive enchantment for damage)
-    if weapon.enchantment > 0 {
-        tmp += weapon.enchantment as i32;
+    if is_large {
+        if name == "iron chain"
+            || is(ObjectType::CrossbowBolt)
+            || is(ObjectType::MorningStar)
+            || is(ObjectType::Partisan)
+            || is(ObjectType::Runesword)
+            || is(ObjectType::ElvenBroadsword)
+            || is(ObjectType::Broadsword)
+        {
+            tmp += 1;
+        } else if is(ObjectType::Flail) || is(ObjectType::Ranseur) || is(ObjectType::Voulge) {
+            tmp += rng.rnd(4) as i32;
+        } else if name == "acid venom" || is(ObjectType::Halberd) || is(ObjectType::Spetum) {
+            tmp += rng.rnd(6) as i32;
+        } else if is(ObjectType::BattleAxe) || is(ObjectType::Bardiche) || is(ObjectType::Trident) {
+            tmp += rng.dice(2, 4) as i32;
+        } else if is(ObjectType::Tsurugi)
+            || is(ObjectType::DwarvishMattock)
+            || is(ObjectType::TwoHandedSword)
+        {
+            tmp += rng.dice(2, 6) as i32;
+        }
+    } else if name == "iron chain"
+        || is(ObjectType::CrossbowBolt)
+        || is(ObjectType::Mace)
+        || is(ObjectType::WarHammer)
+        || is(ObjectType::Flail)
+        || is(ObjectType::Spetum)
+        || is(ObjectType::Trident)
+    {
+        tmp += 1;
+    } else if is(ObjectType::BattleAxe)
+        || is(ObjectType::Bardiche)
+        || is(ObjectType::BillGuisarme)
+        || is(ObjectType::Guisarme)
+        || is(ObjectType::LucernHammer)
+        || is(ObjectType::MorningStar)
+        || is(ObjectType::Ranseur)
+        || is(ObjectType::Broadsword)
+        || is(ObjectType::ElvenBroadsword)
+        || is(ObjectType::Runesword)
+        || is(ObjectType::Voulge)
+    {
+        tmp += rng.rnd(4) as i32;
+    } else if name == "acid venom" {
+        tmp += rng.rnd(6) as i32;
     }
 
-    // Type-specific bonuses
-    let mut bonus = 0;
+    // Enchantment counts for weapons and weapon-tools only; gems, rocks
+    // and other missiles carry spe for other reasons.
+    let is_weapon = weapon.class == ObjectClass::Weapon
+        || (weapon.class == ObjectClass::Tool && def.is_some_and(|d| d.skill != P_NONE));
+    if is_weapon {
+        tmp = (tmp + weapon.enchantment as i32).max(0);
+    }
 
-    // Blessed vs undead/demon: +1d4
-    if weapon.is_blessed() && (target.is_undead() || target.is_demon()) {
-        bonus += rng.rnd(4) as i32;
+    // Thick-skinned monsters shrug off leather and softer
+    if weapon_material as u8 <= Material::Leather as u8
+        && target.flags.contains(MonsterFlags::THICK_HIDE)
+    {
+        tmp = 0;
+    }
+    let ptr = MONSTERS.get(target.monster_type as usize);
+    if ptr.is_some_and(|p| p.name == "shade") && weapon_material != Material::Silver {
+        tmp = 0;
     }
 
-    // Silver weapon vs silver-hating monster: +1d20
-    if weapon_material == Material::Silver && mon_hates_silver(target) {
-        bonus += rng.rnd(20) as i32;
+    // "Very heavy iron ball": weight beyond the base adds damage
+    if is(ObjectType::HeavyIronBall) && tmp > 0 {
+        let base = def.map_or(0, |d| d.weight as i32);
+        if weapon.weight as i32 > base {
+            let incr = (weapon.weight as i32 - base) / IRON_BALL_W_INCR;
+            if incr > 0 {
+                tmp = (tmp + rng.rnd((4 * incr) as u32) as i32).min(25);
+            }
+        }
     }
 
-    tmp += bonus;
+    // Weapon vs. monster type bonuses
+    if is_weapon
+        || matches!(
+            weapon.class,
+            ObjectClass::Gem | ObjectClass::Ball | ObjectClass::Chain
+        )
+    {
+        let mut bonus = 0;
 
-    // Erosion penalty
-    let erosion = greatest_erosion(weapon) as i32;
-    tmp -= erosion;
+        // Blessed vs undead/demon: +1d4
+        if weapon.is_blessed() && (target.is_undead() || target.is_demon()) {
+            bonus += rng.rnd(4) as i32;
+        }
 
-    // Thick-skinned resistance: leather/soft materials do nothing
-    if target.flags.contains(MonsterFlags::THICK_HIDE) && !weapon_material.is_metallic() {
-        // Only block if material is softer than leather
-        match weapon_material {
-            Material::Leather | Material::Cloth | Material::Paper | Material::Veggy => {
-                tmp = 0;
-            }
-            _ => {}
+        // Axe vs wood golem: +1d4
+        if (weapon.class == ObjectClass::Weapon || weapon.class == ObjectClass::Tool)
+            && def.is_some_and(|d| d.skill == P_AXE)
+            && ptr.is_some_and(|p| p.name == "wood golem")
+        {
+            bonus += rng.rnd(4) as i32;
         }
+
+        // Silver weapon vs silver-hating monster: +1d20
+        if weapon_material == Material::Silver && mon_hates_silver(target) {
+            bonus += rng.rnd(20) as i32;
+        }
+
+        tmp += bonus;
     }
 
-    // Minimum 1 damage on a hit
-    tmp.max(1)
+    // Erosion penalty, but a hit always does at least 1
+    if tmp > 0 {
+        tmp = (tmp - greatest_erosion(weapon) as i32).max(1);
+    }
+
+    tmp
 }
 
 /// Calculate bare-hand damage.
@@ -1193,25 +1288,58 @@ pub fn get_weapon_skill(weapon: Option<&Object>) -> WeaponSkill {
     }
 }
 
-/// Calculate weapon hit value against a specific monster (hitval equivalent)
-/// This is a "quality" rating of how good the weapon is against this target.
-pub fn hitval(weapon: &Object, _target: &Monster) -> i32 {
+/// Calculate weapon hit value against a specific monster
+///
+/// Based on hitval() in weapon.c: enchantment for weapons and weapon-tools,
+/// the table's to-hit bonus, and the blessed, spear, trident and pick
+/// bonuses. The trident's extra +2 against a swimmer in water needs the
+/// level and is left to the caller.
+pub fn hitval(weapon: &Object, target: &Monster) -> i32 {
+    let def = OBJECTS.get(weapon.object_type as usize);
+    let ptr = MONSTERS.get(target.monster_type as usize);
+    let is_weapon = weapon.class == ObjectClass::Weapon
+        || (weapon.class == ObjectClass::Tool && def.is_some_and(|d| d.skill != P_NONE));
     let mut hit = 0;
 
-    // Base weapon to-hit bonus
-    hit += weapon.weapon_tohit as i32;
-
-    // Enchantment bonus
-    hit += weapon.enchantment as i32;
+    if is_weapon {
+        hit += weapon.enchantment as i32;
+    }
 
-    // Silver bonus: requires ObjClassDef material lookup on the weapon
-    // (mon_hates_silver check is available but weapon material is not on Object)
+    // Base to-hit bonus from the object table
+    hit += def.map_or(weapon.weapon_tohit as i32, |d| d.bonus as i32);
 
     // Blessed weapons vs undead/demons
-    if weapon.is_blessed() && (_target.is_undead() || _target.is_demon()) {
+    if is_weapon && weapon.is_blessed() && (target.is_undead() || target.is_demon()) {
         hit += 2;
     }
 
+    if let (Some(d), Some(p)) = (def, ptr) {
+        // Spears are good against kebabable monsters
+        if weapon.class == ObjectClass::Weapon
+            && d.skill == P_SPEAR
+            && matches!(p.symbol, 'X' | 'D' | 'J' | 'N' | 'H')
+        {
+            hit += 2;
+        }
+
+        // Tridents are good against eels and snakes
+        if weapon.object_type == ObjectType::Trident as i16
+            && p.swims()
+            && matches!(p.symbol, ';' | 'S')
+        {
+            hit += 2;
+        }
+
+        // Picks are good against wall-walking xorns
+        if d.skill == P_PICK_AXE
+            && matches!(weapon.class, ObjectClass::Weapon | ObjectClass::Tool)
+            && p.passes_walls()
+            && p.flags.contains(MonsterFlags::THICK_HIDE)
+        {
+            hit += 2;
+        }
+    }
+
     hit
 }
 
@@ -7,6 +7,7 @@ pub mod colors;
 pub mod monsters;
 pub mod objects;
 pub mod roles;
+pub mod static_tables;
 pub mod tile;
 
 pub use artifacts::{
@@ -19,3 +20,4 @@ pub use roles::{
     Advancement, RACES, ROLES, Race, Role, RoleName, StartingItem, find_race, find_role, get_race,
     get_role, num_races, num_roles, race_allows_alignment, role_allows_alignment, role_allows_race,
 };
+pub use static_tables::StaticTables;
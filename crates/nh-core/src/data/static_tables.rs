@@ -0,0 +1,426 @@
+//! Static tables exported by the C engine
+//!
+//! A zero-copy view of the blob `nh_ffi_export_static_tables` writes (layout
+//! in nh-test's `nethack_ffi_types.h`): mons[], objects[], the artifact
+//! names, roles[] and races[] of the linked NetHack, with a string pool.
+//! The harness caches the blob on disk and maps it, so the C tables can be
+//! compared against the Rust ones without parsing the C sources.
+
+#[cfg(not(feature = "std"))]
+use crate::compat::*;
+
+/// "NHST" little-endian
+pub const STATIC_MAGIC: u32 = 0x5453_484E;
+pub const STATIC_VERSION: u16 = 1;
+pub const STATIC_HEADER_SIZE: usize = 80;
+
+const NONE: u32 = 0xFFFF_FFFF;
+
+const FNV_OFFSET: u64 = 0xcbf2_9ce4_8422_2325;
+const FNV_PRIME: u64 = 0x0100_0000_01b3;
+
+/// 64-bit FNV-1a, as the C side computes `content_hash`
+pub fn fnv1a64(bytes: &[u8]) -> u64 {
+    bytes.iter().fold(FNV_OFFSET, |h, &b| (h ^ b as u64).wrapping_mul(FNV_PRIME))
+}
+
+/// Sections in file order
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum Section {
+    Monsters = 0,
+    Objects = 1,
+    Artifacts = 2,
+    Roles = 3,
+    Races = 4,
+}
+
+const NSECTIONS: usize = 5;
+/// Smallest record of each section a version-1 reader understands
+const MIN_RECORD_SIZES: [usize; NSECTIONS] = [60, 28, 8, 100, 20];
+
+#[derive(Debug, Clone, Copy, Default)]
+struct SectionInfo {
+    offset: usize,
+    count: usize,
+    record_size: usize,
+}
+
+fn u16_at(b: &[u8], off: usize) -> u16 {
+    u16::from_le_bytes([b[off], b[off + 1]])
+}
+
+fn u32_at(b: &[u8], off: usize) -> u32 {
+    u32::from_le_bytes([b[off], b[off + 1], b[off + 2], b[off + 3]])
+}
+
+fn u64_at(b: &[u8], off: usize) -> u64 {
+    u64::from(u32_at(b, off)) | u64::from(u32_at(b, off + 4)) << 32
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct StaticAttack {
+    pub aatyp: u8,
+    pub adtyp: u8,
+    pub damn: u8,
+    pub damd: u8,
+}
+
+/// One `mons[]` entry
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct StaticMonster<'a> {
+    pub name: &'a str,
+    /// Monster class (`mlet`)
+    pub class: u8,
+    pub level: i8,
+    pub speed: i8,
+    pub ac: i8,
+    pub mr: i8,
+    pub alignment: i8,
+    pub geno: u16,
+    pub attacks: [StaticAttack; 6],
+    pub weight: u16,
+    pub nutrition: u16,
+    pub sound: u8,
+    pub size: u8,
+    pub resists: u8,
+    pub conveys: u8,
+    pub flags1: u32,
+    pub flags2: u32,
+    pub flags3: u32,
+    pub difficulty: u8,
+    pub color: u8,
+}
+
+/// One `objects[]` entry, with its unshuffled name and description
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct StaticObject<'a> {
+    pub name: Option<&'a str>,
+    pub description: Option<&'a str>,
+    pub class: u8,
+    pub material: u8,
+    pub color: u8,
+    pub oprop: u8,
+    pub weight: u16,
+    pub cost: i16,
+    pub prob: i16,
+    pub nutrition: u16,
+    pub small_damage: i8,
+    pub large_damage: i8,
+    pub oc1: i8,
+    pub oc2: i8,
+    pub subtype: i8,
+    pub delay: i8,
+    /// `StaticObject::MERGE` etc.
+    pub flags: u8,
+}
+
+impl StaticObject<'_> {
+    pub const MERGE: u8 = 0x01;
+    pub const MAGIC: u8 = 0x02;
+    pub const CHARGED: u8 = 0x04;
+    pub const UNIQUE: u8 = 0x08;
+    pub const NOWISH: u8 = 0x10;
+    pub const BIG: u8 = 0x20;
+    pub const TOUGH: u8 = 0x40;
+}
+
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct StaticArtifact<'a> {
+    pub name: Option<&'a str>,
+    /// Base object type
+    pub otyp: i16,
+}
+
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct StaticRole<'a> {
+    pub name: &'a str,
+    pub female_name: Option<&'a str>,
+    /// (male, female) rank titles, lowest first
+    pub ranks: [(Option<&'a str>, Option<&'a str>); 9],
+    /// Lawful, neutral and chaotic gods; `None` for priests' random pantheon
+    pub gods: [Option<&'a str>; 3],
+    pub filecode: Option<&'a str>,
+    pub male_num: i16,
+    pub female_num: i16,
+}
+
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct StaticRace<'a> {
+    pub noun: &'a str,
+    pub adjective: Option<&'a str>,
+    pub collective: Option<&'a str>,
+    pub filecode: Option<&'a str>,
+    pub male_num: i16,
+    pub female_num: i16,
+}
+
+/// Validated view of a static tables blob
+#[derive(Debug, Clone, Copy)]
+pub struct StaticTables<'a> {
+    bytes: &'a [u8],
+    sections: [SectionInfo; NSECTIONS],
+    strings: &'a [u8],
+    source_id: u64,
+    content_hash: u64,
+}
+
+impl<'a> StaticTables<'a> {
+    /// Check the header, section bounds and content hash of `bytes`.
+    pub fn parse(bytes: &'a [u8]) -> Result<Self, String> {
+        if bytes.len() < STATIC_HEADER_SIZE {
+            return Err(format!("Static tables too short: {} bytes", bytes.len()));
+        }
+        if u32_at(bytes, 0) != STATIC_MAGIC {
+            return Err(format!("Bad static tables magic: {:#x}", u32_at(bytes, 0)));
+        }
+        let (version, header_size) = (u16_at(bytes, 4), u16_at(bytes, 6) as usize);
+        if version != STATIC_VERSION || header_size != STATIC_HEADER_SIZE {
+            return Err(format!("Unsupported static tables version {} (header {} bytes)", version, header_size));
+        }
+        let total = u32_at(bytes, 8) as usize;
+        if total != bytes.len() {
+            return Err(format!("Static tables truncated: {} of {} bytes", bytes.len(), total));
+        }
+
+        let mut sections = [SectionInfo::default(); NSECTIONS];
+        for (i, s) in sections.iter_mut().enumerate() {
+            let at = 32 + i * 8;
+            *s = SectionInfo {
+                offset: u32_at(bytes, at) as usize,
+                count: u16_at(bytes, at + 4) as usize,
+                record_size: u16_at(bytes, at + 6) as usize,
+            };
+            if (s.count > 0 && s.record_size < MIN_RECORD_SIZES[i])
+                || s.offset.checked_add(s.count * s.record_size).is_none_or(|end| end > total)
+            {
+                return Err(format!("Bad static tables section {} at {}", i, s.offset));
+            }
+        }
+        let (strings_off, strings_size) = (u32_at(bytes, 72) as usize, u32_at(bytes, 76) as usize);
+        if strings_off.checked_add(strings_size).is_none_or(|end| end > total) {
+            return Err(format!("Bad static tables strings at {}", strings_off));
+        }
+
+        let content_hash = u64_at(bytes, 16);
+        if fnv1a64(&bytes[STATIC_HEADER_SIZE..]) != content_hash {
+            return Err("Static tables content hash mismatch".to_string());
+        }
+        Ok(Self {
+            bytes,
+            sections,
+            strings: &bytes[strings_off..strings_off + strings_size],
+            source_id: u64_at(bytes, 24),
+            content_hash,
+        })
+    }
+
+    /// Build of the C library that wrote the tables
+    pub fn source_id(&self) -> u64 {
+        self.source_id
+    }
+
+    pub fn content_hash(&self) -> u64 {
+        self.content_hash
+    }
+
+    pub fn as_bytes(&self) -> &'a [u8] {
+        self.bytes
+    }
+
+    fn len(&self, section: Section) -> usize {
+        self.sections[section as usize].count
+    }
+
+    fn record(&self, section: Section, i: usize) -> &'a [u8] {
+        let s = self.sections[section as usize];
+        &self.bytes[s.offset + i * s.record_size..s.offset + (i + 1) * s.record_size]
+    }
+
+    /// Pooled string at `off`; `None` for NULL or a bad offset.
+    fn string(&self, off: u32) -> Option<&'a str> {
+        if off == NONE {
+            return None;
+        }
+        let tail = self.strings.get(off as usize..)?;
+        let end = tail.iter().position(|&b| b == 0)?;
+        core::str::from_utf8(&tail[..end]).ok()
+    }
+
+    fn records<T: 'a>(
+        &self,
+        section: Section,
+        decode: fn(&Self, &'a [u8]) -> T,
+    ) -> impl ExactSizeIterator<Item = T> + 'a {
+        let tables = *self;
+        (0..self.len(section)).map(move |i| decode(&tables, tables.record(section, i)))
+    }
+
+    pub fn monsters(&self) -> impl ExactSizeIterator<Item = StaticMonster<'a>> + 'a {
+        self.records(Section::Monsters, |t, r| StaticMonster {
+            name: t.string(u32_at(r, 0)).unwrap_or(""),
+            class: r[4],
+            level: r[5] as i8,
+            speed: r[6] as i8,
+            ac: r[7] as i8,
+            mr: r[8] as i8,
+            alignment: r[9] as i8,
+            geno: u16_at(r, 10),
+            attacks: core::array::from_fn(|j| {
+                let a = &r[12 + j * 4..16 + j * 4];
+                StaticAttack { aatyp: a[0], adtyp: a[1], damn: a[2], damd: a[3] }
+            }),
+            weight: u16_at(r, 36),
+            nutrition: u16_at(r, 38),
+            sound: r[40],
+            size: r[41],
+            resists: r[42],
+            conveys: r[43],
+            flags1: u32_at(r, 44),
+            flags2: u32_at(r, 48),
+            flags3: u32_at(r, 52),
+            difficulty: r[56],
+            color: r[57],
+        })
+    }
+
+    pub fn objects(&self) -> impl ExactSizeIterator<Item = StaticObject<'a>> + 'a {
+        self.records(Section::Objects, |t, r| StaticObject {
+            name: t.string(u32_at(r, 0)),
+            description: t.string(u32_at(r, 4)),
+            class: r[8],
+            material: r[9],
+            color: r[10],
+            oprop: r[11],
+            weight: u16_at(r, 12),
+            cost: u16_at(r, 14) as i16,
+            prob: u16_at(r, 16) as i16,
+            nutrition: u16_at(r, 18),
+            small_damage: r[20] as i8,
+            large_damage: r[21] as i8,
+            oc1: r[22] as i8,
+            oc2: r[23] as i8,
+            subtype: r[24] as i8,
+            delay: r[25] as i8,
+            flags: r[26],
+        })
+    }
+
+    /// Artifacts 1..=NROFARTIFACTS, in order
+    pub fn artifacts(&self) -> impl ExactSizeIterator<Item = StaticArtifact<'a>> + 'a {
+        self.records(Section::Artifacts, |t, r| StaticArtifact {
+            name: t.string(u32_at(r, 0)),
+            otyp: u16_at(r, 4) as i16,
+        })
+    }
+
+    pub fn roles(&self) -> impl ExactSizeIterator<Item = StaticRole<'a>> + 'a {
+        self.records(Section::Roles, |t, r| StaticRole {
+            name: t.string(u32_at(r, 0)).unwrap_or(""),
+            female_name: t.string(u32_at(r, 4)),
+            ranks: core::array::from_fn(|j| (t.string(u32_at(r, 8 + j * 4)), t.string(u32_at(r, 44 + j * 4)))),
+            gods: core::array::from_fn(|j| t.string(u32_at(r, 80 + j * 4))),
+            filecode: t.string(u32_at(r, 92)),
+            male_num: u16_at(r, 96) as i16,
+            female_num: u16_at(r, 98) as i16,
+        })
+    }
+
+    pub fn races(&self) -> impl ExactSizeIterator<Item = StaticRace<'a>> + 'a {
+        self.records(Section::Races, |t, r| StaticRace {
+            noun: t.string(u32_at(r, 0)).unwrap_or(""),
+            adjective: t.string(u32_at(r, 4)),
+            collective: t.string(u32_at(r, 8)),
+            filecode: t.string(u32_at(r, 12)),
+            male_num: u16_at(r, 16) as i16,
+            female_num: u16_at(r, 18) as i16,
+        })
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// A blob with one monster and one race, laid out as the C side does
+    fn sample() -> Vec<u8> {
+        let strings = b"giant ant\0human\0";
+        let mut monster = vec![0u8; 60];
+        monster[4] = 1; // S_ANT
+        monster[5] = 2;
+        monster[6] = 18;
+        monster[7] = 3;
+        monster[12..16].copy_from_slice(&[1, 1, 1, 4]); // AT_BITE AD_PHYS 1d4
+        monster[36..38].copy_from_slice(&10u16.to_le_bytes());
+        let mut race = vec![0u8; 20];
+        race[0..4].copy_from_slice(&10u32.to_le_bytes());
+        for off in [4, 8, 12] {
+            race[off..off + 4].copy_from_slice(&NONE.to_le_bytes());
+        }
+
+        let monsters_off = STATIC_HEADER_SIZE;
+        let races_off = monsters_off + monster.len();
+        let strings_off = races_off + race.len();
+        let total = strings_off + strings.len();
+
+        let mut out = vec![0u8; STATIC_HEADER_SIZE];
+        out[0..4].copy_from_slice(&STATIC_MAGIC.to_le_bytes());
+        out[4..6].copy_from_slice(&STATIC_VERSION.to_le_bytes());
+        out[6..8].copy_from_slice(&(STATIC_HEADER_SIZE as u16).to_le_bytes());
+        out[8..12].copy_from_slice(&(total as u32).to_le_bytes());
+        out[24..32].copy_from_slice(&7u64.to_le_bytes());
+        let sections = [(monsters_off, 1, 60), (races_off, 0, 28), (races_off, 0, 8), (races_off, 0, 100), (races_off, 1, 20)];
+        for (i, (offset, count, size)) in sections.into_iter().enumerate() {
+            let at = 32 + i * 8;
+            out[at..at + 4].copy_from_slice(&(offset as u32).to_le_bytes());
+            out[at + 4..at + 6].copy_from_slice(&(count as u16).to_le_bytes());
+            out[at + 6..at + 8].copy_from_slice(&(size as u16).to_le_bytes());
+        }
+        out[72..76].copy_from_slice(&(strings_off as u32).to_le_bytes());
+        out[76..80].copy_from_slice(&(strings.len() as u32).to_le_bytes());
+        out.extend_from_slice(&monster);
+        out.extend_from_slice(&race);
+        out.extend_from_slice(strings);
+        let hash = fnv1a64(&out[STATIC_HEADER_SIZE..]);
+        out[16..24].copy_from_slice(&hash.to_le_bytes());
+        out
+    }
+
+    #[test]
+    fn test_fnv1a64_reference_values() {
+        assert_eq!(fnv1a64(b""), 0xcbf2_9ce4_8422_2325);
+        assert_eq!(fnv1a64(b"a"), 0xaf63_dc4c_8601_ec8c);
+    }
+
+    #[test]
+    fn test_parse_decodes_records() {
+        let bytes = sample();
+        let tables = StaticTables::parse(&bytes).unwrap();
+        assert_eq!(tables.source_id(), 7);
+
+        let monsters: Vec<_> = tables.monsters().collect();
+        assert_eq!(monsters.len(), 1);
+        assert_eq!(monsters[0].name, "giant ant");
+        assert_eq!((monsters[0].level, monsters[0].speed, monsters[0].ac), (2, 18, 3));
+        assert_eq!(monsters[0].attacks[0], StaticAttack { aatyp: 1, adtyp: 1, damn: 1, damd: 4 });
+        assert_eq!(monsters[0].weight, 10);
+
+        let races: Vec<_> = tables.races().collect();
+        assert_eq!(races[0].noun, "human");
+        assert_eq!(races[0].adjective, None);
+        assert_eq!(tables.objects().len(), 0);
+    }
+
+    #[test]
+    fn test_parse_rejects_damage() {
+        let bytes = sample();
+        assert!(StaticTables::parse(&bytes[..bytes.len() - 1]).is_err());
+
+        let mut corrupt = bytes.clone();
+        *corrupt.last_mut().unwrap() ^= 1;
+        assert!(StaticTables::parse(&corrupt).unwrap_err().contains("hash"));
+
+        let mut old = bytes;
+        old[4] = 0;
+        assert!(StaticTables::parse(&old).is_err());
+    }
+}
@@ -4330,12 +4330,7 @@ fn blessorcurse_c_rng(rng: &mut GameRng, chance: u32) {
 
 /// C's rne(x) during level generation (player_level=1, utmp=5)
 fn rne_c_rng(rng: &mut GameRng, x: u32) -> u32 {
-    let utmp = 5u32;
-    let mut tmp = 1u32;
-    while tmp < utmp && rng.rn2(x) == 0 {
-        tmp += 1;
-    }
-    tmp
+    rng.rne(x)
 }
 
 /// C's rndmonnum(): calls rndmonst() which consumes 1 rn2 call.
@@ -0,0 +1,243 @@
+//! Bit-packed level planes
+//!
+//! One fixed wire format for the per-cell state both engines compare:
+//! three bit planes (in sight, could see, lit) and a byte plane of cell
+//! types, all row-major. The C engine writes it with `nh_ffi_export_grid`
+//! (layout in nh-test's `nethack_ffi_types.h`); `GridPlanes::from_level`
+//! builds the same planes from a Rust level, so two exports compare with
+//! a word compare per row.
+//!
+//! Bit `x % 64` of word `y * GRID_ROW_WORDS + x / 64` of a bit plane is
+//! cell `(x, y)`. Words are little-endian on the wire.
+
+#[cfg(not(feature = "std"))]
+use crate::compat::*;
+
+use super::Level;
+use crate::{COLNO, ROWNO};
+
+/// "NHGP" little-endian
+pub const GRID_MAGIC: u32 = 0x5047_484E;
+pub const GRID_VERSION: u16 = 1;
+pub const GRID_HEADER_SIZE: usize = 32;
+
+/// `u64` words per bit-plane row
+pub const GRID_ROW_WORDS: usize = COLNO.div_ceil(64);
+
+const PLANE_WORDS: usize = ROWNO * GRID_ROW_WORDS;
+const NBITPLANES: usize = 3;
+
+/// Encoded size of every grid export
+pub const GRID_SIZE: usize = GRID_HEADER_SIZE + NBITPLANES * PLANE_WORDS * 8 + COLNO * ROWNO;
+
+/// Bit planes, in wire order
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum GridPlane {
+    /// C: `viz_array[y][x] & IN_SIGHT`
+    InSight = 0,
+    /// C: `viz_array[y][x] & COULD_SEE`
+    CouldSee = 1,
+    /// C: `levl[x][y].lit`
+    Lit = 2,
+}
+
+impl GridPlane {
+    pub const ALL: [GridPlane; NBITPLANES] = [GridPlane::InSight, GridPlane::CouldSee, GridPlane::Lit];
+}
+
+/// First cell where two grids differ
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct GridDifference {
+    /// `None` for the cell type plane
+    pub plane: Option<GridPlane>,
+    pub x: usize,
+    pub y: usize,
+}
+
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct GridPlanes {
+    bits: [[u64; PLANE_WORDS]; NBITPLANES],
+    /// Row-major `CellType` numbers
+    typ: Vec<u8>,
+}
+
+impl Default for GridPlanes {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl GridPlanes {
+    /// All planes clear; every cell is stone.
+    pub fn new() -> Self {
+        Self { bits: [[0; PLANE_WORDS]; NBITPLANES], typ: vec![0; COLNO * ROWNO] }
+    }
+
+    pub fn from_level(level: &Level) -> Self {
+        let mut grid = Self::new();
+        // Walk the column-major grids in storage order; the output fits in
+        // L1, so its scattered writes are cheap
+        for x in 0..COLNO {
+            let (word, bit) = (x / 64, x % 64);
+            for y in 0..ROWNO {
+                let cell = &level.cells[x][y];
+                let i = y * GRID_ROW_WORDS + word;
+                grid.bits[GridPlane::InSight as usize][i] |= (level.visible[x][y] as u64) << bit;
+                grid.bits[GridPlane::CouldSee as usize][i] |= (level.couldsee[x][y] as u64) << bit;
+                grid.bits[GridPlane::Lit as usize][i] |= (cell.lit as u64) << bit;
+                grid.typ[y * COLNO + x] = cell.typ as u8;
+            }
+        }
+        grid
+    }
+
+    pub fn get(&self, plane: GridPlane, x: usize, y: usize) -> bool {
+        (self.bits[plane as usize][y * GRID_ROW_WORDS + x / 64] >> (x % 64)) & 1 != 0
+    }
+
+    pub fn set(&mut self, plane: GridPlane, x: usize, y: usize, value: bool) {
+        let word = &mut self.bits[plane as usize][y * GRID_ROW_WORDS + x / 64];
+        *word = (*word & !(1 << (x % 64))) | ((value as u64) << (x % 64));
+    }
+
+    /// Words of row `y` of a bit plane
+    pub fn row(&self, plane: GridPlane, y: usize) -> &[u64] {
+        &self.bits[plane as usize][y * GRID_ROW_WORDS..(y + 1) * GRID_ROW_WORDS]
+    }
+
+    pub fn typ(&self, x: usize, y: usize) -> u8 {
+        self.typ[y * COLNO + x]
+    }
+
+    pub fn set_typ(&mut self, x: usize, y: usize, typ: u8) {
+        self.typ[y * COLNO + x] = typ;
+    }
+
+    /// Cells set in a bit plane
+    pub fn count(&self, plane: GridPlane) -> usize {
+        self.bits[plane as usize].iter().map(|w| w.count_ones() as usize).sum()
+    }
+
+    /// First difference in plane order, then row-major.
+    pub fn first_difference(&self, other: &GridPlanes) -> Option<GridDifference> {
+        for plane in GridPlane::ALL {
+            let (a, b) = (&self.bits[plane as usize], &other.bits[plane as usize]);
+            if let Some(i) = (0..PLANE_WORDS).find(|&i| a[i] != b[i]) {
+                let x = (i % GRID_ROW_WORDS) * 64 + (a[i] ^ b[i]).trailing_zeros() as usize;
+                return Some(GridDifference { plane: Some(plane), x, y: i / GRID_ROW_WORDS });
+            }
+        }
+        let i = self.typ.iter().zip(&other.typ).position(|(a, b)| a != b)?;
+        Some(GridDifference { plane: None, x: i % COLNO, y: i / COLNO })
+    }
+
+    pub fn encode(&self) -> Vec<u8> {
+        let bits_off = GRID_HEADER_SIZE;
+        let typ_off = bits_off + NBITPLANES * PLANE_WORDS * 8;
+        let mut out = Vec::with_capacity(GRID_SIZE);
+        out.extend_from_slice(&GRID_MAGIC.to_le_bytes());
+        out.extend_from_slice(&GRID_VERSION.to_le_bytes());
+        out.extend_from_slice(&(GRID_HEADER_SIZE as u16).to_le_bytes());
+        out.extend_from_slice(&(GRID_SIZE as u32).to_le_bytes());
+        out.extend_from_slice(&[COLNO as u8, ROWNO as u8, NBITPLANES as u8, GRID_ROW_WORDS as u8]);
+        out.extend_from_slice(&(bits_off as u32).to_le_bytes());
+        out.extend_from_slice(&(typ_off as u32).to_le_bytes());
+        out.resize(GRID_HEADER_SIZE, 0);
+        for plane in &self.bits {
+            for word in plane {
+                out.extend_from_slice(&word.to_le_bytes());
+            }
+        }
+        out.extend_from_slice(&self.typ);
+        out
+    }
+
+    /// Decode and validate an encoded grid.
+    pub fn decode(bytes: &[u8]) -> Result<Self, String> {
+        let u16_at = |off: usize| u16::from_le_bytes([bytes[off], bytes[off + 1]]);
+        let u32_at = |off: usize| u32::from_le_bytes(bytes[off..off + 4].try_into().unwrap());
+
+        if bytes.len() < GRID_HEADER_SIZE {
+            return Err(format!("Grid too short: {} bytes", bytes.len()));
+        }
+        if u32_at(0) != GRID_MAGIC {
+            return Err(format!("Bad grid magic: {:#x}", u32_at(0)));
+        }
+        if u16_at(4) != GRID_VERSION || u16_at(6) as usize != GRID_HEADER_SIZE {
+            return Err(format!("Unsupported grid version {} (header {} bytes)", u16_at(4), u16_at(6)));
+        }
+        let shape = [COLNO as u8, ROWNO as u8, NBITPLANES as u8, GRID_ROW_WORDS as u8];
+        if bytes[12..16] != shape {
+            return Err(format!("Unexpected grid shape {:?}", &bytes[12..16]));
+        }
+        let (total, bits_off, typ_off) = (u32_at(8) as usize, u32_at(16) as usize, u32_at(20) as usize);
+        if total != bytes.len()
+            || bits_off + NBITPLANES * PLANE_WORDS * 8 > total
+            || typ_off + COLNO * ROWNO > total
+        {
+            return Err(format!("Bad grid layout: {} bytes, planes at {} and {}", total, bits_off, typ_off));
+        }
+
+        let mut grid = Self::new();
+        for (p, plane) in grid.bits.iter_mut().enumerate() {
+            let base = bits_off + p * PLANE_WORDS * 8;
+            for (i, word) in plane.iter_mut().enumerate() {
+                *word = u64::from_le_bytes(bytes[base + i * 8..base + i * 8 + 8].try_into().unwrap());
+            }
+        }
+        grid.typ.copy_from_slice(&bytes[typ_off..typ_off + COLNO * ROWNO]);
+        Ok(grid)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::dungeon::{CellType, DLevel};
+
+    #[test]
+    fn test_planes_are_row_major() {
+        let mut level = Level::new(DLevel::new(0, 1));
+        level.visible[70][3] = true;
+        level.couldsee[0][20] = true;
+        level.cells[63][0].lit = true;
+        level.cells[64][0].typ = CellType::Room;
+
+        let grid = GridPlanes::from_level(&level);
+        assert!(grid.get(GridPlane::InSight, 70, 3));
+        assert_eq!(grid.row(GridPlane::InSight, 3), &[0, 1 << 6]);
+        assert!(grid.get(GridPlane::CouldSee, 0, 20));
+        assert_eq!(grid.row(GridPlane::Lit, 0), &[1 << 63, 0]);
+        assert_eq!(grid.typ(64, 0), CellType::Room as u8);
+        assert_eq!(GridPlane::ALL.map(|p| grid.count(p)), [1, 1, 1]);
+    }
+
+    #[test]
+    fn test_encode_round_trips() {
+        let mut grid = GridPlanes::new();
+        grid.set(GridPlane::Lit, 79, 20, true);
+        grid.set_typ(5, 7, CellType::Door as u8);
+        let bytes = grid.encode();
+        assert_eq!(bytes.len(), GRID_SIZE);
+        assert_eq!(GridPlanes::decode(&bytes).unwrap(), grid);
+
+        assert!(GridPlanes::decode(&bytes[..GRID_SIZE - 1]).is_err());
+        let mut bad = bytes.clone();
+        bad[12] = 40;
+        assert!(GridPlanes::decode(&bad).is_err());
+    }
+
+    #[test]
+    fn test_first_difference() {
+        let a = GridPlanes::new();
+        let mut b = a.clone();
+        assert_eq!(a.first_difference(&b), None);
+        b.set_typ(3, 2, 1);
+        assert_eq!(a.first_difference(&b), Some(GridDifference { plane: None, x: 3, y: 2 }));
+        b.set(GridPlane::CouldSee, 66, 9, true);
+        assert_eq!(
+            a.first_difference(&b),
+            Some(GridDifference { plane: Some(GridPlane::CouldSee), x: 66, y: 9 })
+        );
+    }
+}
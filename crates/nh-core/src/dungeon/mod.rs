@@ -10,6 +10,7 @@ pub mod drawbridge;
 pub mod economy;
 mod endgame;
 pub mod generation;
+mod grid_planes;
 mod level;
 mod mapseen;
 mod maze;
@@ -83,6 +84,9 @@ pub use dlevel::{
 };
 pub use endgame::{Plane, WaterBubble, create_water_bubbles, generate_plane, update_water_level};
 pub use generation::generate_rooms_and_corridors;
+pub use grid_planes::{
+    GRID_MAGIC, GRID_ROW_WORDS, GRID_SIZE, GRID_VERSION, GridDifference, GridPlane, GridPlanes,
+};
 pub(crate) use generation::random_monster_name_for_type;
 pub use generation::{
     NO_ROOM,
@@ -23,6 +23,9 @@ pub(crate) mod compat {
     pub use alloc::vec::Vec;
 }
 
+#[cfg(not(feature = "std"))]
+use compat::*;
+
 pub mod action;
 pub mod combat;
 pub mod data;
@@ -67,6 +70,91 @@ pub trait CGameEngineTrait {
     fn race(&self) -> String;
     fn gender_string(&self) -> String;
     fn alignment_string(&self) -> String;
+
+    /// The whole player state, inventory and monster list in one query.
+    ///
+    /// Engines behind a process boundary override this so a full sync is a
+    /// single round trip. The default reads the scalar getters one by one
+    /// and leaves inventory and monsters empty.
+    fn snapshot(&self) -> Result<CGameSnapshot, String> {
+        let (x, y) = self.position();
+        Ok(CGameSnapshot {
+            hp: self.hp(),
+            hp_max: self.max_hp(),
+            energy: self.energy(),
+            energy_max: self.max_energy(),
+            x,
+            y,
+            level: self.current_level(),
+            experience_level: self.experience_level(),
+            armor_class: self.armor_class(),
+            gold: self.gold(),
+            is_dead: self.is_dead(),
+            turn_count: self.turn_count(),
+            dungeon_depth: self.dungeon_depth(),
+            ..CGameSnapshot::default()
+        })
+    }
+}
+
+/// C engine state returned by [`CGameEngineTrait::snapshot`]; mirrors
+/// `struct nh_ffi_game_state` in nh-test's `nethack_ffi_types.h`.
+#[derive(Debug, Clone, Default, PartialEq, Eq, serde::Serialize, serde::Deserialize)]
+pub struct CGameSnapshot {
+    pub hp: i32,
+    pub hp_max: i32,
+    pub energy: i32,
+    pub energy_max: i32,
+    pub x: i32,
+    pub y: i32,
+    pub level: i32,
+    pub experience_level: i32,
+    pub armor_class: i32,
+    pub gold: i32,
+    pub strength: i32,
+    pub dexterity: i32,
+    pub constitution: i32,
+    pub intelligence: i32,
+    pub wisdom: i32,
+    pub charisma: i32,
+    pub is_dead: bool,
+    pub hunger_state: i32,
+    pub turn_count: u64,
+    pub dungeon_depth: i32,
+    pub monster_count: i32,
+    pub inventory: Vec<CObjectSnapshot>,
+    pub monsters: Vec<CMonsterSnapshot>,
+}
+
+/// One inventory item of a [`CGameSnapshot`] (`struct nh_ffi_object`)
+#[derive(Debug, Clone, Default, PartialEq, Eq, serde::Serialize, serde::Deserialize)]
+pub struct CObjectSnapshot {
+    pub name: String,
+    pub obj_class: char,
+    pub weight: i32,
+    pub value: i32,
+    pub quantity: i32,
+    pub enchantment: i32,
+    pub cursed: bool,
+    pub blessed: bool,
+    pub armor_class: i32,
+    pub damage: i32,
+    pub inv_letter: char,
+}
+
+/// One monster on the level of a [`CGameSnapshot`] (`struct nh_ffi_monster`)
+#[derive(Debug, Clone, Default, PartialEq, Eq, serde::Serialize, serde::Deserialize)]
+pub struct CMonsterSnapshot {
+    pub name: String,
+    pub symbol: char,
+    pub level: i32,
+    pub hp: i32,
+    pub max_hp: i32,
+    pub armor_class: i32,
+    pub x: i32,
+    pub y: i32,
+    pub asleep: bool,
+    pub peaceful: bool,
 }
 
 mod consts;
@@ -791,16 +791,7 @@ fn rne(rng: &mut GameRng, x: u32) -> u32 {
 
 /// rne with explicit player level (for testing and contexts where level is known)
 fn rne_at_level(rng: &mut GameRng, x: u32, player_level: u32) -> u32 {
-    let utmp = if player_level < 15 {
-        5
-    } else {
-        player_level / 3
-    };
-    let mut tmp = 1;
-    while tmp < utmp && rng.rn2(x) == 0 {
-        tmp += 1;
-    }
-    tmp
+    rng.rne_at_level(x, player_level)
 }
 
 /// Randomly bless or curse an object
@@ -108,6 +108,11 @@ impl GameRng {
         self.rng.rne(x, 1)
     }
 
+    /// rne(x) for a hero of experience level `player_level`
+    pub fn rne_at_level(&mut self, x: u32, player_level: u32) -> u32 {
+        self.rng.rne(x, player_level)
+    }
+
     /// Choose a random element from a slice
     pub fn choose<'a, T>(&mut self, items: &'a [T]) -> Option<&'a T> {
         if items.is_empty() {
@@ -145,6 +150,17 @@ impl GameRng {
         self.rng.get_trace()
     }
 
+    /// Start a rolling hash of every rn2/rnd/rnl/rne/rnz call (see
+    /// `nh_rng::hash_rng_call`)
+    pub fn enable_hashing(&mut self) {
+        self.rng.enable_hashing();
+    }
+
+    /// Rolling hash of the calls made since `enable_hashing()`
+    pub fn rng_hash(&self) -> u64 {
+        self.rng.rng_hash()
+    }
+
     /// Total number of raw u64 calls consumed
     pub fn call_count(&self) -> u64 {
         self.rng.call_count()
@@ -9,6 +9,33 @@ use serde::{Deserialize, Serialize};
 const ISAAC64_SZ_LOG: usize = 8;
 const ISAAC64_SZ: usize = 1 << ISAAC64_SZ_LOG;
 
+/// `hash_rng_call` function codes, matching `NH_FFI_RNG_FN_*` in nh-test's
+/// `nethack_ffi_types.h`
+pub const RNG_FN_RN2: u8 = 0;
+pub const RNG_FN_RND: u8 = 1;
+pub const RNG_FN_RNE: u8 = 2;
+pub const RNG_FN_RNZ: u8 = 3;
+pub const RNG_FN_RNL: u8 = 4;
+
+/// Starting value of a rolling hash (the FNV-1a offset basis)
+pub const HASH_SEED: u64 = 0xcbf2_9ce4_8422_2325;
+const HASH_PRIME: u64 = 0x0000_0100_0000_01b3;
+
+/// Fold one word into a rolling hash: FNV-1a over 64-bit words rather
+/// than bytes, so the C side can mirror it with three multiplies a call.
+#[inline]
+pub fn hash_word(h: u64, word: u64) -> u64 {
+    (h ^ word).wrapping_mul(HASH_PRIME)
+}
+
+/// Fold one RNG call into a rolling hash, as `nethack_ffi.c` does for
+/// every call it traces. Signed arguments and results are passed
+/// sign-extended, as C folds them.
+#[inline]
+pub fn hash_rng_call(h: u64, func: u8, arg: u64, result: u64) -> u64 {
+    hash_word(hash_word(hash_word(h, func as u64), arg), result)
+}
+
 /// An RNG call trace entry for debugging divergences.
 #[derive(Debug, Clone, Serialize, Deserialize)]
 pub struct RngTraceEntry {
@@ -47,6 +74,12 @@ pub struct Isaac64 {
     /// Trace log (only populated when tracing is true)
     #[serde(skip)]
     trace: Vec<RngTraceEntry>,
+    /// If true, fold every call into `hash`
+    #[serde(skip)]
+    hashing: bool,
+    /// Rolling `hash_rng_call` hash of the calls made while hashing
+    #[serde(skip)]
+    hash: u64,
 }
 
 impl core::fmt::Debug for Isaac64 {
@@ -81,6 +114,8 @@ impl Isaac64 {
             call_count: 0,
             tracing: false,
             trace: Vec::new(),
+            hashing: false,
+            hash: HASH_SEED,
         };
 
         ctx.init(&seed_bytes);
@@ -273,6 +308,44 @@ impl Isaac64 {
         val
     }
 
+    /// Fill `out` with the next values of the stream, in `next_u64` order.
+    pub fn fill(&mut self, out: &mut [u64]) {
+        let mut out = out;
+        self.call_count += out.len() as u64;
+        while !out.is_empty() {
+            if self.n == 0 {
+                self.update();
+            }
+            let k = out.len().min(self.n);
+            let (head, rest) = out.split_at_mut(k);
+            for (dst, src) in head.iter_mut().zip(self.r[self.n - k..self.n].iter().rev()) {
+                *dst = *src;
+            }
+            self.n -= k;
+            out = rest;
+        }
+    }
+
+    /// Discard the next `n` u64 values without generating them one by one.
+    ///
+    /// Whole 256-word blocks are regenerated with `update()`; only the
+    /// position inside the last block is set directly. Every rn2/rnd call
+    /// consumes one value, so this positions the stream at call #N.
+    pub fn skip(&mut self, n: u64) {
+        self.call_count += n;
+        if n <= self.n as u64 {
+            self.n -= n as usize;
+            return;
+        }
+        let mut left = n - self.n as u64;
+        while left > ISAAC64_SZ as u64 {
+            self.update();
+            left -= ISAAC64_SZ as u64;
+        }
+        self.update();
+        self.n -= left as usize;
+    }
+
     /// Returns a random value in [0, n)
     pub fn next_uint(&mut self, n: u64) -> u64 {
         if n == 0 { return 0; }
@@ -287,24 +360,46 @@ impl Isaac64 {
                 raw,
             });
         }
+        if self.hashing {
+            // Draws exactly as rn2 does
+            self.hash = hash_rng_call(self.hash, RNG_FN_RN2, n, res);
+        }
         res
     }
 
-    /// Returns a random value in [0, x) - matches rn2(x)
+    /// Trace and hash one call, as `nethack_ffi.c` records it. `raw` is
+    /// the last value the call drew.
     #[inline]
-    pub fn rn2(&mut self, x: u32) -> u32 {
-        if x <= 1 { return 0; }
-        let raw = self.next_u64();
-        let res = (raw % x as u64) as u32;
+    fn record(&mut self, code: u8, func: &'static str, arg: u64, result: u64, raw: u64) {
         if self.tracing {
             self.trace.push(RngTraceEntry {
-                seq: self.call_count - 1,
-                func: "rn2",
-                arg: x as u64,
-                result: res as u64,
+                seq: self.call_count.saturating_sub(1),
+                func,
+                arg,
+                result,
                 raw,
             });
         }
+        if self.hashing {
+            self.hash = hash_rng_call(self.hash, code, arg, result);
+        }
+    }
+
+    /// rn2(x) without a trace entry, for draws inside another call
+    #[inline]
+    fn rn2_draw(&mut self, x: u32) -> (u32, u64) {
+        if x <= 1 { return (0, 0); }
+        let raw = self.next_u64();
+        ((raw % x as u64) as u32, raw)
+    }
+
+    /// Returns a random value in [0, x) - matches rn2(x)
+    #[inline]
+    pub fn rn2(&mut self, x: u32) -> u32 {
+        let (res, raw) = self.rn2_draw(x);
+        if x > 1 {
+            self.record(RNG_FN_RN2, "rn2", x as u64, res as u64, raw);
+        }
         res
     }
 
@@ -314,36 +409,36 @@ impl Isaac64 {
         if x == 0 { return 0; }
         let raw = self.next_u64();
         let res = (raw % x as u64) as u32 + 1;
-        if self.tracing {
-            self.trace.push(RngTraceEntry {
-                seq: self.call_count - 1,
-                func: "rnd",
-                arg: x as u64,
-                result: res as u64,
-                raw,
-            });
-        }
+        self.record(RNG_FN_RND, "rnd", x as u64, res as u64, raw);
         res
     }
 
-    /// Roll n dice of x sides - matches d(n, x)
+    /// Roll n dice of x sides - matches d(n, x). Like C's d(), which is
+    /// not wrapped for tracing, the dice are neither traced nor hashed.
     pub fn dice(&mut self, n: u32, x: u32) -> u32 {
         let mut result = n;
         for _ in 0..n {
-            result += self.rn2(x);
+            result += self.rn2_draw(x).0;
         }
         result
     }
 
-    /// Luck-adjusted random - matches rnl(x) from rnd.c
+    /// Luck-adjusted random - matches rnl(x) from rnd.c. Traced as one
+    /// call, as C records it.
     pub fn rnl(&mut self, x: u32, luck: i32) -> u32 {
-        let mut i = self.rn2(x) as i32;
+        let res = self.rnl_draw(x, luck);
+        self.record(RNG_FN_RNL, "rnl", x as u64, res as u64, 0);
+        res
+    }
+
+    fn rnl_draw(&mut self, x: u32, luck: i32) -> u32 {
+        let mut i = self.rn2_draw(x).0 as i32;
         let adjustment = if x <= 15 {
             (luck.abs() + 1) / 3 * luck.signum()
         } else {
             luck
         };
-        if adjustment != 0 && self.rn2(37 + adjustment.unsigned_abs()) != 0 {
+        if adjustment != 0 && self.rn2_draw(37 + adjustment.unsigned_abs()).0 != 0 {
             i -= adjustment;
             if i < 0 {
                 i = 0;
@@ -354,28 +449,38 @@ impl Isaac64 {
         i as u32
     }
 
-    /// Exponential distribution - matches rne(x) from rnd.c
+    /// Exponential distribution - matches rne(x) from rnd.c. Traced as
+    /// one call.
     pub fn rne(&mut self, x: u32, player_level: u32) -> u32 {
+        let res = self.rne_draw(x, player_level);
+        self.record(RNG_FN_RNE, "rne", x as u64, res as u64, 0);
+        res
+    }
+
+    fn rne_draw(&mut self, x: u32, player_level: u32) -> u32 {
         let utmp = if player_level < 15 { 5 } else { player_level / 3 };
         let mut tmp = 1u32;
-        while tmp < utmp && self.rn2(x) == 0 {
+        while tmp < utmp && self.rn2_draw(x).0 == 0 {
             tmp += 1;
         }
         tmp
     }
 
-    /// "Everyone's favorite" - matches rnz(i) from rnd.c
+    /// "Everyone's favorite" - matches rnz(i) from rnd.c. Traced as one
+    /// call, its inner rn2 and rne draws included.
     pub fn rnz(&mut self, i: i32, player_level: u32) -> i32 {
         let mut x = i as i64;
         let mut tmp = 1000i64;
-        tmp += self.rn2(1000) as i64;
-        tmp *= self.rne(4, player_level) as i64;
-        if self.rn2(2) != 0 {
+        tmp += self.rn2_draw(1000).0 as i64;
+        tmp *= self.rne_draw(4, player_level) as i64;
+        if self.rn2_draw(2).0 != 0 {
             x = x * tmp / 1000;
         } else {
             x = x * 1000 / tmp;
         }
-        x as i32
+        let res = x as i32;
+        self.record(RNG_FN_RNZ, "rnz", i as i64 as u64, res as i64 as u64, 0);
+        res
     }
 
     /// Enable RNG tracing
@@ -404,6 +509,23 @@ impl Isaac64 {
         self.get_trace()
     }
 
+    /// Start a rolling hash of every rn2/rnd/rnl/rne/rnz call from
+    /// `HASH_SEED`
+    pub fn enable_hashing(&mut self) {
+        self.hashing = true;
+        self.hash = HASH_SEED;
+    }
+
+    /// Stop hashing; `rng_hash()` keeps its last value
+    pub fn disable_hashing(&mut self) {
+        self.hashing = false;
+    }
+
+    /// Rolling hash of the calls made since `enable_hashing()`
+    pub fn rng_hash(&self) -> u64 {
+        self.hash
+    }
+
     /// Total number of raw u64 calls
     pub fn call_count(&self) -> u64 {
         self.call_count
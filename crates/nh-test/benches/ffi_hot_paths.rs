@@ -0,0 +1,227 @@
+//! Timings for the FFI hot paths, in-process and over the worker transport.
+//!
+//! `cargo bench -p nh-test --bench ffi_hot_paths [filter]`
+//!
+//! Every benchmark runs with a fixed seed and character so runs are
+//! comparable. Results are printed and written as JSON to
+//! `$NH_BENCH_OUT`, or `target/nh-bench/ffi_hot_paths.json` by default.
+
+use std::hint::black_box;
+use std::path::PathBuf;
+use std::time::{Duration, Instant};
+
+use nh_core::CGameEngineTrait;
+use nh_test::ffi::subprocess::worker_command;
+use nh_test::ffi::{CGameEngine, CGameEngineSubprocess, CIsaac64};
+use serde::Serialize;
+
+const SEED: u64 = 42;
+const ROLE: (&str, &str, i32, i32) = ("Valkyrie", "Human", 1, 1);
+
+/// Target length of one sample
+const SAMPLE_TIME: Duration = Duration::from_millis(10);
+const SAMPLES: usize = 20;
+
+#[derive(Debug, Serialize)]
+struct Sample {
+    name: String,
+    transport: &'static str,
+    iters_per_sample: u64,
+    samples: usize,
+    mean_ns: f64,
+    median_ns: f64,
+    min_ns: f64,
+    max_ns: f64,
+}
+
+#[derive(Debug, Serialize)]
+struct Report {
+    seed: u64,
+    role: &'static str,
+    real_nethack: bool,
+    results: Vec<Sample>,
+}
+
+struct Bench {
+    filter: Option<String>,
+    results: Vec<Sample>,
+}
+
+impl Bench {
+    fn enabled(&self, name: &str) -> bool {
+        self.filter.as_ref().is_none_or(|f| name.contains(f.as_str()))
+    }
+
+    /// Time `f`, doubling the batch size until one batch fills a sample.
+    fn run<F: FnMut()>(&mut self, name: &str, transport: &'static str, mut f: F) {
+        if !self.enabled(name) {
+            return;
+        }
+        let time = |f: &mut F, iters: u64| {
+            let start = Instant::now();
+            for _ in 0..iters {
+                f();
+            }
+            start.elapsed()
+        };
+
+        let mut iters = 1u64;
+        while time(&mut f, iters) < SAMPLE_TIME && iters < 1 << 24 {
+            iters *= 2;
+        }
+        let mut per_iter: Vec<f64> = (0..SAMPLES)
+            .map(|_| time(&mut f, iters).as_nanos() as f64 / iters as f64)
+            .collect();
+        per_iter.sort_by(f64::total_cmp);
+        self.record(name, transport, iters, &per_iter);
+    }
+
+    fn record(&mut self, name: &str, transport: &'static str, iters: u64, sorted_ns: &[f64]) {
+        let sample = Sample {
+            name: name.to_string(),
+            transport,
+            iters_per_sample: iters,
+            samples: sorted_ns.len(),
+            mean_ns: sorted_ns.iter().sum::<f64>() / sorted_ns.len() as f64,
+            median_ns: sorted_ns[sorted_ns.len() / 2],
+            min_ns: sorted_ns[0],
+            max_ns: sorted_ns[sorted_ns.len() - 1],
+        };
+        println!(
+            "{:<28} {:<11} {:>12.0} ns/iter (median {:.0}, min {:.0}, max {:.0})",
+            sample.name, sample.transport, sample.mean_ns, sample.median_ns, sample.min_ns, sample.max_ns
+        );
+        self.results.push(sample);
+    }
+}
+
+fn output_path() -> PathBuf {
+    if let Some(path) = std::env::var_os("NH_BENCH_OUT") {
+        return PathBuf::from(path);
+    }
+    // target/<profile>/deps/<bench binary>
+    let target = std::env::current_exe()
+        .ok()
+        .and_then(|exe| exe.ancestors().nth(3).map(|p| p.to_path_buf()))
+        .unwrap_or_else(|| PathBuf::from("target"));
+    target.join("nh-bench").join("ffi_hot_paths.json")
+}
+
+fn start_game(engine: &mut CGameEngine) {
+    engine.reset(SEED).unwrap();
+    engine.generate_and_place().unwrap();
+}
+
+fn in_process(bench: &mut Bench) {
+    let mut rng = CIsaac64::new(SEED);
+    bench.run("isaac64_next_uint64", "in-process", || {
+        black_box(rng.next_u64());
+    });
+    bench.run("isaac64_next_uint", "in-process", || {
+        black_box(rng.next_uint(black_box(20)));
+    });
+
+    let mut engine = CGameEngine::new();
+    engine.init(ROLE.0, ROLE.1, ROLE.2, ROLE.3).unwrap();
+    start_game(&mut engine);
+
+    bench.run("export_level", "in-process", || {
+        black_box(engine.export_level());
+    });
+    bench.run("export_level_bin", "in-process", || {
+        black_box(engine.export_level_bin().unwrap());
+    });
+    let (ux, uy) = engine.position();
+    bench.run("monsters_near", "in-process", || {
+        black_box(engine.monsters_near(ux, uy, 7));
+    });
+
+    // Searching keeps the hero in place, so every step is a full turn of
+    // ffi_post_command with the same map
+    if bench.enabled("exec_cmd") || bench.enabled("ffi_post_command") {
+        engine.reset_section_profile();
+        let mut commands = 0u64;
+        let started = Instant::now();
+        bench.run("exec_cmd", "in-process", || {
+            let _ = engine.exec_cmd('s');
+            commands += 1;
+        });
+        let elapsed = started.elapsed();
+        if engine.is_dead() {
+            start_game(&mut engine);
+        }
+
+        // ffi_post_command is static; its cost comes from the section
+        // profiler, which times every phase of it
+        let post_ns: u64 = engine.section_profile().iter().map(|p| p.total_nanos).sum();
+        if commands > 0 && bench.enabled("ffi_post_command") {
+            let per_cmd = post_ns as f64 / commands as f64;
+            bench.record("ffi_post_command", "in-process", commands, &[per_cmd]);
+            println!(
+                "{:<28} {:<11} {:>11.1}% of exec_cmd",
+                "",
+                "",
+                100.0 * post_ns as f64 / elapsed.as_nanos().max(1) as f64
+            );
+        }
+    }
+
+    bench.run("generate_level", "in-process", || {
+        engine.set_dlevel(0, 1);
+        engine.reset_rng(SEED).unwrap();
+        engine.generate_level().unwrap();
+    });
+}
+
+fn subprocess(bench: &mut Bench) {
+    let mut worker = match CGameEngineSubprocess::spawn(worker_command()) {
+        Ok(worker) => worker,
+        Err(e) => {
+            eprintln!("Skipping subprocess benchmarks: {}", e);
+            return;
+        }
+    };
+    worker.init(ROLE.0, ROLE.1, ROLE.2, ROLE.3).unwrap();
+    worker.reset(SEED).unwrap();
+    worker.generate_and_place().unwrap();
+    let transport = if worker.is_binary() { "binary" } else { "json" };
+
+    // One GetHp command: the bare send_command round trip
+    bench.run("send_command", transport, || {
+        black_box(worker.hp());
+    });
+    bench.run("exec_cmd", transport, || {
+        let _ = worker.exec_cmd('s');
+    });
+    bench.run("export_level_bin", transport, || {
+        black_box(worker.export_level_bin().unwrap());
+    });
+    bench.run("generate_level_bin", transport, || {
+        black_box(worker.generate_level_bin(SEED, 0, 1).unwrap());
+    });
+}
+
+fn main() {
+    // cargo passes --bench; anything else is a name filter
+    let filter = std::env::args().skip(1).find(|a| !a.starts_with("--"));
+    let mut bench = Bench { filter, results: Vec::new() };
+
+    in_process(&mut bench);
+    subprocess(&mut bench);
+
+    let report = Report {
+        seed: SEED,
+        role: ROLE.0,
+        real_nethack: cfg!(real_nethack),
+        results: bench.results,
+    };
+    let path = output_path();
+    let written = path
+        .parent()
+        .map_or(Ok(()), std::fs::create_dir_all)
+        .and_then(|()| std::fs::write(&path, serde_json::to_string_pretty(&report).unwrap()));
+    match written {
+        Ok(()) => println!("Wrote {}", path.display()),
+        Err(e) => eprintln!("Cannot write {}: {}", path.display(), e),
+    }
+}
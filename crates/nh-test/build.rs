@@ -3,6 +3,10 @@
 //! Compiles the NetHack C FFI implementation for comparison testing.
 
 fn main() {
+    // Release builds compile the C diagnostics out entirely
+    let log_disabled = std::env::var("PROFILE").map_or(false, |p| p == "release")
+        && std::env::var_os("NH_FFI_LOG").is_none();
+
     let manifest_dir = std::env::var("CARGO_MANIFEST_DIR").unwrap();
     let nethack_src = std::path::PathBuf::from(&manifest_dir).join("nethack_src");
     let c_src = std::path::PathBuf::from(&manifest_dir).join("c_src");
@@ -33,9 +37,15 @@ fn main() {
         builder.define("HACKDIR", Some(hackdir));
         // C99 compatibility for bool type
         builder.define("__STDC_VERSION__", Some("199901L"));
+        if log_disabled {
+            builder.define("NH_FFI_LOG_DISABLED", None);
+        }
 
-        // Compile the FFI wrapper
+        // Compile the FFI wrapper, and the game's rnd.c with the RNG state
+        // hooks checkpoints need (it includes rnd.c from the source tree)
+        builder.include(&real_nethack_src);
         builder.file(nethack_src.join("nethack_ffi.c"));
+        builder.file(c_src.join("nethack_rnd.c"));
         builder.compile("nethack_ffi");
 
         // Link against ncurses for terminal functions
@@ -50,7 +60,7 @@ fn main() {
             if path.extension().map_or(false, |ext| ext == "o") {
                 let file_name = path.file_name().unwrap().to_str().unwrap();
                 println!("cargo:warning=Collecting object from path: {:?}", path);
-                if file_name != "unixmain.o" && file_name != "nethack_ffi.o" {
+                if file_name != "unixmain.o" && file_name != "nethack_ffi.o" && file_name != "rnd.o" {
                     all_objs.push(path);
                 }
             }
@@ -89,12 +99,16 @@ fn main() {
         // Build FFI library
         let mut ffi_builder = cc::Build::new();
         ffi_builder.opt_level(2);
+        if log_disabled {
+            ffi_builder.define("NH_FFI_LOG_DISABLED", None);
+        }
         ffi_builder.file(nethack_src.join("nethack_ffi.c"));
         ffi_builder.compile("nethack_ffi");
     }
 
     // Print link information
     println!("cargo:rerun-if-changed=build.rs");
+    println!("cargo:rerun-if-env-changed=NH_FFI_LOG");
     println!("cargo:rerun-if-changed=nethack_src/");
     println!("cargo:rerun-if-changed=c_src/");
 }
@@ -0,0 +1,28 @@
+/*
+ * Bulk ISAAC64 draws
+ *
+ * Defined by isaac64_standalone.c in the stub build and by nethack_rnd.c
+ * in the real one.  Each returns exactly the values of the per-call draws
+ * it batches and leaves the stream where they would.
+ */
+
+#ifndef ISAAC64_BULK_H
+#define ISAAC64_BULK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct isaac64_ctx;
+
+/* The next n values of isaac64_next_uint64(ctx), in order */
+void isaac64_fill(struct isaac64_ctx *ctx, uint64_t *out, size_t n);
+
+/* n draws of isaac64_next_uint(ctx, limit), rejected values skipped as it
+   skips them; zeros without drawing if limit <= 0.  Returns the number of
+   raw values taken, rejected ones included. */
+size_t isaac64_rn2_bulk(struct isaac64_ctx *ctx, int limit, int *out, size_t n);
+
+/* n draws of rn2(limit) from the game RNG */
+void rn2_bulk(int limit, int *out, size_t n);
+
+#endif /* ISAAC64_BULK_H */
@@ -9,6 +9,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "isaac64_bulk.h"
+
 #define ISAAC64_SZ_LOG 8
 #define ISAAC64_SZ (1 << ISAAC64_SZ_LOG)
 #define ISAAC64_SEED_SZ_MAX (ISAAC64_SZ << 3)
@@ -188,6 +190,47 @@ uint64_t isaac64_next_uint(isaac64_ctx *_ctx, uint64_t _n)
     return v;
 }
 
+/* Copy the next _n values of the stream into _out, in the order
+   isaac64_next_uint64() would return them.  The result buffer is read
+   from the top down, so each refill is one straight reversed copy that
+   the compiler can vectorize. */
+void isaac64_fill(isaac64_ctx *_ctx, uint64_t *_out, size_t _n)
+{
+    while (_n > 0) {
+        const uint64_t *r;
+        unsigned k;
+        unsigned i;
+
+        if (!_ctx->n)
+            isaac64_update(_ctx);
+        k = _n < _ctx->n ? (unsigned)_n : _ctx->n;
+        r = _ctx->r + _ctx->n - k;
+        for (i = 0; i < k; i++)
+            _out[i] = r[k - 1 - i];
+        _ctx->n -= k;
+        _out += k;
+        _n -= k;
+    }
+}
+
+/* Discard the next _n values.  Whole blocks are regenerated with
+   isaac64_update() without reading them; only the position inside the
+   last block is set directly. */
+void isaac64_skip(isaac64_ctx *_ctx, uint64_t _n)
+{
+    if (_n <= _ctx->n) {
+        _ctx->n -= (unsigned)_n;
+        return;
+    }
+    _n -= _ctx->n;
+    while (_n > ISAAC64_SZ) {
+        isaac64_update(_ctx);
+        _n -= ISAAC64_SZ;
+    }
+    isaac64_update(_ctx);
+    _ctx->n -= (unsigned)_n;
+}
+
 /* Global context for the standalone RNG */
 static isaac64_ctx g_isaac64_ctx;
 static isaac64_ctx g_disp_rng_ctx;
@@ -214,10 +257,55 @@ int rnd(int n) {
     return rn2(n) + 1;
 }
 
+/* _n results of isaac64_next_uint(_ctx, _limit), drawn exactly as _n
+   calls would draw them.  Raw values come in blocks from isaac64_fill();
+   a rejected draw is simply dropped, and no more raw values are taken
+   than outputs are still missing, so the stream never runs ahead.
+   Returns the number of raw values taken. */
+size_t isaac64_rn2_bulk(isaac64_ctx *_ctx, int _limit, int *_out, size_t _n)
+{
+    uint64_t raw[ISAAC64_SZ];
+    uint64_t lim;
+    size_t done = 0;
+    size_t drawn = 0;
+
+    if (_limit <= 0) {
+        memset(_out, 0, _n * sizeof(*_out));
+        return 0;
+    }
+    lim = (uint64_t)_limit;
+    while (done < _n) {
+        size_t want = _n - done < ISAAC64_SZ ? _n - done : ISAAC64_SZ;
+        size_t i;
+
+        isaac64_fill(_ctx, raw, want);
+        drawn += want;
+        for (i = 0; i < want; i++) {
+            uint64_t v = raw[i] % lim;
+            uint64_t dv = raw[i] - v;
+            if (((dv + lim - 1) & ISAAC64_MASK) < dv)
+                continue;
+            _out[done++] = (int)v;
+        }
+    }
+    return drawn;
+}
+
+/* _n results of rn2(limit), as _n rn2() calls would draw them */
+void rn2_bulk(int limit, int *out, size_t n) {
+    isaac64_rn2_bulk(&g_isaac64_ctx, limit, out, n);
+}
+
 int d(int n, int x) {
+    int rolls[64];
     int res = n;
     if (x <= 0 || n <= 0) return n;
-    while (n--) res += rn2(x);
+    while (n > 0) {
+        int k = n < 64 ? n : 64;
+        rn2_bulk(x, rolls, (size_t)k);
+        for (int i = 0; i < k; i++) res += rolls[i];
+        n -= k;
+    }
     return res;
 }
 
@@ -226,6 +314,28 @@ int rn2_on_display_rng(int x) {
     return (int)isaac64_next_uint(&g_disp_rng_ctx, (uint64_t)x);
 }
 
+/* Checkpoint hooks picked up by nethack_ffi.c: the whole state of both
+   generators, and a skip on the core one.  isaac64_ctx holds no pointers,
+   so the image can be restored in another process. */
+
+size_t nh_rng_state_size(void) {
+    return sizeof(g_isaac64_ctx) + sizeof(g_disp_rng_ctx);
+}
+
+void nh_rng_state_save(void *buf) {
+    memcpy(buf, &g_isaac64_ctx, sizeof(g_isaac64_ctx));
+    memcpy((char *)buf + sizeof(g_isaac64_ctx), &g_disp_rng_ctx, sizeof(g_disp_rng_ctx));
+}
+
+void nh_rng_state_load(const void *buf) {
+    memcpy(&g_isaac64_ctx, buf, sizeof(g_isaac64_ctx));
+    memcpy(&g_disp_rng_ctx, (const char *)buf + sizeof(g_isaac64_ctx), sizeof(g_disp_rng_ctx));
+}
+
+void nh_rng_skip(unsigned long n) {
+    isaac64_skip(&g_isaac64_ctx, (uint64_t)n);
+}
+
 /* Stubs/Simplified versions of other rnd.c functions */
 /* These might need NetHack globals like 'u' and 'Luck' */
 
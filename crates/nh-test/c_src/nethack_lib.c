@@ -136,11 +136,102 @@ static char g_last_message[256] = "";
 /* Forward declaration for nh_free_game */
 void nh_free_game(void);
 
-/* Free allocated string */
-void nh_free_string(void* ptr) {
-    if (ptr != NULL) {
-        free(ptr);
+/* ============================================================================
+ * Output Arena
+ * ============================================================================ */
+
+/* String results are carved out of a bump arena owned by the library.
+   They stay valid until the next nh_arena_reset(); nothing is freed per
+   string.  Reset folds a generation's chunks into one, so a steady
+   workload stops allocating. */
+
+#define NH_ARENA_CHUNK (16 * 1024)
+#define NH_ARENA_ALIGN 16
+
+struct nh_arena_chunk {
+    struct nh_arena_chunk* next;
+    size_t size;                   /* bytes in data[] */
+    char data[];
+};
+
+struct nh_arena {
+    struct nh_arena_chunk* chunks; /* newest first; allocation uses the head */
+    size_t used;                   /* bytes handed out from the head chunk */
+    size_t total;                  /* bytes handed out this generation */
+    unsigned long generation;
+};
+
+static struct nh_arena g_default_arena;
+static struct nh_arena* g_arena = &g_default_arena;
+
+static void* nh_arena_alloc(size_t n) {
+    struct nh_arena_chunk* c = g_arena->chunks;
+    void* p;
+
+    n = (n + NH_ARENA_ALIGN - 1) & ~(size_t)(NH_ARENA_ALIGN - 1);
+    if (c == NULL || c->size - g_arena->used < n) {
+        size_t size = c ? c->size * 2 : NH_ARENA_CHUNK;
+        while (size < n) {
+            size *= 2;
+        }
+        c = (struct nh_arena_chunk*)malloc(sizeof(*c) + size);
+        if (c == NULL) return NULL;
+        c->size = size;
+        c->next = g_arena->chunks;
+        g_arena->chunks = c;
+        g_arena->used = 0;
+    }
+    p = c->data + g_arena->used;
+    g_arena->used += n;
+    g_arena->total += n;
+    return p;
+}
+
+static char* nh_arena_strdup(const char* s) {
+    size_t len = strlen(s) + 1;
+    char* p = (char*)nh_arena_alloc(len);
+    if (p != NULL) {
+        memcpy(p, s, len);
+    }
+    return p;
+}
+
+static void nh_arena_release(struct nh_arena* a) {
+    while (a->chunks != NULL) {
+        struct nh_arena_chunk* next = a->chunks->next;
+        free(a->chunks);
+        a->chunks = next;
     }
+    a->used = a->total = 0;
+}
+
+/* Invalidate every string handed out so far */
+void nh_arena_reset(void) {
+    struct nh_arena* a = g_arena;
+
+    if (a->chunks != NULL && a->chunks->next != NULL) {
+        size_t size = a->chunks->size;
+        while (size < a->total) {
+            size *= 2;
+        }
+        nh_arena_release(a);
+        a->chunks = (struct nh_arena_chunk*)malloc(sizeof(*a->chunks) + size);
+        if (a->chunks != NULL) {
+            a->chunks->size = size;
+            a->chunks->next = NULL;
+        }
+    }
+    a->used = a->total = 0;
+    a->generation++;
+}
+
+unsigned long nh_arena_generation(void) {
+    return g_arena->generation;
+}
+
+/* Arena strings go away with nh_arena_reset(); kept for old callers */
+void nh_free_string(void* ptr) {
+    (void)ptr;
 }
 
 /* ============================================================================
@@ -563,12 +654,11 @@ bool nh_is_player_dead(void) {
 /* Serialize game state to JSON string */
 char* nh_get_state_json(void) {
     if (g_game == NULL) {
-        char* empty = strdup("{}");
-        return empty;
+        return nh_arena_strdup("{}");
     }
     
     /* Build JSON string */
-    char* json = (char*)malloc(4096);
+    char* json = (char*)nh_arena_alloc(4096);
     if (json == NULL) return NULL;
     
     snprintf(json, 4096,
@@ -667,12 +757,12 @@ size_t nh_get_state_size(void) {
 
 /* Get last message */
 char* nh_get_last_message(void) {
-    return strdup(g_last_message[0] ? g_last_message : "No message");
+    return nh_arena_strdup(g_last_message[0] ? g_last_message : "No message");
 }
 
 /* Get message history */
 char* nh_get_message_history(void) {
-    return strdup(""); /* Placeholder */
+    return nh_arena_strdup(""); /* Placeholder */
 }
 
 /* ============================================================================
@@ -687,11 +777,11 @@ int nh_get_inventory_count(void) {
 /* Get inventory item as JSON */
 char* nh_get_inventory_json(void) {
     if (g_game == NULL) {
-        return strdup("[]");
+        return nh_arena_strdup("[]");
     }
     
     /* Build JSON array */
-    char* json = (char*)malloc(4096);
+    char* json = (char*)nh_arena_alloc(4096);
     if (json == NULL) return NULL;
     
     strcpy(json, "[");
@@ -719,10 +809,10 @@ char* nh_get_inventory_json(void) {
 /* Get nearby monsters as JSON */
 char* nh_get_nearby_monsters_json(void) {
     if (g_game == NULL) {
-        return strdup("[]");
+        return nh_arena_strdup("[]");
     }
     
-    char* json = (char*)malloc(4096);
+    char* json = (char*)nh_arena_alloc(4096);
     if (json == NULL) return NULL;
     
     strcpy(json, "[");
@@ -765,10 +855,10 @@ bool nh_is_game_won(void) {
 /* Get game result message */
 char* nh_get_result_message(void) {
     if (g_game == NULL) {
-        return strdup("Game not initialized");
+        return nh_arena_strdup("Game not initialized");
     }
     if (g_game->player.hp <= 0) {
-        return strdup("You died!");
+        return nh_arena_strdup("You died!");
     }
-    return strdup("Game continues");
+    return nh_arena_strdup("Game continues");
 }
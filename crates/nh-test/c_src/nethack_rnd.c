@@ -0,0 +1,229 @@
+/*
+ * rnd.c plus the RNG state hooks, for the real-NetHack build
+ *
+ * Linked in place of the game's rnd.o.  The game's rnd.c is included
+ * as it is, with whatever local changes that tree carries, so the
+ * generators draw and count exactly as rnd.o does.  Its rn2, rnd, rnl,
+ * rne and rnz are renamed on the way in and wrapped below, so every call
+ * the game makes is reported to nh_ffi_rng_record() for the trace, the
+ * stream and the step digests' hash.  Draws rnd.c makes internally, e.g.
+ * rnz's rn2(1000), stay inside the one record of the outer call.
+ *
+ * The other additions are the hooks below, the same ones
+ * isaac64_standalone.c defines for the stub build; they live here because
+ * rnglist[] is file-static in rnd.c.  The bulk draws of isaac64_bulk.h
+ * come along, as plain loops.
+ */
+
+#define rn2 nh_rnd_rn2
+#define rnd nh_rnd_rnd
+#define rnl nh_rnd_rnl
+#define rne nh_rnd_rne
+#define rnz nh_rnd_rnz
+#include "rnd.c"
+#undef rn2
+#undef rnd
+#undef rnl
+#undef rne
+#undef rnz
+
+#include "isaac64_bulk.h"
+#include "../nethack_src/nethack_ffi_types.h"
+
+extern void nh_ffi_rng_record(int func, int arg, int result);
+
+int rn2(int);
+int rnd(int);
+int rnl(int);
+int rne(int);
+int rnz(int);
+
+int
+rn2(int x)
+{
+    int r = nh_rnd_rn2(x);
+
+    nh_ffi_rng_record(NH_FFI_RNG_FN_RN2, x, r);
+    return r;
+}
+
+int
+rnd(int x)
+{
+    int r = nh_rnd_rnd(x);
+
+    nh_ffi_rng_record(NH_FFI_RNG_FN_RND, x, r);
+    return r;
+}
+
+int
+rnl(int x)
+{
+    int r = nh_rnd_rnl(x);
+
+    nh_ffi_rng_record(NH_FFI_RNG_FN_RNL, x, r);
+    return r;
+}
+
+int
+rne(int x)
+{
+    int r = nh_rnd_rne(x);
+
+    nh_ffi_rng_record(NH_FFI_RNG_FN_RNE, x, r);
+    return r;
+}
+
+int
+rnz(int i)
+{
+    int r = nh_rnd_rnz(i);
+
+    nh_ffi_rng_record(NH_FFI_RNG_FN_RNZ, i, r);
+    return r;
+}
+
+/* rnglist[] tells the generators apart by function pointer, and its
+   initializer names the renamed rn2; callers pass the wrapper, as in
+   init_isaac64(seed, rn2) */
+__attribute__((constructor))
+static void
+nh_rnd_name_core(void)
+{
+    rnglist[CORE].fn = rn2;
+}
+
+/* The whole state of both generators, and a skip on the core one.
+   isaac64_ctx holds no pointers, so the image can be restored in another
+   process. */
+
+size_t
+nh_rng_state_size(void)
+{
+    return sizeof(rnglist[CORE].rng_state) + sizeof(rnglist[DISP].rng_state);
+}
+
+void
+nh_rng_state_save(void *buf)
+{
+    memcpy(buf, &rnglist[CORE].rng_state, sizeof(rnglist[CORE].rng_state));
+    memcpy((char *) buf + sizeof(rnglist[CORE].rng_state),
+           &rnglist[DISP].rng_state, sizeof(rnglist[DISP].rng_state));
+}
+
+void
+nh_rng_state_load(const void *buf)
+{
+    memcpy(&rnglist[CORE].rng_state, buf, sizeof(rnglist[CORE].rng_state));
+    memcpy(&rnglist[DISP].rng_state,
+           (const char *) buf + sizeof(rnglist[CORE].rng_state),
+           sizeof(rnglist[DISP].rng_state));
+}
+
+/* Skipped draws are not counted here; nh_ffi_rng_skip() adds them to the
+   counter itself.  Whole blocks cost one refill each, as in
+   CIsaac64::skip: only the block holding the last skipped draw is read. */
+void
+nh_rng_skip(unsigned long n)
+{
+    isaac64_ctx *ctx = &rnglist[CORE].rng_state;
+
+    if (n <= ctx->n) {
+        ctx->n -= (unsigned) n;
+        return;
+    }
+    n -= ctx->n;
+    while (n > ISAAC64_SZ) {
+        ctx->n = 0;
+        (void) isaac64_next_uint64(ctx);
+        n -= ISAAC64_SZ;
+    }
+    ctx->n = 0;
+    (void) isaac64_next_uint64(ctx);
+    /* The refill draw above already took one value */
+    ctx->n = ISAAC64_SZ - (unsigned) n;
+}
+
+/* Script the core generator: its next n draws return raw[0..n-1], after
+   which it refills as usual.  The weapon calculator enumerates dmgval()'s
+   dice this way, between a state save and load. */
+void
+nh_rng_plant(const uint64_t *raw, unsigned n)
+{
+    isaac64_ctx *ctx = &rnglist[CORE].rng_state;
+    unsigned i;
+
+    for (i = 0; i < n; i++)
+        ctx->r[n - 1 - i] = raw[i];
+    ctx->n = n;
+}
+
+/* Planted draws not yet taken */
+unsigned
+nh_rng_planted_left(void)
+{
+    return rnglist[CORE].rng_state.n;
+}
+
+/* Bulk draws (isaac64_bulk.h).  NetHack's isaac64.c keeps
+   isaac64_update() to itself, so a block is refilled by drawing its first
+   value, as CIsaac64::skip does. */
+
+void
+isaac64_fill(isaac64_ctx *ctx, uint64_t *out, size_t n)
+{
+    while (n > 0) {
+        unsigned k, i;
+
+        if (!ctx->n) {
+            *out++ = isaac64_next_uint64(ctx);
+            n--;
+            continue;
+        }
+        k = n < ctx->n ? (unsigned) n : ctx->n;
+        for (i = 0; i < k; i++)
+            out[i] = ctx->r[ctx->n - 1 - i];
+        ctx->n -= k;
+        out += k;
+        n -= k;
+    }
+}
+
+/* Blocks from isaac64_fill(), filtered with isaac64_next_uint()'s
+   rejection test; never more raw values than outputs still missing, so
+   the stream stops where the per-call draws would */
+size_t
+isaac64_rn2_bulk(isaac64_ctx *ctx, int limit, int *out, size_t n)
+{
+    uint64_t raw[ISAAC64_SZ];
+    size_t done = 0, drawn = 0;
+
+    if (limit <= 0) {
+        memset(out, 0, n * sizeof *out);
+        return 0;
+    }
+    while (done < n) {
+        size_t want = n - done < ISAAC64_SZ ? n - done : ISAAC64_SZ;
+        size_t i;
+
+        isaac64_fill(ctx, raw, want);
+        drawn += want;
+        for (i = 0; i < want; i++) {
+            uint64_t v = raw[i] % (uint64_t) limit;
+            uint64_t dv = raw[i] - v;
+
+            if (dv + (uint64_t) limit - 1 < dv)
+                continue;
+            out[done++] = (int) v;
+        }
+    }
+    return drawn;
+}
+
+/* Through rn2() itself, so the draws are counted and recorded as usual */
+void
+rn2_bulk(int limit, int *out, size_t n)
+{
+    while (n--)
+        *out++ = rn2(limit);
+}
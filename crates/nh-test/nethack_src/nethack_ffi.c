@@ -1,10 +1,23 @@
+#if !defined(__APPLE__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* dl_iterate_phdr */
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <unistd.h>
+#include <errno.h>
 #include <signal.h>
+#include <time.h>
 #include <execinfo.h>
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#include <mach-o/loader.h>
+#else
+#include <link.h>
+#endif
+
+#include "nethack_ffi_types.h"
 
 static void ffi_crash_handler(int sig) {
     void *array[30];
@@ -23,11 +36,49 @@ static void install_crash_handler(void) {
     signal(SIGABRT, ffi_crash_handler);
 }
 
+/* ============================================================================
+ * Diagnostics
+ * ============================================================================ */
+
+/* FFI_LOG(cat, fmt, ...) writes to stderr when `cat` is enabled in the
+   runtime mask.  stderr is unbuffered, so no fflush is needed.  With
+   NH_FFI_LOG_DISABLED the call is dead code: arguments are type-checked but
+   never evaluated, so anything with side effects must be hoisted out. */
+#ifdef NH_FFI_LOG_DISABLED
+#define FFI_LOG_ON(cat) 0
+#else
+static unsigned int g_log_mask = NH_FFI_LOG_ALL;
+#define FFI_LOG_ON(cat) ((g_log_mask & (cat)) != 0)
+#endif
+
+#define FFI_LOG(cat, ...) \
+    do { if (FFI_LOG_ON(cat)) fprintf(stderr, __VA_ARGS__); } while (0)
+
+unsigned int nh_ffi_set_log_mask(unsigned int mask) {
+#ifdef NH_FFI_LOG_DISABLED
+    (void)mask;
+    return 0;
+#else
+    unsigned int old = g_log_mask;
+    g_log_mask = mask;
+    return old;
+#endif
+}
+
+unsigned int nh_ffi_get_log_mask(void) {
+#ifdef NH_FFI_LOG_DISABLED
+    return 0;
+#else
+    return g_log_mask;
+#endif
+}
+
 #ifdef REAL_NETHACK
 #include "hack.h"
 #include "dlb.h"
 #include "func_tab.h"
 #include "mfndpos.h"
+#include "isaac64.h"
 
 /* External declarations for role and race tables and lookup functions */
 extern const struct Role roles[];
@@ -66,8 +117,7 @@ static volatile int ffi_in_post_command = 0;
 static volatile int ffi_player_died = 0;
 
 void nh_terminate(int status) {
-    fprintf(stderr, "FFI: nh_terminate(%d) called — player died or game ended\n", status);
-    fflush(stderr);
+    FFI_LOG(NH_FFI_LOG_LIFECYCLE, "FFI: nh_terminate(%d) called — player died or game ended\n", status);
     ffi_player_died = 1;
     if (ffi_in_post_command) {
         longjmp(ffi_terminate_jmp, 1);
@@ -118,8 +168,10 @@ static void dummy_mark_synch(void) {}
 static void dummy_wait_synch(void) {}
 static char dummy_message_menu(int let, int def, const char* msg) { (void)let; (void)msg; return (char)def; }
 static void dummy_print_glyph(winid window, int x, int y, int glyph, int bkglyph) { (void)window; (void)x; (void)y; (void)glyph; (void)bkglyph; }
-static void dummy_raw_print(const char* str) { (void)str; }
-static void dummy_raw_print_bold(const char* str) { (void)str; }
+/* Without window_inited, pline() hands every message to raw_print */
+static void ffi_capture_message(const char* str);
+static void dummy_raw_print(const char* str) { ffi_capture_message(str); }
+static void dummy_raw_print_bold(const char* str) { ffi_capture_message(str); }
 static int dummy_nhgetch(void) { return 0; }
 static int dummy_nh_poskey(int* x, int* y, int* mod) { (void)x; (void)y; (void)mod; return 0; }
 static void dummy_nhbell(void) {}
@@ -215,77 +267,30 @@ struct permonst;
 /* extern void initoptions(int, char **); */
 #endif
 
-#ifndef REAL_NETHACK
-/* Game state */
-struct nh_ffi_game_state {
-    int hp;
-    int hp_max;
-    int energy;
-    int energy_max;
-    int x;
-    int y;
-    int level;
-    int experience_level;
-    int armor_class;
-    int gold;
-    int strength;
-    int dexterity;
-    int constitution;
-    int intelligence;
-    int wisdom;
-    int charisma;
-    int is_dead;
-    int hunger_state;
-    int turn_count;
-    int dungeon_depth;
-    int monster_count;
-};
-#endif
-
-/* Inventory item */
-struct nh_ffi_object {
-    char name[128];
-    char class;
-    int weight;
-    int value;
-    int quantity;
-    int enchantment;
-    boolean cursed;
-    boolean blessed;
-    int armor_class;
-    int damage;
-    char inv_letter;
-    int recharged;
-    int poisoned;
-    int otyp;
-};
-
-/* Monster info */
-struct nh_ffi_monster {
-    char name[128];
-    char symbol;
-    int level;
-    int hp;
-    int max_hp;
-    int armor_class;
-    int x; int y;
-    boolean asleep;
-    boolean peaceful;
-    unsigned long strategy;
-};
-
-/* Forward declaration */
+/* Forward declarations */
 void nh_ffi_free(void);
+int nh_ffi_get_monsters(struct nh_ffi_monster* out, int max);
+int nh_ffi_get_step_digest(struct nh_ffi_step_digest* d, int status);
 
 /* ============================================================================
  * Global state for the FFI interface
  * ============================================================================ */
 
+static char g_last_message[256] = "";
+
+/* Rolling hash of every traced RNG call, for step digests */
+static uint64_t g_rng_hash = NH_FFI_HASH_SEED;
+
+static inline uint64_t ffi_hash_word(uint64_t h, uint64_t w) {
+    return (h ^ w) * NH_FFI_HASH_PRIME;
+}
+
+#define FFI_HASH_INT(h, v) ffi_hash_word((h), (uint64_t)(int64_t)(v))
+
 #ifndef REAL_NETHACK
 static boolean g_initialized = FALSE;
 static boolean g_game_over = FALSE;
 static unsigned long g_turn_count = 0;
-static char g_last_message[256] = "";
 static char g_role[32] = "";
 static char g_race[32] = "";
 static int g_gender = 0;
@@ -303,9 +308,109 @@ static char g_last_role[32] = "Tourist";
 static char g_last_race[32] = "Human";
 static int g_last_gender = 0;
 static int g_last_alignment = 0;
+static boolean g_game_live = FALSE; /* nh_ffi_init() has run in this context */
 static char g_json_buffer[1024 * 1024]; /* 1MB for map/state serialization */
 #endif
 
+/* ============================================================================
+ * Output Arena
+ * ============================================================================ */
+
+/* String results (JSON, messages) are carved out of a bump arena owned by
+   the live context rather than malloc'ed one at a time.  A result stays
+   valid until the next nh_ffi_arena_reset(); nothing is freed per string.
+   Reset folds the chunks of a generation into one, so a steady workload
+   stops allocating once the arena reaches its high-water mark. */
+
+#define FFI_ARENA_CHUNK (64 * 1024)
+#define FFI_ARENA_ALIGN 16
+
+struct ffi_arena_chunk {
+    struct ffi_arena_chunk *next;
+    size_t size;                    /* bytes in data[] */
+    char data[];
+};
+
+struct ffi_arena {
+    struct ffi_arena_chunk *chunks; /* newest first; allocation uses the head */
+    size_t used;                    /* bytes handed out from the head chunk */
+    size_t total;                   /* bytes handed out this generation */
+    unsigned long generation;
+};
+
+static struct ffi_arena g_default_arena;
+static struct ffi_arena *g_arena = &g_default_arena; /* the live context's */
+
+static void *ffi_arena_alloc(size_t n) {
+    struct ffi_arena *a = g_arena;
+    struct ffi_arena_chunk *c = a->chunks;
+    void *p;
+
+    n = (n + FFI_ARENA_ALIGN - 1) & ~(size_t)(FFI_ARENA_ALIGN - 1);
+    if (!c || c->size - a->used < n) {
+        size_t size = c ? c->size * 2 : FFI_ARENA_CHUNK;
+        while (size < n)
+            size *= 2;
+        if (!(c = (struct ffi_arena_chunk *)malloc(sizeof(*c) + size)))
+            return NULL;
+        c->size = size;
+        c->next = a->chunks;
+        a->chunks = c;
+        a->used = 0;
+    }
+    p = c->data + a->used;
+    a->used += n;
+    a->total += n;
+    return p;
+}
+
+static char *ffi_arena_strdup(const char *s) {
+    size_t len = strlen(s) + 1;
+    char *p = (char *)ffi_arena_alloc(len);
+    if (p)
+        memcpy(p, s, len);
+    return p;
+}
+
+static void ffi_arena_release(struct ffi_arena *a) {
+    while (a->chunks) {
+        struct ffi_arena_chunk *next = a->chunks->next;
+        free(a->chunks);
+        a->chunks = next;
+    }
+    a->used = a->total = 0;
+}
+
+/* Invalidate every result handed out by the live context's arena */
+void nh_ffi_arena_reset(void) {
+    struct ffi_arena *a = g_arena;
+
+    if (a->chunks && a->chunks->next) {
+        size_t size = a->chunks->size;
+        while (size < a->total)
+            size *= 2;
+        ffi_arena_release(a);
+        if ((a->chunks = (struct ffi_arena_chunk *)malloc(sizeof(*a->chunks) + size))) {
+            a->chunks->size = size;
+            a->chunks->next = NULL;
+        }
+    }
+    a->used = a->total = 0;
+    a->generation++;
+}
+
+unsigned long nh_ffi_arena_generation(void) {
+    return g_arena->generation;
+}
+
+size_t nh_ffi_arena_capacity(void) {
+    size_t total = 0;
+    struct ffi_arena_chunk *c;
+    for (c = g_arena->chunks; c; c = c->next)
+        total += c->size;
+    return total;
+}
+
 /* ============================================================================
  * Implementations
  * ============================================================================ */
@@ -319,22 +424,21 @@ void nh_ffi_set_dlevel(int dnum, int dlevel) {
 /* Force generation of a standard maze */
 void nh_ffi_generate_maze(void) {
 #ifdef REAL_NETHACK
-    fprintf(stderr, "FFI: nh_ffi_generate_maze()...\n");
+    FFI_LOG(NH_FFI_LOG_LIFECYCLE, "FFI: nh_ffi_generate_maze()...\n");
     
     s_level *sp = Is_special(&u.uz);
     if (sp) {
-        fprintf(stderr, "FFI: Is_special! proto=%s, rndlevs=%d\n", sp->proto, (int)sp->rndlevs);
+        FFI_LOG(NH_FFI_LOG_LIFECYCLE, "FFI: Is_special! proto=%s, rndlevs=%d\n", sp->proto, (int)sp->rndlevs);
     }
     
     /* Setup level flags for maze */
     level.flags.is_maze_lev = TRUE;
     
-    fprintf(stderr, "FFI: x_maze_max=%d, y_maze_max=%d\n", x_maze_max, y_maze_max);
+    FFI_LOG(NH_FFI_LOG_LIFECYCLE, "FFI: x_maze_max=%d, y_maze_max=%d\n", x_maze_max, y_maze_max);
     makemaz("");
     
-    fprintf(stderr, "FFI: nh_ffi_generate_maze() complete. is_maze_lev=%d, corrmaze=%d\n", 
+    FFI_LOG(NH_FFI_LOG_LIFECYCLE, "FFI: nh_ffi_generate_maze() complete. is_maze_lev=%d, corrmaze=%d\n", 
             level.flags.is_maze_lev, level.flags.corrmaze);
-    fflush(stderr);
 #endif
 }
 
@@ -371,16 +475,21 @@ void nh_ffi_cleanup_globals(void) {
 #endif
 }
 
+/* Defined with the game contexts at the end of this file */
+static void ffi_ctx_capture_baseline(void);
+
+/* Defined with the startup image at the end of this file */
+static boolean ffi_image_load(void);
+static void ffi_image_record(void);
+static boolean g_tables_initialized = FALSE; /* one-time setup in nh_ffi_init() done */
+
 /* Initialize the game with character creation */
 int nh_ffi_init(const char* role, const char* race, int gender, int alignment) {
 #ifdef REAL_NETHACK
-    fprintf(stderr, "FFI: nh_ffi_init(%s, %s)...\n", role ? role : "NULL", race ? race : "NULL");
-    fflush(stderr);
+    FFI_LOG(NH_FFI_LOG_LIFECYCLE, "FFI: nh_ffi_init(%s, %s)...\n", role ? role : "NULL", race ? race : "NULL");
 
-    static boolean global_initialized = FALSE;
-    if (!global_initialized) {
-        fprintf(stderr, "FFI: Global NetHack initialization...\n");
-        fflush(stderr);
+    if (!g_tables_initialized) {
+        FFI_LOG(NH_FFI_LOG_LIFECYCLE, "FFI: Global NetHack initialization...\n");
         windowprocs = dummy_procs;
         
         /* Change directory to HACKDIR to find data files */
@@ -399,12 +508,16 @@ int nh_ffi_init(const char* role, const char* race, int gender, int alignment) {
         choose_windows("tty");
         
         dlb_init();
-        init_objects();
-        init_dungeons();
+        if (!ffi_image_load()) {
+            init_objects();
+            init_dungeons();
+            ffi_image_record();
+        }
         monst_init();
         vision_init();
         
-        global_initialized = TRUE;
+        g_tables_initialized = TRUE;
+        ffi_ctx_capture_baseline();
     } 
     
     /* ALWAYS zero core structures before u_init() to avoid double-free/SIGABRT */
@@ -442,19 +555,17 @@ int nh_ffi_init(const char* role, const char* race, int gender, int alignment) {
     flags.initgend = flags.female;
     flags.initalign = alignment;
 
-    fprintf(stderr, "FFI: u_init()...\n");
-    fflush(stderr);
+    FFI_LOG(NH_FFI_LOG_LIFECYCLE, "FFI: u_init()...\n");
     u_init();
 
     /* Fix ubirthday to a constant for reproducible antholemon() results */
     ubirthday = 0;
 
-    fprintf(stderr, "C FFI Rolled: Role=%s Race=%s HP=%d, Energy=%d\n", role, race, u.uhp, u.uen);
-    fflush(stderr);
+    FFI_LOG(NH_FFI_LOG_LIFECYCLE, "C FFI Rolled: Role=%s Race=%s HP=%d, Energy=%d\n", role, race, u.uhp, u.uen);
 
-    fprintf(stderr, "C FFI: Init complete, player at (%d,%d)\n", u.ux, u.uy);
-    fflush(stderr);
+    FFI_LOG(NH_FFI_LOG_LIFECYCLE, "C FFI: Init complete, player at (%d,%d)\n", u.ux, u.uy);
 
+    g_game_live = TRUE;
     return 0;
 #else
     if (g_initialized) {
@@ -509,6 +620,7 @@ int nh_ffi_reset(unsigned long seed) {
     init_isaac64(seed, rn2);
     init_isaac64(seed, rn2_on_display_rng);
     { extern unsigned long rng_call_counter; rng_call_counter = 0; }
+    g_rng_hash = NH_FFI_HASH_SEED;
 
     /* Don't re-call u_init() — calling it twice causes massive inventory
        duplication due to stale C global state that leaks between u_init calls.
@@ -516,6 +628,7 @@ int nh_ffi_reset(unsigned long seed) {
        Tests sync stats from Rust via set_state() anyway. */
     moves = 1L;
     multi = 0;
+    g_last_message[0] = '\0';
     return 0;
 #else
     (void)seed;
@@ -526,6 +639,7 @@ int nh_ffi_reset(unsigned long seed) {
     g_turn_count = 0;
     g_game_over = FALSE;
     g_last_message[0] = '\0';
+    g_rng_hash = NH_FFI_HASH_SEED;
     g_x = 40;
     g_y = 10;
     g_ac = 10;
@@ -569,9 +683,8 @@ static void nh_ffi_pre_generate_cleanup(void) {
 /* Generate level and place player on stairs (full newgame-like init) */
 int nh_ffi_generate_and_place(void) {
 #ifdef REAL_NETHACK
-    fprintf(stderr, "FFI: nh_ffi_generate_and_place() dnum=%d, dlevel=%d...\n",
+    FFI_LOG(NH_FFI_LOG_LIFECYCLE, "FFI: nh_ffi_generate_and_place() dnum=%d, dlevel=%d...\n",
             u.uz.dnum, u.uz.dlevel);
-    fflush(stderr);
 
     nh_ffi_pre_generate_cleanup();
     mklev();
@@ -604,9 +717,8 @@ int nh_ffi_generate_and_place(void) {
     /* Initialize monstermoves (matches C moveloop) */
     monstermoves = 1L;
 
-    fprintf(stderr, "FFI: nh_ffi_generate_and_place() complete. Player at (%d,%d), upstair=(%d,%d), dnstair=(%d,%d)\n",
+    FFI_LOG(NH_FFI_LOG_LIFECYCLE, "FFI: nh_ffi_generate_and_place() complete. Player at (%d,%d), upstair=(%d,%d), dnstair=(%d,%d)\n",
             u.ux, u.uy, xupstair, yupstair, xdnstair, ydnstair);
-    fflush(stderr);
     return 0;
 #else
     return 0;
@@ -616,18 +728,16 @@ int nh_ffi_generate_and_place(void) {
 /* Generate a new level */
 int nh_ffi_generate_level(void) {
 #ifdef REAL_NETHACK
-    fprintf(stderr, "FFI: nh_ffi_generate_level() ledger=%d, dnum=%d, dlevel=%d, name=%s...\n",
+    FFI_LOG(NH_FFI_LOG_LIFECYCLE, "FFI: nh_ffi_generate_level() ledger=%d, dnum=%d, dlevel=%d, name=%s...\n",
             ledger_no(&u.uz), u.uz.dnum, u.uz.dlevel, dungeons[u.uz.dnum].dname);
-    fflush(stderr);
 
     /* Thorough cleanup of accumulated state from prior generations */
     nh_ffi_pre_generate_cleanup();
 
     mklev();
 
-    fprintf(stderr, "FFI: nh_ffi_generate_level() complete. is_maze=%d, corrmaze=%d\n",
+    FFI_LOG(NH_FFI_LOG_LIFECYCLE, "FFI: nh_ffi_generate_level() complete. is_maze=%d, corrmaze=%d\n",
             level.flags.is_maze_lev, level.flags.corrmaze);
-    fflush(stderr);
     return 0;
 #else
     return 0;
@@ -727,9 +837,9 @@ const char* nh_ffi_get_map_json(void) {
             (rooms[i+1].hx >= 0 && i+1 < MAXNROFROOMS) ? "," : "");
     }
     p += sprintf(p, "]}");
-    return strdup(g_json_buffer);
+    return ffi_arena_strdup(g_json_buffer);
 #else
-    return strdup("{}");
+    return ffi_arena_strdup("{}");
 #endif
 }
 
@@ -921,6 +1031,40 @@ int nh_ffi_get_alignment(void) {
 #endif
 }
 
+/* ============================================================================
+ * Headless Mode
+ * ============================================================================ */
+
+/* Process-wide, like the log mask: iflags is not parked with a context */
+static unsigned int g_headless = 0;
+
+#define FFI_HEADLESS(flag) ((g_headless & (flag)) != 0)
+
+static void ffi_capture_message(const char* str) {
+    if (!str || FFI_HEADLESS(NH_FFI_HEADLESS_MESSAGES))
+        return;
+    strncpy(g_last_message, str, sizeof(g_last_message) - 1);
+    g_last_message[sizeof(g_last_message) - 1] = '\0';
+}
+
+unsigned int nh_ffi_set_headless(unsigned int flags) {
+    unsigned int old = g_headless;
+
+    g_headless = flags & NH_FFI_HEADLESS_ALL;
+#ifdef REAL_NETHACK
+    /* bot() still clears context.botl; force a full redraw once the status
+       lines are back so nothing stale is shown */
+    iflags.status_updates = !FFI_HEADLESS(NH_FFI_HEADLESS_STATUS);
+    if ((old & NH_FFI_HEADLESS_STATUS) && iflags.status_updates)
+        context.botlx = TRUE;
+#endif
+    return old;
+}
+
+unsigned int nh_ffi_get_headless(void) {
+    return g_headless;
+}
+
 /* ============================================================================
  * Command Execution
  * ============================================================================ */
@@ -928,12 +1072,91 @@ int nh_ffi_get_alignment(void) {
 /* Set message */
 #ifndef REAL_NETHACK
 static void nh_ffi_set_message(const char* msg) {
-    if (msg) {
-        strncpy(g_last_message, msg, sizeof(g_last_message) - 1);
-        g_last_message[sizeof(g_last_message) - 1] = '\0';
-    }
+    ffi_capture_message(msg);
+}
+#endif
+
+/* ============================================================================
+ * Section Profiler
+ * ============================================================================ */
+
+static const char *const ffi_section_names[NH_FFI_SECT_COUNT] = {
+    "movemon", "mcalcdistress", "mcalcmove", "spawn", "speed",
+    "timeout", "hp_regen", "energy_regen", "tele_poly", "search",
+    "dosounds", "do_storms", "gethungry", "age_spells", "exerchk",
+    "invault", "engrave"
+};
+
+static struct nh_ffi_section_profile g_section_profile[NH_FFI_SECT_COUNT];
+
+struct ffi_section_mark {
+    unsigned long rng;
+    uint64_t ns;
+};
+
+static inline uint64_t ffi_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
 }
+
+static inline unsigned long ffi_rng_now(void) {
+#ifdef REAL_NETHACK
+    extern unsigned long rng_call_counter;
+    return rng_call_counter;
+#else
+    return 0;
 #endif
+}
+
+static inline void ffi_section_enter(struct ffi_section_mark *mark) {
+    mark->rng = ffi_rng_now();
+    mark->ns = FFI_HEADLESS(NH_FFI_HEADLESS_PROFILE) ? 0 : ffi_now_ns();
+}
+
+/* Charge the time and RNG calls since ffi_section_enter() to a section.
+   Returns the RNG delta so callers can still log it. */
+static inline unsigned long ffi_section_leave(int sect, const struct ffi_section_mark *mark) {
+    struct nh_ffi_section_profile *p = &g_section_profile[sect];
+    unsigned long rng = ffi_rng_now() - mark->rng;
+    uint64_t ns;
+
+    if (FFI_HEADLESS(NH_FFI_HEADLESS_PROFILE))
+        return rng;
+    ns = ffi_now_ns() - mark->ns;
+
+    p->calls++;
+    p->rng_calls += rng;
+    p->nanos += ns;
+    p->total_calls++;
+    p->total_rng_calls += rng;
+    p->total_nanos += ns;
+    return rng;
+}
+
+/* Start of a command: per-command counters restart, totals keep going */
+static void ffi_section_begin_command(void) {
+    if (FFI_HEADLESS(NH_FFI_HEADLESS_PROFILE))
+        return;
+    for (int i = 0; i < NH_FFI_SECT_COUNT; i++) {
+        g_section_profile[i].calls = 0;
+        g_section_profile[i].rng_calls = 0;
+        g_section_profile[i].nanos = 0;
+    }
+}
+
+int nh_ffi_get_section_profile(struct nh_ffi_section_profile *out, int max) {
+    for (int i = 0; i < NH_FFI_SECT_COUNT && i < max; i++) {
+        out[i] = g_section_profile[i];
+        strncpy(out[i].name, ffi_section_names[i], NH_FFI_SECTION_NAME_LEN - 1);
+        out[i].name[NH_FFI_SECTION_NAME_LEN - 1] = '\0';
+    }
+    return NH_FFI_SECT_COUNT;
+}
+
+void nh_ffi_reset_section_profile(void) {
+    memset(g_section_profile, 0, sizeof(g_section_profile));
+}
 
 /* Inline regen_hp (static in allmain.c, can't call directly) */
 static void ffi_regen_hp(int wtcap) {
@@ -1010,6 +1233,7 @@ static void ffi_post_command(void) {
     int moveamt = 0, wtcap = 0;
     boolean monscanmove = FALSE;
     int change = 0;
+    unsigned long rngs;
 
     /* Hero spends movement (C moveloop line 95) */
     youmonst.movement -= NORMAL_SPEED;
@@ -1019,19 +1243,19 @@ static void ffi_post_command(void) {
 
         context.mon_moving = TRUE;
         if (!ffi_skip_movemon) {
-            extern unsigned long rng_call_counter;
-            unsigned long rng_movemon_start = rng_call_counter;
+            struct ffi_section_mark sect;
             int movemon_rounds = 0;
+            ffi_section_enter(&sect);
             do {
                 monscanmove = movemon();
                 movemon_rounds++;
                 if (youmonst.movement >= NORMAL_SPEED)
                     break; /* hero gained movement from speed */
             } while (monscanmove);
-            fprintf(stderr, "  C SECTION movemon: %lu RNG calls (%d rounds)\n",
-                rng_call_counter - rng_movemon_start, movemon_rounds);
+            rngs = ffi_section_leave(NH_FFI_SECT_MOVEMON, &sect);
+            FFI_LOG(NH_FFI_LOG_SECTION, "  C SECTION movemon: %lu RNG calls (%d rounds)\n", rngs, movemon_rounds);
             /* Print per-monster positions after movemon for debugging */
-            {
+            if (FFI_LOG_ON(NH_FFI_LOG_MONSTER)) {
                 struct monst *mtmp;
                 int mi = 0;
                 for (mtmp = fmon; mtmp; mtmp = mtmp->nmon, mi++) {
@@ -1048,29 +1272,31 @@ static void ffi_post_command(void) {
         if (!monscanmove && youmonst.movement < NORMAL_SPEED) {
             /* Both hero and monsters are out of steam — new turn */
             struct monst *mtmp;
-            extern unsigned long rng_call_counter;
-            unsigned long rng_sect;
+            struct ffi_section_mark sect;
 
-            rng_sect = rng_call_counter;
+            ffi_section_enter(&sect);
             mcalcdistress(); /* adjust monsters' trap, blind, etc */
-            fprintf(stderr, "  C SECTION mcalcdistress: %lu RNG calls\n", rng_call_counter - rng_sect);
+            rngs = ffi_section_leave(NH_FFI_SECT_MCALCDISTRESS, &sect);
+            FFI_LOG(NH_FFI_LOG_SECTION, "  C SECTION mcalcdistress: %lu RNG calls\n", rngs);
 
             /* Reallocate movement to monsters */
-            rng_sect = rng_call_counter;
+            ffi_section_enter(&sect);
             for (mtmp = fmon; mtmp; mtmp = mtmp->nmon)
                 mtmp->movement += mcalcmove(mtmp);
-            fprintf(stderr, "  C SECTION mcalcmove: %lu RNG calls\n", rng_call_counter - rng_sect);
+            rngs = ffi_section_leave(NH_FFI_SECT_MCALCMOVE, &sect);
+            FFI_LOG(NH_FFI_LOG_SECTION, "  C SECTION mcalcmove: %lu RNG calls\n", rngs);
 
             /* Occasionally add another monster (C moveloop lines 124-128) */
-            rng_sect = rng_call_counter;
+            ffi_section_enter(&sect);
             if (!rn2(u.uevent.udemigod ? 25
                      : (depth(&u.uz) > depth(&stronghold_level)) ? 50
                        : 70))
                 (void) makemon((struct permonst *) 0, 0, 0, NO_MM_FLAGS);
-            fprintf(stderr, "  C SECTION spawn: %lu RNG calls\n", rng_call_counter - rng_sect);
+            rngs = ffi_section_leave(NH_FFI_SECT_SPAWN, &sect);
+            FFI_LOG(NH_FFI_LOG_SECTION, "  C SECTION spawn: %lu RNG calls\n", rngs);
 
             /* Calculate hero movement for this turn (C moveloop lines 131-169) */
-            rng_sect = rng_call_counter;
+            ffi_section_enter(&sect);
             if (u.usteed && u.umoved) {
                 moveamt = mcalcmove(u.usteed);
             } else {
@@ -1084,7 +1310,8 @@ static void ffi_post_command(void) {
                         moveamt += NORMAL_SPEED;
                 }
             }
-            fprintf(stderr, "  C SECTION speed: %lu RNG calls (Fast=%d VFast=%d)\n", rng_call_counter - rng_sect, (int)(!!Fast), (int)(!!Very_fast));
+            rngs = ffi_section_leave(NH_FFI_SECT_SPEED, &sect);
+            FFI_LOG(NH_FFI_LOG_SECTION, "  C SECTION speed: %lu RNG calls (Fast=%d VFast=%d)\n", rngs, (int)(!!Fast), (int)(!!Very_fast));
 
             switch (wtcap) {
             case UNENCUMBERED: break;
@@ -1106,18 +1333,19 @@ static void ffi_post_command(void) {
             /* once-per-turn things go here */
             /********************************/
 
-            rng_sect = rng_call_counter;
+            ffi_section_enter(&sect);
             if (Glib)
                 glibr();
             nh_timeout();
             run_regions();
-            fprintf(stderr, "  C SECTION timeout+regions: %lu RNG calls\n", rng_call_counter - rng_sect);
+            rngs = ffi_section_leave(NH_FFI_SECT_TIMEOUT, &sect);
+            FFI_LOG(NH_FFI_LOG_SECTION, "  C SECTION timeout+regions: %lu RNG calls\n", rngs);
 
             if (u.ublesscnt)
                 u.ublesscnt--;
 
             /* HP regeneration (C moveloop lines 200-205) */
-            rng_sect = rng_call_counter;
+            ffi_section_enter(&sect);
             if (!u.uinvulnerable) {
                 if (!Upolyd ? (u.uhp < u.uhpmax)
                             : (u.mh < u.mhmax
@@ -1125,7 +1353,8 @@ static void ffi_post_command(void) {
                     ffi_regen_hp(wtcap);
                 }
             }
-            fprintf(stderr, "  C SECTION hp_regen: %lu RNG calls (hp=%d/%d)\n", rng_call_counter - rng_sect, u.uhp, u.uhpmax);
+            rngs = ffi_section_leave(NH_FFI_SECT_HP_REGEN, &sect);
+            FFI_LOG(NH_FFI_LOG_SECTION, "  C SECTION hp_regen: %lu RNG calls (hp=%d/%d)\n", rngs, u.uhp, u.uhpmax);
 
             /* Moving while encumbered costs HP (C moveloop lines 208-223) */
             if (wtcap > MOD_ENCUMBER && u.umoved) {
@@ -1140,7 +1369,7 @@ static void ffi_post_command(void) {
             }
 
             /* Energy regeneration (C moveloop lines 225-237) */
-            rng_sect = rng_call_counter;
+            ffi_section_enter(&sect);
             if (u.uen < u.uenmax
                 && ((wtcap < MOD_ENCUMBER
                      && (!(moves % ((MAXULEV + 8 - u.ulevel)
@@ -1151,12 +1380,13 @@ static void ffi_post_command(void) {
                 if (u.uen > u.uenmax)
                     u.uen = u.uenmax;
             }
-            fprintf(stderr, "  C SECTION energy_regen: %lu RNG calls (en=%d/%d moves=%ld freq=%d)\n",
-                rng_call_counter - rng_sect, u.uen, u.uenmax, moves,
+            rngs = ffi_section_leave(NH_FFI_SECT_ENERGY_REGEN, &sect);
+            FFI_LOG(NH_FFI_LOG_SECTION, "  C SECTION energy_regen: %lu RNG calls (en=%d/%d moves=%ld freq=%d)\n",
+                rngs, u.uen, u.uenmax, moves,
                 (int)((MAXULEV + 8 - u.ulevel) * (Role_if(PM_WIZARD) ? 3 : 4) / 6));
 
             /* Teleportation check (C moveloop line 240) */
-            rng_sect = rng_call_counter;
+            ffi_section_enter(&sect);
             if (!u.uinvulnerable) {
                 if (Teleportation && !rn2(85)) {
                     xchar old_ux = u.ux, old_uy = u.uy;
@@ -1187,38 +1417,46 @@ static void ffi_post_command(void) {
                     }
                 }
             }
-            fprintf(stderr, "  C SECTION tele+poly: %lu RNG calls\n", rng_call_counter - rng_sect);
+            rngs = ffi_section_leave(NH_FFI_SECT_TELE_POLY, &sect);
+            FFI_LOG(NH_FFI_LOG_SECTION, "  C SECTION tele+poly: %lu RNG calls\n", rngs);
 
-            rng_sect = rng_call_counter;
+            ffi_section_enter(&sect);
             if (Searching && multi >= 0)
                 (void) dosearch0(1);
-            fprintf(stderr, "  C SECTION search: %lu RNG calls\n", rng_call_counter - rng_sect);
-            rng_sect = rng_call_counter;
+            rngs = ffi_section_leave(NH_FFI_SECT_SEARCH, &sect);
+            FFI_LOG(NH_FFI_LOG_SECTION, "  C SECTION search: %lu RNG calls\n", rngs);
+            ffi_section_enter(&sect);
             dosounds();
-            fprintf(stderr, "  C SECTION dosounds: %lu RNG calls\n", rng_call_counter - rng_sect);
-            rng_sect = rng_call_counter;
+            rngs = ffi_section_leave(NH_FFI_SECT_DOSOUNDS, &sect);
+            FFI_LOG(NH_FFI_LOG_SECTION, "  C SECTION dosounds: %lu RNG calls\n", rngs);
+            ffi_section_enter(&sect);
             do_storms();
-            fprintf(stderr, "  C SECTION do_storms: %lu RNG calls\n", rng_call_counter - rng_sect);
-            rng_sect = rng_call_counter;
+            rngs = ffi_section_leave(NH_FFI_SECT_DO_STORMS, &sect);
+            FFI_LOG(NH_FFI_LOG_SECTION, "  C SECTION do_storms: %lu RNG calls\n", rngs);
+            ffi_section_enter(&sect);
             gethungry();
-            fprintf(stderr, "  C SECTION gethungry: %lu RNG calls\n", rng_call_counter - rng_sect);
-            rng_sect = rng_call_counter;
+            rngs = ffi_section_leave(NH_FFI_SECT_GETHUNGRY, &sect);
+            FFI_LOG(NH_FFI_LOG_SECTION, "  C SECTION gethungry: %lu RNG calls\n", rngs);
+            ffi_section_enter(&sect);
             age_spells();
-            fprintf(stderr, "  C SECTION age_spells: %lu RNG calls\n", rng_call_counter - rng_sect);
-            rng_sect = rng_call_counter;
+            rngs = ffi_section_leave(NH_FFI_SECT_AGE_SPELLS, &sect);
+            FFI_LOG(NH_FFI_LOG_SECTION, "  C SECTION age_spells: %lu RNG calls\n", rngs);
+            ffi_section_enter(&sect);
             exerchk();
-            fprintf(stderr, "  C SECTION exerchk: %lu RNG calls\n", rng_call_counter - rng_sect);
-            rng_sect = rng_call_counter;
+            rngs = ffi_section_leave(NH_FFI_SECT_EXERCHK, &sect);
+            FFI_LOG(NH_FFI_LOG_SECTION, "  C SECTION exerchk: %lu RNG calls\n", rngs);
+            ffi_section_enter(&sect);
             invault();
             if (u.uhave.amulet)
                 amulet();
-            fprintf(stderr, "  C SECTION invault+amulet: %lu RNG calls\n", rng_call_counter - rng_sect);
+            rngs = ffi_section_leave(NH_FFI_SECT_INVAULT, &sect);
+            FFI_LOG(NH_FFI_LOG_SECTION, "  C SECTION invault+amulet: %lu RNG calls\n", rngs);
 
-            rng_sect = rng_call_counter;
+            ffi_section_enter(&sect);
             if (!rn2(40 + (int) (ACURR(A_DEX) * 3)))
                 u_wipe_engr(rnd(3));
-            fprintf(stderr, "  C SECTION engrave: %lu RNG calls (dex=%d threshold=%d)\n",
-                rng_call_counter - rng_sect, (int)ACURR(A_DEX), 40 + (int)(ACURR(A_DEX) * 3));
+            rngs = ffi_section_leave(NH_FFI_SECT_ENGRAVE, &sect);
+            FFI_LOG(NH_FFI_LOG_SECTION, "  C SECTION engrave: %lu RNG calls (dex=%d threshold=%d)\n", rngs, (int)ACURR(A_DEX), 40 + (int)(ACURR(A_DEX) * 3));
             if (u.uevent.udemigod && !u.uinvulnerable) {
                 if (u.udg_cnt)
                     u.udg_cnt--;
@@ -1244,8 +1482,8 @@ static void ffi_post_command(void) {
 /* Execute a game command */
 int nh_ffi_exec_cmd(char cmd) {
 #ifdef REAL_NETHACK
-    fprintf(stderr, "C FFI Exec: '%c' Start Pos: (%d,%d)\n", cmd, u.ux, u.uy);
-    fflush(stderr);
+    ffi_section_begin_command();
+    FFI_LOG(NH_FFI_LOG_EXEC, "C FFI Exec: '%c' Start Pos: (%d,%d)\n", cmd, u.ux, u.uy);
 
     int is_movement = 1;
 
@@ -1264,8 +1502,7 @@ int nh_ffi_exec_cmd(char cmd) {
             is_movement = 0;
             break;
         default:
-            fprintf(stderr, "FFI: Unsupported command '%c'\n", cmd);
-            fflush(stderr);
+            FFI_LOG(NH_FFI_LOG_EXEC, "FFI: Unsupported command '%c'\n", cmd);
             return -1;
     }
 
@@ -1289,14 +1526,12 @@ int nh_ffi_exec_cmd(char cmd) {
         ffi_post_command();
     } else {
         /* Returned via longjmp from nh_terminate — player died */
-        fprintf(stderr, "C FFI Exec: '%c' — player died during post-turn processing\n", cmd);
-        fflush(stderr);
+        FFI_LOG(NH_FFI_LOG_EXEC, "C FFI Exec: '%c' — player died during post-turn processing\n", cmd);
     }
     ffi_in_post_command = 0;
 
-    fprintf(stderr, "C FFI Exec: '%c' End Pos: (%d,%d) moves=%ld died=%d\n",
+    FFI_LOG(NH_FFI_LOG_EXEC, "C FFI Exec: '%c' End Pos: (%d,%d) moves=%ld died=%d\n",
             cmd, u.ux, u.uy, moves, ffi_player_died);
-    fflush(stderr);
     return ffi_player_died ? -2 : 0;
 #else
     if (!g_initialized) {
@@ -1368,6 +1603,78 @@ int nh_ffi_exec_cmd_dir(char cmd, int dx, int dy) {
 #endif
 }
 
+/* Run a command script without a round trip per keystroke */
+int nh_ffi_exec_cmds(const char* cmds, int n, struct nh_ffi_step_digest* digests) {
+    int i;
+
+    if (!cmds || n < 0) {
+        return -1;
+    }
+
+    for (i = 0; i < n; i++) {
+        int status = nh_ffi_exec_cmd(cmds[i]);
+
+        if (digests) {
+            (void) nh_ffi_get_step_digest(&digests[i], status);
+        }
+        if (status != 0) {
+            return i + 1;
+        }
+    }
+    return n;
+}
+
+/* Hash of the state a lockstep run compares every turn; the layout notes
+   in nethack_ffi_types.h give the exact fold. */
+static uint64_t ffi_state_hash(const struct nh_ffi_step_digest* d) {
+    uint64_t h = NH_FFI_HASH_SEED, mons = 0;
+#ifdef REAL_NETHACK
+    struct monst *mtmp;
+
+    for (mtmp = fmon; mtmp; mtmp = mtmp->nmon) {
+        uint64_t m = NH_FFI_HASH_SEED;
+
+        if (DEADMONSTER(mtmp))
+            continue;
+        m = FFI_HASH_INT(m, mtmp->mx);
+        m = FFI_HASH_INT(m, mtmp->my);
+        m = FFI_HASH_INT(m, mtmp->mhp);
+        mons += m;
+    }
+#endif
+    h = FFI_HASH_INT(h, d->turn);
+    h = FFI_HASH_INT(h, d->x);
+    h = FFI_HASH_INT(h, d->y);
+    h = FFI_HASH_INT(h, d->hp);
+    h = FFI_HASH_INT(h, d->hpmax);
+    h = FFI_HASH_INT(h, d->depth);
+    return ffi_hash_word(h, mons);
+}
+
+int nh_ffi_get_step_digest(struct nh_ffi_step_digest* d, int status) {
+    int x, y;
+
+    if (!d) {
+        return -1;
+    }
+    nh_ffi_get_position(&x, &y);
+    d->rng_calls = ffi_rng_now();
+    d->turn = (uint32_t)nh_ffi_get_turn_count();
+    d->hp = nh_ffi_get_hp();
+    d->hpmax = nh_ffi_get_max_hp();
+    d->x = (uint8_t)x;
+    d->y = (uint8_t)y;
+    d->status = (int8_t)status;
+    d->depth = (int8_t)nh_ffi_get_dungeon_depth();
+    d->rng_hash = g_rng_hash;
+    d->state_hash = ffi_state_hash(d);
+    return 0;
+}
+
+void nh_ffi_reset_rng_hash(void) {
+    g_rng_hash = NH_FFI_HASH_SEED;
+}
+
 /* ============================================================================
  * State Serialization
  * ============================================================================ */
@@ -1376,11 +1683,11 @@ int nh_ffi_exec_cmd_dir(char cmd, int dx, int dy) {
 char* nh_ffi_get_state_json(void) {
 #ifndef REAL_NETHACK
     if (!g_initialized) {
-        return strdup("{}");
+        return ffi_arena_strdup("{}");
     }
 #endif
     
-    char* json = (char*)malloc(4096);
+    char* json = (char*)ffi_arena_alloc(4096);
     if (json == NULL) return NULL;
     
     int x, y;
@@ -1425,26 +1732,431 @@ char* nh_ffi_get_state_json(void) {
     return json;
 }
 
-/* Free JSON string */
+/* Strings now live in the output arena and go away with
+   nh_ffi_arena_reset(); kept so callers of the old malloc API still link. */
 void nh_ffi_free_string(void* ptr) {
-    if (ptr != NULL) {
-        free(ptr);
+    (void)ptr;
+}
+
+/* ============================================================================
+ * Structured State
+ * ============================================================================ */
+
+/* Fill the whole player state in one call; same values as the scalar
+   getters above. */
+int nh_ffi_get_game_state(struct nh_ffi_game_state* state) {
+    int x, y;
+
+    if (state == NULL) return -1;
+    memset(state, 0, sizeof(*state));
+    nh_ffi_get_position(&x, &y);
+    state->hp = nh_ffi_get_hp();
+    state->hp_max = nh_ffi_get_max_hp();
+    state->energy = nh_ffi_get_energy();
+    state->energy_max = nh_ffi_get_max_energy();
+    state->x = x;
+    state->y = y;
+    state->level = nh_ffi_get_current_level();
+    state->experience_level = nh_ffi_get_experience_level();
+    state->armor_class = nh_ffi_get_armor_class();
+    state->gold = nh_ffi_get_gold();
+#ifdef REAL_NETHACK
+    state->strength = ACURR(A_STR);
+    state->dexterity = ACURR(A_DEX);
+    state->constitution = ACURR(A_CON);
+    state->intelligence = ACURR(A_INT);
+    state->wisdom = ACURR(A_WIS);
+    state->charisma = ACURR(A_CHA);
+    state->hunger_state = (int32_t)u.uhs;
+#else
+    /* Same defaults as nh_ffi_get_attributes_json() */
+    state->strength = state->dexterity = state->constitution = 10;
+    state->intelligence = state->wisdom = state->charisma = 10;
+    state->hunger_state = 1; /* NOT_HUNGRY */
+#endif
+    state->is_dead = nh_ffi_is_player_dead() ? 1 : 0;
+    state->turn_count = (uint64_t)nh_ffi_get_turn_count();
+    state->dungeon_depth = nh_ffi_get_dungeon_depth();
+    state->monster_count = nh_ffi_get_monsters(NULL, 0);
+    return 0;
+}
+
+/* Copy up to max inventory items; returns the inventory size. */
+int nh_ffi_get_inventory(struct nh_ffi_object* out, int max) {
+#ifdef REAL_NETHACK
+    int n = 0;
+    struct obj *otmp;
+
+    for (otmp = invent; otmp; otmp = otmp->nobj, n++) {
+        const struct objclass *oc = &objects[otmp->otyp];
+        const char *name = NULL;
+        struct nh_ffi_object *o;
+
+        if (!out || n >= max)
+            continue;
+        o = &out[n];
+        memset(o, 0, sizeof(*o));
+        if (oc->oc_name_idx >= 0 && oc->oc_name_idx < NUM_OBJECTS)
+            name = obj_descr[oc->oc_name_idx].oc_name;
+        snprintf(o->name, sizeof(o->name), "%s", name ? name : "item");
+        o->obj_class = def_oc_syms[(int)otmp->oclass].sym;
+        o->weight = (int32_t)otmp->owt;
+        o->value = oc->oc_cost;
+        o->quantity = (int32_t)otmp->quan;
+        o->enchantment = otmp->spe;
+        o->cursed = otmp->cursed;
+        o->blessed = otmp->blessed;
+        o->armor_class = otmp->oclass == ARMOR_CLASS ? oc->a_ac : 0;
+        o->damage = otmp->oclass == WEAPON_CLASS ? oc->oc_wsdam : 0;
+        o->inv_letter = otmp->invlet;
+    }
+    return n;
+#else
+    (void)out; (void)max;
+    return 0;
+#endif
+}
+
+#ifdef REAL_NETHACK
+static void ffi_fill_monster(struct nh_ffi_monster* m, struct monst* mtmp) {
+    memset(m, 0, sizeof(*m));
+    snprintf(m->name, sizeof(m->name), "%s", mtmp->data->mname);
+    m->symbol = def_monsyms[(int)mtmp->data->mlet].sym;
+    m->level = mtmp->m_lev;
+    m->hp = mtmp->mhp;
+    m->max_hp = mtmp->mhpmax;
+    m->armor_class = find_mac(mtmp);
+    m->x = mtmp->mx;
+    m->y = mtmp->my;
+    m->asleep = mtmp->msleeping;
+    m->peaceful = mtmp->mpeaceful;
+}
+#endif
+
+/* Copy up to max live monsters on the level; returns how many there are. */
+int nh_ffi_get_monsters(struct nh_ffi_monster* out, int max) {
+#ifdef REAL_NETHACK
+    int n = 0;
+    struct monst *mtmp;
+
+    for (mtmp = fmon; mtmp; mtmp = mtmp->nmon) {
+        if (DEADMONSTER(mtmp))
+            continue;
+        if (out && n < max)
+            ffi_fill_monster(&out[n], mtmp);
+        n++;
+    }
+    return n;
+#else
+    (void)out; (void)max;
+    return 0;
+#endif
+}
+
+/* Same for the live monsters in a clipped rectangle, found through
+   level.monsters[][] so the cost follows the area rather than fmon. */
+int nh_ffi_get_monsters_in_rect(int x1, int y1, int x2, int y2,
+                                struct nh_ffi_monster* out, int max) {
+#ifdef REAL_NETHACK
+    int n = 0, x, y;
+
+    if (x1 < 1) x1 = 1;
+    if (y1 < 0) y1 = 0;
+    if (x2 > COLNO - 1) x2 = COLNO - 1;
+    if (y2 > ROWNO - 1) y2 = ROWNO - 1;
+
+    /* level.monsters is [COLNO][ROWNO]: walk columns in storage order */
+    for (x = x1; x <= x2; x++) {
+        for (y = y1; y <= y2; y++) {
+            struct monst *mtmp = level.monsters[x][y];
+
+            /* Long worm tail segments point back at the head */
+            if (!mtmp || DEADMONSTER(mtmp) || mtmp->mx != x || mtmp->my != y)
+                continue;
+            if (out && n < max)
+                ffi_fill_monster(&out[n], mtmp);
+            n++;
+        }
     }
+    return n;
+#else
+    (void)x1; (void)y1; (void)x2; (void)y2; (void)out; (void)max;
+    return 0;
+#endif
+}
+
+int nh_ffi_get_monsters_near(int x, int y, int radius, struct nh_ffi_monster* out, int max) {
+    if (radius < 0)
+        return 0;
+    return nh_ffi_get_monsters_in_rect(x - radius, y - radius, x + radius, y + radius, out, max);
 }
 
 /* ============================================================================
- * Message Log
+ * Static Tables
  * ============================================================================ */
 
-/* Get last message */
-char* nh_ffi_get_last_message(void) {
+#define FFI_FNV_OFFSET 0xcbf29ce484222325ULL
+#define FFI_FNV_PRIME  0x100000001b3ULL
+
+static uint64_t ffi_fnv1a64(uint64_t h, const void *p, size_t n) {
+    const unsigned char *b = (const unsigned char *)p;
+    while (n--) {
+        h ^= *b++;
+        h *= FFI_FNV_PRIME;
+    }
+    return h;
+}
+
+/* Writes records and strings when out is set; otherwise only sizes them */
+struct ffi_static_writer {
+    unsigned char *out;
+    size_t strings_offset;
+    size_t strings_size;
+};
+
+static uint32_t ffi_static_string(struct ffi_static_writer *w, const char *str) {
+    size_t n, off;
+
+    if (!str)
+        return NH_FFI_STATIC_NONE;
+    n = strlen(str) + 1;
+    off = w->strings_size;
+    if (w->out)
+        memcpy(w->out + w->strings_offset + off, str, n);
+    w->strings_size += n;
+    return (uint32_t)off;
+}
+
+static void ffi_static_record(struct ffi_static_writer *w, const struct nh_ffi_static_section *sect,
+                              int i, const void *rec) {
+    if (w->out)
+        memcpy(w->out + sect->offset + (size_t)i * sect->record_size, rec, sect->record_size);
+}
+
+static int ffi_static_count(int section) {
+#ifdef REAL_NETHACK
+    int n = 0;
+    switch (section) {
+    case NH_FFI_STATIC_MONSTERS: return NUMMONS;
+    case NH_FFI_STATIC_OBJECTS: return NUM_OBJECTS;
+    case NH_FFI_STATIC_ARTIFACTS: return NROFARTIFACTS;
+    case NH_FFI_STATIC_ROLES:
+        while (roles[n].name.m)
+            n++;
+        return n;
+    case NH_FFI_STATIC_RACES:
+        while (races[n].noun)
+            n++;
+        return n;
+    }
+#endif
+    (void)section;
+    return 0;
+}
+
+/* Fill every record; strings go to the pool in record order */
+static void ffi_static_fill(struct ffi_static_writer *w, const struct nh_ffi_static_header *hdr) {
 #ifdef REAL_NETHACK
-    return strdup("Real message log not yet implemented");
+    const struct nh_ffi_static_section *sect = hdr->sections;
+    int i, j;
+
+    for (i = 0; i < sect[NH_FFI_STATIC_MONSTERS].count; i++) {
+        const struct permonst *pm = &mons[i];
+        struct nh_ffi_static_monster m;
+
+        memset(&m, 0, sizeof(m));
+        m.name = ffi_static_string(w, pm->mname);
+        m.mlet = (uint8_t)pm->mlet;
+        m.mlevel = pm->mlevel;
+        m.mmove = pm->mmove;
+        m.ac = pm->ac;
+        m.mr = pm->mr;
+        m.maligntyp = (int8_t)pm->maligntyp;
+        m.geno = pm->geno;
+        for (j = 0; j < 6; j++) {
+            m.attacks[j][0] = pm->mattk[j].aatyp;
+            m.attacks[j][1] = pm->mattk[j].adtyp;
+            m.attacks[j][2] = pm->mattk[j].damn;
+            m.attacks[j][3] = pm->mattk[j].damd;
+        }
+        m.cwt = pm->cwt;
+        m.cnutrit = pm->cnutrit;
+        m.msound = pm->msound;
+        m.msize = pm->msize;
+        m.mresists = pm->mresists;
+        m.mconveys = pm->mconveys;
+        m.mflags1 = (uint32_t)pm->mflags1;
+        m.mflags2 = (uint32_t)pm->mflags2;
+        m.mflags3 = (uint32_t)pm->mflags3;
+        m.difficulty = pm->difficulty;
+        m.mcolor = pm->mcolor;
+        ffi_static_record(w, &sect[NH_FFI_STATIC_MONSTERS], i, &m);
+    }
+
+    for (i = 0; i < sect[NH_FFI_STATIC_OBJECTS].count; i++) {
+        const struct objclass *oc = &objects[i];
+        struct nh_ffi_static_object o;
+
+        memset(&o, 0, sizeof(o));
+        /* obj_descr[i], not oc_descr_idx: descriptions are shuffled per game */
+        o.name = ffi_static_string(w, obj_descr[i].oc_name);
+        o.descr = ffi_static_string(w, obj_descr[i].oc_descr);
+        o.oc_class = (uint8_t)oc->oc_class;
+        o.material = oc->oc_material;
+        o.color = oc->oc_color;
+        o.oprop = oc->oc_oprop;
+        o.weight = oc->oc_weight;
+        o.cost = oc->oc_cost;
+        o.prob = oc->oc_prob;
+        o.nutrition = oc->oc_nutrition;
+        o.wsdam = oc->oc_wsdam;
+        o.wldam = oc->oc_wldam;
+        o.oc1 = oc->oc_oc1;
+        o.oc2 = oc->oc_oc2;
+        o.subtyp = oc->oc_subtyp;
+        o.delay = oc->oc_delay;
+        o.flags = (oc->oc_merge ? NH_FFI_STATIC_OBJ_MERGE : 0)
+                  | (oc->oc_magic ? NH_FFI_STATIC_OBJ_MAGIC : 0)
+                  | (oc->oc_charged ? NH_FFI_STATIC_OBJ_CHARGED : 0)
+                  | (oc->oc_unique ? NH_FFI_STATIC_OBJ_UNIQUE : 0)
+                  | (oc->oc_nowish ? NH_FFI_STATIC_OBJ_NOWISH : 0)
+                  | (oc->oc_big ? NH_FFI_STATIC_OBJ_BIG : 0)
+                  | (oc->oc_tough ? NH_FFI_STATIC_OBJ_TOUGH : 0);
+        ffi_static_record(w, &sect[NH_FFI_STATIC_OBJECTS], i, &o);
+    }
+
+    /* artilist[] is static to artifact.c; artiname() and artifact_name()
+       are the public view of it */
+    for (i = 0; i < sect[NH_FFI_STATIC_ARTIFACTS].count; i++) {
+        struct nh_ffi_static_artifact a;
+        const char *name = artiname(i + 1);
+        short otyp = 0;
+
+        memset(&a, 0, sizeof(a));
+        a.name = ffi_static_string(w, name);
+        if (artifact_name(name, &otyp))
+            a.otyp = otyp;
+        ffi_static_record(w, &sect[NH_FFI_STATIC_ARTIFACTS], i, &a);
+    }
+
+    for (i = 0; i < sect[NH_FFI_STATIC_ROLES].count; i++) {
+        const struct Role *role = &roles[i];
+        struct nh_ffi_static_role r;
+
+        memset(&r, 0, sizeof(r));
+        r.name_m = ffi_static_string(w, role->name.m);
+        r.name_f = ffi_static_string(w, role->name.f);
+        for (j = 0; j < 9; j++) {
+            r.rank_m[j] = ffi_static_string(w, role->rank[j].m);
+            r.rank_f[j] = ffi_static_string(w, role->rank[j].f);
+        }
+        r.gods[0] = ffi_static_string(w, role->lgod);
+        r.gods[1] = ffi_static_string(w, role->ngod);
+        r.gods[2] = ffi_static_string(w, role->cgod);
+        r.filecode = ffi_static_string(w, role->filecode);
+        r.malenum = role->malenum;
+        r.femalenum = role->femalenum;
+        ffi_static_record(w, &sect[NH_FFI_STATIC_ROLES], i, &r);
+    }
+
+    for (i = 0; i < sect[NH_FFI_STATIC_RACES].count; i++) {
+        const struct Race *race = &races[i];
+        struct nh_ffi_static_race r;
+
+        memset(&r, 0, sizeof(r));
+        r.noun = ffi_static_string(w, race->noun);
+        r.adj = ffi_static_string(w, race->adj);
+        r.coll = ffi_static_string(w, race->coll);
+        r.filecode = ffi_static_string(w, race->filecode);
+        r.malenum = race->malenum;
+        r.femalenum = race->femalenum;
+        ffi_static_record(w, &sect[NH_FFI_STATIC_RACES], i, &r);
+    }
 #else
-    return strdup(g_last_message[0] ? g_last_message : "No message");
+    (void)w; (void)hdr;
 #endif
 }
 
+static long ffi_static_export(void *buf, size_t bufsize, uint64_t source_id);
+
+/* Identifies the tables themselves: the FNV-1a of their export, header
+   (section shapes, content hash) included, with source_id left 0.  A
+   rebuild that does not change them keeps the id.  Computed once. */
+unsigned long long nh_ffi_static_tables_id(void) {
+    static uint64_t id;
+    static boolean known = FALSE;
+    unsigned char *buf;
+    long size;
+
+    if (known)
+        return id;
+    size = ffi_static_export(NULL, 0, 0);
+    /* Out of memory: 0 matches no cache, and the next call retries */
+    if (!(buf = (unsigned char *)malloc((size_t)size)))
+        return 0;
+    ffi_static_export(buf, (size_t)size, 0);
+    id = ffi_fnv1a64(FFI_FNV_OFFSET, buf, (size_t)size);
+    known = TRUE;
+    free(buf);
+    return id;
+}
+
+/* Write the static game tables (layout in nethack_ffi_types.h). */
+long nh_ffi_export_static_tables(void* buf, size_t bufsize) {
+    return ffi_static_export(buf, bufsize, nh_ffi_static_tables_id());
+}
+
+static long ffi_static_export(void *buf, size_t bufsize, uint64_t source_id) {
+    static const uint16_t record_sizes[NH_FFI_STATIC_NSECTIONS] = {
+        sizeof(struct nh_ffi_static_monster), sizeof(struct nh_ffi_static_object),
+        sizeof(struct nh_ffi_static_artifact), sizeof(struct nh_ffi_static_role),
+        sizeof(struct nh_ffi_static_race),
+    };
+    struct nh_ffi_static_header hdr;
+    struct ffi_static_writer w;
+    size_t off, total;
+    int i;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = NH_FFI_STATIC_MAGIC;
+    hdr.version = NH_FFI_STATIC_VERSION;
+    hdr.header_size = sizeof(hdr);
+    hdr.source_id = source_id;
+    for (i = 0, off = sizeof(hdr); i < NH_FFI_STATIC_NSECTIONS; i++) {
+        hdr.sections[i].offset = (uint32_t)off;
+        hdr.sections[i].count = (uint16_t)ffi_static_count(i);
+        hdr.sections[i].record_size = record_sizes[i];
+        off += (size_t)hdr.sections[i].count * record_sizes[i];
+    }
+
+    /* Size the string pool, then write for real if the buffer fits */
+    memset(&w, 0, sizeof(w));
+    ffi_static_fill(&w, &hdr);
+    hdr.strings_offset = (uint32_t)off;
+    hdr.strings_size = (uint32_t)w.strings_size;
+    total = off + w.strings_size;
+    hdr.total_size = (uint32_t)total;
+    if (!buf || bufsize < total)
+        return (long)total;
+
+    w.out = (unsigned char *)buf;
+    w.strings_offset = off;
+    w.strings_size = 0;
+    ffi_static_fill(&w, &hdr);
+    hdr.content_hash = ffi_fnv1a64(FFI_FNV_OFFSET, w.out + sizeof(hdr), total - sizeof(hdr));
+    memcpy(w.out, &hdr, sizeof(hdr));
+    return (long)total;
+}
+
+/* ============================================================================
+ * Message Log
+ * ============================================================================ */
+
+/* Get last message */
+char* nh_ffi_get_last_message(void) {
+    return ffi_arena_strdup(g_last_message[0] ? g_last_message : "No message");
+}
+
 /* ============================================================================
  * Inventory Management
  * ============================================================================ */
@@ -1469,11 +2181,10 @@ char* nh_ffi_get_inventory_json(void) {
     struct obj *otmp;
     for (otmp = invent; otmp && count < 1000; otmp = otmp->nobj) count++;
     
-    fprintf(stderr, "FFI: nh_ffi_get_inventory_json() found %d items.\n", count);
-    fflush(stderr);
+    FFI_LOG(NH_FFI_LOG_JSON, "FFI: nh_ffi_get_inventory_json() found %d items.\n", count);
 
     size_t buf_size = (count + 1) * 1024 + 10;
-    char* json = (char*)malloc(buf_size);
+    char* json = (char*)ffi_arena_alloc(buf_size);
     if (json == NULL) return NULL;
     
     strcpy(json, "[");
@@ -1499,7 +2210,7 @@ char* nh_ffi_get_inventory_json(void) {
     strcat(json, "]");
     return json;
 #else
-    return strdup("[]");
+    return ffi_arena_strdup("[]");
 #endif
 }
 
@@ -1507,11 +2218,10 @@ char* nh_ffi_get_inventory_json(void) {
 char* nh_ffi_get_object_table_json(void) {
 #ifdef REAL_NETHACK
     size_t buf_size = 65536;
-    char* json = (char*)malloc(buf_size);
+    char* json = (char*)ffi_arena_alloc(buf_size);
     if (json == NULL) return NULL;
     
-    fprintf(stderr, "FFI: nh_ffi_get_object_table_json()...\n");
-    fflush(stderr);
+    FFI_LOG(NH_FFI_LOG_JSON, "FFI: nh_ffi_get_object_table_json()...\n");
 
     strcpy(json, "[");
     boolean first = TRUE;
@@ -1534,7 +2244,7 @@ char* nh_ffi_get_object_table_json(void) {
     strcat(json, "]");
     return json;
 #else
-    return strdup("[]");
+    return ffi_arena_strdup("[]");
 #endif
 }
 
@@ -1554,7 +2264,7 @@ char* minimal_monnam(struct monst *mtmp, int b) {
 /* Get nearby monsters as JSON */
 char* nh_ffi_get_nearby_monsters_json(void) {
 #ifdef REAL_NETHACK
-    char* json = (char*)malloc(16384);
+    char* json = (char*)ffi_arena_alloc(16384);
     if (json == NULL) return NULL;
     
     strcpy(json, "[");
@@ -1578,7 +2288,7 @@ char* nh_ffi_get_nearby_monsters_json(void) {
     strcat(json, "]");
     return json;
 #else
-    return strdup("[]");
+    return ffi_arena_strdup("[]");
 #endif
 }
 
@@ -1612,24 +2322,40 @@ boolean nh_ffi_is_game_won(void) {
     return FALSE;
 }
 
-/* Get game result message */
-char* nh_ffi_get_result_message(void) {
+/* Result text without touching the arena, for rollouts */
+static void ffi_result_text(char* buf, size_t size) {
 #ifdef REAL_NETHACK
-    return strdup("Game continues");
+    if (ffi_player_died) {
+        /* As topten.c words the killer, less the helplessness suffix */
+        const char* name = killer.name[0] ? killer.name : "unknown causes";
+        snprintf(buf, size, "%s%s",
+                 killer.format == NO_KILLER_PREFIX ? "" : "killed by ",
+                 killer.format == KILLED_BY_AN ? an(name) : name);
+        return;
+    }
+    snprintf(buf, size, "Game continues");
 #else
     if (!g_initialized) {
-        return strdup("Game not initialized");
-    }
-    if (g_game_over) {
-        return strdup("You died!");
+        snprintf(buf, size, "Game not initialized");
+    } else if (g_game_over) {
+        snprintf(buf, size, "You died!");
+    } else {
+        snprintf(buf, size, "Game continues");
     }
-    return strdup("Game continues");
 #endif
 }
 
-/* ============================================================================
- * Logic/Calculation Wrappers (Phase 2)
- * ============================================================================ */
+/* Get game result message */
+char* nh_ffi_get_result_message(void) {
+    char buf[256];
+
+    ffi_result_text(buf, sizeof(buf));
+    return ffi_arena_strdup(buf);
+}
+
+/* ============================================================================
+ * Logic/Calculation Wrappers (Phase 2)
+ * ============================================================================ */
 
 /* Synchronize engine state from external source */
 void nh_ffi_set_state(int hp, int hpmax, int x, int y, int ac, long turn_count) {
@@ -1667,6 +2393,15 @@ void nh_ffi_set_wizard_mode(int enable) {
 #endif
 }
 
+/* RNG state hooks, exported by c_src/isaac64_standalone.c in the stub
+   build and by c_src/nethack_rnd.c in the real one.  Without them game
+   contexts all draw from one ISAAC64 stream, checkpoints fail and skips
+   fall back to discarding draws. */
+extern size_t nh_rng_state_size(void) __attribute__((weak));
+extern void nh_rng_state_save(void *buf) __attribute__((weak));
+extern void nh_rng_state_load(const void *buf) __attribute__((weak));
+extern void nh_rng_skip(unsigned long n) __attribute__((weak));
+
 /* RNG wrapper */
 void nh_ffi_reset_rng(unsigned long seed) {
 #ifdef REAL_NETHACK
@@ -1674,6 +2409,7 @@ void nh_ffi_reset_rng(unsigned long seed) {
     init_isaac64(seed, rn2);
     init_isaac64(seed, rn2_on_display_rng);
     { extern unsigned long rng_call_counter; rng_call_counter = 0; }
+    g_rng_hash = NH_FFI_HASH_SEED;
 #endif
 }
 
@@ -1685,7 +2421,11 @@ void reseed_random(int (*fn)(int)) {
 }
 
 /* Forward declaration for rng_trace_record (defined below) */
-static void rng_trace_record(const char *func, unsigned long arg, unsigned long result);
+static void rng_trace_record(int func, int arg, int result);
+
+/* Set while the weapon calculator borrows the core RNG: its draws are
+   not the game's, so they stay out of the trace, stream and hash */
+static int g_rng_record_paused = 0;
 
 /* Return the total number of RNG calls made since last reset */
 unsigned long nh_ffi_get_rng_call_count(void) {
@@ -1699,26 +2439,24 @@ unsigned long nh_ffi_get_rng_call_count(void) {
 
 int nh_ffi_rng_rn2(int limit) {
 #ifdef REAL_NETHACK
-    int r = rn2(limit);
-    rng_trace_record("rn2", (unsigned long)limit, (unsigned long)r);
-    fprintf(stderr, "FFI: rn2(%d) = %d\n", limit, r);
+    int r = rn2(limit); /* recorded by nethack_rnd.c */
+    FFI_LOG(NH_FFI_LOG_RNG, "FFI: rn2(%d) = %d\n", limit, r);
     return r;
 #else
     if (limit <= 0) return 0;
-    rng_trace_record("rn2", (unsigned long)limit, 0);
+    rng_trace_record(NH_FFI_RNG_FN_RN2, limit, 0);
     return 0;
 #endif
 }
 
 int nh_ffi_rng_rnd(int limit) {
 #ifdef REAL_NETHACK
-    int r = rnd(limit);
-    rng_trace_record("rnd", (unsigned long)limit, (unsigned long)r);
-    fprintf(stderr, "FFI: rnd(%d) = %d\n", limit, r);
+    int r = rnd(limit); /* recorded by nethack_rnd.c */
+    FFI_LOG(NH_FFI_LOG_RNG, "FFI: rnd(%d) = %d\n", limit, r);
     return r;
 #else
     if (limit <= 0) return 1;
-    rng_trace_record("rnd", (unsigned long)limit, 1);
+    rng_trace_record(NH_FFI_RNG_FN_RND, limit, 1);
     return 1;
 #endif
 }
@@ -1735,23 +2473,283 @@ int nh_ffi_calc_base_damage(int weapon_id, int small_monster) {
 #endif
 }
 
+/* ============================================================================
+ * Weapon Calculator
+ * ============================================================================ */
+
+#ifdef REAL_NETHACK
+/* Scripted draws, from c_src/nethack_rnd.c */
+extern void nh_rng_plant(const uint64_t *raw, unsigned n);
+extern unsigned nh_rng_planted_left(void);
+
+/* More draws than dmgval() makes for any weapon against a plain monster */
+#define FFI_WEAPON_DRAWS 8
+
+/* dmgval() with its draws scripted: draw i returns raw[i], reduced by
+   the die it rolls.  *used gets the number of draws it made. */
+static int ffi_weapon_scripted(struct obj* obj, struct monst* mon,
+                               const uint64_t* raw, int* used) {
+    int dmg;
+
+    nh_rng_plant(raw, FFI_WEAPON_DRAWS);
+    dmg = dmgval(obj, mon);
+    *used = FFI_WEAPON_DRAWS - (int)nh_rng_planted_left();
+    return dmg;
+}
+
+/* Runs the game's own hitval() and dmgval() on a fresh object and a plain
+   jackal or ogre.  The exact distribution comes from enumerating every
+   face of every draw dmgval() makes; the faces of each draw are found
+   with an unenchanted copy, whose damage rises with each draw until the
+   die wraps. */
+static void ffi_weapon_query(const struct nh_ffi_weapon_query* q,
+                             struct nh_ffi_weapon_result* r) {
+    struct obj obj, probe;
+    struct monst mon;
+    uint64_t raw[FFI_WEAPON_DRAWS];
+    uint32_t counts[256];
+    int faces[FFI_WEAPON_DRAWS];
+    int draws, base, used, dmg, total, i, k;
+
+    memset(r, 0, sizeof(*r));
+    if (q->weapon_id < 0 || q->weapon_id >= NUM_OBJECTS) {
+        r->status = NH_FFI_WEAPON_UNKNOWN;
+        return;
+    }
+    if (q->enchantment < -128 || q->enchantment > 127) {
+        r->status = NH_FFI_WEAPON_RANGE;
+        return;
+    }
+
+    memset(&obj, 0, sizeof(obj));
+    obj.otyp = q->weapon_id;
+    obj.oclass = objects[q->weapon_id].oc_class;
+    obj.spe = (schar)q->enchantment;
+    obj.quan = 1L;
+    obj.owt = objects[q->weapon_id].oc_weight;
+    obj.where = OBJ_FREE;
+    probe = obj;
+    probe.spe = 0;
+
+    memset(&mon, 0, sizeof(mon));
+    mon.mnum = q->large ? PM_OGRE : PM_JACKAL;
+    mon.data = &mons[mon.mnum];
+    mon.cham = NON_PM;
+
+    /* hitval(): a hit needs to_hit + hitval() > rnd(20) */
+    r->hit_bonus = hitval(&obj, &mon);
+    total = q->to_hit + r->hit_bonus;
+    r->hit_faces = total <= 1 ? 0 : total > 20 ? 20 : (uint32_t)(total - 1);
+
+    memset(raw, 0, sizeof(raw));
+    base = ffi_weapon_scripted(&probe, &mon, raw, &draws);
+    if (draws < 0 || draws > FFI_WEAPON_DRAWS) {
+        r->status = NH_FFI_WEAPON_RANGE;
+        return;
+    }
+    for (i = 0; i < draws; i++) {
+        for (faces[i] = 0, k = 1; k < 256 && !faces[i]; k++) {
+            raw[i] = (uint64_t)k;
+            if (ffi_weapon_scripted(&probe, &mon, raw, &used) == base)
+                faces[i] = k;
+        }
+        raw[i] = 0;
+        if (!faces[i]) {
+            r->status = NH_FFI_WEAPON_RANGE;
+            return;
+        }
+    }
+
+    /* Every combination of faces, through the real object */
+    memset(counts, 0, sizeof(counts));
+    for (;;) {
+        dmg = ffi_weapon_scripted(&obj, &mon, raw, &used);
+        if (used != draws || dmg < 0 || dmg >= 256) {
+            r->status = NH_FFI_WEAPON_RANGE;
+            return;
+        }
+        counts[dmg]++;
+        for (i = 0; i < draws && ++raw[i] == (uint64_t)faces[i]; i++)
+            raw[i] = 0;
+        if (i == draws)
+            break;
+    }
+    for (r->dmg_min = 0; !counts[r->dmg_min]; r->dmg_min++)
+        ;
+    for (r->dmg_max = 255; !counts[r->dmg_max]; r->dmg_max--)
+        ;
+    if (r->dmg_max - r->dmg_min >= NH_FFI_DMG_BINS) {
+        r->status = NH_FFI_WEAPON_RANGE;
+        return;
+    }
+    if (q->exact) {
+        for (k = r->dmg_min; k <= r->dmg_max; k++) {
+            r->exact[k - r->dmg_min] = counts[k];
+            r->outcomes += counts[k];
+        }
+    }
+
+    if (q->samples) {
+        uint32_t n;
+
+        /* uhitm.c order: the to-hit roll, then dmgval() on a hit */
+        init_isaac64(q->seed, rn2);
+        for (n = 0; n < q->samples; n++) {
+            if (total <= rnd(20))
+                continue;
+            dmg = dmgval(&obj, &mon);
+            if (dmg < r->dmg_min || dmg > r->dmg_max) {
+                r->status = NH_FFI_WEAPON_RANGE;
+                return;
+            }
+            r->sampled[dmg - r->dmg_min]++;
+            r->hits++;
+        }
+    }
+}
+#endif
+
+/* The queries draw from the game's core RNG, so its state, the call
+   counter and the trace are put back afterwards: a batch leaves the game
+   exactly as it found it. */
+int nh_ffi_calc_weapon_batch(const struct nh_ffi_weapon_query* queries, int count,
+                             struct nh_ffi_weapon_result* out) {
+    int i;
+#ifdef REAL_NETHACK
+    extern unsigned long rng_call_counter;
+    unsigned long calls = rng_call_counter;
+    void* saved;
+#endif
+
+    if (count < 0 || (count > 0 && (!queries || !out)))
+        return -1;
+#ifdef REAL_NETHACK
+    if (!(saved = malloc(nh_rng_state_size())))
+        return -1;
+    nh_rng_state_save(saved);
+    g_rng_record_paused = 1;
+#endif
+    for (i = 0; i < count; i++) {
+#ifdef REAL_NETHACK
+        ffi_weapon_query(&queries[i], &out[i]);
+#else
+        memset(&out[i], 0, sizeof(out[i]));
+        out[i].status = NH_FFI_WEAPON_UNKNOWN;
+#endif
+    }
+#ifdef REAL_NETHACK
+    g_rng_record_paused = 0;
+    nh_rng_state_load(saved);
+    rng_call_counter = calls;
+    free(saved);
+#endif
+    return count;
+}
+
+/* ============================================================================
+ * RNG Positioning
+ * ============================================================================ */
+
+/* Checkpoint image: this header followed by nh_rng_state_save() output.
+   The call counter travels with the state so trace positions line up
+   after a restore. */
+#define FFI_RNG_CHECKPOINT_MAGIC 0x4B43524EU /* "NRCK" */
+
+struct ffi_rng_checkpoint {
+    uint32_t magic;
+    uint32_t state_size;
+    uint64_t rng_calls;
+};
+
+/* Advance the core RNG by n draws.  With nh_rng_skip() whole ISAAC64
+   blocks are regenerated without being read. */
+void nh_ffi_rng_skip(unsigned long n) {
+#ifdef REAL_NETHACK
+    extern unsigned long rng_call_counter;
+    if (nh_rng_skip) {
+        nh_rng_skip(n);
+        rng_call_counter += n;
+    } else {
+        /* rn2() counts each draw itself */
+        while (n--)
+            (void) rn2(2);
+    }
+#else
+    if (nh_rng_skip)
+        nh_rng_skip(n);
+#endif
+    FFI_LOG(NH_FFI_LOG_RNG, "FFI: rng_skip(%lu) -> call %lu\n", n, ffi_rng_now());
+}
+
+/* Write the RNG state into buf.  Returns the size the checkpoint needs
+   (0 if the RNG cannot be checkpointed); buf is only written when bufsize
+   is at least that large. */
+size_t nh_ffi_rng_checkpoint(void *buf, size_t bufsize) {
+    struct ffi_rng_checkpoint hdr;
+    size_t need;
+
+    if (!nh_rng_state_size || !nh_rng_state_save)
+        return 0;
+    need = sizeof(hdr) + nh_rng_state_size();
+    if (buf && bufsize >= need) {
+        hdr.magic = FFI_RNG_CHECKPOINT_MAGIC;
+        hdr.state_size = (uint32_t)nh_rng_state_size();
+        hdr.rng_calls = ffi_rng_now();
+        memcpy(buf, &hdr, sizeof(hdr));
+        nh_rng_state_save((unsigned char *)buf + sizeof(hdr));
+    }
+    return need;
+}
+
+/* Restore a checkpoint from nh_ffi_rng_checkpoint().  Returns 0, or -1 if
+   it does not match this build's RNG. */
+int nh_ffi_rng_restore(const void *buf, size_t size) {
+    struct ffi_rng_checkpoint hdr;
+
+    if (!buf || size < sizeof(hdr) || !nh_rng_state_size || !nh_rng_state_load)
+        return -1;
+    memcpy(&hdr, buf, sizeof(hdr));
+    if (hdr.magic != FFI_RNG_CHECKPOINT_MAGIC
+        || hdr.state_size != nh_rng_state_size()
+        || size != sizeof(hdr) + hdr.state_size)
+        return -1;
+    nh_rng_state_load((const unsigned char *)buf + sizeof(hdr));
+#ifdef REAL_NETHACK
+    { extern unsigned long rng_call_counter; rng_call_counter = (unsigned long)hdr.rng_calls; }
+#endif
+    return 0;
+}
+
 /* ============================================================================
  * RNG Trace Ring Buffer (Phase 4: Convergence Framework)
  * ============================================================================ */
 
 #define RNG_TRACE_SIZE 4096
 
+static const char *const ffi_rng_fn_names[NH_FFI_RNG_FN_COUNT] = {
+    "rn2", "rnd", "rne", "rnz", "rnl"
+};
+
 struct rng_trace_entry {
     unsigned long seq;
-    char func[8]; /* "rn2", "rnd", "rne", "rnz" */
-    unsigned long arg;
-    unsigned long result;
+    unsigned char func; /* NH_FFI_RNG_FN_* */
+    int arg;
+    int result;
 };
 
 static struct rng_trace_entry g_rng_trace[RNG_TRACE_SIZE];
 static unsigned long g_rng_trace_count = 0;
 static int g_rng_tracing = 0;
 
+/* Streaming mode: every call is kept, in nh_ffi_rng_trace_record form,
+   and written out a chunk at a time.  The stream is an output channel
+   rather than game state, so it is shared by all game contexts. */
+static int g_rng_stream_fd = -1;
+static struct nh_ffi_rng_trace_record g_rng_stream_buf[NH_FFI_RNG_TRACE_CHUNK];
+static unsigned int g_rng_stream_fill = 0;
+static uint32_t g_rng_stream_seq = 0;
+static int g_rng_stream_failed = 0;
+
 void nh_ffi_enable_rng_tracing(void) {
     g_rng_tracing = 1;
     g_rng_trace_count = 0;
@@ -1761,15 +2759,94 @@ void nh_ffi_disable_rng_tracing(void) {
     g_rng_tracing = 0;
 }
 
-static void rng_trace_record(const char *func, unsigned long arg, unsigned long result) {
-    if (!g_rng_tracing) return;
-    unsigned long idx = g_rng_trace_count % RNG_TRACE_SIZE;
-    g_rng_trace[idx].seq = g_rng_trace_count;
-    strncpy(g_rng_trace[idx].func, func, sizeof(g_rng_trace[idx].func) - 1);
-    g_rng_trace[idx].func[sizeof(g_rng_trace[idx].func) - 1] = '\0';
-    g_rng_trace[idx].arg = arg;
-    g_rng_trace[idx].result = result;
-    g_rng_trace_count++;
+static int ffi_write_all(int fd, const void *buf, size_t len) {
+    const char *p = (const char *)buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static void rng_stream_write_chunk(void) {
+    if (g_rng_stream_fill && !g_rng_stream_failed
+        && ffi_write_all(g_rng_stream_fd, g_rng_stream_buf,
+                         g_rng_stream_fill * sizeof(g_rng_stream_buf[0])) != 0)
+        g_rng_stream_failed = 1;
+    g_rng_stream_fill = 0;
+}
+
+static void rng_trace_record(int func, int arg, int result) {
+    if (g_rng_record_paused)
+        return;
+    g_rng_hash = ffi_hash_word(ffi_hash_word(ffi_hash_word(g_rng_hash, (uint64_t)func),
+                                             (uint64_t)(int64_t)arg),
+                               (uint64_t)(int64_t)result);
+    if (g_rng_tracing) {
+        unsigned long idx = g_rng_trace_count % RNG_TRACE_SIZE;
+        g_rng_trace[idx].seq = g_rng_trace_count;
+        g_rng_trace[idx].func = (unsigned char)func;
+        g_rng_trace[idx].arg = arg;
+        g_rng_trace[idx].result = result;
+        g_rng_trace_count++;
+    }
+    if (g_rng_stream_fd >= 0) {
+        struct nh_ffi_rng_trace_record *rec = &g_rng_stream_buf[g_rng_stream_fill];
+        rec->seq = g_rng_stream_seq++;
+        rec->func = (uint8_t)func;
+        rec->reserved[0] = rec->reserved[1] = rec->reserved[2] = 0;
+        rec->arg = arg;
+        rec->result = result;
+        if (++g_rng_stream_fill == NH_FFI_RNG_TRACE_CHUNK)
+            rng_stream_write_chunk();
+    }
+}
+
+/* Entry point for c_src/nethack_rnd.c to report the game's own calls.
+   The stub build's nh_ffi_rng_* wrappers record theirs directly. */
+void nh_ffi_rng_record(int func, int arg, int result) {
+    rng_trace_record(func, arg, result);
+}
+
+/* Write out buffered records.  Returns the number of records streamed so
+   far, or -1 once a write has failed. */
+long nh_ffi_rng_trace_stream_flush(void) {
+    if (g_rng_stream_fd < 0)
+        return -1;
+    rng_stream_write_chunk();
+    return g_rng_stream_failed ? -1 : (long)g_rng_stream_seq;
+}
+
+/* Flush and stop streaming.  Returns what the final flush returns. */
+long nh_ffi_rng_trace_stream_close(void) {
+    long n = nh_ffi_rng_trace_stream_flush();
+    g_rng_stream_fd = -1;
+    return n;
+}
+
+/* Start streaming every traced call to fd, closing any previous stream.
+   The fd stays owned by the caller.  Returns 0, or -1 if the header could
+   not be written. */
+int nh_ffi_rng_trace_stream_open(int fd) {
+    struct nh_ffi_rng_trace_header hdr;
+
+    if (g_rng_stream_fd >= 0)
+        (void) nh_ffi_rng_trace_stream_close();
+    hdr.magic = NH_FFI_RNG_TRACE_MAGIC;
+    hdr.version = NH_FFI_RNG_TRACE_VERSION;
+    hdr.record_size = (uint16_t)sizeof(struct nh_ffi_rng_trace_record);
+    if (fd < 0 || ffi_write_all(fd, &hdr, sizeof(hdr)) != 0)
+        return -1;
+    g_rng_stream_fd = fd;
+    g_rng_stream_fill = 0;
+    g_rng_stream_seq = 0;
+    g_rng_stream_failed = 0;
+    return 0;
 }
 
 /* Get RNG trace as JSON array */
@@ -1779,16 +2856,16 @@ char* nh_ffi_get_rng_trace(void) {
 
     /* Estimate buffer: ~80 chars per entry */
     size_t buf_size = count * 80 + 16;
-    char* json = (char*)malloc(buf_size);
-    if (json == NULL) return strdup("[]");
+    char* json = (char*)ffi_arena_alloc(buf_size);
+    if (json == NULL) return NULL;
 
     char *p = json;
     p += sprintf(p, "[");
     for (unsigned long i = 0; i < count; i++) {
         unsigned long idx = (start + i) % RNG_TRACE_SIZE;
         if (i > 0) p += sprintf(p, ",");
-        p += sprintf(p, "{\"seq\":%lu,\"func\":\"%s\",\"arg\":%lu,\"result\":%lu}",
-            g_rng_trace[idx].seq, g_rng_trace[idx].func,
+        p += sprintf(p, "{\"seq\":%lu,\"func\":\"%s\",\"arg\":%d,\"result\":%d}",
+            g_rng_trace[idx].seq, ffi_rng_fn_names[g_rng_trace[idx].func],
             g_rng_trace[idx].arg, g_rng_trace[idx].result);
     }
     p += sprintf(p, "]");
@@ -1816,7 +2893,7 @@ int nh_ffi_get_nutrition(void) {
 /* Get player attributes as JSON */
 char* nh_ffi_get_attributes_json(void) {
 #ifdef REAL_NETHACK
-    char* json = (char*)malloc(512);
+    char* json = (char*)ffi_arena_alloc(512);
     if (json == NULL) return NULL;
     snprintf(json, 512,
         "{\"str\": %d, \"int\": %d, \"wis\": %d, \"dex\": %d, \"con\": %d, \"cha\": %d}",
@@ -1824,7 +2901,7 @@ char* nh_ffi_get_attributes_json(void) {
         ACURR(A_DEX), ACURR(A_CON), ACURR(A_CHA));
     return json;
 #else
-    return strdup("{\"str\": 10, \"int\": 10, \"wis\": 10, \"dex\": 10, \"con\": 10, \"cha\": 10}");
+    return ffi_arena_strdup("{\"str\": 10, \"int\": 10, \"wis\": 10, \"dex\": 10, \"con\": 10, \"cha\": 10}");
 #endif
 }
 
@@ -1855,6 +2932,23 @@ void nh_ffi_get_couldsee(char* out) {
 #endif
 }
 
+/* Displayed glyphs, row-major, for episode recordings */
+int nh_ffi_get_glyphs(uint16_t* out, int max) {
+#ifdef REAL_NETHACK
+    int x, y;
+
+    if (out && max >= COLNO * ROWNO) {
+        for (y = 0; y < ROWNO; y++)
+            for (x = 0; x < COLNO; x++)
+                out[y * COLNO + x] = (uint16_t)glyph_at(x, y);
+    }
+    return COLNO * ROWNO;
+#else
+    (void)out; (void)max;
+    return 0;
+#endif
+}
+
 /* Export current level as JSON (cells, rooms, stairs, objects, monsters) */
 char* nh_ffi_export_level(void) {
 #ifdef REAL_NETHACK
@@ -1990,10 +3084,546 @@ char* nh_ffi_export_level(void) {
     }
     p += sprintf(p, "]}");
 
-    return strdup(g_json_buffer);
+    return ffi_arena_strdup(g_json_buffer);
+#else
+    return ffi_arena_strdup("{\"width\":80,\"height\":21,\"dnum\":0,\"dlevel\":1,\"cells\":[],\"rooms\":[],\"stairs\":[],\"objects\":[],\"monsters\":[],\"engravings\":[]}");
+#endif
+}
+
+/* Export current level as packed fixed-layout records into a caller-owned
+ * buffer (layout in nethack_ffi_types.h).  Returns the number of bytes the
+ * export needs; nothing is written unless bufsize is at least that large,
+ * so callers can pass NULL first to size their buffer.  The buffer must be
+ * 4-byte aligned. */
+long nh_ffi_export_level_bin(void* buf, size_t bufsize) {
+    struct nh_ffi_level_header hdr;
+    size_t total;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = NH_FFI_LEVEL_MAGIC;
+    hdr.version = NH_FFI_LEVEL_VERSION;
+    hdr.header_size = (uint16_t)sizeof(hdr);
+#ifdef REAL_NETHACK
+    struct obj *otmp;
+    struct monst *mtmp;
+    int nrooms = 0, nstairs = 0, nobjects = 0, nmonsters = 0;
+
+    for (nrooms = 0; nrooms < MAXNROFROOMS && rooms[nrooms].hx >= 0; nrooms++)
+        ;
+    nstairs = (xupstair != 0) + (xdnstair != 0) + (xupladder != 0)
+              + (xdnladder != 0) + (sstairs.sx != 0);
+    for (otmp = fobj; otmp; otmp = otmp->nobj)
+        nobjects++;
+    for (mtmp = fmon; mtmp; mtmp = mtmp->nmon)
+        nmonsters++;
+
+    hdr.width = COLNO;
+    hdr.height = ROWNO;
+    hdr.dnum = u.uz.dnum;
+    hdr.dlevel = u.uz.dlevel;
+    hdr.ncells = COLNO * ROWNO;
+    hdr.nrooms = nrooms;
+    hdr.nstairs = nstairs;
+    hdr.nobjects = nobjects;
+    hdr.nmonsters = nmonsters;
+    hdr.nfountains = level.flags.nfountains;
+    hdr.nsinks = level.flags.nsinks;
+    hdr.flags = (level.flags.has_shop ? NH_FFI_LEVEL_F_SHOP : 0)
+                | (level.flags.has_vault ? NH_FFI_LEVEL_F_VAULT : 0)
+                | (level.flags.has_zoo ? NH_FFI_LEVEL_F_ZOO : 0)
+                | (level.flags.has_court ? NH_FFI_LEVEL_F_COURT : 0)
+                | (level.flags.has_morgue ? NH_FFI_LEVEL_F_MORGUE : 0)
+                | (level.flags.has_beehive ? NH_FFI_LEVEL_F_BEEHIVE : 0)
+                | (level.flags.has_barracks ? NH_FFI_LEVEL_F_BARRACKS : 0)
+                | (level.flags.has_temple ? NH_FFI_LEVEL_F_TEMPLE : 0)
+                | (level.flags.has_swamp ? NH_FFI_LEVEL_F_SWAMP : 0)
+                | (level.flags.is_maze_lev ? NH_FFI_LEVEL_F_MAZE : 0)
+                | (level.flags.corrmaze ? NH_FFI_LEVEL_F_CORRMAZE : 0);
+
+    hdr.cells_offset = sizeof(hdr);
+    hdr.rooms_offset = hdr.cells_offset + hdr.ncells * sizeof(struct nh_ffi_level_cell);
+    hdr.stairs_offset = hdr.rooms_offset + nrooms * sizeof(struct nh_ffi_level_room);
+    hdr.objects_offset = hdr.stairs_offset + nstairs * sizeof(struct nh_ffi_level_stair);
+    hdr.monsters_offset = hdr.objects_offset + nobjects * sizeof(struct nh_ffi_level_object);
+    total = hdr.monsters_offset + nmonsters * sizeof(struct nh_ffi_level_monster);
+    hdr.total_size = (uint32_t)total;
+
+    if (!buf || bufsize < total)
+        return (long)total;
+
+    unsigned char *out = (unsigned char *)buf;
+    memcpy(out, &hdr, sizeof(hdr));
+
+    /* Cells: levl[] is column-major, the export is row-major; read levl[]
+       in storage order and scatter the writes */
+    {
+        struct nh_ffi_level_cell *cells = (struct nh_ffi_level_cell *)(out + hdr.cells_offset);
+        for (int x = 0; x < COLNO; x++) {
+            for (int y = 0; y < ROWNO; y++) {
+                struct rm *lev = &level.locations[x][y];
+                struct nh_ffi_level_cell *c = &cells[y * COLNO + x];
+                c->typ = (uint8_t)lev->typ;
+                c->lit = lev->lit;
+                c->door_mask = lev->doormask;
+                c->roomno = lev->roomno;
+            }
+        }
+    }
+
+    {
+        struct nh_ffi_level_room *r = (struct nh_ffi_level_room *)(out + hdr.rooms_offset);
+        for (int i = 0; i < nrooms; i++, r++) {
+            r->lx = rooms[i].lx;
+            r->hx = rooms[i].hx;
+            r->ly = rooms[i].ly;
+            r->hy = rooms[i].hy;
+            r->rtype = rooms[i].rtype;
+            r->rlit = rooms[i].rlit;
+            r->doorct = rooms[i].doorct;
+            r->nsubrooms = rooms[i].nsubrooms;
+        }
+    }
+
+    {
+        struct nh_ffi_level_stair *s = (struct nh_ffi_level_stair *)(out + hdr.stairs_offset);
+        if (xupstair) {
+            s->x = xupstair; s->y = yupstair; s->dir = 1; s->kind = NH_FFI_STAIR_STAIRS; s++;
+        }
+        if (xdnstair) {
+            s->x = xdnstair; s->y = ydnstair; s->dir = -1; s->kind = NH_FFI_STAIR_STAIRS; s++;
+        }
+        if (xupladder) {
+            s->x = xupladder; s->y = yupladder; s->dir = 1; s->kind = NH_FFI_STAIR_LADDER; s++;
+        }
+        if (xdnladder) {
+            s->x = xdnladder; s->y = ydnladder; s->dir = -1; s->kind = NH_FFI_STAIR_LADDER; s++;
+        }
+        if (sstairs.sx) {
+            s->x = sstairs.sx; s->y = sstairs.sy; s->dir = sstairs.up ? 1 : -1;
+            s->kind = NH_FFI_STAIR_BRANCH;
+        }
+    }
+
+    {
+        struct nh_ffi_level_object *o = (struct nh_ffi_level_object *)(out + hdr.objects_offset);
+        for (otmp = fobj; otmp; otmp = otmp->nobj, o++) {
+            o->otyp = otmp->otyp;
+            o->x = otmp->ox;
+            o->y = otmp->oy;
+            o->quan = (int32_t)otmp->quan;
+            o->spe = otmp->spe;
+            o->buc = otmp->blessed ? 1 : (otmp->cursed ? -1 : 0);
+            o->oclass = (uint8_t)otmp->oclass;
+            o->reserved = 0;
+            o->o_id = otmp->o_id;
+        }
+    }
+
+    {
+        struct nh_ffi_level_monster *m = (struct nh_ffi_level_monster *)(out + hdr.monsters_offset);
+        for (mtmp = fmon; mtmp; mtmp = mtmp->nmon, m++) {
+            m->mnum = mtmp->mnum;
+            m->x = mtmp->mx;
+            m->y = mtmp->my;
+            m->hp = mtmp->mhp;
+            m->hpmax = mtmp->mhpmax;
+            m->peaceful = mtmp->mpeaceful ? 1 : 0;
+            m->asleep = mtmp->msleeping ? 1 : 0;
+            m->mmove = mtmp->data->mmove;
+            m->mspeed = mtmp->mspeed;
+            m->m_id = mtmp->m_id;
+        }
+    }
+
+    return (long)total;
+#else
+    /* Stub: an empty 80x21 level header with no records */
+    hdr.width = 80;
+    hdr.height = 21;
+    hdr.dlevel = 1;
+    hdr.cells_offset = hdr.rooms_offset = hdr.stairs_offset = sizeof(hdr);
+    hdr.objects_offset = hdr.monsters_offset = sizeof(hdr);
+    total = sizeof(hdr);
+    hdr.total_size = (uint32_t)total;
+    if (buf && bufsize >= total)
+        memcpy(buf, &hdr, sizeof(hdr));
+    return (long)total;
+#endif
+}
+
+/* ============================================================================
+ * Level Deltas
+ * ============================================================================ */
+
+/* NetHack writes levl[], fobj and fmon directly, so there is nothing to hook
+   for change tracking.  Instead the state the last delta described is kept
+   as a shadow of export records and the live level is compared against it.
+   The shadow is per game and moves with the game contexts. */
+#ifdef REAL_NETHACK
+struct ffi_level_shadow {
+    int valid;
+    int dnum, dlevel;
+    uint32_t seq;
+    struct nh_ffi_level_cell cells[COLNO * ROWNO];
+    struct nh_ffi_level_object *objects;   /* sorted by o_id */
+    int nobjects, objects_cap;
+    struct nh_ffi_level_monster *monsters; /* sorted by m_id */
+    int nmonsters, monsters_cap;
+};
+
+static struct ffi_level_shadow g_level_shadow;
+
+/* The level as it is now, in the same layout; swapped into the shadow
+   once a delta is delivered.  Scratch space, shared by all contexts. */
+static struct ffi_level_shadow g_level_scratch;
+
+static int ffi_delta_cmp_object(const void *a, const void *b) {
+    uint32_t x = ((const struct nh_ffi_level_object *)a)->o_id;
+    uint32_t y = ((const struct nh_ffi_level_object *)b)->o_id;
+    return (x > y) - (x < y);
+}
+
+static int ffi_delta_cmp_monster(const void *a, const void *b) {
+    uint32_t x = ((const struct nh_ffi_level_monster *)a)->m_id;
+    uint32_t y = ((const struct nh_ffi_level_monster *)b)->m_id;
+    return (x > y) - (x < y);
+}
+
+static int ffi_delta_grow(void **arr, int *cap, int need, size_t recsize) {
+    void *p;
+    int ncap;
+
+    if (need <= *cap)
+        return 0;
+    ncap = *cap ? *cap : 64;
+    while (ncap < need)
+        ncap *= 2;
+    if (!(p = realloc(*arr, (size_t)ncap * recsize)))
+        return -1;
+    *arr = p;
+    *cap = ncap;
+    return 0;
+}
+
+/* Fill g_level_scratch from the live level */
+static int ffi_delta_capture(void) {
+    struct ffi_level_shadow *s = &g_level_scratch;
+    struct obj *otmp;
+    struct monst *mtmp;
+    int n;
+
+    s->dnum = u.uz.dnum;
+    s->dlevel = u.uz.dlevel;
+    for (int y = 0; y < ROWNO; y++) {
+        for (int x = 0; x < COLNO; x++) {
+            struct rm *lev = &level.locations[x][y];
+            struct nh_ffi_level_cell *c = &s->cells[y * COLNO + x];
+            c->typ = (uint8_t)lev->typ;
+            c->lit = lev->lit;
+            c->door_mask = lev->doormask;
+            c->roomno = lev->roomno;
+        }
+    }
+
+    for (n = 0, otmp = fobj; otmp; otmp = otmp->nobj)
+        n++;
+    if (ffi_delta_grow((void **)&s->objects, &s->objects_cap, n, sizeof(*s->objects)) != 0)
+        return -1;
+    for (n = 0, otmp = fobj; otmp; otmp = otmp->nobj, n++) {
+        struct nh_ffi_level_object *o = &s->objects[n];
+        o->otyp = otmp->otyp;
+        o->x = otmp->ox;
+        o->y = otmp->oy;
+        o->quan = (int32_t)otmp->quan;
+        o->spe = otmp->spe;
+        o->buc = otmp->blessed ? 1 : (otmp->cursed ? -1 : 0);
+        o->oclass = (uint8_t)otmp->oclass;
+        o->reserved = 0;
+        o->o_id = otmp->o_id;
+    }
+    s->nobjects = n;
+    qsort(s->objects, n, sizeof(*s->objects), ffi_delta_cmp_object);
+
+    for (n = 0, mtmp = fmon; mtmp; mtmp = mtmp->nmon)
+        n++;
+    if (ffi_delta_grow((void **)&s->monsters, &s->monsters_cap, n, sizeof(*s->monsters)) != 0)
+        return -1;
+    for (n = 0, mtmp = fmon; mtmp; mtmp = mtmp->nmon, n++) {
+        struct nh_ffi_level_monster *m = &s->monsters[n];
+        m->mnum = mtmp->mnum;
+        m->x = mtmp->mx;
+        m->y = mtmp->my;
+        m->hp = mtmp->mhp;
+        m->hpmax = mtmp->mhpmax;
+        m->peaceful = mtmp->mpeaceful ? 1 : 0;
+        m->asleep = mtmp->msleeping ? 1 : 0;
+        m->mmove = mtmp->data->mmove;
+        m->mspeed = mtmp->mspeed;
+        m->m_id = mtmp->m_id;
+    }
+    s->nmonsters = n;
+    qsort(s->monsters, n, sizeof(*s->monsters), ffi_delta_cmp_monster);
+    return 0;
+}
+
+/* Merge two id-sorted record arrays.  Records of cur that are new or differ
+   go to `changed`, ids only in prev go to `gone`; either may be NULL to
+   just count.  The id is the last field of every record type. */
+static void ffi_delta_merge(const void *prev, int nprev, const void *cur, int ncur,
+                            size_t recsize, unsigned char *changed, uint32_t *gone,
+                            int *nchanged, int *ngone) {
+    const unsigned char *p = (const unsigned char *)prev;
+    const unsigned char *c = (const unsigned char *)cur;
+    size_t id_off = recsize - sizeof(uint32_t);
+    int i = 0, j = 0;
+
+    *nchanged = *ngone = 0;
+    while (i < nprev || j < ncur) {
+        uint32_t pid, cid;
+        const unsigned char *pr = p + (size_t)i * recsize;
+        const unsigned char *cr = c + (size_t)j * recsize;
+
+        if (i < nprev)
+            memcpy(&pid, pr + id_off, sizeof(pid));
+        if (j < ncur)
+            memcpy(&cid, cr + id_off, sizeof(cid));
+
+        if (j >= ncur || (i < nprev && pid < cid)) {
+            if (gone)
+                gone[*ngone] = pid;
+            (*ngone)++;
+            i++;
+        } else if (i >= nprev || cid < pid) {
+            if (changed)
+                memcpy(changed + (size_t)*nchanged * recsize, cr, recsize);
+            (*nchanged)++;
+            j++;
+        } else {
+            if (memcmp(pr, cr, recsize) != 0) {
+                if (changed)
+                    memcpy(changed + (size_t)*nchanged * recsize, cr, recsize);
+                (*nchanged)++;
+            }
+            i++;
+            j++;
+        }
+    }
+}
+#endif
+
+/* Write the changes since the last delivered delta (layout in
+ * nethack_ffi_types.h).  Returns the number of bytes the delta needs;
+ * nothing is written, and nothing counts as delivered, unless bufsize is
+ * at least that large.  The buffer must be 4-byte aligned.  A change of
+ * dungeon level starts a new baseline. */
+long nh_ffi_export_level_delta(void* buf, size_t bufsize) {
+    struct nh_ffi_level_delta_header hdr;
+    size_t total;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = NH_FFI_DELTA_MAGIC;
+    hdr.version = NH_FFI_DELTA_VERSION;
+    hdr.header_size = (uint16_t)sizeof(hdr);
+#ifdef REAL_NETHACK
+    struct ffi_level_shadow *prev = &g_level_shadow;
+    struct ffi_level_shadow *cur = &g_level_scratch;
+    int full, ncells = 0, nobj, nobj_gone, nmon, nmon_gone;
+
+    if (ffi_delta_capture() != 0)
+        return -1;
+    full = !prev->valid || prev->dnum != cur->dnum || prev->dlevel != cur->dlevel;
+
+    if (full) {
+        ncells = COLNO * ROWNO;
+        nobj = cur->nobjects;
+        nmon = cur->nmonsters;
+        nobj_gone = nmon_gone = 0;
+    } else {
+        for (int i = 0; i < COLNO * ROWNO; i++)
+            if (memcmp(&prev->cells[i], &cur->cells[i], sizeof(cur->cells[i])) != 0)
+                ncells++;
+        ffi_delta_merge(prev->objects, prev->nobjects, cur->objects, cur->nobjects,
+                        sizeof(*cur->objects), NULL, NULL, &nobj, &nobj_gone);
+        ffi_delta_merge(prev->monsters, prev->nmonsters, cur->monsters, cur->nmonsters,
+                        sizeof(*cur->monsters), NULL, NULL, &nmon, &nmon_gone);
+    }
+
+    hdr.seq = full ? 0 : prev->seq + 1;
+    hdr.width = COLNO;
+    hdr.height = ROWNO;
+    hdr.dnum = cur->dnum;
+    hdr.dlevel = cur->dlevel;
+    hdr.flags = full ? NH_FFI_DELTA_F_FULL : 0;
+    hdr.ncells = ncells;
+    hdr.nobjects = nobj;
+    hdr.nobjects_gone = nobj_gone;
+    hdr.nmonsters = nmon;
+    hdr.nmonsters_gone = nmon_gone;
+    hdr.cells_offset = sizeof(hdr);
+    hdr.objects_offset = hdr.cells_offset + ncells * sizeof(struct nh_ffi_level_delta_cell);
+    hdr.objects_gone_offset = hdr.objects_offset + nobj * sizeof(struct nh_ffi_level_object);
+    hdr.monsters_offset = hdr.objects_gone_offset + nobj_gone * sizeof(uint32_t);
+    hdr.monsters_gone_offset = hdr.monsters_offset + nmon * sizeof(struct nh_ffi_level_monster);
+    total = hdr.monsters_gone_offset + nmon_gone * sizeof(uint32_t);
+    hdr.total_size = (uint32_t)total;
+
+    if (!buf || bufsize < total)
+        return (long)total;
+
+    unsigned char *out = (unsigned char *)buf;
+    memcpy(out, &hdr, sizeof(hdr));
+
+    {
+        struct nh_ffi_level_delta_cell *dc =
+            (struct nh_ffi_level_delta_cell *)(out + hdr.cells_offset);
+        for (int i = 0; i < COLNO * ROWNO; i++) {
+            if (full || memcmp(&prev->cells[i], &cur->cells[i], sizeof(cur->cells[i])) != 0) {
+                dc->index = (uint16_t)i;
+                dc->reserved = 0;
+                dc->cell = cur->cells[i];
+                dc++;
+            }
+        }
+    }
+
+    if (full) {
+        memcpy(out + hdr.objects_offset, cur->objects, nobj * sizeof(*cur->objects));
+        memcpy(out + hdr.monsters_offset, cur->monsters, nmon * sizeof(*cur->monsters));
+    } else {
+        ffi_delta_merge(prev->objects, prev->nobjects, cur->objects, cur->nobjects,
+                        sizeof(*cur->objects), out + hdr.objects_offset,
+                        (uint32_t *)(out + hdr.objects_gone_offset), &nobj, &nobj_gone);
+        ffi_delta_merge(prev->monsters, prev->nmonsters, cur->monsters, cur->nmonsters,
+                        sizeof(*cur->monsters), out + hdr.monsters_offset,
+                        (uint32_t *)(out + hdr.monsters_gone_offset), &nmon, &nmon_gone);
+    }
+
+    /* Delivered: the live level becomes the shadow, and the old shadow's
+       arrays are reused for the next capture */
+    {
+        struct ffi_level_shadow tmp = *prev;
+        *prev = *cur;
+        *cur = tmp;
+        prev->valid = 1;
+        prev->seq = hdr.seq;
+    }
+    return (long)total;
+#else
+    /* Stub: every delta is an empty 80x21 baseline */
+    hdr.width = 80;
+    hdr.height = 21;
+    hdr.dlevel = 1;
+    hdr.flags = NH_FFI_DELTA_F_FULL;
+    hdr.cells_offset = hdr.objects_offset = hdr.objects_gone_offset = sizeof(hdr);
+    hdr.monsters_offset = hdr.monsters_gone_offset = sizeof(hdr);
+    total = sizeof(hdr);
+    hdr.total_size = (uint32_t)total;
+    if (buf && bufsize >= total)
+        memcpy(buf, &hdr, sizeof(hdr));
+    return (long)total;
+#endif
+}
+
+/* Forget the shadow so the next delta is a full baseline */
+void nh_ffi_reset_level_delta(void) {
+#ifdef REAL_NETHACK
+    g_level_shadow.valid = 0;
+#endif
+}
+
+/* ============================================================================
+ * Grid Planes
+ * ============================================================================ */
+
+#ifdef REAL_NETHACK
+#define FFI_GRID_ROW_WORDS ((COLNO + 63) / 64)
+
+/* Bit 0 of each byte of v, gathered into bits 0..7: the multiply moves
+   byte i's bit to bit 56 + i and no partial products collide. */
+static uint64_t ffi_grid_gather8(uint64_t v) {
+    return ((v & 0x0101010101010101ULL) * 0x0102040810204080ULL) >> 56;
+}
+
+static int ffi_grid_shift(int flag) {
+    int shift = 0;
+    while (!(flag & 1)) {
+        flag >>= 1;
+        shift++;
+    }
+    return shift;
+}
+
+/* Pack bit `shift` of each byte of a COLNO-byte row, eight bytes at a
+   time.  The load is little-endian, like the wire format. */
+static void ffi_grid_pack_row(const char *row, int shift, uint64_t *out) {
+    int x = 0;
+
+    for (; x + 8 <= COLNO; x += 8) {
+        uint64_t v;
+        memcpy(&v, row + x, sizeof(v));
+        out[x / 64] |= ffi_grid_gather8(v >> shift) << (x % 64);
+    }
+    for (; x < COLNO; x++)
+        out[x / 64] |= (uint64_t)((row[x] >> shift) & 1) << (x % 64);
+}
+#endif
+
+/* Write the sight, lit and type planes (layout in nethack_ffi_types.h).
+   The stub has no map and writes the header alone, with no planes. */
+long nh_ffi_export_grid(void* buf, size_t bufsize) {
+    struct nh_ffi_grid_header hdr;
+    unsigned char *out = (unsigned char *)buf;
+    size_t total;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = NH_FFI_GRID_MAGIC;
+    hdr.version = NH_FFI_GRID_VERSION;
+    hdr.header_size = (uint16_t)sizeof(hdr);
+#ifdef REAL_NETHACK
+    static uint64_t bits[NH_FFI_GRID_NBITPLANES][ROWNO][FFI_GRID_ROW_WORDS];
+
+    hdr.width = COLNO;
+    hdr.height = ROWNO;
+    hdr.nbitplanes = NH_FFI_GRID_NBITPLANES;
+    hdr.row_words = FFI_GRID_ROW_WORDS;
+    hdr.bits_offset = sizeof(hdr);
+    hdr.typ_offset = hdr.bits_offset + sizeof(bits);
+    total = hdr.typ_offset + COLNO * ROWNO;
+    hdr.total_size = (uint32_t)total;
+    if (!out || bufsize < total)
+        return (long)total;
+
+    memset(bits, 0, sizeof(bits));
+    memcpy(out, &hdr, sizeof(hdr));
+    {
+        unsigned char *typ = out + hdr.typ_offset;
+        int sight = ffi_grid_shift(IN_SIGHT), could = ffi_grid_shift(COULD_SEE);
+        int x, y;
+
+        /* viz_array[] is already row-major */
+        for (y = 0; y < ROWNO; y++) {
+            ffi_grid_pack_row(viz_array[y], sight, bits[NH_FFI_GRID_IN_SIGHT][y]);
+            ffi_grid_pack_row(viz_array[y], could, bits[NH_FFI_GRID_COULD_SEE][y]);
+        }
+        /* levl[] is column-major: read it in storage order */
+        for (x = 0; x < COLNO; x++) {
+            const struct rm *col = level.locations[x];
+            for (y = 0; y < ROWNO; y++) {
+                bits[NH_FFI_GRID_LIT][y][x / 64] |= (uint64_t)col[y].lit << (x % 64);
+                typ[y * COLNO + x] = (unsigned char)col[y].typ;
+            }
+        }
+    }
+    memcpy(out + hdr.bits_offset, bits, sizeof(bits));
 #else
-    return strdup("{\"width\":80,\"height\":21,\"dnum\":0,\"dlevel\":1,\"cells\":[],\"rooms\":[],\"stairs\":[],\"objects\":[],\"monsters\":[],\"engravings\":[]}");
+    hdr.bits_offset = hdr.typ_offset = sizeof(hdr);
+    total = sizeof(hdr);
+    hdr.total_size = (uint32_t)total;
+    if (!out || bufsize < total)
+        return (long)total;
+    memcpy(out, &hdr, sizeof(hdr));
 #endif
+    return (long)total;
 }
 
 /* ============================================================================
@@ -2065,7 +3695,7 @@ void nh_ffi_test_makecorridors(void) {
 
 /* Export a rectangular region of level cells as a flat JSON array.
  * Returns JSON: [row0_col0_typ, row0_col1_typ, ...] (row-major, y then x).
- * Caller must free with nh_ffi_free_string().
+ * Valid until the next nh_ffi_arena_reset().
  */
 char* nh_ffi_get_cell_region(int x1, int y1, int x2, int y2) {
 #ifdef REAL_NETHACK
@@ -2078,8 +3708,8 @@ char* nh_ffi_get_cell_region(int x1, int y1, int x2, int y2) {
     int w = x2 - x1 + 1;
     int h = y2 - y1 + 1;
     size_t buf_size = (size_t)(w * h) * 8 + 64;
-    char* json = (char*)malloc(buf_size);
-    if (!json) return strdup("[]");
+    char* json = (char*)ffi_arena_alloc(buf_size);
+    if (!json) return NULL;
 
     char *p = json;
     p += sprintf(p, "[");
@@ -2095,7 +3725,7 @@ char* nh_ffi_get_cell_region(int x1, int y1, int x2, int y2) {
     return json;
 #else
     (void)x1; (void)y1; (void)x2; (void)y2;
-    return strdup("[]");
+    return ffi_arena_strdup("[]");
 #endif
 }
 
@@ -2285,7 +3915,8 @@ char* nh_ffi_get_rect_json(void) {
     int coords[200]; /* 50 rects * 4 coords */
     nh_ffi_get_rect_list(&count, coords);
 
-    char *buf = (char*)malloc(4096);
+    char *buf = (char*)ffi_arena_alloc(4096);
+    if (buf == NULL) return NULL;
     char *p = buf;
     p += sprintf(p, "{\"count\":%d,\"rects\":[", count);
     for (int i = 0; i < count; i++) {
@@ -2295,7 +3926,7 @@ char* nh_ffi_get_rect_json(void) {
     p += sprintf(p, "]}");
     return buf;
 #else
-    return strdup("{\"count\":0,\"rects\":[]}");
+    return ffi_arena_strdup("{\"count\":0,\"rects\":[]}");
 #endif
 }
 
@@ -2400,9 +4031,9 @@ char* nh_ffi_get_smeq(void) {
         p += sprintf(p, "%d", smeq[i]);
     }
     p += sprintf(p, "]");
-    return strdup(buf);
+    return ffi_arena_strdup(buf);
 #else
-    return strdup("[]");
+    return ffi_arena_strdup("[]");
 #endif
 }
 
@@ -2423,3 +4054,1388 @@ int nh_ffi_get_ac(void) {
     return g_initialized ? g_ac : 10;
 #endif
 }
+
+/* ============================================================================
+ * Game Contexts
+ * ============================================================================ */
+
+/* NetHack keeps a game in process globals, so only one game can be live.
+   A context parks another game: a byte image of every per-game global
+   listed in ffi_ctx_regions[], plus (real NetHack) the module-static lists
+   that have no extern handle -- timers, light sources, engravings and long
+   worms -- written to a scratch file in NetHack's own save format.  Heap
+   graphs (monster and object chains) are not copied: their root pointers
+   move with the image, so each chain is owned by exactly one context.
+   Each context has its own output arena; g_json_buffer is scratch space
+   and is shared. */
+
+#ifdef REAL_NETHACK
+#include <sys/types.h>
+
+extern unsigned long rng_call_counter;
+extern mapseen *mapseenchn;
+extern NhRegion **regions;
+extern int n_regions, max_regions;
+#endif
+
+struct ffi_ctx_region {
+    void *addr;
+    size_t size;
+};
+
+#define FFI_CTX_VAR(v)    { (void *)&(v), sizeof(v) }
+#define FFI_CTX_ARR(a, n) { (void *)(a), sizeof((a)[0]) * (n) }
+
+static const struct ffi_ctx_region ffi_ctx_regions[] = {
+#ifdef REAL_NETHACK
+    /* hero */
+    FFI_CTX_VAR(u), FFI_CTX_VAR(youmonst), FFI_CTX_VAR(urole), FFI_CTX_VAR(urace),
+    FFI_CTX_VAR(context), FFI_CTX_VAR(flags), FFI_CTX_VAR(killer),
+    FFI_CTX_VAR(ubirthday), FFI_CTX_VAR(urealtime), FFI_CTX_VAR(quest_status),
+    FFI_CTX_ARR(spl_book, MAXSPELL + 1), FFI_CTX_VAR(tune),
+    FFI_CTX_VAR(invent), FFI_CTX_VAR(uarm), FFI_CTX_VAR(uarmc), FFI_CTX_VAR(uarmh),
+    FFI_CTX_VAR(uarms), FFI_CTX_VAR(uarmg), FFI_CTX_VAR(uarmf), FFI_CTX_VAR(uarmu),
+    FFI_CTX_VAR(uskin), FFI_CTX_VAR(uamul), FFI_CTX_VAR(uleft), FFI_CTX_VAR(uright),
+    FFI_CTX_VAR(ublindf), FFI_CTX_VAR(uwep), FFI_CTX_VAR(uswapwep), FFI_CTX_VAR(uquiver),
+    FFI_CTX_VAR(uchain), FFI_CTX_VAR(uball), FFI_CTX_VAR(unweapon),
+    FFI_CTX_VAR(current_wand), FFI_CTX_VAR(thrownobj), FFI_CTX_VAR(kickedobj),
+    /* turn loop */
+    FFI_CTX_VAR(moves), FFI_CTX_VAR(monstermoves), FFI_CTX_VAR(wailmsg),
+    FFI_CTX_VAR(multi), FFI_CTX_VAR(multi_reason), FFI_CTX_VAR(nomovemsg),
+    FFI_CTX_VAR(occupation), FFI_CTX_VAR(afternmv),
+    /* current level */
+    FFI_CTX_VAR(level), FFI_CTX_ARR(rooms, (MAXNROFROOMS + 1) * 2),
+    FFI_CTX_VAR(nroom), FFI_CTX_VAR(nsubroom), FFI_CTX_ARR(smeq, MAXNROFROOMS + 1),
+    FFI_CTX_ARR(doors, DOORMAX), FFI_CTX_VAR(doorindex), FFI_CTX_VAR(ftrap),
+    FFI_CTX_VAR(upstair), FFI_CTX_VAR(dnstair), FFI_CTX_VAR(upladder),
+    FFI_CTX_VAR(dnladder), FFI_CTX_VAR(sstairs), FFI_CTX_VAR(updest),
+    FFI_CTX_VAR(dndest), FFI_CTX_VAR(inv_pos), FFI_CTX_VAR(upstairs_room),
+    FFI_CTX_VAR(dnstairs_room), FFI_CTX_VAR(sstairs_room),
+    FFI_CTX_VAR(x_maze_max), FFI_CTX_VAR(y_maze_max),
+    FFI_CTX_VAR(regions), FFI_CTX_VAR(n_regions), FFI_CTX_VAR(max_regions),
+    /* dungeon and off-level lists */
+    FFI_CTX_ARR(dungeons, MAXDUNGEON), FFI_CTX_ARR(level_info, MAXLINFO),
+    FFI_CTX_VAR(mapseenchn), FFI_CTX_VAR(migrating_objs), FFI_CTX_VAR(billobjs),
+    FFI_CTX_VAR(migrating_mons), FFI_CTX_VAR(mydogs), FFI_CTX_VAR(ffruit),
+    /* object identification and monster bookkeeping */
+    FFI_CTX_ARR(objects, NUM_OBJECTS), FFI_CTX_ARR(disco, NUM_OBJECTS),
+    FFI_CTX_ARR(mvitals, NUMMONS),
+    /* FFI-local state */
+    FFI_CTX_VAR(rng_call_counter), FFI_CTX_VAR(g_seed), FFI_CTX_VAR(g_game_live),
+    FFI_CTX_VAR(g_weight_bonus), FFI_CTX_VAR(g_last_role), FFI_CTX_VAR(g_last_race),
+    FFI_CTX_VAR(g_last_gender), FFI_CTX_VAR(g_last_alignment),
+    FFI_CTX_VAR(ffi_player_died), FFI_CTX_VAR(g_last_message),
+#else
+    FFI_CTX_VAR(g_initialized), FFI_CTX_VAR(g_game_over), FFI_CTX_VAR(g_turn_count),
+    FFI_CTX_VAR(g_last_message), FFI_CTX_VAR(g_role), FFI_CTX_VAR(g_race),
+    FFI_CTX_VAR(g_gender), FFI_CTX_VAR(g_alignment), FFI_CTX_VAR(g_x), FFI_CTX_VAR(g_y),
+    FFI_CTX_VAR(g_ac), FFI_CTX_VAR(g_hp), FFI_CTX_VAR(g_max_hp), FFI_CTX_VAR(g_level),
+    FFI_CTX_VAR(g_weight),
+#endif
+    FFI_CTX_VAR(g_rng_hash),
+};
+
+/* Harness state: parked with its context, but left out of checkpoints */
+static const struct ffi_ctx_region ffi_ctx_harness_regions[] = {
+#ifdef REAL_NETHACK
+    FFI_CTX_VAR(g_level_shadow),
+#endif
+    FFI_CTX_VAR(ffi_skip_movemon), FFI_CTX_VAR(g_section_profile),
+    FFI_CTX_VAR(g_rng_trace), FFI_CTX_VAR(g_rng_trace_count), FFI_CTX_VAR(g_rng_tracing),
+};
+
+#define FFI_CTX_NGAME (sizeof(ffi_ctx_regions) / sizeof(ffi_ctx_regions[0]))
+#define FFI_CTX_NREGIONS \
+    (FFI_CTX_NGAME + sizeof(ffi_ctx_harness_regions) / sizeof(ffi_ctx_harness_regions[0]))
+
+static const struct ffi_ctx_region *ffi_ctx_region(size_t i) {
+    return i < FFI_CTX_NGAME ? &ffi_ctx_regions[i] : &ffi_ctx_harness_regions[i - FFI_CTX_NGAME];
+}
+
+#ifdef REAL_NETHACK
+#define FFI_GAME_LIVE() (g_game_live)
+#else
+#define FFI_GAME_LIVE() (g_initialized)
+#endif
+
+struct nh_ffi_ctx {
+    unsigned char *image;     /* ffi_ctx_regions[], NULL until first parked */
+    boolean has_game;         /* a game was live when the context was parked */
+    void *rng;                /* nh_rng_state_save() image, if supported */
+#ifdef REAL_NETHACK
+    FILE *aux;                /* timers, light sources, engravings, worms */
+#endif
+    struct ffi_arena arena;   /* string results; the default context uses g_default_arena */
+};
+
+static struct nh_ffi_ctx g_default_ctx;
+static struct nh_ffi_ctx *g_ctx_current = &g_default_ctx;
+static unsigned char *g_ctx_baseline = NULL; /* image of a process with no game */
+
+static size_t ffi_ctx_image_size(void) {
+    size_t i, total = 0;
+    for (i = 0; i < FFI_CTX_NREGIONS; i++)
+        total += ffi_ctx_region(i)->size;
+    return total;
+}
+
+static void ffi_ctx_store_image(unsigned char *image) {
+    size_t i;
+    for (i = 0; i < FFI_CTX_NREGIONS; i++) {
+        memcpy(image, ffi_ctx_region(i)->addr, ffi_ctx_region(i)->size);
+        image += ffi_ctx_region(i)->size;
+    }
+}
+
+static void ffi_ctx_load_image(const unsigned char *image) {
+    size_t i;
+    for (i = 0; i < FFI_CTX_NREGIONS; i++) {
+        memcpy(ffi_ctx_region(i)->addr, image, ffi_ctx_region(i)->size);
+        image += ffi_ctx_region(i)->size;
+    }
+}
+
+/* Record the globals of a process that has no game yet; fresh contexts
+   start from this image.  Real NetHack captures it once the one-time
+   table initialization in nh_ffi_init() is done. */
+static void ffi_ctx_capture_baseline(void) {
+    if (g_ctx_baseline)
+        return;
+    g_ctx_baseline = (unsigned char *)malloc(ffi_ctx_image_size());
+    if (g_ctx_baseline)
+        ffi_ctx_store_image(g_ctx_baseline);
+}
+
+#ifndef REAL_NETHACK
+__attribute__((constructor))
+static void ffi_ctx_stub_baseline(void) {
+    ffi_ctx_capture_baseline();
+}
+#endif
+
+#ifdef REAL_NETHACK
+/* Module-static lists go through NetHack's save/restore routines.  A
+   FREE_SAVE pass leaves the live lists empty. */
+static void ffi_aux_save(int fd, int mode) {
+    save_engravings(fd, mode);
+    save_worm(fd, mode);
+    save_timers(fd, mode, RANGE_GLOBAL);
+    save_light_sources(fd, mode, RANGE_GLOBAL);
+    save_timers(fd, mode, RANGE_LEVEL);
+    save_light_sources(fd, mode, RANGE_LEVEL);
+}
+
+/* Must run after the globals are loaded: relinking looks ids up in the
+   restored monster and object chains. */
+static void ffi_aux_load(int fd) {
+    rest_engravings(fd);
+    rest_worm(fd);
+    restore_timers(fd, RANGE_GLOBAL, FALSE, 0L);
+    restore_light_sources(fd);
+    restore_timers(fd, RANGE_LEVEL, FALSE, 0L);
+    restore_light_sources(fd);
+    relink_timers(FALSE);
+    relink_light_sources(FALSE);
+}
+
+/* Empty a scratch file for a new write */
+static int ffi_aux_rewind(FILE **fp) {
+    int fd;
+
+    if (!*fp && !(*fp = tmpfile()))
+        return -1;
+    fd = fileno(*fp);
+    if (ftruncate(fd, 0) != 0 || lseek(fd, 0, SEEK_SET) != 0)
+        return -1;
+    return fd;
+}
+
+static int ffi_ctx_save_aux(struct nh_ffi_ctx *ctx) {
+    int fd = ffi_aux_rewind(&ctx->aux);
+
+    if (fd < 0)
+        return -1;
+    ffi_aux_save(fd, WRITE_SAVE | FREE_SAVE);
+    return 0;
+}
+
+static void ffi_ctx_load_aux(struct nh_ffi_ctx *ctx) {
+    int fd = fileno(ctx->aux);
+
+    (void)lseek(fd, 0, SEEK_SET);
+    ffi_aux_load(fd);
+}
+#endif
+
+static int ffi_ctx_park(struct nh_ffi_ctx *ctx) {
+    if (!ctx->image && !(ctx->image = (unsigned char *)malloc(ffi_ctx_image_size())))
+        return -1;
+#ifdef REAL_NETHACK
+    if (ffi_ctx_save_aux(ctx) != 0)
+        return -1;
+    if (nh_rng_state_size) {
+        if (!ctx->rng && !(ctx->rng = malloc(nh_rng_state_size())))
+            return -1;
+        nh_rng_state_save(ctx->rng);
+    }
+#endif
+    ctx->has_game = FFI_GAME_LIVE();
+    ffi_ctx_store_image(ctx->image);
+    return 0;
+}
+
+static void ffi_ctx_activate(struct nh_ffi_ctx *ctx) {
+    if (ctx->image && ctx->has_game) {
+        ffi_ctx_load_image(ctx->image);
+#ifdef REAL_NETHACK
+        ffi_ctx_load_aux(ctx);
+        if (ctx->rng && nh_rng_state_load)
+            nh_rng_state_load(ctx->rng);
+#endif
+    } else if (g_ctx_baseline) {
+        /* No game to resume: start from a clean process */
+        ffi_ctx_load_image(g_ctx_baseline);
+    }
+#ifdef REAL_NETHACK
+    vision_full_recalc = 1;
+#endif
+}
+
+/* Create an empty context; it holds no game until one is initialized
+   while it is live. */
+struct nh_ffi_ctx* nh_ffi_ctx_new(void) {
+    return (struct nh_ffi_ctx *)calloc(1, sizeof(struct nh_ffi_ctx));
+}
+
+/* Park the live game in the current context and make ctx live (NULL selects
+   the default context).  Returns 1 if ctx holds an initialized game, 0 if it
+   is empty, -1 if the live game could not be parked. */
+int nh_ffi_ctx_switch(struct nh_ffi_ctx* ctx) {
+    if (!ctx)
+        ctx = &g_default_ctx;
+    if (ctx != g_ctx_current) {
+        if (ffi_ctx_park(g_ctx_current) != 0)
+            return -1;
+        ffi_ctx_activate(ctx);
+        g_ctx_current = ctx;
+        g_arena = ctx == &g_default_ctx ? &g_default_arena : &ctx->arena;
+    }
+    return FFI_GAME_LIVE() ? 1 : 0;
+}
+
+/* The live context, or NULL for the default one */
+struct nh_ffi_ctx* nh_ffi_ctx_current(void) {
+    return g_ctx_current == &g_default_ctx ? NULL : g_ctx_current;
+}
+
+/* Release a context.  A live context hands over to the default one first.
+   Its heap graphs are leaked, as with nh_ffi_pre_generate_cleanup(). */
+void nh_ffi_ctx_free(struct nh_ffi_ctx* ctx) {
+    if (!ctx || ctx == &g_default_ctx)
+        return;
+    if (ctx == g_ctx_current)
+        (void)nh_ffi_ctx_switch(NULL);
+    free(ctx->image);
+    free(ctx->rng);
+    ffi_arena_release(&ctx->arena);
+#ifdef REAL_NETHACK
+    if (ctx->aux)
+        fclose(ctx->aux);
+#endif
+    free(ctx);
+}
+
+/* ============================================================================
+ * Game Checkpoints
+ * ============================================================================ */
+
+/* A checkpoint holds the per-game globals of ffi_ctx_regions[] and every
+   heap block they reach, found by walking NetHack's typed lists.  Each
+   pointer-aligned word of the globals or of a block that lands inside a
+   known block -- interior pointers such as eshk.bill_p included -- is
+   zeroed and recorded as a fixup.  Restoring allocates the blocks afresh,
+   copies them in and patches the fixups, so its cost is linear in the
+   checkpoint and one checkpoint can seed any number of games.  Words
+   that point into the loaded image holding this code -- monster types,
+   role tables, functions, string literals -- are fixups too, as offsets
+   from the image start, so any run of the same build can restore a
+   checkpoint.  Heap pointers that reach no known block (stale thrownobj
+   and the like) are kept as they are. */
+
+#define FFI_CKPT_ALIGN(n) (((n) + 7) & ~(size_t)7)
+
+struct ffi_ckpt_block {
+    uintptr_t addr;
+    uint32_t size;
+    uint32_t scan;            /* may hold pointers */
+    size_t blob_off;          /* body offset in the checkpoint being written */
+};
+
+static struct ffi_ckpt_block *g_ckpt_blocks;
+static size_t g_ckpt_nblocks, g_ckpt_blocks_cap;
+static struct nh_ffi_checkpoint_fixup *g_ckpt_fixups;
+static size_t g_ckpt_nfixups, g_ckpt_fixups_cap;
+static int g_ckpt_oom;
+
+/* The loaded image holding this code, [lo, hi); hi is 0 if it was not
+   found */
+struct ffi_ckpt_image {
+    uintptr_t lo, hi;
+    uint64_t build_id;
+};
+#ifdef REAL_NETHACK
+static FILE *g_ckpt_aux;      /* scratch file for the aux lists */
+#endif
+
+static int ffi_ckpt_reserve(void **arr, size_t *cap, size_t n, size_t elem) {
+    size_t ncap;
+    void *p;
+
+    if (n <= *cap)
+        return 0;
+    ncap = *cap ? *cap * 2 : 256;
+    while (ncap < n)
+        ncap *= 2;
+    if (!(p = realloc(*arr, ncap * elem))) {
+        g_ckpt_oom = 1;
+        return -1;
+    }
+    *arr = p;
+    *cap = ncap;
+    return 0;
+}
+
+static void ffi_ckpt_add(const void *p, size_t size, int scan) {
+    struct ffi_ckpt_block *b;
+
+    if (!p || !size)
+        return;
+    if (ffi_ckpt_reserve((void **)&g_ckpt_blocks, &g_ckpt_blocks_cap,
+                         g_ckpt_nblocks + 1, sizeof(*g_ckpt_blocks)) != 0)
+        return;
+    b = &g_ckpt_blocks[g_ckpt_nblocks++];
+    b->addr = (uintptr_t)p;
+    b->size = (uint32_t)size;
+    b->scan = (uint32_t)scan;
+    b->blob_off = 0;
+}
+
+#ifdef REAL_NETHACK
+static void ffi_ckpt_add_string(const char *s) {
+    if (s)
+        ffi_ckpt_add(s, strlen(s) + 1, 0);
+}
+
+static void ffi_ckpt_add_objs(struct obj *chain);
+
+static void ffi_ckpt_add_mon(struct monst *mtmp) {
+    struct mextra *x = mtmp->mextra;
+
+    ffi_ckpt_add(mtmp, sizeof(*mtmp), 1);
+    ffi_ckpt_add_objs(mtmp->minvent);
+    if (x) {
+        ffi_ckpt_add(x, sizeof(*x), 1);
+        ffi_ckpt_add_string(x->mname);
+        ffi_ckpt_add(x->egd, sizeof(*x->egd), 1);
+        ffi_ckpt_add(x->epri, sizeof(*x->epri), 1);
+        ffi_ckpt_add(x->eshk, sizeof(*x->eshk), 1);
+        ffi_ckpt_add(x->emin, sizeof(*x->emin), 1);
+        ffi_ckpt_add(x->edog, sizeof(*x->edog), 1);
+    }
+}
+
+static void ffi_ckpt_add_mons(struct monst *chain) {
+    for (; chain; chain = chain->nmon)
+        ffi_ckpt_add_mon(chain);
+}
+
+static void ffi_ckpt_add_objs(struct obj *chain) {
+    for (; chain; chain = chain->nobj) {
+        struct oextra *x = chain->oextra;
+
+        ffi_ckpt_add(chain, sizeof(*chain), 1);
+        ffi_ckpt_add_objs(chain->cobj);
+        if (x) {
+            ffi_ckpt_add(x, sizeof(*x), 1);
+            ffi_ckpt_add_string(x->oname);
+            ffi_ckpt_add_string(x->omailcmd);
+            ffi_ckpt_add(x->omid, sizeof(*x->omid), 0);
+            ffi_ckpt_add(x->olong, sizeof(*x->olong), 0);
+            if (x->omonst)
+                ffi_ckpt_add_mon(x->omonst);
+        }
+    }
+}
+#endif
+
+static int ffi_ckpt_block_cmp(const void *a, const void *b) {
+    uintptr_t x = ((const struct ffi_ckpt_block *)a)->addr;
+    uintptr_t y = ((const struct ffi_ckpt_block *)b)->addr;
+    return x < y ? -1 : x > y;
+}
+
+/* Gather the heap blocks of the live game, sorted by address */
+static void ffi_ckpt_collect(void) {
+    size_t i, n;
+
+    g_ckpt_nblocks = 0;
+    g_ckpt_oom = 0;
+#ifdef REAL_NETHACK
+    {
+        struct trap *t;
+        struct fruit *f;
+        struct damage *d;
+        mapseen *ms;
+        int r;
+
+        ffi_ckpt_add_objs(invent);
+        ffi_ckpt_add_objs(fobj);
+        ffi_ckpt_add_objs(level.buriedobjlist);
+        ffi_ckpt_add_objs(migrating_objs);
+        ffi_ckpt_add_objs(billobjs);
+        ffi_ckpt_add_mons(fmon);
+        ffi_ckpt_add_mons(migrating_mons);
+        ffi_ckpt_add_mons(mydogs);
+        for (t = ftrap; t; t = t->ntrap)
+            ffi_ckpt_add(t, sizeof(*t), 1);
+        for (f = ffruit; f; f = f->nextf)
+            ffi_ckpt_add(f, sizeof(*f), 1);
+        for (d = level.damagelist; d; d = d->next)
+            ffi_ckpt_add(d, sizeof(*d), 1);
+        for (ms = mapseenchn; ms; ms = ms->next) {
+            struct cemetery *bones;
+
+            ffi_ckpt_add(ms, sizeof(*ms), 1);
+            ffi_ckpt_add_string(ms->custom);
+            for (bones = ms->final_resting_place; bones; bones = bones->next)
+                ffi_ckpt_add(bones, sizeof(*bones), 1);
+        }
+        if (regions) {
+            ffi_ckpt_add(regions, sizeof(*regions) * (size_t)max_regions, 1);
+            for (r = 0; r < n_regions; r++) {
+                NhRegion *reg = regions[r];
+
+                ffi_ckpt_add(reg, sizeof(*reg), 1);
+                ffi_ckpt_add(reg->rects, sizeof(*reg->rects) * (size_t)reg->nrects, 0);
+                ffi_ckpt_add(reg->monsters, sizeof(*reg->monsters) * (size_t)reg->max_monst, 0);
+                ffi_ckpt_add_string(reg->enter_msg);
+                ffi_ckpt_add_string(reg->leave_msg);
+            }
+        }
+        for (r = 0; r < NUM_OBJECTS; r++)
+            ffi_ckpt_add_string(objects[r].oc_uname);
+    }
+#endif
+    if (!g_ckpt_nblocks)
+        return;
+    qsort(g_ckpt_blocks, g_ckpt_nblocks, sizeof(*g_ckpt_blocks), ffi_ckpt_block_cmp);
+    for (i = 1, n = 1; i < g_ckpt_nblocks; i++)
+        if (g_ckpt_blocks[i].addr != g_ckpt_blocks[n - 1].addr)
+            g_ckpt_blocks[n++] = g_ckpt_blocks[i];
+    g_ckpt_nblocks = n;
+}
+
+/* Index of the block holding p, or -1 */
+static long ffi_ckpt_find(uintptr_t p) {
+    size_t lo = 0, hi = g_ckpt_nblocks;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (g_ckpt_blocks[mid].addr <= p)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0 || p - g_ckpt_blocks[lo - 1].addr >= g_ckpt_blocks[lo - 1].size)
+        return -1;
+    return (long)(lo - 1);
+}
+
+/* Record a fixup for every aligned word of [addr, addr + size) that points
+   into a block or into img; base is the offset of addr within its area. */
+static void ffi_ckpt_scan(const struct ffi_ckpt_image *img, uint32_t slot_node,
+                          const void *addr, size_t size, size_t base) {
+    uintptr_t start = (uintptr_t)addr, end = start + size, w;
+
+    for (w = (start + sizeof(void *) - 1) & ~(uintptr_t)(sizeof(void *) - 1);
+         w + sizeof(void *) <= end; w += sizeof(void *)) {
+        struct nh_ffi_checkpoint_fixup *fx;
+        uintptr_t target;
+        long b;
+
+        memcpy(&target, (const void *)w, sizeof(target));
+        if ((b = ffi_ckpt_find(target)) < 0 && target - img->lo >= img->hi - img->lo)
+            continue;
+        if (ffi_ckpt_reserve((void **)&g_ckpt_fixups, &g_ckpt_fixups_cap,
+                             g_ckpt_nfixups + 1, sizeof(*g_ckpt_fixups)) != 0)
+            return;
+        fx = &g_ckpt_fixups[g_ckpt_nfixups++];
+        fx->slot_node = slot_node;
+        fx->slot_offset = (uint32_t)(base + (w - start));
+        if (b >= 0) {
+            fx->target_node = (uint32_t)b;
+            fx->target_offset = (uint32_t)(target - g_ckpt_blocks[b].addr);
+        } else {
+            fx->target_node = NH_FFI_CKPT_IMAGE;
+            fx->target_offset = (uint32_t)(target - img->lo);
+        }
+    }
+}
+
+#ifdef __APPLE__
+/* Bounds and LC_UUID of the Mach-O image holding anchor */
+static void ffi_ckpt_find_image(uintptr_t anchor, struct ffi_ckpt_image *img,
+                                uint64_t *h) {
+    uint32_t i, j, n = _dyld_image_count();
+
+    for (i = 0; i < n; i++) {
+        const struct mach_header_64 *mh = (const struct mach_header_64 *)_dyld_get_image_header(i);
+        uintptr_t slide = (uintptr_t)_dyld_get_image_vmaddr_slide(i);
+        const struct load_command *lc = (const struct load_command *)(mh + 1);
+        const uint8_t *uuid = NULL;
+        uintptr_t lo = UINTPTR_MAX, hi = 0;
+        int mine = 0;
+
+        if (!mh || mh->magic != MH_MAGIC_64)
+            continue;
+        for (j = 0; j < mh->ncmds; j++, lc = (const struct load_command *)((const char *)lc + lc->cmdsize)) {
+            if (lc->cmd == LC_SEGMENT_64) {
+                const struct segment_command_64 *sg = (const struct segment_command_64 *)lc;
+                uintptr_t seg = (uintptr_t)sg->vmaddr + slide;
+
+                if (!sg->maxprot) /* __PAGEZERO */
+                    continue;
+                lo = seg < lo ? seg : lo;
+                hi = seg + sg->vmsize > hi ? seg + sg->vmsize : hi;
+                mine |= anchor - seg < sg->vmsize;
+            } else if (lc->cmd == LC_UUID) {
+                uuid = ((const struct uuid_command *)lc)->uuid;
+            }
+        }
+        if (mine) {
+            img->lo = lo;
+            img->hi = hi;
+            if (uuid)
+                *h = ffi_fnv1a64(*h, uuid, 16);
+            return;
+        }
+    }
+}
+#else
+struct ffi_ckpt_phdr_search {
+    uintptr_t anchor;
+    struct ffi_ckpt_image *img;
+    uint64_t *h;
+};
+
+static int ffi_ckpt_phdr_cb(struct dl_phdr_info *info, size_t size, void *data) {
+    struct ffi_ckpt_phdr_search *s = (struct ffi_ckpt_phdr_search *)data;
+    uintptr_t lo = UINTPTR_MAX, hi = 0;
+    int i, mine = 0;
+
+    (void)size;
+    for (i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr) *ph = &info->dlpi_phdr[i];
+        uintptr_t seg = (uintptr_t)(info->dlpi_addr + ph->p_vaddr);
+
+        if (ph->p_type != PT_LOAD)
+            continue;
+        lo = seg < lo ? seg : lo;
+        hi = seg + ph->p_memsz > hi ? seg + ph->p_memsz : hi;
+        mine |= s->anchor - seg < ph->p_memsz;
+    }
+    if (!mine)
+        return 0;
+    s->img->lo = lo;
+    s->img->hi = hi;
+
+    /* The GNU build-id note, if the linker wrote one */
+    for (i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr) *ph = &info->dlpi_phdr[i];
+        const unsigned char *p = (const unsigned char *)(info->dlpi_addr + ph->p_vaddr);
+        const unsigned char *end = p + ph->p_memsz;
+
+        if (ph->p_type != PT_NOTE)
+            continue;
+        while (p + sizeof(ElfW(Nhdr)) <= end) {
+            const ElfW(Nhdr) *nh = (const ElfW(Nhdr) *)p;
+            size_t name = (nh->n_namesz + 3) & ~(size_t)3;
+            size_t desc = (nh->n_descsz + 3) & ~(size_t)3;
+
+            p += sizeof(*nh);
+            if (nh->n_type == NT_GNU_BUILD_ID && nh->n_namesz == 4 && !memcmp(p, "GNU", 4))
+                *s->h = ffi_fnv1a64(*s->h, p + name, nh->n_descsz);
+            p += name + desc;
+        }
+    }
+    return 1;
+}
+
+/* Bounds and build-id note of the ELF object holding anchor */
+static void ffi_ckpt_find_image(uintptr_t anchor, struct ffi_ckpt_image *img,
+                                uint64_t *h) {
+    struct ffi_ckpt_phdr_search s;
+
+    s.anchor = anchor;
+    s.img = img;
+    s.h = h;
+    dl_iterate_phdr(ffi_ckpt_phdr_cb, &s);
+}
+#endif
+
+/* The image holding this code, found once.  Its build id hashes what a
+   different link would change: the static-tables id, the image size, the
+   offsets of a data and a code address, and the linker's build id when
+   there is one. */
+static const struct ffi_ckpt_image *ffi_ckpt_image(void) {
+    static struct ffi_ckpt_image img;
+    static int found;
+
+    if (!found) {
+        uintptr_t data = (uintptr_t)&ffi_ctx_regions, code = (uintptr_t)&ffi_ckpt_scan;
+        uint64_t h = FFI_FNV_OFFSET, id = nh_ffi_static_tables_id(), off;
+
+        found = 1;
+        ffi_ckpt_find_image(data, &img, &h);
+        /* Offsets are stored in 32 bits */
+        if (img.hi - img.lo > UINT32_MAX || code - img.lo >= img.hi - img.lo) {
+            img.hi = 0;
+            return &img;
+        }
+        h = ffi_fnv1a64(h, &id, sizeof(id));
+        off = img.hi - img.lo;
+        h = ffi_fnv1a64(h, &off, sizeof(off));
+        off = data - img.lo;
+        h = ffi_fnv1a64(h, &off, sizeof(off));
+        off = code - img.lo;
+        h = ffi_fnv1a64(h, &off, sizeof(off));
+        img.build_id = h;
+    }
+    return &img;
+}
+
+unsigned long long nh_ffi_build_id(void) {
+    return ffi_ckpt_image()->build_id;
+}
+
+static size_t ffi_ckpt_globals_size(void) {
+    size_t i, total = 0;
+    for (i = 0; i < FFI_CTX_NGAME; i++)
+        total += ffi_ctx_regions[i].size;
+    return total;
+}
+
+/* Live address of len bytes at off in globals[], or NULL if they do not
+   fall inside one region */
+static unsigned char *ffi_ckpt_globals_addr(size_t off, size_t len) {
+    size_t i;
+    for (i = 0; i < FFI_CTX_NGAME; i++) {
+        if (off < ffi_ctx_regions[i].size)
+            return off + len <= ffi_ctx_regions[i].size
+                       ? (unsigned char *)ffi_ctx_regions[i].addr + off : NULL;
+        off -= ffi_ctx_regions[i].size;
+    }
+    return NULL;
+}
+
+/* Write the live game as a checkpoint.  Returns the size it needs (-1 if
+   it cannot be taken); buf is only written when bufsize is that large. */
+long nh_ffi_checkpoint(void* buf, size_t bufsize) {
+    const struct ffi_ckpt_image *img = ffi_ckpt_image();
+    struct nh_ffi_checkpoint_header hdr;
+    unsigned char *out = (unsigned char *)buf;
+    size_t i, off, rng_size, need;
+    long aux_size = 0;
+#ifdef REAL_NETHACK
+    int aux_fd;
+#endif
+
+    /* Static pointers could not be made relative */
+    if (!img->hi)
+        return -1;
+    ffi_ckpt_collect();
+    g_ckpt_nfixups = 0;
+    for (i = 0, off = 0; i < FFI_CTX_NGAME; off += ffi_ctx_regions[i].size, i++)
+        ffi_ckpt_scan(img, NH_FFI_CKPT_GLOBALS, ffi_ctx_regions[i].addr, ffi_ctx_regions[i].size, off);
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.header_size = sizeof(hdr);
+    hdr.globals_off = (uint32_t)FFI_CKPT_ALIGN(sizeof(hdr));
+    hdr.globals_size = (uint32_t)off;
+    hdr.nodes_off = (uint32_t)FFI_CKPT_ALIGN(hdr.globals_off + off);
+    off = hdr.nodes_off;
+    for (i = 0; i < g_ckpt_nblocks; i++) {
+        struct ffi_ckpt_block *b = &g_ckpt_blocks[i];
+        if (b->scan)
+            ffi_ckpt_scan(img, (uint32_t)i, (const void *)b->addr, b->size, 0);
+        b->blob_off = off + sizeof(struct nh_ffi_checkpoint_node);
+        off = b->blob_off + FFI_CKPT_ALIGN(b->size);
+    }
+    if (g_ckpt_oom)
+        return -1;
+
+#ifdef REAL_NETHACK
+    if ((aux_fd = ffi_aux_rewind(&g_ckpt_aux)) < 0)
+        return -1;
+    ffi_aux_save(aux_fd, WRITE_SAVE);
+    if ((aux_size = (long)lseek(aux_fd, 0, SEEK_END)) < 0)
+        return -1;
+#endif
+    /* A game whose RNG position is lost would not replay */
+    if ((rng_size = nh_ffi_rng_checkpoint(NULL, 0)) == 0)
+        return -1;
+
+    hdr.magic = NH_FFI_CKPT_MAGIC;
+    hdr.version = NH_FFI_CKPT_VERSION;
+    hdr.flags = FFI_GAME_LIVE() ? NH_FFI_CKPT_F_GAME : 0;
+    hdr.build_id = img->build_id;
+    hdr.nnodes = (uint32_t)g_ckpt_nblocks;
+    hdr.nfixups = (uint32_t)g_ckpt_nfixups;
+    hdr.fixups_off = (uint32_t)off;
+    hdr.aux_off = (uint32_t)(off + g_ckpt_nfixups * sizeof(*g_ckpt_fixups));
+    hdr.aux_size = (uint32_t)aux_size;
+    hdr.rng_off = (uint32_t)FFI_CKPT_ALIGN(hdr.aux_off + (size_t)aux_size);
+    hdr.rng_size = (uint32_t)rng_size;
+    need = hdr.rng_off + rng_size;
+    if (need > UINT32_MAX)
+        return -1;
+    hdr.total_size = (uint32_t)need;
+    if (!out || bufsize < need)
+        return (long)need;
+
+    memset(out, 0, need);
+    memcpy(out, &hdr, sizeof(hdr));
+    for (i = 0, off = hdr.globals_off; i < FFI_CTX_NGAME; off += ffi_ctx_regions[i].size, i++)
+        memcpy(out + off, ffi_ctx_regions[i].addr, ffi_ctx_regions[i].size);
+    for (i = 0; i < g_ckpt_nblocks; i++) {
+        struct ffi_ckpt_block *b = &g_ckpt_blocks[i];
+        struct nh_ffi_checkpoint_node node;
+
+        node.size = b->size;
+        node.reserved = 0;
+        memcpy(out + b->blob_off - sizeof(node), &node, sizeof(node));
+        memcpy(out + b->blob_off, (const void *)b->addr, b->size);
+    }
+    /* No heap or image addresses leave the process */
+    for (i = 0; i < g_ckpt_nfixups; i++) {
+        const struct nh_ffi_checkpoint_fixup *fx = &g_ckpt_fixups[i];
+        size_t slot = fx->slot_node == NH_FFI_CKPT_GLOBALS
+                          ? hdr.globals_off + fx->slot_offset
+                          : g_ckpt_blocks[fx->slot_node].blob_off + fx->slot_offset;
+        memset(out + slot, 0, sizeof(void *));
+    }
+    memcpy(out + hdr.fixups_off, g_ckpt_fixups, g_ckpt_nfixups * sizeof(*g_ckpt_fixups));
+#ifdef REAL_NETHACK
+    if (aux_size > 0 && pread(aux_fd, out + hdr.aux_off, (size_t)aux_size, 0) != aux_size)
+        return -1;
+#endif
+    (void)nh_ffi_rng_checkpoint(out + hdr.rng_off, rng_size);
+    return (long)need;
+}
+
+static int ffi_ckpt_within(uint32_t off, size_t len, size_t size) {
+    return off <= size && len <= size - off;
+}
+
+/* Replace the live game with a checkpoint.  Everything that can fail is
+   done before the live game is touched. */
+int nh_ffi_restore(const void* buf, size_t size) {
+    const struct ffi_ckpt_image *img = ffi_ckpt_image();
+    const unsigned char *in = (const unsigned char *)buf;
+    struct nh_ffi_checkpoint_header hdr;
+    struct ffi_ckpt_fresh { unsigned char *p; uint32_t size; } *fresh = NULL;
+    const struct nh_ffi_checkpoint_fixup *fixups;
+    size_t i, off;
+#ifdef REAL_NETHACK
+    int aux_fd;
+#endif
+
+    if (!img->hi || !in || size < sizeof(hdr))
+        return -1;
+    memcpy(&hdr, in, sizeof(hdr));
+    if (hdr.magic != NH_FFI_CKPT_MAGIC || hdr.version != NH_FFI_CKPT_VERSION
+        || hdr.header_size != sizeof(hdr) || hdr.total_size != size
+        || hdr.build_id != img->build_id
+        || hdr.globals_size != ffi_ckpt_globals_size()
+        || !ffi_ckpt_within(hdr.globals_off, hdr.globals_size, size)
+        || !ffi_ckpt_within(hdr.fixups_off, (size_t)hdr.nfixups * sizeof(*fixups), size)
+        || !ffi_ckpt_within(hdr.aux_off, hdr.aux_size, size)
+        || !ffi_ckpt_within(hdr.rng_off, hdr.rng_size, size)
+        || hdr.fixups_off % sizeof(uint32_t) != 0)
+        return -1;
+#ifndef REAL_NETHACK
+    if (hdr.nnodes || hdr.aux_size)
+        return -1;
+#endif
+
+    /* Fresh copies of the blocks */
+    if (!(fresh = calloc(hdr.nnodes ? hdr.nnodes : 1, sizeof(*fresh))))
+        return -1;
+    for (i = 0, off = hdr.nodes_off; i < hdr.nnodes; i++) {
+        struct nh_ffi_checkpoint_node node;
+
+        if (!ffi_ckpt_within((uint32_t)off, sizeof(node), size))
+            goto fail;
+        memcpy(&node, in + off, sizeof(node));
+        off += sizeof(node);
+        if (!node.size || !ffi_ckpt_within((uint32_t)off, node.size, hdr.fixups_off)
+            || !(fresh[i].p = (unsigned char *)malloc(node.size)))
+            goto fail;
+        memcpy(fresh[i].p, in + off, node.size);
+        fresh[i].size = node.size;
+        off += FFI_CKPT_ALIGN(node.size);
+    }
+
+    fixups = (const struct nh_ffi_checkpoint_fixup *)(in + hdr.fixups_off);
+    for (i = 0; i < hdr.nfixups; i++) {
+        struct nh_ffi_checkpoint_fixup fx;
+
+        memcpy(&fx, &fixups[i], sizeof(fx));
+        if (fx.target_node == NH_FFI_CKPT_IMAGE
+                ? fx.target_offset >= img->hi - img->lo
+                : fx.target_node >= hdr.nnodes || fx.target_offset >= fresh[fx.target_node].size)
+            goto fail;
+        if (fx.slot_node == NH_FFI_CKPT_GLOBALS
+                ? !ffi_ckpt_globals_addr(fx.slot_offset, sizeof(void *))
+                : fx.slot_node >= hdr.nnodes
+                      || !ffi_ckpt_within(fx.slot_offset, sizeof(void *), fresh[fx.slot_node].size))
+            goto fail;
+    }
+
+#ifdef REAL_NETHACK
+    if ((aux_fd = ffi_aux_rewind(&g_ckpt_aux)) < 0
+        || write(aux_fd, in + hdr.aux_off, hdr.aux_size) != (ssize_t)hdr.aux_size
+        || lseek(aux_fd, 0, SEEK_SET) != 0)
+        goto fail;
+#endif
+    if (nh_ffi_rng_restore(in + hdr.rng_off, hdr.rng_size) != 0)
+        goto fail;
+
+    /* Past this point the live game is replaced */
+#ifdef REAL_NETHACK
+    ffi_aux_save(aux_fd, FREE_SAVE);
+    ffi_ckpt_collect();
+    for (i = 0; i < g_ckpt_nblocks; i++)
+        free((void *)g_ckpt_blocks[i].addr);
+    g_ckpt_nblocks = 0;
+#endif
+    for (i = 0, off = hdr.globals_off; i < FFI_CTX_NGAME; off += ffi_ctx_regions[i].size, i++)
+        memcpy(ffi_ctx_regions[i].addr, in + off, ffi_ctx_regions[i].size);
+    for (i = 0; i < hdr.nfixups; i++) {
+        struct nh_ffi_checkpoint_fixup fx;
+        unsigned char *slot;
+        void *target;
+
+        memcpy(&fx, &fixups[i], sizeof(fx));
+        slot = fx.slot_node == NH_FFI_CKPT_GLOBALS
+                   ? ffi_ckpt_globals_addr(fx.slot_offset, sizeof(void *))
+                   : fresh[fx.slot_node].p + fx.slot_offset;
+        target = fx.target_node == NH_FFI_CKPT_IMAGE
+                     ? (void *)(img->lo + fx.target_offset)
+                     : fresh[fx.target_node].p + fx.target_offset;
+        memcpy(slot, &target, sizeof(target));
+    }
+#ifdef REAL_NETHACK
+    ffi_aux_load(aux_fd);
+    vision_full_recalc = 1;
+#endif
+    nh_ffi_reset_level_delta();
+    free(fresh);
+    return 0;
+
+fail:
+    for (i = 0; i < hdr.nnodes; i++)
+        free(fresh[i].p);
+    free(fresh);
+    return -1;
+}
+
+/* ============================================================================
+ * Level Checkpoints
+ * ============================================================================ */
+
+/* The level goes through savelev() and getlev(), as on a level change, so
+   its monsters, objects, traps, timers and the rest relink by id rather
+   than by address.  The stub build has no level: its checkpoints are the
+   bare header. */
+long nh_ffi_level_checkpoint(void* buf, size_t bufsize) {
+    const struct ffi_ckpt_image *img = ffi_ckpt_image();
+    struct nh_ffi_level_checkpoint_header hdr;
+    unsigned char *out = (unsigned char *)buf;
+    size_t need;
+#ifdef REAL_NETHACK
+    xchar ledger = ledger_no(&u.uz);
+    unsigned lflags;
+    long level_size;
+    int fd;
+#endif
+
+    if (!img->hi)
+        return -1;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = NH_FFI_LVCK_MAGIC;
+    hdr.version = NH_FFI_LVCK_VERSION;
+    hdr.header_size = sizeof(hdr);
+    hdr.build_id = img->build_id;
+#ifdef REAL_NETHACK
+    if ((fd = ffi_aux_rewind(&g_ckpt_aux)) < 0)
+        return -1;
+    /* savelev() marks the level visited; a generation does not */
+    lflags = level_info[ledger].flags;
+    savelev(fd, ledger, WRITE_SAVE);
+    level_info[ledger].flags = lflags;
+    if ((level_size = (long)lseek(fd, 0, SEEK_END)) < 0)
+        return -1;
+    hdr.ledger = ledger;
+    hdr.mvitals_size = (uint32_t)sizeof(mvitals);
+    hdr.level_size = (uint32_t)level_size;
+    hdr.monstermoves = (int64_t)monstermoves;
+    hdr.ident = (uint64_t)context.ident;
+#endif
+    need = sizeof(hdr) + hdr.mvitals_size + hdr.level_size;
+    if (!out || bufsize < need)
+        return (long)need;
+
+    memcpy(out, &hdr, sizeof(hdr));
+#ifdef REAL_NETHACK
+    memcpy(out + sizeof(hdr), mvitals, sizeof(mvitals));
+    if (pread(fd, out + sizeof(hdr) + hdr.mvitals_size, (size_t)level_size, 0) != level_size)
+        return -1;
+#endif
+    return (long)need;
+}
+
+int nh_ffi_restore_level(const void* buf, size_t size) {
+    const struct ffi_ckpt_image *img = ffi_ckpt_image();
+    const unsigned char *in = (const unsigned char *)buf;
+    struct nh_ffi_level_checkpoint_header hdr;
+#ifdef REAL_NETHACK
+    long moves_now;
+    int fd;
+#endif
+
+    if (!img->hi || !in || size < sizeof(hdr))
+        return -1;
+    memcpy(&hdr, in, sizeof(hdr));
+    if (hdr.magic != NH_FFI_LVCK_MAGIC || hdr.version != NH_FFI_LVCK_VERSION
+        || hdr.header_size != sizeof(hdr) || hdr.build_id != img->build_id
+        || size != sizeof(hdr) + (size_t)hdr.mvitals_size + hdr.level_size)
+        return -1;
+#ifdef REAL_NETHACK
+    if (hdr.ledger != ledger_no(&u.uz) || hdr.mvitals_size != sizeof(mvitals)
+        || (fd = ffi_aux_rewind(&g_ckpt_aux)) < 0
+        || write(fd, in + sizeof(hdr) + hdr.mvitals_size, hdr.level_size)
+               != (ssize_t)hdr.level_size
+        || lseek(fd, 0, SEEK_SET) != 0)
+        return -1;
+
+    /* Past this point the live level is replaced, the way a generation
+       replaces it */
+    nh_ffi_pre_generate_cleanup();
+    moves_now = monstermoves;
+    monstermoves = (long)hdr.monstermoves;
+    getlev(fd, 0, (xchar)hdr.ledger, FALSE);
+    monstermoves = moves_now;
+    memcpy(mvitals, in + sizeof(hdr), sizeof(mvitals));
+    context.ident = (unsigned)hdr.ident;
+    vision_full_recalc = 1;
+#else
+    if (hdr.mvitals_size || hdr.level_size)
+        return -1;
+#endif
+    nh_ffi_reset_level_delta();
+    return 0;
+}
+
+uint64_t nh_ffi_level_inputs_id(void) {
+    uint64_t h = FFI_FNV_OFFSET;
+#ifdef REAL_NETHACK
+    int64_t v[9];
+
+    v[0] = u.uz.dnum;
+    v[1] = u.uz.dlevel;
+    v[2] = depth(&u.uz);
+    v[3] = level_difficulty();
+    v[4] = u.ulevel;
+    v[5] = u.ualign.type;
+    v[6] = moves;
+    v[7] = monstermoves;
+    v[8] = (int64_t)context.ident;
+    h = ffi_fnv1a64(h, v, sizeof(v));
+    h = ffi_fnv1a64(h, mvitals, sizeof(mvitals));
+#endif
+    return h;
+}
+
+/* ============================================================================
+ * Rollouts
+ * ============================================================================ */
+
+/* Process-wide, like the headless flags */
+static nh_ffi_rollout_policy_fn g_rollout_fn = NULL;
+static void* g_rollout_user = NULL;
+
+/* A rollout that runs this many commands per move without reaching
+   max_turns has stalled, e.g. walking into a wall forever */
+#define FFI_ROLLOUT_STEPS_PER_TURN 4
+
+struct ffi_rollout {
+    uint64_t rng;             /* the built-in policies' xorshift64 state */
+    int heading;              /* index into ffi_rollout_dirs, -1 for none */
+    int moved;                /* the last step changed the position */
+    struct nh_ffi_step_digest last;
+};
+
+static const char ffi_rollout_dirs[] = "hjklyubn";
+
+static unsigned ffi_rollout_rand(struct ffi_rollout* ro, unsigned n) {
+    ro->rng ^= ro->rng << 13;
+    ro->rng ^= ro->rng >> 7;
+    ro->rng ^= ro->rng << 17;
+    return (unsigned)(ro->rng % n);
+}
+
+static char ffi_policy_random(struct ffi_rollout* ro) {
+    return ffi_rollout_dirs[ffi_rollout_rand(ro, 8)];
+}
+
+static char ffi_policy_explore(struct ffi_rollout* ro) {
+    if (ro->heading < 0 || !ro->moved || !ffi_rollout_rand(ro, 16))
+        ro->heading = (int)ffi_rollout_rand(ro, 8);
+    return ffi_rollout_dirs[ro->heading];
+}
+
+static char ffi_policy_cautious(struct ffi_rollout* ro) {
+    if (ro->last.hp * 3 < ro->last.hpmax)
+        return '.';
+    return ffi_policy_explore(ro);
+}
+
+/* Indexed by NH_FFI_POLICY_* */
+static char (*const ffi_rollout_policies[])(struct ffi_rollout*) = {
+    ffi_policy_random, ffi_policy_explore, ffi_policy_cautious,
+};
+
+#define FFI_NPOLICIES ((int)(sizeof(ffi_rollout_policies) / sizeof(ffi_rollout_policies[0])))
+
+void nh_ffi_set_rollout_policy(nh_ffi_rollout_policy_fn fn, void* user) {
+    g_rollout_fn = fn;
+    g_rollout_user = fn ? user : NULL;
+}
+
+/* The score the status line shows with SCORE_ON_BOTL */
+static int32_t ffi_score(void) {
+#ifdef REAL_NETHACK
+    long deepest = deepest_lev_reached(FALSE);
+    long utotal = money_cnt(invent) + hidden_gold() - u.umoney0;
+
+    if (utotal < 0L)
+        utotal = 0L;
+    utotal += u.urexp + 50 * (deepest - 1);
+    if (deepest > 20)
+        utotal += 1000 * ((deepest > 30) ? 10 : deepest - 20);
+    if (utotal < u.urexp || utotal > INT32_MAX)
+        return INT32_MAX;
+    return (int32_t)utotal;
+#else
+    return 50 * (g_level - 1);
+#endif
+}
+
+static void ffi_rollout_play(unsigned long seed, int r, int policy, int max_turns,
+                             struct nh_ffi_rollout_outcome* o) {
+    struct ffi_rollout ro;
+    uint32_t start_turn;
+    uint64_t max_steps = (uint64_t)max_turns * FFI_ROLLOUT_STEPS_PER_TURN;
+
+    memset(o, 0, sizeof(*o));
+    /* splitmix64 of the rollout seed; xorshift needs a nonzero state */
+    ro.rng = (uint64_t)(seed + (unsigned long)r) + 0x9e3779b97f4a7c15ULL;
+    ro.rng = (ro.rng ^ (ro.rng >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    ro.rng = (ro.rng ^ (ro.rng >> 27)) * 0x94d049bb133111ebULL;
+    ro.rng = (ro.rng ^ (ro.rng >> 31)) | 1;
+    ro.heading = -1;
+    ro.moved = 1;
+    (void) nh_ffi_get_step_digest(&ro.last, 0);
+    start_turn = ro.last.turn;
+    o->end = NH_FFI_ROLLOUT_ALIVE;
+    o->max_depth = ro.last.depth;
+
+    while (ro.last.turn - start_turn < (uint32_t)max_turns) {
+        struct nh_ffi_step_digest d;
+        int cmd, status;
+
+        if (o->steps >= max_steps) {
+            o->end = NH_FFI_ROLLOUT_STALLED;
+            break;
+        }
+        cmd = policy == NH_FFI_POLICY_CALLBACK
+                  ? g_rollout_fn(g_rollout_user, r, &ro.last)
+                  : ffi_rollout_policies[policy](&ro);
+        if (cmd <= 0 || cmd > 127) {
+            o->end = NH_FFI_ROLLOUT_STOPPED;
+            break;
+        }
+        status = nh_ffi_exec_cmd((char)cmd);
+        o->steps++;
+        (void) nh_ffi_get_step_digest(&d, status);
+        ro.moved = d.x != ro.last.x || d.y != ro.last.y;
+        ro.last = d;
+        if (d.depth > o->max_depth)
+            o->max_depth = d.depth;
+        if (status != 0) {
+            o->end = status == -2 ? NH_FFI_ROLLOUT_DIED : NH_FFI_ROLLOUT_STOPPED;
+            break;
+        }
+    }
+
+    o->turns = ro.last.turn - start_turn;
+    o->hp = ro.last.hp;
+    o->depth = ro.last.depth;
+    o->score = ffi_score();
+    ffi_result_text(o->result, sizeof(o->result));
+}
+
+int nh_ffi_rollout(unsigned long seed, int policy, int max_turns, int count,
+                   struct nh_ffi_rollout_outcome* out) {
+    unsigned char* start;
+    long need;
+    int r, restored;
+
+    if (policy == NH_FFI_POLICY_CALLBACK ? !g_rollout_fn : policy < 0 || policy >= FFI_NPOLICIES)
+        return -1;
+    if (max_turns < 0 || count < 0 || (count && !out))
+        return -1;
+
+    /* Every rollout starts from this checkpoint */
+    if ((need = nh_ffi_checkpoint(NULL, 0)) < 0 || !(start = malloc((size_t)need)))
+        return -1;
+    if (nh_ffi_checkpoint(start, (size_t)need) != need) {
+        free(start);
+        return -1;
+    }
+
+    for (r = 0; r < count; r++) {
+        /* The first rollout plays from the live state itself */
+        if (r > 0 && nh_ffi_restore(start, (size_t)need) != 0)
+            break;
+        nh_ffi_reset_rng(seed + (unsigned long)r);
+        ffi_rollout_play(seed, r, policy, max_turns, &out[r]);
+    }
+
+    restored = nh_ffi_restore(start, (size_t)need) == 0;
+    free(start);
+    return restored && r == count ? count : -1;
+}
+
+/* ============================================================================
+ * Startup Image
+ * ============================================================================ */
+
+/* The one-time setup in nh_ffi_init() runs with the RNG seeded to 42, so
+   what init_objects() (shuffled descriptions) and init_dungeons() (the
+   dungeon file, laid out) leave behind is the same in every process of a
+   build.  A startup image records that result and the RNG position after
+   it, so later processes load it instead of redoing the work:
+
+     struct ffi_image_header
+     objects[], bases[]                  raw
+     s_level sp_levchn[nspecial]         list order, next pointers unused
+     save_dungeon() stream               dungeons, branches, level_info, ...
+     nh_ffi_rng_checkpoint() image
+
+   initoptions(), dlb_init() and vision_init() still run every time: they
+   open files and allocate, which an image cannot carry.  mons[] is
+   statically initialized and needs no image. */
+#define FFI_IMAGE_MAGIC   0x474D494EU /* "NIMG" */
+#define FFI_IMAGE_VERSION 1
+
+struct ffi_image_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t build_id;        /* nh_ffi_build_id() of the writer */
+    uint64_t content_hash;    /* FNV-1a of everything after the header */
+    uint32_t total_size;
+    uint32_t tables_size;     /* objects[] + bases[] */
+    uint32_t nspecial;
+    uint32_t special_size;    /* sizeof(s_level) */
+    uint32_t dungeon_size;
+    uint32_t rng_size;
+};
+
+static const unsigned char *g_image_in = NULL; /* nh_ffi_set_startup_image() */
+static size_t g_image_in_size = 0;
+static boolean g_image_wanted = FALSE;         /* record one for the caller */
+static boolean g_image_used = FALSE;           /* setup came from an image */
+static unsigned char *g_image_out = NULL;
+static size_t g_image_out_size = 0;
+
+#ifdef REAL_NETHACK
+static size_t ffi_image_tables_size(void) {
+    return sizeof(objects[0]) * NUM_OBJECTS + sizeof(bases);
+}
+
+/* Whether img is a complete image this build can load */
+static boolean ffi_image_valid(const unsigned char *img, size_t size) {
+    struct ffi_image_header hdr;
+
+    if (!img || size < sizeof(hdr))
+        return FALSE;
+    memcpy(&hdr, img, sizeof(hdr));
+    return hdr.magic == FFI_IMAGE_MAGIC && hdr.version == FFI_IMAGE_VERSION
+           && hdr.build_id == nh_ffi_build_id() && hdr.build_id != 0
+           && hdr.total_size == size
+           && hdr.tables_size == ffi_image_tables_size()
+           && hdr.special_size == sizeof(s_level)
+           && hdr.rng_size == nh_ffi_rng_checkpoint(NULL, 0)
+           && (uint64_t)sizeof(hdr) + hdr.tables_size + (uint64_t)hdr.nspecial * hdr.special_size
+                      + hdr.dungeon_size + hdr.rng_size == size
+           && hdr.content_hash == ffi_fnv1a64(FFI_FNV_OFFSET, img + sizeof(hdr), size - sizeof(hdr));
+}
+#endif
+
+/* In place of init_objects() and init_dungeons(): restore their result
+   from the image given to nh_ffi_set_startup_image().  FALSE, with nothing
+   changed, when there is none or it does not fit this build. */
+static boolean ffi_image_load(void) {
+#ifdef REAL_NETHACK
+    struct ffi_image_header hdr;
+    const unsigned char *tables, *special, *dungeon;
+    FILE *fp = NULL;
+    s_level *lev, *last = NULL;
+    uint32_t i;
+    int fd;
+
+    if (!ffi_image_valid(g_image_in, g_image_in_size))
+        return FALSE;
+    memcpy(&hdr, g_image_in, sizeof(hdr));
+    tables = g_image_in + sizeof(hdr);
+    special = tables + hdr.tables_size;
+    dungeon = special + (size_t)hdr.nspecial * hdr.special_size;
+
+    /* Everything that can fail comes before the first global is touched:
+       restore_dungeon() reads from a file descriptor, and the RNG restore
+       checks its image before loading it. */
+    if ((fd = ffi_aux_rewind(&fp)) < 0
+        || write(fd, dungeon, hdr.dungeon_size) != (ssize_t)hdr.dungeon_size
+        || lseek(fd, 0, SEEK_SET) != 0
+        || nh_ffi_rng_restore(dungeon + hdr.dungeon_size, hdr.rng_size) != 0) {
+        if (fp)
+            fclose(fp);
+        return FALSE;
+    }
+    restore_dungeon(fd);
+    fclose(fp);
+
+    memcpy(objects, tables, sizeof(objects[0]) * NUM_OBJECTS);
+    memcpy(bases, tables + sizeof(objects[0]) * NUM_OBJECTS, sizeof(bases));
+    for (i = 0; i < hdr.nspecial; i++) {
+        lev = (s_level *) alloc(sizeof(s_level));
+        memcpy(lev, special + (size_t)i * sizeof(s_level), sizeof(s_level));
+        lev->next = (s_level *) 0;
+        if (last)
+            last->next = lev;
+        else
+            sp_levchn = lev;
+        last = lev;
+    }
+
+    g_image_used = TRUE;
+    FFI_LOG(NH_FFI_LOG_LIFECYCLE, "FFI: tables restored from startup image (%u bytes)\n", hdr.total_size);
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+/* After init_objects() and init_dungeons(): keep an image of their result
+   if nh_ffi_set_startup_image(NULL, 0) asked for one. */
+static void ffi_image_record(void) {
+#ifdef REAL_NETHACK
+    struct ffi_image_header hdr;
+    FILE *fp = NULL;
+    s_level *lev;
+    unsigned char *img, *p;
+    size_t need, rng = nh_ffi_rng_checkpoint(NULL, 0);
+    long dungeon;
+    int fd;
+
+    if (!g_image_wanted || !rng)
+        return;
+    if ((fd = ffi_aux_rewind(&fp)) < 0)
+        return;
+    save_dungeon(fd, TRUE, FALSE);
+    dungeon = lseek(fd, 0, SEEK_CUR);
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = FFI_IMAGE_MAGIC;
+    hdr.version = FFI_IMAGE_VERSION;
+    hdr.build_id = nh_ffi_build_id();
+    hdr.tables_size = (uint32_t) ffi_image_tables_size();
+    for (lev = sp_levchn; lev; lev = lev->next)
+        hdr.nspecial++;
+    hdr.special_size = sizeof(s_level);
+    hdr.dungeon_size = dungeon > 0 ? (uint32_t) dungeon : 0;
+    hdr.rng_size = (uint32_t) rng;
+    need = sizeof(hdr) + hdr.tables_size + (size_t)hdr.nspecial * hdr.special_size
+           + hdr.dungeon_size + hdr.rng_size;
+    hdr.total_size = (uint32_t) need;
+
+    if (dungeon > 0 && (img = (unsigned char *) malloc(need)) != NULL) {
+        p = img + sizeof(hdr);
+        memcpy(p, objects, sizeof(objects[0]) * NUM_OBJECTS);
+        memcpy(p + sizeof(objects[0]) * NUM_OBJECTS, bases, sizeof(bases));
+        p += hdr.tables_size;
+        for (lev = sp_levchn; lev; lev = lev->next, p += sizeof(s_level))
+            memcpy(p, lev, sizeof(s_level));
+        if (lseek(fd, 0, SEEK_SET) == 0 && read(fd, p, hdr.dungeon_size) == (ssize_t)hdr.dungeon_size) {
+            p += hdr.dungeon_size;
+            (void) nh_ffi_rng_checkpoint(p, rng);
+            hdr.content_hash = ffi_fnv1a64(FFI_FNV_OFFSET, img + sizeof(hdr), need - sizeof(hdr));
+            memcpy(img, &hdr, sizeof(hdr));
+            free(g_image_out);
+            g_image_out = img;
+            g_image_out_size = need;
+        } else {
+            free(img);
+        }
+    }
+    fclose(fp);
+#endif
+}
+
+/* Hand the next nh_ffi_init() a startup image (the caller keeps it alive
+   until then), or with NULL ask it to record one. */
+int nh_ffi_set_startup_image(const void* image, size_t size) {
+    if (g_tables_initialized)
+        return -1;
+    g_image_in = (const unsigned char *) image;
+    g_image_in_size = image ? size : 0;
+    g_image_wanted = image == NULL;
+#ifdef REAL_NETHACK
+    if (image && !ffi_image_valid(g_image_in, size)) {
+        g_image_in = NULL;
+        g_image_in_size = 0;
+        return -1;
+    }
+    return 0;
+#else
+    /* Stub builds have no tables to image */
+    return image ? -1 : 0;
+#endif
+}
+
+/* Copy out the image recorded at init.  Same size protocol as
+   nh_ffi_export_level_bin(); 0 when none was recorded. */
+long nh_ffi_get_startup_image(void* buf, size_t bufsize) {
+    if (!g_image_out)
+        return 0;
+    if (buf && bufsize >= g_image_out_size)
+        memcpy(buf, g_image_out, g_image_out_size);
+    return (long) g_image_out_size;
+}
+
+/* 1 if nh_ffi_init() restored its tables from an image */
+int nh_ffi_startup_image_used(void) {
+    return g_image_used ? 1 : 0;
+}
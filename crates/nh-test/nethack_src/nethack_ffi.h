@@ -9,65 +9,14 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
+
+#include "nethack_ffi_types.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/* Game state */
-struct nh_ffi_game_state {
-    int hp;
-    int hp_max;
-    int energy;
-    int energy_max;
-    int x;
-    int y;
-    int level;
-    int experience_level;
-    int armor_class;
-    int gold;
-    int strength;
-    int dexterity;
-    int constitution;
-    int intelligence;
-    int wisdom;
-    int charisma;
-    bool is_dead;
-    int hunger_state;
-    int turn_count;
-    int dungeon_depth;
-    int monster_count;
-};
-
-/* Inventory item */
-struct nh_ffi_object {
-    char name[128];
-    char obj_class;
-    int weight;
-    int value;
-    int quantity;
-    int enchantment;
-    bool cursed;
-    bool blessed;
-    int armor_class;
-    int damage;
-    char inv_letter;
-};
-
-/* Monster info */
-struct nh_ffi_monster {
-    char name[128];
-    char symbol;
-    int level;
-    int hp;
-    int max_hp;
-    int armor_class;
-    int x;
-    int y;
-    bool asleep;
-    bool peaceful;
-};
-
 /* ============================================================================
  * Initialization and Cleanup
  * ============================================================================ */
@@ -110,14 +59,267 @@ int nh_ffi_get_alignment(void);
 int nh_ffi_exec_cmd(char cmd);
 int nh_ffi_exec_cmd_dir(char cmd, int dx, int dy);
 
+/* Run n commands in order, stopping after the first one that fails.  When
+ * digests is non-NULL it must hold n entries; one is written per executed
+ * step.  Returns the number of steps executed, or -1 on bad arguments. */
+int nh_ffi_exec_cmds(const char* cmds, int n, struct nh_ffi_step_digest* digests);
+
+/* Fill *digest from the live game as nh_ffi_exec_cmds() would after a step
+ * that returned status.  Returns 0, or -1 if digest is NULL. */
+int nh_ffi_get_step_digest(struct nh_ffi_step_digest* digest, int status);
+
+/* Restart the step digests' rolling RNG hash.  nh_ffi_reset() and
+ * nh_ffi_reset_rng() restart it too; it is checkpointed with the game but
+ * not by nh_ffi_rng_checkpoint(). */
+void nh_ffi_reset_rng_hash(void);
+
+/* ============================================================================
+ * Rollouts
+ * ============================================================================ */
+
+/* Play count games from the live state, each for up to max_turns moves,
+ * and write one outcome per game to out.  Rollout r restarts from the
+ * state at the call with the game RNG reset to seed + r; the live game is
+ * restored afterwards.  Returns count, or -1 on bad arguments or if the
+ * state cannot be checkpointed or restored. */
+int nh_ffi_rollout(unsigned long seed, int policy, int max_turns, int count,
+                   struct nh_ffi_rollout_outcome* out);
+
+/* Set the NH_FFI_POLICY_CALLBACK policy for the process (NULL clears it). */
+void nh_ffi_set_rollout_policy(nh_ffi_rollout_policy_fn fn, void* user);
+
 /* ============================================================================
  * State Serialization
  * ============================================================================ */
 
+/* String results come from the live context's output arena and stay valid
+ * until the next nh_ffi_arena_reset(); callers never free them. */
 char* nh_ffi_get_state_json(void);
 char* nh_ffi_get_map_json(void);
+
+/* No-op: arena strings are released by nh_ffi_arena_reset(). */
 void nh_ffi_free_string(void* ptr);
 
+/* ============================================================================
+ * Output Arena
+ * ============================================================================ */
+
+/* Start a new generation: every string handed out so far is invalidated and
+ * its memory reused.  Only the live context's arena is affected. */
+void nh_ffi_arena_reset(void);
+
+/* Bumped by every nh_ffi_arena_reset() of the live context. */
+unsigned long nh_ffi_arena_generation(void);
+
+/* Bytes the live context's arena holds in chunks. */
+size_t nh_ffi_arena_capacity(void);
+
+/* ============================================================================
+ * Structured State
+ * ============================================================================ */
+
+/* Fill *state from the live game in one call.  Returns 0, or -1 if state
+ * is NULL. */
+int nh_ffi_get_game_state(struct nh_ffi_game_state* state);
+
+/* Copy up to max inventory items into out, in inventory order.  Returns the
+ * number of items, which may exceed max; pass NULL to count. */
+int nh_ffi_get_inventory(struct nh_ffi_object* out, int max);
+
+/* Same for the live monsters on the current level, in fmon order. */
+int nh_ffi_get_monsters(struct nh_ffi_monster* out, int max);
+
+/* Same for the live monsters with x1 <= x <= x2 and y1 <= y <= y2, clipped
+ * to the map, in column-major order.  Reads level.monsters[][], so the cost
+ * follows the area rather than the number of monsters on the level. */
+int nh_ffi_get_monsters_in_rect(int x1, int y1, int x2, int y2,
+                                struct nh_ffi_monster* out, int max);
+
+/* Same within radius moves of (x, y), i.e. at Chebyshev distance <= radius. */
+int nh_ffi_get_monsters_near(int x, int y, int radius, struct nh_ffi_monster* out, int max);
+
+/* Copy the glyph shown at each map cell (glyph_at()) into out, row-major.
+ * Returns COLNO * ROWNO, or 0 in builds without a map; out is only
+ * written when max is at least that. */
+int nh_ffi_get_glyphs(uint16_t* out, int max);
+
+/* ============================================================================
+ * Static Tables
+ * ============================================================================ */
+
+/* Write the monster, object, artifact, role and race tables (see
+ * nethack_ffi_types.h).  Same size protocol as nh_ffi_export_level_bin();
+ * needs no game. */
+long nh_ffi_export_static_tables(void* buf, size_t bufsize);
+
+/* The source_id nh_ffi_export_static_tables() would write: a hash of the
+ * tables' contents, stable across rebuilds that leave them alone. */
+unsigned long long nh_ffi_static_tables_id(void);
+
+/* ============================================================================
+ * Startup Image
+ * ============================================================================ */
+
+/* Give the first nh_ffi_init() an image of the one-time table setup
+ * (init_objects(), init_dungeons()) to restore instead of rebuilding; the
+ * caller keeps it alive until then.  With NULL, init records an image for
+ * nh_ffi_get_startup_image().  Returns -1 if init already ran or the image
+ * is not from this build. */
+int nh_ffi_set_startup_image(const void* image, size_t size);
+
+/* Copy out the recorded image.  Same size protocol as
+ * nh_ffi_export_level_bin(); 0 when none was recorded. */
+long nh_ffi_get_startup_image(void* buf, size_t bufsize);
+
+/* 1 if nh_ffi_init() restored its tables from an image. */
+int nh_ffi_startup_image_used(void);
+
+/* ============================================================================
+ * Binary Export
+ * ============================================================================ */
+
+/* Write the current level as packed records (see nethack_ffi_types.h).
+ * Returns the size the export needs; the buffer is only written when
+ * bufsize is at least that large.  Pass NULL to query the size. */
+long nh_ffi_export_level_bin(void* buf, size_t bufsize);
+
+/* Write the cells, floor objects and monsters that changed since the last
+ * delta (see nethack_ffi_types.h).  Same size protocol as
+ * nh_ffi_export_level_bin(); only a delta that was written counts as
+ * delivered. */
+long nh_ffi_export_level_delta(void* buf, size_t bufsize);
+
+/* Make the next delta a full baseline. */
+void nh_ffi_reset_level_delta(void);
+
+/* Write the sight, lit and cell type planes of the current level (see
+ * nethack_ffi_types.h).  Same size protocol as nh_ffi_export_level_bin(). */
+long nh_ffi_export_grid(void* buf, size_t bufsize);
+
+/* ============================================================================
+ * Section Profiler
+ * ============================================================================ */
+
+/* Copy up to max per-phase records (indexed by NH_FFI_SECT_*) into out.
+ * Returns NH_FFI_SECT_COUNT. */
+int nh_ffi_get_section_profile(struct nh_ffi_section_profile* out, int max);
+
+/* Clear the cumulative counters. */
+void nh_ffi_reset_section_profile(void);
+
+/* ============================================================================
+ * Game Contexts
+ * ============================================================================ */
+
+/* Opaque handle to a parked game.  Only one context is live at a time;
+ * switching parks the live game in its context and resumes another. */
+struct nh_ffi_ctx;
+
+struct nh_ffi_ctx* nh_ffi_ctx_new(void);
+void nh_ffi_ctx_free(struct nh_ffi_ctx* ctx);
+
+/* Make ctx live (NULL = default context).  Returns 1 if it holds an
+ * initialized game, 0 if it is empty, -1 on failure. */
+int nh_ffi_ctx_switch(struct nh_ffi_ctx* ctx);
+struct nh_ffi_ctx* nh_ffi_ctx_current(void);
+
+/* ============================================================================
+ * Game Checkpoints
+ * ============================================================================ */
+
+/* Write the live game as a checkpoint (see nethack_ffi_types.h).  Same size
+ * protocol as nh_ffi_export_level_bin(); -1 if the RNG state cannot be
+ * saved. */
+long nh_ffi_checkpoint(void* buf, size_t bufsize);
+
+/* Replace the live game with a checkpoint.  Returns 0, or -1 if it is
+ * malformed or was written by another build; the live game is
+ * left alone on failure. */
+int nh_ffi_restore(const void* buf, size_t size);
+
+/* Identifies this build of the library: the linker's build id, image
+ * size and layout, and the static tables.  Checkpoints and startup images
+ * carry it.  0 if the image holding the library could not be found. */
+unsigned long long nh_ffi_build_id(void);
+
+/* Write the live level as a level checkpoint (see nethack_ffi_types.h).
+ * Same size protocol as nh_ffi_checkpoint(). */
+long nh_ffi_level_checkpoint(void* buf, size_t bufsize);
+
+/* Replace the live level with a level checkpoint of the same ledger
+ * level.  Returns 0, or -1 if it is malformed, from another build or
+ * for another level; the live level is left alone on failure. */
+int nh_ffi_restore_level(const void* buf, size_t size);
+
+/* Digest of what mklev() reads besides the RNG: the level's place and
+ * difficulty, the hero's experience level and alignment, the turn,
+ * context.ident and mvitals[] (births, extinctions, uniques). */
+uint64_t nh_ffi_level_inputs_id(void);
+
+/* ============================================================================
+ * RNG Trace Stream
+ * ============================================================================ */
+
+/* Stream every traced RNG call to fd as nh_ffi_rng_trace_record chunks
+ * (see nethack_ffi_types.h).  The fd stays owned by the caller.
+ * Returns 0, or -1 if the stream header could not be written. */
+int nh_ffi_rng_trace_stream_open(int fd);
+
+/* Record one RNG call (NH_FFI_RNG_FN_* func) in the trace ring, the stream
+ * and the step digests' rolling hash.  c_src/nethack_rnd.c calls it for
+ * every rn2/rnd/rnl/rne/rnz the game makes. */
+void nh_ffi_rng_record(int func, int arg, int result);
+
+/* Write out buffered records.  Returns the number of records streamed so
+ * far, or -1 if no stream is open or a write failed. */
+long nh_ffi_rng_trace_stream_flush(void);
+
+/* Flush and stop streaming; returns what the final flush returns. */
+long nh_ffi_rng_trace_stream_close(void);
+
+/* ============================================================================
+ * RNG Positioning
+ * ============================================================================ */
+
+/* Advance the core RNG by n draws, as if rn2() had been called n times. */
+void nh_ffi_rng_skip(unsigned long n);
+
+/* Write the RNG state and call counter into buf.  Returns the size the
+ * checkpoint needs, or 0 if this build cannot checkpoint its RNG; the
+ * buffer is only written when bufsize is at least that large. */
+size_t nh_ffi_rng_checkpoint(void* buf, size_t bufsize);
+
+/* Restore a checkpoint.  Returns 0, or -1 if it does not fit this build. */
+int nh_ffi_rng_restore(const void* buf, size_t size);
+
+/* ============================================================================
+ * Weapon Calculator
+ * ============================================================================ */
+
+/* Fill out[i] for each of the count queries.  Needs no init and leaves the
+ * game RNG alone.  Returns count, or -1 on bad arguments. */
+int nh_ffi_calc_weapon_batch(const struct nh_ffi_weapon_query* queries, int count,
+                             struct nh_ffi_weapon_result* out);
+
+/* ============================================================================
+ * Headless Mode
+ * ============================================================================ */
+
+/* Set the NH_FFI_HEADLESS_* flags for every context; returns the old ones.
+ * While NH_FFI_HEADLESS_MESSAGES is set nh_ffi_get_last_message() keeps
+ * returning the last message captured before. */
+unsigned int nh_ffi_set_headless(unsigned int flags);
+unsigned int nh_ffi_get_headless(void);
+
+/* ============================================================================
+ * Diagnostics
+ * ============================================================================ */
+
+/* Set the NH_FFI_LOG_* categories written to stderr; returns the old mask.
+ * Always 0 when built with NH_FFI_LOG_DISABLED. */
+unsigned int nh_ffi_set_log_mask(unsigned int mask);
+unsigned int nh_ffi_get_log_mask(void);
+
 /* ============================================================================
  * Message Log
  * ============================================================================ */
@@ -0,0 +1,743 @@
+/*
+ * NetHack FFI fixed-layout types
+ *
+ * Plain-old-data records exchanged with the Rust harness through
+ * caller-owned buffers.  Only fixed-width integer types are used so the
+ * layout is identical on every platform; the matching #[repr(C)] views
+ * live in src/ffi/game_engine.rs.  Bump the version constant of a format
+ * whenever one of its records changes.
+ */
+
+#ifndef NH_FFI_TYPES_H
+#define NH_FFI_TYPES_H
+
+#include <stdint.h>
+
+/* ============================================================================
+ * Binary Level Export
+ * ============================================================================
+ *
+ * Layout written by nh_ffi_export_level_bin():
+ *
+ *   struct nh_ffi_level_header
+ *   struct nh_ffi_level_cell    cells[width * height]   (row-major: y * width + x)
+ *   struct nh_ffi_level_room    rooms[nrooms]
+ *   struct nh_ffi_level_stair   stairs[nstairs]
+ *   struct nh_ffi_level_object  objects[nobjects]       (floor objects, fobj order)
+ *   struct nh_ffi_level_monster monsters[nmonsters]     (fmon order)
+ *
+ * Every section starts at the offset recorded in the header and is 4-byte
+ * aligned, so a 4-byte aligned buffer can be viewed in place.
+ */
+
+#define NH_FFI_LEVEL_MAGIC   0x4C56484EU /* "NHVL" */
+#define NH_FFI_LEVEL_VERSION 1
+
+/* nh_ffi_level_header.flags */
+#define NH_FFI_LEVEL_F_SHOP      0x0001
+#define NH_FFI_LEVEL_F_VAULT     0x0002
+#define NH_FFI_LEVEL_F_ZOO       0x0004
+#define NH_FFI_LEVEL_F_COURT     0x0008
+#define NH_FFI_LEVEL_F_MORGUE    0x0010
+#define NH_FFI_LEVEL_F_BEEHIVE   0x0020
+#define NH_FFI_LEVEL_F_BARRACKS  0x0040
+#define NH_FFI_LEVEL_F_TEMPLE    0x0080
+#define NH_FFI_LEVEL_F_SWAMP     0x0100
+#define NH_FFI_LEVEL_F_MAZE      0x0200
+#define NH_FFI_LEVEL_F_CORRMAZE  0x0400
+
+/* nh_ffi_level_stair.kind */
+#define NH_FFI_STAIR_STAIRS 0
+#define NH_FFI_STAIR_LADDER 1
+#define NH_FFI_STAIR_BRANCH 2
+
+struct nh_ffi_level_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t total_size;      /* bytes of the whole export, header included */
+    uint8_t width;            /* COLNO */
+    uint8_t height;           /* ROWNO */
+    int8_t dnum;
+    int8_t dlevel;
+    uint16_t ncells;
+    uint16_t nrooms;
+    uint16_t nstairs;
+    uint16_t nobjects;
+    uint16_t nmonsters;
+    uint16_t flags;           /* NH_FFI_LEVEL_F_* */
+    uint8_t nfountains;
+    uint8_t nsinks;
+    uint16_t reserved;
+    uint32_t cells_offset;
+    uint32_t rooms_offset;
+    uint32_t stairs_offset;
+    uint32_t objects_offset;
+    uint32_t monsters_offset;
+};
+
+struct nh_ffi_level_cell {
+    uint8_t typ;
+    uint8_t lit;
+    uint8_t door_mask;        /* rm.doormask (hack.h #defines doormask) */
+    uint8_t roomno;
+};
+
+struct nh_ffi_level_room {
+    int8_t lx, hx, ly, hy;
+    int8_t rtype;
+    int8_t rlit;
+    int8_t doorct;
+    int8_t nsubrooms;
+};
+
+struct nh_ffi_level_stair {
+    uint8_t x, y;
+    int8_t dir;               /* 1 = up, -1 = down */
+    uint8_t kind;             /* NH_FFI_STAIR_* */
+};
+
+struct nh_ffi_level_object {
+    int16_t otyp;
+    uint8_t x, y;
+    int32_t quan;
+    int8_t spe;
+    int8_t buc;               /* 1 blessed, 0 uncursed, -1 cursed */
+    uint8_t oclass;
+    uint8_t reserved;
+    uint32_t o_id;
+};
+
+struct nh_ffi_level_monster {
+    int16_t mnum;
+    uint8_t x, y;
+    int32_t hp;
+    int32_t hpmax;
+    uint8_t peaceful;
+    uint8_t asleep;
+    int8_t mmove;
+    uint8_t mspeed;
+    uint32_t m_id;
+};
+
+/* ============================================================================
+ * Binary Level Delta
+ * ============================================================================
+ *
+ * Layout written by nh_ffi_export_level_delta():
+ *
+ *   struct nh_ffi_level_delta_header
+ *   struct nh_ffi_level_delta_cell cells[ncells]           (changed cells)
+ *   struct nh_ffi_level_object     objects[nobjects]       (new or changed)
+ *   uint32_t                       objects_gone[nobjects_gone]   (o_id)
+ *   struct nh_ffi_level_monster    monsters[nmonsters]     (new or changed)
+ *   uint32_t                       monsters_gone[nmonsters_gone] (m_id)
+ *
+ * Each delta covers the changes since the previous one.  A delta with
+ * NH_FFI_DELTA_F_FULL set is a new baseline: it lists every cell, floor
+ * object and monster, and seq restarts at 0.  Sections are 4-byte aligned
+ * as in the level export.
+ */
+
+#define NH_FFI_DELTA_MAGIC   0x44564C4EU /* "NLVD" */
+#define NH_FFI_DELTA_VERSION 1
+
+/* nh_ffi_level_delta_header.flags */
+#define NH_FFI_DELTA_F_FULL 0x0001
+
+struct nh_ffi_level_delta_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t total_size;      /* bytes of the whole delta, header included */
+    uint32_t seq;             /* deltas since the baseline */
+    uint8_t width;            /* COLNO */
+    uint8_t height;           /* ROWNO */
+    int8_t dnum;
+    int8_t dlevel;
+    uint16_t flags;           /* NH_FFI_DELTA_F_* */
+    uint16_t ncells;
+    uint16_t nobjects;
+    uint16_t nobjects_gone;
+    uint16_t nmonsters;
+    uint16_t nmonsters_gone;
+    uint32_t cells_offset;
+    uint32_t objects_offset;
+    uint32_t objects_gone_offset;
+    uint32_t monsters_offset;
+    uint32_t monsters_gone_offset;
+};
+
+struct nh_ffi_level_delta_cell {
+    uint16_t index;           /* y * width + x */
+    uint16_t reserved;
+    struct nh_ffi_level_cell cell;
+};
+
+/* ============================================================================
+ * Grid Planes
+ * ============================================================================
+ *
+ * Layout written by nh_ffi_export_grid(), and by nh-core's GridPlanes:
+ *
+ *   struct nh_ffi_grid_header
+ *   uint64_t bits[nbitplanes][height][row_words]   NH_FFI_GRID_* order
+ *   uint8_t  typ[height][width]                    levl[x][y].typ
+ *
+ * Everything is row-major: cell (x, y) is bit x % 64 of bits[p][y][x / 64]
+ * and typ[y][x].  Words are little-endian.  The stub build writes the
+ * header alone, with zero width and height.
+ */
+
+#define NH_FFI_GRID_MAGIC   0x5047484EU /* "NHGP" */
+#define NH_FFI_GRID_VERSION 1
+
+/* Bit planes */
+#define NH_FFI_GRID_IN_SIGHT  0  /* viz_array[y][x] & IN_SIGHT */
+#define NH_FFI_GRID_COULD_SEE 1  /* viz_array[y][x] & COULD_SEE */
+#define NH_FFI_GRID_LIT       2  /* levl[x][y].lit */
+#define NH_FFI_GRID_NBITPLANES 3
+
+struct nh_ffi_grid_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;     /* sizeof(struct nh_ffi_grid_header) */
+    uint32_t total_size;
+    uint8_t width;
+    uint8_t height;
+    uint8_t nbitplanes;
+    uint8_t row_words;        /* uint64_t words per bit-plane row */
+    uint32_t bits_offset;
+    uint32_t typ_offset;
+    uint32_t reserved[2];
+};
+
+/* ============================================================================
+ * Game Checkpoint
+ * ============================================================================
+ *
+ * Layout written by nh_ffi_checkpoint():
+ *
+ *   struct nh_ffi_checkpoint_header
+ *   uint8_t globals[globals_size]      per-game globals, as a context parks them
+ *   nodes[nnodes]                      heap blocks of the game: objects,
+ *                                      monsters, their extras, traps, ...
+ *                                      each a struct nh_ffi_checkpoint_node
+ *                                      followed by size bytes, padded to 8
+ *   struct nh_ffi_checkpoint_fixup fixups[nfixups]
+ *   uint8_t aux[aux_size]              timers, light sources, engravings and
+ *                                      worms in NetHack's save format
+ *   uint8_t rng[rng_size]              nh_ffi_rng_checkpoint() image
+ *
+ * Pointers between heap blocks are not stored: each slot is zeroed and
+ * listed as a fixup naming the block (and offset) it points into, so a
+ * restore allocates fresh blocks and patches them.  Pointers into static
+ * data (monster types, role tables, functions) are fixups too, naming an
+ * offset from the start of the loaded image, so a checkpoint restores in
+ * any process running the same build.  build_id identifies the build.
+ */
+
+#define NH_FFI_CKPT_MAGIC   0x4B43484EU /* "NHCK" */
+#define NH_FFI_CKPT_VERSION 2
+
+/* nh_ffi_checkpoint_header.flags */
+#define NH_FFI_CKPT_F_GAME 0x0001 /* a game was live */
+
+/* nh_ffi_checkpoint_fixup.slot_node for a slot in globals[] */
+#define NH_FFI_CKPT_GLOBALS 0xFFFFFFFFU
+
+/* nh_ffi_checkpoint_fixup.target_node for a pointer into the loaded image */
+#define NH_FFI_CKPT_IMAGE   0xFFFFFFFEU
+
+struct nh_ffi_checkpoint_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;     /* sizeof(struct nh_ffi_checkpoint_header) */
+    uint32_t total_size;
+    uint32_t flags;
+    uint64_t build_id;
+    uint32_t globals_size;
+    uint32_t nnodes;
+    uint32_t nfixups;
+    uint32_t aux_size;
+    uint32_t rng_size;
+    /* Byte offsets from the start of the checkpoint */
+    uint32_t globals_off;
+    uint32_t nodes_off;
+    uint32_t fixups_off;
+    uint32_t aux_off;
+    uint32_t rng_off;
+};
+
+struct nh_ffi_checkpoint_node {
+    uint32_t size;
+    uint32_t reserved;
+};
+
+/* The pointer slot at slot_offset in globals[] or node slot_node points
+   target_offset bytes into node target_node, or into the image. */
+struct nh_ffi_checkpoint_fixup {
+    uint32_t slot_node;
+    uint32_t slot_offset;
+    uint32_t target_node;
+    uint32_t target_offset;
+};
+
+/* Level checkpoint, nh_ffi_level_checkpoint(): just the live level, for
+ * the level cache.  The level itself is NetHack's own savelev() stream;
+ * mvitals[] and context.ident, which mklev() advances, ride along so a
+ * restore leaves them as the generation did.  Everything else -- hero,
+ * inventory, turn, RNG -- is left to the caller.
+ *
+ *   struct nh_ffi_level_checkpoint_header
+ *   uint8_t mvitals[mvitals_size]
+ *   uint8_t level[level_size]          savelev(WRITE_SAVE) output
+ */
+
+#define NH_FFI_LVCK_MAGIC   0x4B564C4EU /* "NLVK" */
+#define NH_FFI_LVCK_VERSION 1
+
+struct nh_ffi_level_checkpoint_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;     /* sizeof(struct nh_ffi_level_checkpoint_header) */
+    uint64_t build_id;        /* as in nh_ffi_checkpoint_header */
+    int32_t ledger;           /* ledger_no() of the level */
+    uint32_t mvitals_size;
+    uint32_t level_size;
+    uint32_t reserved;
+    int64_t monstermoves;     /* when saved: a restore catches nothing up */
+    uint64_t ident;           /* context.ident after the generation */
+};
+
+/* ============================================================================
+ * Section Profiler
+ * ============================================================================
+ *
+ * One record per ffi_post_command() phase, indexed by NH_FFI_SECT_*.  The
+ * plain counters cover the last command only; the total_* counters keep
+ * accumulating until nh_ffi_reset_section_profile().
+ */
+
+#define NH_FFI_SECT_MOVEMON       0
+#define NH_FFI_SECT_MCALCDISTRESS 1
+#define NH_FFI_SECT_MCALCMOVE     2
+#define NH_FFI_SECT_SPAWN         3
+#define NH_FFI_SECT_SPEED         4
+#define NH_FFI_SECT_TIMEOUT       5  /* nh_timeout + run_regions */
+#define NH_FFI_SECT_HP_REGEN      6
+#define NH_FFI_SECT_ENERGY_REGEN  7
+#define NH_FFI_SECT_TELE_POLY     8
+#define NH_FFI_SECT_SEARCH        9
+#define NH_FFI_SECT_DOSOUNDS      10
+#define NH_FFI_SECT_DO_STORMS     11
+#define NH_FFI_SECT_GETHUNGRY     12
+#define NH_FFI_SECT_AGE_SPELLS    13
+#define NH_FFI_SECT_EXERCHK       14
+#define NH_FFI_SECT_INVAULT       15 /* invault + amulet */
+#define NH_FFI_SECT_ENGRAVE       16
+#define NH_FFI_SECT_COUNT         17
+
+#define NH_FFI_SECTION_NAME_LEN 16
+
+struct nh_ffi_section_profile {
+    char name[NH_FFI_SECTION_NAME_LEN];
+    uint64_t calls;
+    uint64_t rng_calls;
+    uint64_t nanos;
+    uint64_t total_calls;
+    uint64_t total_rng_calls;
+    uint64_t total_nanos;
+};
+
+/* ============================================================================
+ * Batched Command Execution
+ * ============================================================================
+ *
+ * State recorded by nh_ffi_exec_cmds() after every step.
+ *
+ * The two hashes let a lockstep run compare a whole turn with the Rust
+ * engine in a few words.  Both fold 64-bit words as FNV-1a does bytes
+ * (h = (h ^ w) * NH_FFI_HASH_PRIME, from NH_FFI_HASH_SEED), the same as
+ * nh_rng::hash_word():
+ *
+ *   rng_hash    every rn2/rnd/rnl/rne/rnz call the game made since
+ *               nh_ffi_reset_rng_hash(), folded as func, arg, result
+ *               (NH_FFI_RNG_FN_* codes).  Draws inside one of those
+ *               calls, and d()'s dice, are not folded on their own;
+ *               nh_rng::Isaac64 hashes the same way.  rng_calls still
+ *               counts every draw.
+ *   state_hash  turn, x, y, hp, hpmax, depth, then the wrapping sum over
+ *               live monsters of the hash of their x, y, hp, so fmon
+ *               order does not matter
+ *
+ * Signed fields are folded sign-extended to 64 bits.
+ */
+
+#define NH_FFI_HASH_SEED  0xcbf29ce484222325ULL
+#define NH_FFI_HASH_PRIME 0x00000100000001b3ULL
+
+struct nh_ffi_step_digest {
+    uint64_t rng_calls;       /* RNG call counter after the step */
+    uint32_t turn;            /* moves */
+    int32_t hp;
+    int32_t hpmax;
+    uint8_t x, y;
+    int8_t status;            /* nh_ffi_exec_cmd() result: 0, -1 bad cmd, -2 died */
+    int8_t depth;
+    uint64_t rng_hash;
+    uint64_t state_hash;
+};
+
+/* ============================================================================
+ * Rollouts
+ * ============================================================================
+ *
+ * nh_ffi_rollout() plays games out from the live state and keeps one
+ * nh_ffi_rollout_outcome per game.  Built-in policies draw from their own
+ * generator, seeded per rollout, so the game RNG sees only the commands.
+ */
+
+#define NH_FFI_POLICY_RANDOM   0 /* a random direction every step */
+#define NH_FFI_POLICY_EXPLORE  1 /* keep a heading, turn when blocked */
+#define NH_FFI_POLICY_CAUTIOUS 2 /* explore, rest below a third of max HP */
+#define NH_FFI_POLICY_CALLBACK 3 /* nh_ffi_set_rollout_policy() */
+
+#define NH_FFI_ROLLOUT_ALIVE   0 /* max_turns reached */
+#define NH_FFI_ROLLOUT_DIED    1
+#define NH_FFI_ROLLOUT_STOPPED 2 /* the policy or a command ended it */
+#define NH_FFI_ROLLOUT_STALLED 3 /* commands stopped advancing the turn */
+
+#define NH_FFI_RESULT_LEN 64
+
+struct nh_ffi_rollout_outcome {
+    uint32_t turns;           /* moves played */
+    uint32_t steps;           /* commands executed */
+    int32_t score;            /* botl_score() at the end */
+    int32_t hp;
+    int8_t end;               /* NH_FFI_ROLLOUT_* */
+    int8_t depth;             /* depth at the end */
+    int8_t max_depth;         /* deepest level reached */
+    uint8_t reserved;
+    char result[NH_FFI_RESULT_LEN]; /* nh_ffi_get_result_message(), truncated */
+};
+
+/* Picks the next command of a rollout from the digest after the last step
+ * (status 0 before the first).  Returns a command for nh_ffi_exec_cmd(),
+ * or 0 to end the rollout. */
+typedef int (*nh_ffi_rollout_policy_fn)(void* user, int rollout,
+                                        const struct nh_ffi_step_digest* last);
+
+/* ============================================================================
+ * Weapon Calculator
+ * ============================================================================
+ *
+ * nh_ffi_calc_weapon_batch() answers one nh_ffi_weapon_query per entry
+ * by running the game's hitval() and dmgval() on a pristine weapon and a
+ * plain jackal (small) or ogre (large).  Sampled attacks reseed the core
+ * RNG with init_isaac64(seed); its state, call counter and trace are
+ * restored after the batch, so the game is left as it was.  Bin k of both
+ * histograms counts damage dmg_min + k.
+ */
+
+#define NH_FFI_DMG_BINS 32
+
+#define NH_FFI_WEAPON_OK       0
+#define NH_FFI_WEAPON_UNKNOWN -1 /* no such object (or no objects[] here) */
+#define NH_FFI_WEAPON_RANGE   -2 /* enchantment outside schar, or too many bins */
+
+struct nh_ffi_weapon_query {
+    int32_t weapon_id;        /* objects[] index */
+    int32_t enchantment;      /* obj->spe */
+    int32_t to_hit;           /* find_roll_to_hit() total without hitval() */
+    uint32_t samples;         /* attacks to roll from seed, 0 for none */
+    uint64_t seed;
+    uint8_t large;            /* bigmonst() target (an ogre) */
+    uint8_t exact;            /* also fill exact[] */
+    uint8_t reserved[6];
+};
+
+struct nh_ffi_weapon_result {
+    int32_t status;           /* NH_FFI_WEAPON_* */
+    int32_t hit_bonus;        /* hitval() */
+    int32_t dmg_min;          /* dmgval() range */
+    int32_t dmg_max;
+    uint32_t hits;            /* sampled attacks that hit */
+    uint32_t hit_faces;       /* rnd(20) results that hit, of 20 */
+    uint32_t outcomes;        /* equally likely dice outcomes behind exact[] */
+    uint32_t reserved;
+    uint32_t sampled[NH_FFI_DMG_BINS]; /* damage of each sampled hit */
+    uint32_t exact[NH_FFI_DMG_BINS];   /* outcomes per damage */
+};
+
+/* ============================================================================
+ * Structured State
+ * ============================================================================
+ *
+ * Filled by nh_ffi_get_game_state(), nh_ffi_get_inventory() and
+ * nh_ffi_get_monsters().  Names are NUL-terminated and truncated to fit;
+ * the flag fields are 0 or 1.
+ */
+
+#define NH_FFI_NAME_LEN 128
+
+struct nh_ffi_game_state {
+    int32_t hp;
+    int32_t hp_max;
+    int32_t energy;
+    int32_t energy_max;
+    int32_t x;
+    int32_t y;
+    int32_t level;            /* u.uz.dlevel */
+    int32_t experience_level;
+    int32_t armor_class;
+    int32_t gold;
+    int32_t strength;
+    int32_t dexterity;
+    int32_t constitution;
+    int32_t intelligence;
+    int32_t wisdom;
+    int32_t charisma;
+    uint8_t is_dead;
+    int32_t hunger_state;     /* u.uhs */
+    uint64_t turn_count;      /* moves (a long), widened */
+    int32_t dungeon_depth;
+    int32_t monster_count;    /* live monsters, as nh_ffi_get_monsters() counts them */
+};
+
+/* Inventory item */
+struct nh_ffi_object {
+    char name[NH_FFI_NAME_LEN];
+    char obj_class;           /* class symbol, e.g. ')' */
+    int32_t weight;
+    int32_t value;            /* base cost */
+    int32_t quantity;
+    int32_t enchantment;
+    uint8_t cursed;
+    uint8_t blessed;
+    int32_t armor_class;      /* base AC of armor, else 0 */
+    int32_t damage;           /* small-monster damage die of weapons, else 0 */
+    char inv_letter;
+};
+
+/* Monster on the current level */
+struct nh_ffi_monster {
+    char name[NH_FFI_NAME_LEN];
+    char symbol;
+    int32_t level;
+    int32_t hp;
+    int32_t max_hp;
+    int32_t armor_class;
+    int32_t x;
+    int32_t y;
+    uint8_t asleep;
+    uint8_t peaceful;
+};
+
+/* ============================================================================
+ * Static Tables
+ * ============================================================================
+ *
+ * Layout written by nh_ffi_export_static_tables(), and read by nh-core's
+ * data::static_tables:
+ *
+ *   struct nh_ffi_static_header
+ *   struct nh_ffi_static_monster  monsters[]    mons[], NUMMONS entries
+ *   struct nh_ffi_static_object   objects[]     objects[], NUM_OBJECTS
+ *   struct nh_ffi_static_artifact artifacts[]   1..NROFARTIFACTS
+ *   struct nh_ffi_static_role     roles[]
+ *   struct nh_ffi_static_race     races[]
+ *   char strings[strings_size]                  NUL-terminated
+ *
+ * Strings are byte offsets into strings[], or NH_FFI_STATIC_NONE for a
+ * NULL pointer.  content_hash is the 64-bit FNV-1a of everything after the
+ * header; source_id (nh_ffi_static_tables_id()) hashes the whole export,
+ * so a cached copy can be checked against the live library without
+ * regenerating it, and survives rebuilds that leave the tables alone.
+ * Object names and descriptions are the unshuffled obj_descr[] entries.
+ */
+
+#define NH_FFI_STATIC_MAGIC   0x5453484EU /* "NHST" */
+#define NH_FFI_STATIC_VERSION 1
+#define NH_FFI_STATIC_NONE    0xFFFFFFFFU
+
+/* Sections, in file order */
+#define NH_FFI_STATIC_MONSTERS  0
+#define NH_FFI_STATIC_OBJECTS   1
+#define NH_FFI_STATIC_ARTIFACTS 2
+#define NH_FFI_STATIC_ROLES     3
+#define NH_FFI_STATIC_RACES     4
+#define NH_FFI_STATIC_NSECTIONS 5
+
+struct nh_ffi_static_section {
+    uint32_t offset;
+    uint16_t count;
+    uint16_t record_size;
+};
+
+struct nh_ffi_static_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;     /* sizeof(struct nh_ffi_static_header) */
+    uint32_t total_size;
+    uint32_t reserved;
+    uint64_t content_hash;
+    uint64_t source_id;
+    struct nh_ffi_static_section sections[NH_FFI_STATIC_NSECTIONS];
+    uint32_t strings_offset;
+    uint32_t strings_size;
+};
+
+struct nh_ffi_static_monster {
+    uint32_t name;
+    uint8_t mlet;
+    int8_t mlevel;
+    int8_t mmove;
+    int8_t ac;
+    int8_t mr;
+    int8_t maligntyp;
+    uint16_t geno;
+    uint8_t attacks[6][4];    /* aatyp, adtyp, damn, damd */
+    uint16_t cwt;
+    uint16_t cnutrit;
+    uint8_t msound;
+    uint8_t msize;
+    uint8_t mresists;
+    uint8_t mconveys;
+    uint32_t mflags1;
+    uint32_t mflags2;
+    uint32_t mflags3;
+    uint8_t difficulty;
+    uint8_t mcolor;
+    uint8_t reserved[2];
+};
+
+/* nh_ffi_static_object.flags */
+#define NH_FFI_STATIC_OBJ_MERGE   0x01
+#define NH_FFI_STATIC_OBJ_MAGIC   0x02
+#define NH_FFI_STATIC_OBJ_CHARGED 0x04
+#define NH_FFI_STATIC_OBJ_UNIQUE  0x08
+#define NH_FFI_STATIC_OBJ_NOWISH  0x10
+#define NH_FFI_STATIC_OBJ_BIG     0x20
+#define NH_FFI_STATIC_OBJ_TOUGH   0x40
+
+struct nh_ffi_static_object {
+    uint32_t name;
+    uint32_t descr;
+    uint8_t oc_class;
+    uint8_t material;
+    uint8_t color;
+    uint8_t oprop;
+    uint16_t weight;
+    int16_t cost;
+    int16_t prob;
+    uint16_t nutrition;
+    int8_t wsdam;
+    int8_t wldam;
+    int8_t oc1;
+    int8_t oc2;
+    int8_t subtyp;
+    int8_t delay;
+    uint8_t flags;            /* NH_FFI_STATIC_OBJ_* */
+    uint8_t reserved;
+};
+
+struct nh_ffi_static_artifact {
+    uint32_t name;
+    int16_t otyp;
+    int16_t reserved;
+};
+
+struct nh_ffi_static_role {
+    uint32_t name_m;
+    uint32_t name_f;
+    uint32_t rank_m[9];
+    uint32_t rank_f[9];
+    uint32_t gods[3];         /* lawful, neutral, chaotic */
+    uint32_t filecode;
+    int16_t malenum;
+    int16_t femalenum;
+};
+
+struct nh_ffi_static_race {
+    uint32_t noun;
+    uint32_t adj;
+    uint32_t coll;
+    uint32_t filecode;
+    int16_t malenum;
+    int16_t femalenum;
+};
+
+/* ============================================================================
+ * RNG Trace Stream
+ * ============================================================================
+ *
+ * Layout written to the fd given to nh_ffi_rng_trace_stream_open():
+ *
+ *   struct nh_ffi_rng_trace_header
+ *   struct nh_ffi_rng_trace_record records[]   (until the end of the file)
+ *
+ * Records are buffered and written in chunks of NH_FFI_RNG_TRACE_CHUNK.
+ * seq counts every traced call since the stream was opened, so a gap
+ * means records were lost.  There is one record per rn2, rnd, rnl, rne or
+ * rnz call the game makes; arg and result are that call's int argument
+ * and return value, unconverted.
+ */
+
+#define NH_FFI_RNG_TRACE_MAGIC   0x54524E4EU /* "NNRT" */
+#define NH_FFI_RNG_TRACE_VERSION 1
+#define NH_FFI_RNG_TRACE_CHUNK   4096
+
+/* nh_ffi_rng_trace_record.func */
+#define NH_FFI_RNG_FN_RN2 0
+#define NH_FFI_RNG_FN_RND 1
+#define NH_FFI_RNG_FN_RNE 2
+#define NH_FFI_RNG_FN_RNZ 3
+#define NH_FFI_RNG_FN_RNL 4
+#define NH_FFI_RNG_FN_COUNT 5
+
+struct nh_ffi_rng_trace_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+};
+
+struct nh_ffi_rng_trace_record {
+    uint32_t seq;
+    uint8_t func;             /* NH_FFI_RNG_FN_* */
+    uint8_t reserved[3];
+    int32_t arg;
+    int32_t result;
+};
+
+/* ============================================================================
+ * Headless Mode
+ * ============================================================================
+ *
+ * Flags for nh_ffi_set_headless().  Each one drops work no game rule reads,
+ * so the RNG stream is the same with any combination.  Vision is never
+ * skipped: monster movement reads viz_array.
+ */
+
+#define NH_FFI_HEADLESS_PROFILE  0x0001 /* section profiler stops timing */
+#define NH_FFI_HEADLESS_STATUS   0x0002 /* bot() formats no status lines */
+#define NH_FFI_HEADLESS_MESSAGES 0x0004 /* messages are not captured */
+#define NH_FFI_HEADLESS_ALL      0x0007
+
+/* ============================================================================
+ * Diagnostics
+ * ============================================================================
+ *
+ * Categories for nh_ffi_set_log_mask().  Building with NH_FFI_LOG_DISABLED
+ * (the default for release profiles) compiles every category out.
+ */
+
+#define NH_FFI_LOG_LIFECYCLE 0x0001 /* init, level generation, terminate */
+#define NH_FFI_LOG_EXEC      0x0002 /* per-command start/end positions */
+#define NH_FFI_LOG_SECTION   0x0004 /* per-phase RNG counts in post-command */
+#define NH_FFI_LOG_MONSTER   0x0008 /* per-monster dump after movemon */
+#define NH_FFI_LOG_RNG       0x0010 /* direct rn2/rnd calls */
+#define NH_FFI_LOG_JSON      0x0020 /* JSON getters */
+#define NH_FFI_LOG_ALL       0xFFFF
+
+#endif /* NH_FFI_TYPES_H */
@@ -0,0 +1,63 @@
+//! Sweep seeds and dungeon levels through both level generators.
+//!
+//! Usage: nh-level-sweep [--seed S] [--count N] [--levels K] [--dnum D]
+//!                       [--workers W] [--snapshot] [--json PATH]
+//!
+//! Generates levels 1..=K of dungeon D for seeds S..S+N in the C engine
+//! (spread over a pool of W workers, one per core by default) and in
+//! nh-core, then prints levels/sec and first-divergence statistics. With
+//! `--json` the report is also written as JSON for regression tracking.
+
+use anyhow::{Context, Result, anyhow};
+use nh_test::ffi::{WorkerPool, WorkerSpec};
+use nh_test::maps::sweep::{SweepConfig, run_sweep};
+
+fn parse<T: std::str::FromStr>(flag: &str, value: Option<String>) -> Result<T> {
+    let value = value.ok_or_else(|| anyhow!("{} needs a value", flag))?;
+    value.parse().map_err(|_| anyhow!("Bad value for {}: {}", flag, value))
+}
+
+fn main() -> Result<()> {
+    let mut config = SweepConfig { first_seed: 1, seeds: 100, dnum: 0, max_dlevel: 10 };
+    let mut workers = None;
+    let mut spec = WorkerSpec::default();
+    let mut json = None;
+
+    let mut args = std::env::args().skip(1);
+    while let Some(arg) = args.next() {
+        match arg.as_str() {
+            "--seed" => config.first_seed = parse(&arg, args.next())?,
+            "--count" => config.seeds = parse(&arg, args.next())?,
+            "--levels" => config.max_dlevel = parse(&arg, args.next())?,
+            "--dnum" => config.dnum = parse(&arg, args.next())?,
+            "--workers" => workers = Some(parse::<usize>(&arg, args.next())?),
+            "--snapshot" => spec.snapshot = true,
+            "--json" => json = Some(parse::<String>(&arg, args.next())?),
+            other => return Err(anyhow!("Unknown argument: {}", other)),
+        }
+    }
+
+    let pool = match workers {
+        Some(n) => WorkerPool::new(n, spec)?,
+        None => WorkerPool::with_default_size(spec)?,
+    };
+    eprintln!(
+        "Sweeping seeds {}..{} x dlevels 1..={} on {} workers",
+        config.first_seed,
+        config.first_seed + config.seeds,
+        config.max_dlevel,
+        pool.size()
+    );
+
+    let report = run_sweep(&pool, &config);
+    print!("{}", report);
+    for (seed, error) in report.failed.iter().take(5) {
+        println!("  seed {} failed: {}", seed, error);
+    }
+
+    if let Some(path) = json {
+        let text = serde_json::to_string_pretty(&report)?;
+        std::fs::write(&path, text).with_context(|| format!("Cannot write {}", path))?;
+    }
+    Ok(())
+}
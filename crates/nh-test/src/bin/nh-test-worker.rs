@@ -1,12 +1,29 @@
-use std::io::{self, BufRead, Write};
+use std::fs::File;
+use std::io::{self, BufRead, BufWriter, Write};
+use std::os::fd::{AsRawFd, FromRawFd};
+use std::path::Path;
 use serde::{Serialize, Deserialize};
-use nh_test::ffi::CGameEngine;
+use nh_test::ffi::{CGameEngine, EpisodeRecorder, LevelCache};
+use nh_test::ffi::game_engine::{
+    CStepDigest, CWeaponQuery, CWeaponResult, NH_COLNO, NH_ROWNO, RolloutOutcome, RolloutPolicy, SectionProfile,
+    StepBatch,
+};
+use nh_test::ffi::shm::{SHM_COULDSEE_OFFSET, SHM_LEVEL_OFFSET, SHM_VISIBILITY_OFFSET, SharedRegion};
+use nh_test::ffi::startup_image::StartupImage;
+use nh_test::ffi::static_tables;
+use nh_test::ffi::wire;
+use nh_test::maps::isolation::{self, CaseResult, IsolationCase};
 use nh_core::CGameEngineTrait;
 
+// Variant order is part of the binary protocol and must match
+// CommandMsg/ResponseMsg in src/ffi/subprocess.rs.
 #[derive(Serialize, Deserialize)]
 enum Command {
+    SetProtocol { binary: bool },
     Init { role: String, race: String, gender: i32, align: i32 },
     Reset { seed: u64 },
+    ForkSession { seed: u64 },
+    EndForkSession,
     ResetRng { seed: u64 },
     GenerateLevel,
     GenerateAndPlace,
@@ -18,9 +35,14 @@ enum Command {
     GetPosition,
     GetTurnCount,
     GetStateJson,
+    GetSnapshot,
+    GetMonstersNear { x: i32, y: i32, radius: i32 },
     GetMapJson,
     ExecCmd { cmd: char },
     ExecCmdDir { cmd: char, dx: i32, dy: i32 },
+    ExecCmds { cmds: String, record: bool },
+    GetStepDigest,
+    Rollout { seed: u64, policy: RolloutPolicy, max_turns: u32, count: u32 },
     SetDLevel { dnum: i32, dlevel: i32 },
     SetState { hp: i32, hpmax: i32, x: i32, y: i32, ac: i32, moves: i64 },
     GetArmorClass,
@@ -33,6 +55,7 @@ enum Command {
     GetInventoryCount,
     GetInventoryJson,
     GetObjectTableJson,
+    GetStaticTables,
     GetMonstersJson,
     SetWizardMode { enable: bool },
     AddItemToInv { item_id: i32, weight: i32 },
@@ -45,18 +68,38 @@ enum Command {
     GetResultMessage,
     GetRngCallCount,
     SetSkipMovemon { skip: bool },
+    GetSectionProfile,
+    ResetSectionProfile,
+    SetLogMask { mask: u32 },
+    SetHeadless { flags: u32 },
     RngRn2 { limit: i32 },
     CalcBaseDamage { weapon_id: i32, small_monster: bool },
+    CalcWeaponBatch { queries: Vec<CWeaponQuery> },
     GetAc,
     TestSetupStatus { hp: i32, max_hp: i32, level: i32, ac: i32 },
     WearItem { item_id: i32 },
     GetNutrition,
     GetAttributesJson,
     ExportLevel,
+    ExportLevelBin,
+    ExportLevelDelta,
+    ResetLevelDelta,
+    ExportGrid,
+    GenerateLevelBin { seed: u64, dnum: i32, dlevel: i32 },
+    Checkpoint,
+    Restore { checkpoint: Vec<u8> },
+    AttachShm { path: String, size: u64 },
+    ShmExportLevelBin,
+    ShmSight,
     EnableRngTracing,
     DisableRngTracing,
     GetRngTrace,
     ClearRngTrace,
+    ResetRngHash,
+    StartRngTraceStream { path: String },
+    StopRngTraceStream,
+    StartRecording { path: String, chunk_rows: u32, append: bool },
+    StopRecording,
     GetVisibility,
     GetCouldsee,
     // Function-level isolation testing (Phase 1)
@@ -71,6 +114,7 @@ enum Command {
     ClearLevel,
     AddRoom { lx: i32, ly: i32, hx: i32, hy: i32, rtype: i32 },
     CarveRoom { lx: i32, ly: i32, hx: i32, hy: i32 },
+    RunIsolationCase { case: IsolationCase },
     GetRectJson,
     DebugCell { x: i32, y: i32 },
     DebugMfndpos { mon_index: i32 },
@@ -85,35 +129,195 @@ enum Response {
     Long(u64),
     String(String),
     Bool(bool),
+    Bytes(Vec<u8>),
+    SectionProfile(Vec<SectionProfile>),
+    StepBatch(StepBatch),
+    StepDigest(CStepDigest),
+    Rollouts(Vec<RolloutOutcome>),
+    WeaponResults(Vec<CWeaponResult>),
+    IsolationResult(CaseResult),
+    Snapshot(nh_core::CGameSnapshot),
+    Monsters(Vec<nh_core::CMonsterSnapshot>),
     Error(String),
 }
 
-fn main() {
-    let mut engine = CGameEngine::new();
-    let stdin = io::stdin();
-    let mut stdout = io::stdout();
+fn parse_log_mask(s: &str) -> Option<u32> {
+    let s = s.trim();
+    match s.strip_prefix("0x") {
+        Some(hex) => u32::from_str_radix(hex, 16).ok(),
+        None => s.parse().ok(),
+    }
+}
+
+/// Where responses go: JSON lines on stdout, or frames on a private copy
+/// of stdout once the client has switched to the binary protocol.
+enum Channel {
+    Json(io::Stdout),
+    Binary(BufWriter<File>),
+}
+
+impl Channel {
+    fn send(&mut self, resp: &Response) {
+        match self {
+            Channel::Json(out) => {
+                let _ = writeln!(out, "JSON:{}", serde_json::to_string(resp).unwrap());
+                let _ = out.flush();
+            }
+            Channel::Binary(out) => {
+                let _ = wire::write_frame(out, &wire::to_vec(resp).unwrap());
+            }
+        }
+    }
 
-    for line in stdin.lock().lines() {
-        let line = match line {
-            Ok(l) => l,
-            Err(_) => break,
+    fn flush(&mut self) {
+        let _ = match self {
+            Channel::Json(out) => out.flush(),
+            Channel::Binary(out) => out.flush(),
         };
+    }
+
+    /// Move frames to a duplicate of fd 1 and point fd 1 at stderr, so
+    /// stray output from the C side cannot corrupt the stream.
+    fn binary() -> io::Result<Self> {
+        let _ = io::stdout().flush();
+        let fd = unsafe { libc::dup(libc::STDOUT_FILENO) };
+        if fd < 0 || unsafe { libc::dup2(libc::STDERR_FILENO, libc::STDOUT_FILENO) } < 0 {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(Channel::Binary(BufWriter::new(unsafe { File::from_raw_fd(fd) })))
+    }
+}
+
+/// `exec_cmds` one command at a time, so `recorder` gets a row after each
+/// executed step. Stops after the first failing command like `exec_cmds`.
+fn exec_recorded(engine: &CGameEngine, recorder: &mut EpisodeRecorder, cmds: &[u8], record: bool) -> Result<StepBatch, String> {
+    let mut batch = StepBatch::default();
+    for &cmd in cmds {
+        let step = engine.exec_cmds(&[cmd], true)?;
+        let Some(&digest) = step.digests.first() else { break };
+        recorder.record_step(engine, cmd, digest.status)?;
+        batch.executed += 1;
+        if record {
+            batch.digests.push(digest);
+        }
+        if digest.status < 0 {
+            break;
+        }
+    }
+    Ok(batch)
+}
+
+/// Wait for a forked session to finish. `None` means it ended cleanly via
+/// `EndForkSession` and has already answered the client.
+fn wait_for_session(pid: libc::pid_t) -> Option<String> {
+    let mut status = 0;
+    loop {
+        if unsafe { libc::waitpid(pid, &mut status, 0) } == pid {
+            break;
+        }
+        let err = io::Error::last_os_error();
+        if err.kind() != io::ErrorKind::Interrupted {
+            return Some(format!("waitpid failed: {}", err));
+        }
+    }
+    if libc::WIFEXITED(status) && libc::WEXITSTATUS(status) == 0 {
+        None
+    } else if libc::WIFSIGNALED(status) {
+        Some(format!("Forked session killed by signal {}", libc::WTERMSIG(status)))
+    } else {
+        Some(format!("Forked session exited with status {}", libc::WEXITSTATUS(status)))
+    }
+}
 
-        if line.trim().is_empty() { continue; }
+fn main() {
+    // Before any init: reuse the table setup recorded by an earlier worker
+    let mut startup_image = StartupImage::attach_default();
+    let mut engine = CGameEngine::new();
+    // NH_FFI_LOG_MASK=0 silences C diagnostics in debug builds too
+    if let Some(mask) = std::env::var("NH_FFI_LOG_MASK").ok().and_then(|m| parse_log_mask(&m)) {
+        engine.set_log_mask(mask);
+    }
+    let mut input = io::stdin().lock();
+    let mut out = Channel::Json(io::stdout());
+    let mut line = String::new();
+    let mut frame = Vec::new();
+    // Number of ForkSession levels this process is below the original worker
+    let mut fork_depth = 0;
+    // Target of StartRngTraceStream, kept open while C writes to it
+    let mut trace_file: Option<File> = None;
+    // Region from AttachShm; bulk results are written into it
+    let mut shm: Option<SharedRegion> = None;
+    // With NH_LEVEL_CACHE set, GenerateLevelBin reuses levels across runs.
+    // Later commands play on the level, so every hit must leave it live.
+    let mut level_cache =
+        std::env::var_os("NH_LEVEL_CACHE").map(|dir| LevelCache::persistent(dir).with_live_level());
+    // Episode file from StartRecording; every executed command adds a row
+    let mut recorder: Option<EpisodeRecorder> = None;
 
-        let cmd: Command = match serde_json::from_str(&line) {
-            Ok(c) => c,
-            Err(e) => {
-                let resp = Response::Error(format!("Invalid command: {}", e));
-                println!("JSON:{}", serde_json::to_string(&resp).unwrap());
-                continue;
+    loop {
+        let cmd: Command = match out {
+            Channel::Json(_) => {
+                line.clear();
+                match input.read_line(&mut line) {
+                    Ok(0) | Err(_) => break,
+                    Ok(_) => {}
+                }
+                if line.trim().is_empty() { continue; }
+                match serde_json::from_str(&line) {
+                    Ok(c) => c,
+                    Err(e) => {
+                        out.send(&Response::Error(format!("Invalid command: {}", e)));
+                        continue;
+                    }
+                }
+            }
+            Channel::Binary(_) => {
+                match wire::read_frame(&mut input, &mut frame) {
+                    Ok(Some(())) => {}
+                    Ok(None) | Err(_) => break,
+                }
+                match wire::from_slice(&frame) {
+                    Ok(c) => c,
+                    Err(e) => {
+                        out.send(&Response::Error(format!("Invalid command: {}", e)));
+                        continue;
+                    }
+                }
             }
         };
 
         let resp = match cmd {
+            Command::SetProtocol { binary } => {
+                match (binary, &out) {
+                    (true, Channel::Json(_)) => {
+                        // Acknowledge in the old protocol, then switch
+                        out.send(&Response::Ok);
+                        match Channel::binary() {
+                            Ok(channel) => {
+                                out = channel;
+                                continue;
+                            }
+                            // The client is already waiting for frames
+                            Err(e) => {
+                                eprintln!("nh-test-worker: cannot switch to binary protocol: {}", e);
+                                break;
+                            }
+                        }
+                    }
+                    (false, Channel::Binary(_)) => {
+                        Response::Error("Cannot switch back to JSON".to_string())
+                    }
+                    _ => Response::Ok,
+                }
+            }
             Command::Init { role, race, gender, align } => {
                 match CGameEngineTrait::init(&mut engine, &role, &race, gender, align) {
-                    Ok(_) => Response::Ok,
+                    Ok(_) => {
+                        if let Err(e) = startup_image.store() {
+                            eprintln!("Startup image not saved: {}", e);
+                        }
+                        Response::Ok
+                    }
                     Err(e) => Response::Error(e),
                 }
             }
@@ -123,6 +327,51 @@ fn main() {
                     Err(e) => Response::Error(e),
                 }
             }
+            Command::ForkSession { seed } => {
+                // Snapshot mode: the child serves the session from a
+                // copy-on-write image of this process while we wait, so
+                // every session starts from the same post-init state.
+                //
+                // The child also inherits `input`'s buffer. Both sides read
+                // commands through it, so it must be empty here: anything
+                // buffered would run in the child and again in the parent
+                // once the session ends, and whatever the child buffers
+                // past EndForkSession is lost with it. Clients therefore
+                // never send past ForkSession or EndForkSession before the
+                // reply: `CGameEngineSubprocess` waits for every reply, and
+                // `Pipeline` has neither command and holds the worker
+                // borrowed while it is in use.
+                if !engine.is_initialized() {
+                    Response::Error("Game not initialized".to_string())
+                } else {
+                    out.flush();
+                    match unsafe { libc::fork() } {
+                        -1 => Response::Error(format!("fork failed: {}", io::Error::last_os_error())),
+                        0 => {
+                            fork_depth += 1;
+                            // The parent's recording and its buffered rows stay the parent's
+                            std::mem::forget(recorder.take());
+                            match CGameEngineTrait::reset(&mut engine, seed) {
+                                Ok(_) => Response::Ok,
+                                Err(e) => Response::Error(e),
+                            }
+                        }
+                        pid => match wait_for_session(pid) {
+                            None => continue,
+                            Some(e) => Response::Error(e),
+                        },
+                    }
+                }
+            }
+            Command::EndForkSession => {
+                if fork_depth == 0 {
+                    Response::Error("Not in a forked session".to_string())
+                } else {
+                    out.send(&Response::Ok);
+                    // Skip atexit handlers inherited from the parent
+                    unsafe { libc::_exit(0) }
+                }
+            }
             Command::ResetRng { seed } => {
                 match engine.reset_rng(seed) {
                     Ok(_) => Response::Ok,
@@ -157,19 +406,62 @@ fn main() {
             }
             Command::GetTurnCount => Response::Long(CGameEngineTrait::turn_count(&engine)),
             Command::GetStateJson => Response::String(CGameEngineTrait::state_json(&engine)),
+            Command::GetSnapshot => match CGameEngineTrait::snapshot(&engine) {
+                Ok(snapshot) => Response::Snapshot(snapshot),
+                Err(e) => Response::Error(e),
+            },
+            Command::GetMonstersNear { x, y, radius } => Response::Monsters(engine.monsters_near(x, y, radius)),
             Command::GetMapJson => Response::String(engine.map_json()),
             Command::ExecCmd { cmd } => {
-                match CGameEngineTrait::exec_cmd(&engine, cmd) {
+                let result = match recorder.as_mut() {
+                    Some(recorder) => exec_recorded(&engine, recorder, &[cmd as u8], true).and_then(|batch| {
+                        match batch.digests.first().map(|d| d.status) {
+                            Some(-2) => Err("Player died".to_string()),
+                            Some(status) if status < 0 => Err(format!("Command failed: {}", cmd)),
+                            _ => Ok(()),
+                        }
+                    }),
+                    None => CGameEngineTrait::exec_cmd(&engine, cmd),
+                };
+                match result {
                     Ok(_) => Response::Ok,
                     Err(e) => Response::Error(e),
                 }
             }
             Command::ExecCmdDir { cmd, dx, dy } => {
-                match CGameEngineTrait::exec_cmd_dir(&engine, cmd, dx, dy) {
+                let mut result = CGameEngineTrait::exec_cmd_dir(&engine, cmd, dx, dy);
+                if let Some(recorder) = recorder.as_mut() {
+                    let status = match &result {
+                        Ok(_) => 0,
+                        Err(_) if CGameEngineTrait::is_dead(&engine) => -2,
+                        Err(_) => -1,
+                    };
+                    if let Err(e) = recorder.record_step(&engine, cmd as u8, status) {
+                        result = Err(e);
+                    }
+                }
+                match result {
                     Ok(_) => Response::Ok,
                     Err(e) => Response::Error(e),
                 }
             }
+            Command::ExecCmds { cmds, record } => {
+                let result = match recorder.as_mut() {
+                    Some(recorder) => exec_recorded(&engine, recorder, cmds.as_bytes(), record),
+                    None => engine.exec_cmds(cmds.as_bytes(), record),
+                };
+                match result {
+                    Ok(batch) => Response::StepBatch(batch),
+                    Err(e) => Response::Error(e),
+                }
+            }
+            Command::GetStepDigest => Response::StepDigest(engine.step_digest()),
+            Command::Rollout { seed, policy, max_turns, count } => {
+                match engine.rollout(seed, policy, max_turns, count as usize) {
+                    Ok(outcomes) => Response::Rollouts(outcomes),
+                    Err(e) => Response::Error(e),
+                }
+            }
             Command::SetDLevel { dnum, dlevel } => {
                 engine.set_dlevel(dnum, dlevel);
                 Response::Ok
@@ -188,6 +480,10 @@ fn main() {
             Command::GetInventoryCount => Response::Int(engine.inventory_count()),
             Command::GetInventoryJson => Response::String(CGameEngineTrait::inventory_json(&engine)),
             Command::GetObjectTableJson => Response::String(engine.object_table_json()),
+            Command::GetStaticTables => match static_tables::export_static_tables() {
+                Ok(tables) => Response::Bytes(tables),
+                Err(e) => Response::Error(e),
+            },
             Command::GetMonstersJson => Response::String(CGameEngineTrait::monsters_json(&engine)),
             Command::SetWizardMode { enable } => {
                 engine.set_wizard_mode(enable);
@@ -211,10 +507,21 @@ fn main() {
                 engine.set_skip_movemon(skip);
                 Response::Ok
             }
+            Command::GetSectionProfile => Response::SectionProfile(engine.section_profile()),
+            Command::ResetSectionProfile => {
+                engine.reset_section_profile();
+                Response::Ok
+            }
+            Command::SetLogMask { mask } => Response::Int(engine.set_log_mask(mask) as i32),
+            Command::SetHeadless { flags } => Response::Int(engine.set_headless(flags) as i32),
             Command::RngRn2 { limit } => Response::Int(engine.rng_rn2(limit)),
             Command::CalcBaseDamage { weapon_id, small_monster } => {
                 Response::Int(engine.calc_base_damage(weapon_id, small_monster))
             }
+            Command::CalcWeaponBatch { queries } => match engine.calc_weapon_batch(&queries) {
+                Ok(results) => Response::WeaponResults(results),
+                Err(e) => Response::Error(e),
+            },
             Command::GetAc => Response::Int(engine.ac()),
             Command::TestSetupStatus { hp, max_hp, level, ac } => {
                 engine.test_setup_status(hp, max_hp, level, ac);
@@ -229,6 +536,72 @@ fn main() {
             Command::GetNutrition => Response::Int(engine.nutrition()),
             Command::GetAttributesJson => Response::String(engine.attributes_json()),
             Command::ExportLevel => Response::String(CGameEngineTrait::export_level(&engine)),
+            Command::ExportLevelBin => match engine.export_level_bin() {
+                Ok(export) => Response::Bytes(export.as_bytes().to_vec()),
+                Err(e) => Response::Error(e),
+            },
+            Command::ExportLevelDelta => match engine.export_level_delta() {
+                Ok(delta) => Response::Bytes(delta.as_bytes().to_vec()),
+                Err(e) => Response::Error(e),
+            },
+            Command::ResetLevelDelta => {
+                engine.reset_level_delta();
+                Response::Ok
+            }
+            Command::ExportGrid => match engine.export_grid_bytes() {
+                Ok(grid) => Response::Bytes(grid),
+                Err(e) => Response::Error(e),
+            },
+            Command::GenerateLevelBin { seed, dnum, dlevel } => {
+                let generated = match level_cache.as_mut() {
+                    Some(cache) => cache.generate(&engine, seed, dnum, dlevel).map(|(export, _)| export),
+                    None => {
+                        engine.set_dlevel(dnum, dlevel);
+                        engine
+                            .reset_rng(seed)
+                            .and_then(|()| engine.generate_level())
+                            .and_then(|()| engine.export_level_bin())
+                    }
+                };
+                match generated {
+                    Ok(export) => Response::Bytes(export.as_bytes().to_vec()),
+                    Err(e) => Response::Error(e),
+                }
+            }
+            Command::Checkpoint => match engine.checkpoint() {
+                Ok(checkpoint) => Response::Bytes(checkpoint),
+                Err(e) => Response::Error(e),
+            },
+            Command::Restore { checkpoint } => match engine.restore(&checkpoint) {
+                Ok(()) => Response::Ok,
+                Err(e) => Response::Error(e),
+            },
+            Command::AttachShm { path, size } => match SharedRegion::open(Path::new(&path), size as usize) {
+                Ok(region) => {
+                    shm.replace(region);
+                    Response::Ok
+                }
+                Err(e) => Response::Error(format!("Cannot map {}: {}", path, e)),
+            },
+            Command::ShmExportLevelBin => match shm.as_mut() {
+                Some(region) => {
+                    let len = region.len() - SHM_LEVEL_OFFSET;
+                    let out = region.bytes_mut(SHM_LEVEL_OFFSET, len).unwrap();
+                    match engine.export_level_bin_into(out) {
+                        Ok(n) => Response::Long(n as u64),
+                        Err(e) => Response::Error(e),
+                    }
+                }
+                None => Response::Error("No shared memory attached".to_string()),
+            },
+            Command::ShmSight => match shm.as_mut() {
+                Some(region) => {
+                    engine.visibility_into(region.bytes_mut(SHM_VISIBILITY_OFFSET, NH_COLNO * NH_ROWNO).unwrap());
+                    engine.couldsee_into(region.bytes_mut(SHM_COULDSEE_OFFSET, NH_COLNO * NH_ROWNO).unwrap());
+                    Response::Ok
+                }
+                None => Response::Error("No shared memory attached".to_string()),
+            },
             Command::EnableRngTracing => {
                 engine.enable_rng_tracing();
                 Response::Ok
@@ -242,8 +615,53 @@ fn main() {
                 engine.clear_rng_trace();
                 Response::Ok
             }
-            Command::GetVisibility => Response::String(serde_json::to_string(&engine.get_visibility()).unwrap()),
-            Command::GetCouldsee => Response::String(serde_json::to_string(&engine.get_couldsee()).unwrap()),
+            Command::ResetRngHash => {
+                engine.reset_rng_hash();
+                Response::Ok
+            }
+            Command::StartRngTraceStream { path } => match File::create(&path) {
+                Ok(file) => match engine.start_rng_trace_stream(file.as_raw_fd()) {
+                    Ok(()) => {
+                        trace_file.replace(file);
+                        Response::Ok
+                    }
+                    Err(e) => Response::Error(e),
+                },
+                Err(e) => Response::Error(format!("Cannot create {}: {}", path, e)),
+            },
+            Command::StopRngTraceStream => {
+                let result = engine.stop_rng_trace_stream();
+                trace_file.take();
+                match result {
+                    Ok(n) => Response::Long(n),
+                    Err(e) => Response::Error(e),
+                }
+            }
+            Command::StartRecording { path, chunk_rows, append } => {
+                let path = Path::new(&path);
+                let chunk_rows = chunk_rows as usize;
+                let opened = if append {
+                    EpisodeRecorder::append(path, chunk_rows)
+                } else {
+                    EpisodeRecorder::create(path, chunk_rows)
+                };
+                match opened {
+                    Ok(new) => match recorder.replace(new).map(EpisodeRecorder::finish) {
+                        Some(Err(e)) => Response::Error(e),
+                        _ => Response::Ok,
+                    },
+                    Err(e) => Response::Error(e),
+                }
+            }
+            Command::StopRecording => match recorder.take() {
+                Some(recorder) => match recorder.finish() {
+                    Ok(rows) => Response::Long(rows),
+                    Err(e) => Response::Error(e),
+                },
+                None => Response::Error("Not recording".to_string()),
+            },
+            Command::GetVisibility => Response::Bytes(engine.visibility_bytes()),
+            Command::GetCouldsee => Response::Bytes(engine.couldsee_bytes()),
             Command::TestFinddpos { xl, yl, xh, yh } => {
                 let (x, y) = engine.test_finddpos(xl, yl, xh, yh);
                 Response::Pos(x, y)
@@ -275,13 +693,16 @@ fn main() {
                 engine.carve_room(lx, ly, hx, hy);
                 Response::Ok
             }
+            Command::RunIsolationCase { case } => match isolation::run_c_case(&engine, &case) {
+                Ok(result) => Response::IsolationResult(result),
+                Err(e) => Response::Error(e),
+            },
             Command::GetRectJson => Response::String(engine.rect_json()),
             Command::DebugCell { x, y } => Response::String(engine.debug_cell(x, y)),
             Command::DebugMfndpos { mon_index } => Response::String(engine.debug_mfndpos(mon_index)),
             Command::Exit => break,
         };
 
-        println!("JSON:{}", serde_json::to_string(&resp).unwrap());
-        let _ = stdout.flush();
+        out.send(&resp);
     }
 }
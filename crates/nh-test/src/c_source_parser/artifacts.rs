@@ -16,8 +16,12 @@ pub struct CArtifact {
     pub race: String,
 }
 
-/// Extract artifact names from C artilist.h
+/// Extract artifact names, from the static tables cache when available,
+/// else from C artilist.h
 pub fn extract_artifact_names() -> Vec<String> {
+    if let Some(cache) = crate::ffi::static_tables::cached() {
+        return cache.tables().artifacts().filter_map(|a| a.name).map(str::to_string).collect();
+    }
     let artilist_h = Path::new(super::NETHACK_SRC).join("include/artilist.h");
 
     if !artilist_h.exists() {
@@ -104,8 +104,12 @@ pub fn load_c_monsters() -> Vec<CMonster> {
     monsters
 }
 
-/// Extract just monster names from C source for basic comparison
+/// Extract just monster names for basic comparison, from the static tables
+/// cache when the linked library exports one, else from the C source
 pub fn extract_monster_names() -> Vec<String> {
+    if let Some(cache) = crate::ffi::static_tables::cached() {
+        return cache.tables().monsters().map(|m| m.name.to_string()).collect();
+    }
     let monst_c = Path::new(super::NETHACK_SRC).join("src/monst.c");
 
     if !monst_c.exists() {
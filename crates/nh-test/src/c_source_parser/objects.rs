@@ -18,8 +18,19 @@ pub struct CObject {
     pub material: String,
 }
 
-/// Extract object names from C source
+/// Extract object names, from the static tables cache when available,
+/// else from the C source
 pub fn extract_object_names() -> Vec<String> {
+    if let Some(cache) = crate::ffi::static_tables::cached() {
+        // objects[0] is the "strange object" placeholder no macro defines
+        return cache
+            .tables()
+            .objects()
+            .skip(1)
+            .filter_map(|o| o.name.filter(|name| !name.is_empty()))
+            .map(str::to_string)
+            .collect();
+    }
     let objects_c = Path::new(super::NETHACK_SRC).join("src/objects.c");
 
     if !objects_c.exists() {
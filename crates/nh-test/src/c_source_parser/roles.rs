@@ -37,8 +37,12 @@ const KNOWN_ROLES: [&str; 13] = [
     "Wizard",
 ];
 
-/// Extract role names from C role.c
+/// Extract role names, from the static tables cache when available, else
+/// from C role.c
 pub fn extract_role_names() -> Vec<String> {
+    if let Some(cache) = crate::ffi::static_tables::cached() {
+        return cache.tables().roles().map(|r| r.name.to_string()).collect();
+    }
     // The C code has a complex nested structure where both role names
     // and rank titles use { "Name", ... } pattern.
     // We use the known roles list to filter correctly.
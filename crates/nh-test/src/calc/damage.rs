@@ -1,10 +1,16 @@
 //! Damage dice comparison
 //!
 //! Verifies that damage dice rolling (d(n,x)) produces identical results
-//! between C and Rust implementations when using the same RNG seed.
+//! between C and Rust implementations when using the same RNG seed, and
+//! that nh-core's dmgval() and hitval() over the whole object table match
+//! the game's, as the C weapon calculator runs them.
 
 use crate::Isaac64;
 use crate::ffi::CIsaac64;
+use nh_core::data::monsters::MONSTERS;
+use nh_core::data::objects::{OBJECTS, P_NONE};
+use nh_core::monster::{Monster, MonsterId};
+use nh_core::object::{Object, ObjectClass, ObjectId};
 
 /// Compare dice rolling between Rust and C implementations
 ///
@@ -30,9 +36,37 @@ fn c_dice(rng: &mut CIsaac64, n: u32, x: u32) -> u32 {
     result
 }
 
+/// A pristine object of `OBJECTS[otyp]`, as mkobj() makes it before any
+/// enchantment or erosion
+pub fn pristine_object(otyp: usize) -> Object {
+    let def = &OBJECTS[otyp];
+    let mut obj = Object::new(ObjectId(1), otyp as i16, def.class);
+    obj.weight = def.weight as u32;
+    if def.class == ObjectClass::Weapon {
+        obj.damage_dice = 1;
+        obj.damage_sides = def.w_small_damage;
+        obj.weapon_tohit = def.bonus;
+    }
+    obj
+}
+
+/// The plain target the C weapon calculator uses: a jackal, or an ogre for
+/// a large one
+pub fn plain_target(large: bool) -> Monster {
+    let name = if large { "ogre" } else { "jackal" };
+    let mtyp = MONSTERS.iter().position(|m| m.name == name).unwrap();
+    Monster::new(MonsterId(1), mtyp as i16, 0, 0)
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
+    use crate::ffi::CGameEngine;
+    use crate::ffi::game_engine::{CWeaponQuery, NH_FFI_WEAPON_OK, NH_FFI_WEAPON_UNKNOWN};
+    use nh_core::CGameEngineTrait;
+    use nh_core::combat::uhitm::{dmgval, hitval};
+    use nh_core::rng::GameRng;
+    use serial_test::serial;
 
     #[test]
     fn test_dice_single_die() {
@@ -151,4 +185,120 @@ mod tests {
             );
         }
     }
+
+    #[test]
+    #[serial]
+    fn test_weapon_batch_matches_object_table() {
+        let mut engine = CGameEngine::new();
+        engine.init("Valkyrie", "Human", 1, 1).unwrap();
+        let table: Vec<serde_json::Value> = serde_json::from_str(&engine.object_table_json()).unwrap();
+        if table.is_empty() {
+            // No objects[] in the stub library
+            let r = engine.calc_weapon_batch(&[CWeaponQuery::default()]).unwrap();
+            assert_eq!(r[0].status, NH_FFI_WEAPON_UNKNOWN);
+            return;
+        }
+
+        // Every C object, both target sizes, a few enchantments: one FFI call
+        let mut queries = Vec::new();
+        for entry in &table {
+            for large in [0u8, 1] {
+                for enchantment in [-5, 0, 3] {
+                    queries.push(CWeaponQuery {
+                        weapon_id: entry["index"].as_i64().unwrap() as i32,
+                        enchantment,
+                        to_hit: 8,
+                        samples: 64,
+                        seed: 42 + queries.len() as u64,
+                        large,
+                        exact: 1,
+                        ..Default::default()
+                    });
+                }
+            }
+        }
+        let results = engine.calc_weapon_batch(&queries).unwrap();
+        assert_eq!(results.len(), queries.len());
+
+        for (i, (q, r)) in queries.iter().zip(&results).enumerate() {
+            // The C and Rust tables are not in step, so match them by name
+            let name = table[i / 6]["name"].as_str().unwrap();
+            assert_eq!(r.status, NH_FFI_WEAPON_OK, "{} {:?}", name, q);
+            let Some(otyp) = OBJECTS.iter().position(|o| o.name == name) else {
+                assert_eq!(r.outcomes, 1, "{} rolls dice in C but has no Rust entry", name);
+                continue;
+            };
+
+            let def = &OBJECTS[otyp];
+            let mut obj = pristine_object(otyp);
+            obj.enchantment = q.enchantment as i8;
+            let target = plain_target(q.large != 0);
+
+            // oc_hitbon shares its field with armor AC, and the tables
+            // differ there, so only weapons and weapon-tools say
+            if def.class == ObjectClass::Weapon
+                || (def.class == ObjectClass::Tool && def.skill != P_NONE)
+            {
+                assert_eq!(r.hit_bonus, hitval(&obj, &target), "{} {:?}", name, q);
+            }
+            let total = q.to_hit + r.hit_bonus;
+            assert_eq!(r.hit_faces, (total - 1).clamp(0, 20) as u32);
+
+            let exact = &r.exact[..r.bins()];
+            assert_eq!(r.outcomes, exact.iter().sum::<u32>());
+            assert!(exact[0] > 0 && exact[r.bins() - 1] > 0, "{} {:?}", name, q);
+
+            // The samples replay through nh-core with the same seed
+            let mut rng = GameRng::new(q.seed);
+            let mut sampled = vec![0u32; r.bins()];
+            for _ in 0..q.samples {
+                if total > rng.rnd(20) as i32 {
+                    let dmg = dmgval(&obj, def.material, &target, q.large != 0, &mut rng);
+                    assert!((r.dmg_min..=r.dmg_max).contains(&dmg), "{} {:?}: {}", name, q, dmg);
+                    let bin = (dmg - r.dmg_min) as usize;
+                    assert!(exact[bin] > 0, "{} {:?}: {} is not a C outcome", name, q, dmg);
+                    sampled[bin] += 1;
+                }
+            }
+            assert_eq!(&r.sampled[..r.bins()], &sampled[..], "{} {:?}", name, q);
+            assert_eq!(r.hits, sampled.iter().sum::<u32>());
+        }
+    }
+
+    #[test]
+    #[serial]
+    fn test_gem_ammo_ignores_enchantment() {
+        // dmgval() and hitval() add spe only when Is_weapon: a +3 flint
+        // stone still does d6 and gets no to-hit bonus
+        let flint = OBJECTS.iter().position(|o| o.name == "flint").unwrap();
+        let mut obj = pristine_object(flint);
+        obj.enchantment = 3;
+        let target = plain_target(false);
+        assert_eq!(hitval(&obj, &target), 0);
+        let mut rng = GameRng::new(42);
+        for _ in 0..200 {
+            let dmg = dmgval(&obj, OBJECTS[flint].material, &target, false, &mut rng);
+            assert!((1..=6).contains(&dmg), "+3 flint did {}", dmg);
+        }
+
+        let mut engine = CGameEngine::new();
+        engine.init("Valkyrie", "Human", 1, 1).unwrap();
+        let table: Vec<serde_json::Value> = serde_json::from_str(&engine.object_table_json()).unwrap();
+        let Some(entry) = table.iter().find(|e| e["name"] == "flint") else {
+            return; // No objects[] in the stub library
+        };
+        let query = CWeaponQuery {
+            weapon_id: entry["index"].as_i64().unwrap() as i32,
+            enchantment: 3,
+            to_hit: 8,
+            exact: 1,
+            ..Default::default()
+        };
+        let r = engine.calc_weapon_batch(&[query]).unwrap()[0];
+        assert_eq!(r.status, NH_FFI_WEAPON_OK);
+        assert_eq!((r.dmg_min, r.dmg_max), (1, 6));
+        assert_eq!(&r.exact[..r.bins()], &[1; 6]);
+        assert_eq!(r.hit_bonus, 0);
+        assert_eq!(r.hit_faces, 7);
+    }
 }
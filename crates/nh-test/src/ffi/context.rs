@@ -0,0 +1,120 @@
+//! Multiple C games in one process.
+//!
+//! The C engine keeps a game in process globals, so only one game can be
+//! live at a time. A `CGameContext` holds a parked game; `with()` swaps it
+//! in, runs a closure against it and swaps the default game back. Contexts
+//! are `Send`, so a thread pool can own one per seed; the swaps are
+//! serialized by a process-wide lock.
+
+use std::mem::ManuallyDrop;
+use std::ptr::NonNull;
+use std::sync::Mutex;
+
+use libc::c_int;
+
+use super::game_engine::CGameEngine;
+
+/// Opaque `struct nh_ffi_ctx`
+#[repr(C)]
+pub struct NhFfiCtx {
+    _private: [u8; 0],
+}
+
+unsafe extern "C" {
+    fn nh_ffi_ctx_new() -> *mut NhFfiCtx;
+    fn nh_ffi_ctx_free(ctx: *mut NhFfiCtx);
+    fn nh_ffi_ctx_switch(ctx: *mut NhFfiCtx) -> c_int;
+}
+
+/// Serializes every context switch and the work done while a context is live
+static CONTEXT_LOCK: Mutex<()> = Mutex::new(());
+
+/// A parked C game
+pub struct CGameContext {
+    raw: NonNull<NhFfiCtx>,
+}
+
+// The handle is only dereferenced by C while CONTEXT_LOCK is held.
+unsafe impl Send for CGameContext {}
+
+impl CGameContext {
+    /// Create an empty context; initialize a game inside `with()`.
+    pub fn new() -> Result<Self, String> {
+        let raw = unsafe { nh_ffi_ctx_new() };
+        NonNull::new(raw)
+            .map(|raw| Self { raw })
+            .ok_or_else(|| "Failed to allocate game context".to_string())
+    }
+
+    /// Make this context live for the duration of `f`.
+    ///
+    /// The engine handed to `f` borrows the context's game; it is not freed
+    /// when `f` returns, so the game is still there on the next call.
+    pub fn with<R>(&mut self, f: impl FnOnce(&mut CGameEngine) -> R) -> Result<R, String> {
+        let _lock = CONTEXT_LOCK.lock().unwrap_or_else(|e| e.into_inner());
+
+        let live = unsafe { nh_ffi_ctx_switch(self.raw.as_ptr()) };
+        if live < 0 {
+            return Err("Failed to park the live game".to_string());
+        }
+        let _restore = RestoreDefault;
+
+        let mut engine = ManuallyDrop::new(CGameEngine::attached(live == 1));
+        Ok(f(&mut engine))
+    }
+}
+
+impl Drop for CGameContext {
+    fn drop(&mut self) {
+        let _lock = CONTEXT_LOCK.lock().unwrap_or_else(|e| e.into_inner());
+        unsafe { nh_ffi_ctx_free(self.raw.as_ptr()) };
+    }
+}
+
+/// Switches back to the default context, also when the closure panics
+struct RestoreDefault;
+
+impl Drop for RestoreDefault {
+    fn drop(&mut self) {
+        unsafe { nh_ffi_ctx_switch(std::ptr::null_mut()) };
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use nh_core::CGameEngineTrait;
+    use serial_test::serial;
+
+    #[test]
+    #[serial]
+    fn test_contexts_are_independent() {
+        let mut a = CGameContext::new().unwrap();
+        let mut b = CGameContext::new().unwrap();
+
+        a.with(|engine| {
+            assert!(!engine.is_initialized());
+            engine.init("Valkyrie", "Human", 1, 1).unwrap();
+            engine.reset(1).unwrap();
+        })
+        .unwrap();
+        b.with(|engine| {
+            engine.init("Wizard", "Elf", 0, 0).unwrap();
+            engine.reset(2).unwrap();
+        })
+        .unwrap();
+
+        let role_a = a.with(|engine| engine.role()).unwrap();
+        let role_b = b.with(|engine| engine.role()).unwrap();
+        assert_eq!(role_a, "Valkyrie");
+        assert_eq!(role_b, "Wizard");
+
+        // Moving in one context leaves the other untouched
+        let before = b.with(|engine| engine.position()).unwrap();
+        a.with(|engine| {
+            let _ = engine.exec_cmd('l');
+        })
+        .unwrap();
+        assert_eq!(b.with(|engine| engine.position()).unwrap(), before);
+    }
+}
@@ -3,8 +3,10 @@
 //! Provides extern fn declarations and a safe `CGameEngine` wrapper
 //! for comparison testing with the Rust nethack-rs implementation.
 
-use libc::{c_char, c_int, c_long, c_ulong, c_void};
+use libc::{c_char, c_int, c_long, c_uint, c_ulong, c_void};
+use serde::{Deserialize, Serialize};
 use std::ffi::{CStr, CString};
+use std::os::fd::RawFd;
 
 // ============================================================================
 // C Structures (must match C definitions)
@@ -19,41 +21,1060 @@ pub const NH_MAX_MONSTERS: usize = 100;
 /// Max dungeon levels
 pub const NH_MAX_DUNGEON_LEVELS: usize = 30;
 
+/// Map size (COLNO x ROWNO)
+pub const NH_COLNO: usize = 80;
+pub const NH_ROWNO: usize = 21;
+
+/// `[x][y]` grid from a flat `x * ROWNO + y` sight array.
+pub fn sight_grid(flat: &[u8]) -> Vec<Vec<bool>> {
+    flat.chunks(NH_ROWNO)
+        .map(|col| col.iter().map(|&b| b != 0).collect())
+        .collect()
+}
+
+// ============================================================================
+// Structured State (must match nethack_src/nethack_ffi_types.h)
+// ============================================================================
+
+pub const NH_FFI_NAME_LEN: usize = 128;
+
 #[repr(C)]
+#[derive(Debug, Clone, Copy, Default)]
+pub struct CGameState {
+    pub hp: i32,
+    pub hp_max: i32,
+    pub energy: i32,
+    pub energy_max: i32,
+    pub x: i32,
+    pub y: i32,
+    pub level: i32,
+    pub experience_level: i32,
+    pub armor_class: i32,
+    pub gold: i32,
+    pub strength: i32,
+    pub dexterity: i32,
+    pub constitution: i32,
+    pub intelligence: i32,
+    pub wisdom: i32,
+    pub charisma: i32,
+    pub is_dead: u8,
+    pub hunger_state: i32,
+    pub turn_count: u64,
+    pub dungeon_depth: i32,
+    pub monster_count: i32,
+}
+
+const _: () = assert!(std::mem::size_of::<CGameState>() == 88);
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
 pub struct CObject {
-    pub name: [c_char; 64],
-    pub class_: c_char,
-    pub weight: c_int,
-    pub value: c_int,
-    pub quantity: c_int,
-    pub enchantment: c_int,
-    pub cursed: c_int,
-    pub blessed: c_int,
-    pub armor_class: c_int,
-    pub damage: c_int,
+    pub name: [c_char; NH_FFI_NAME_LEN],
+    pub obj_class: c_char,
+    pub weight: i32,
+    pub value: i32,
+    pub quantity: i32,
+    pub enchantment: i32,
+    pub cursed: u8,
+    pub blessed: u8,
+    pub armor_class: i32,
+    pub damage: i32,
     pub inv_letter: c_char,
-    pub x: c_int,
-    pub y: c_int,
-    pub recharged: c_int,
-    pub poisoned: c_int,
-    pub otyp: c_int,
 }
 
+const _: () = assert!(std::mem::size_of::<CObject>() == 164);
+
 #[repr(C)]
+#[derive(Debug, Clone, Copy)]
 pub struct CMonster {
-    pub name: [c_char; 64],
+    pub name: [c_char; NH_FFI_NAME_LEN],
     pub symbol: c_char,
-    pub level: c_int,
-    pub hp: c_int,
-    pub max_hp: c_int,
-    pub armor_class: c_int,
-    pub x: c_int,
-    pub y: c_int,
-    pub asleep: c_int,
-    pub peaceful: c_int,
-    pub strategy: c_ulong,
+    pub level: i32,
+    pub hp: i32,
+    pub max_hp: i32,
+    pub armor_class: i32,
+    pub x: i32,
+    pub y: i32,
+    pub asleep: u8,
+    pub peaceful: u8,
+}
+
+const _: () = assert!(std::mem::size_of::<CMonster>() == 160);
+
+impl Default for CObject {
+    fn default() -> Self {
+        // All-zero is a valid empty record
+        unsafe { std::mem::zeroed() }
+    }
+}
+
+impl Default for CMonster {
+    fn default() -> Self {
+        unsafe { std::mem::zeroed() }
+    }
+}
+
+fn c_name(name: &[c_char; NH_FFI_NAME_LEN]) -> String {
+    let bytes: Vec<u8> = name.iter().take_while(|&&c| c != 0).map(|&c| c as u8).collect();
+    String::from_utf8_lossy(&bytes).into_owned()
+}
+
+impl From<&CGameState> for nh_core::CGameSnapshot {
+    fn from(s: &CGameState) -> Self {
+        Self {
+            hp: s.hp,
+            hp_max: s.hp_max,
+            energy: s.energy,
+            energy_max: s.energy_max,
+            x: s.x,
+            y: s.y,
+            level: s.level,
+            experience_level: s.experience_level,
+            armor_class: s.armor_class,
+            gold: s.gold,
+            strength: s.strength,
+            dexterity: s.dexterity,
+            constitution: s.constitution,
+            intelligence: s.intelligence,
+            wisdom: s.wisdom,
+            charisma: s.charisma,
+            is_dead: s.is_dead != 0,
+            hunger_state: s.hunger_state,
+            turn_count: s.turn_count,
+            dungeon_depth: s.dungeon_depth,
+            monster_count: s.monster_count,
+            inventory: Vec::new(),
+            monsters: Vec::new(),
+        }
+    }
+}
+
+impl From<&CObject> for nh_core::CObjectSnapshot {
+    fn from(o: &CObject) -> Self {
+        Self {
+            name: c_name(&o.name),
+            obj_class: o.obj_class as u8 as char,
+            weight: o.weight,
+            value: o.value,
+            quantity: o.quantity,
+            enchantment: o.enchantment,
+            cursed: o.cursed != 0,
+            blessed: o.blessed != 0,
+            armor_class: o.armor_class,
+            damage: o.damage,
+            inv_letter: o.inv_letter as u8 as char,
+        }
+    }
+}
+
+impl From<&CMonster> for nh_core::CMonsterSnapshot {
+    fn from(m: &CMonster) -> Self {
+        Self {
+            name: c_name(&m.name),
+            symbol: m.symbol as u8 as char,
+            level: m.level,
+            hp: m.hp,
+            max_hp: m.max_hp,
+            armor_class: m.armor_class,
+            x: m.x,
+            y: m.y,
+            asleep: m.asleep != 0,
+            peaceful: m.peaceful != 0,
+        }
+    }
+}
+
+// ============================================================================
+// Binary Level Export (must match nethack_src/nethack_ffi_types.h)
+// ============================================================================
+
+/// "NHVL" little-endian
+pub const NH_FFI_LEVEL_MAGIC: u32 = 0x4C56_484E;
+pub const NH_FFI_LEVEL_VERSION: u16 = 1;
+
+pub const NH_FFI_LEVEL_F_SHOP: u16 = 0x0001;
+pub const NH_FFI_LEVEL_F_VAULT: u16 = 0x0002;
+pub const NH_FFI_LEVEL_F_ZOO: u16 = 0x0004;
+pub const NH_FFI_LEVEL_F_COURT: u16 = 0x0008;
+pub const NH_FFI_LEVEL_F_MORGUE: u16 = 0x0010;
+pub const NH_FFI_LEVEL_F_BEEHIVE: u16 = 0x0020;
+pub const NH_FFI_LEVEL_F_BARRACKS: u16 = 0x0040;
+pub const NH_FFI_LEVEL_F_TEMPLE: u16 = 0x0080;
+pub const NH_FFI_LEVEL_F_SWAMP: u16 = 0x0100;
+pub const NH_FFI_LEVEL_F_MAZE: u16 = 0x0200;
+pub const NH_FFI_LEVEL_F_CORRMAZE: u16 = 0x0400;
+
+pub const NH_FFI_STAIR_STAIRS: u8 = 0;
+pub const NH_FFI_STAIR_LADDER: u8 = 1;
+pub const NH_FFI_STAIR_BRANCH: u8 = 2;
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct CLevelHeader {
+    pub magic: u32,
+    pub version: u16,
+    pub header_size: u16,
+    pub total_size: u32,
+    pub width: u8,
+    pub height: u8,
+    pub dnum: i8,
+    pub dlevel: i8,
+    pub ncells: u16,
+    pub nrooms: u16,
+    pub nstairs: u16,
+    pub nobjects: u16,
+    pub nmonsters: u16,
+    pub flags: u16,
+    pub nfountains: u8,
+    pub nsinks: u8,
+    pub reserved: u16,
+    pub cells_offset: u32,
+    pub rooms_offset: u32,
+    pub stairs_offset: u32,
+    pub objects_offset: u32,
+    pub monsters_offset: u32,
+}
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct CLevelCell {
+    pub typ: u8,
+    pub lit: u8,
+    pub doormask: u8,
+    pub roomno: u8,
+}
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct CLevelRoom {
+    pub lx: i8,
+    pub hx: i8,
+    pub ly: i8,
+    pub hy: i8,
+    pub rtype: i8,
+    pub rlit: i8,
+    pub doorct: i8,
+    pub nsubrooms: i8,
+}
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct CLevelStair {
+    pub x: u8,
+    pub y: u8,
+    /// 1 = up, -1 = down
+    pub dir: i8,
+    pub kind: u8,
+}
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct CLevelObject {
+    pub otyp: i16,
+    pub x: u8,
+    pub y: u8,
+    pub quan: i32,
+    pub spe: i8,
+    /// 1 blessed, 0 uncursed, -1 cursed
+    pub buc: i8,
+    pub oclass: u8,
+    pub reserved: u8,
+    pub o_id: u32,
+}
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct CLevelMonster {
+    pub mnum: i16,
+    pub x: u8,
+    pub y: u8,
+    pub hp: i32,
+    pub hpmax: i32,
+    pub peaceful: u8,
+    pub asleep: u8,
+    pub mmove: i8,
+    pub mspeed: u8,
+    pub m_id: u32,
+}
+
+const _: () = {
+    assert!(std::mem::size_of::<CLevelHeader>() == 52);
+    assert!(std::mem::size_of::<CLevelCell>() == 4);
+    assert!(std::mem::size_of::<CLevelRoom>() == 8);
+    assert!(std::mem::size_of::<CLevelStair>() == 4);
+    assert!(std::mem::size_of::<CLevelObject>() == 16);
+    assert!(std::mem::size_of::<CLevelMonster>() == 20);
+};
+
+/// Owned, validated copy of a binary level export.
+///
+/// The bytes are kept in a `u32` backing store so the record slices can be
+/// borrowed in place; two exports compare equal when their bytes do.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct CLevelExport {
+    words: Vec<u32>,
+    len: usize,
+}
+
+impl CLevelExport {
+    /// Copy and validate an export produced by `nh_ffi_export_level_bin`.
+    pub fn from_bytes(bytes: &[u8]) -> Result<Self, String> {
+        let mut words = vec![0u32; bytes.len().div_ceil(4)];
+        unsafe {
+            std::ptr::copy_nonoverlapping(bytes.as_ptr(), words.as_mut_ptr() as *mut u8, bytes.len());
+        }
+        let export = Self { words, len: bytes.len() };
+        export.validate()?;
+        Ok(export)
+    }
+
+    fn validate(&self) -> Result<(), String> {
+        let hdr_size = std::mem::size_of::<CLevelHeader>();
+        if self.len < hdr_size {
+            return Err(format!("Level export too short: {} bytes", self.len));
+        }
+        let hdr = self.header();
+        if hdr.magic != NH_FFI_LEVEL_MAGIC {
+            return Err(format!("Bad level export magic: {:#x}", hdr.magic));
+        }
+        if hdr.version != NH_FFI_LEVEL_VERSION || hdr.header_size as usize != hdr_size {
+            return Err(format!(
+                "Unsupported level export version {} (header {} bytes)",
+                hdr.version, hdr.header_size
+            ));
+        }
+        if hdr.total_size as usize > self.len {
+            return Err(format!(
+                "Level export truncated: {} of {} bytes",
+                self.len, hdr.total_size
+            ));
+        }
+        let sections = [
+            (hdr.cells_offset, hdr.ncells as usize * std::mem::size_of::<CLevelCell>()),
+            (hdr.rooms_offset, hdr.nrooms as usize * std::mem::size_of::<CLevelRoom>()),
+            (hdr.stairs_offset, hdr.nstairs as usize * std::mem::size_of::<CLevelStair>()),
+            (hdr.objects_offset, hdr.nobjects as usize * std::mem::size_of::<CLevelObject>()),
+            (hdr.monsters_offset, hdr.nmonsters as usize * std::mem::size_of::<CLevelMonster>()),
+        ];
+        for (offset, size) in sections {
+            if offset % 4 != 0 || offset as usize + size > hdr.total_size as usize {
+                return Err(format!("Bad level export section at {} ({} bytes)", offset, size));
+            }
+        }
+        if hdr.ncells != 0 && hdr.ncells as usize != hdr.width as usize * hdr.height as usize {
+            return Err(format!(
+                "Level export has {} cells for {}x{}",
+                hdr.ncells, hdr.width, hdr.height
+            ));
+        }
+        Ok(())
+    }
+
+    fn section<T>(&self, offset: u32, count: u16) -> &[T] {
+        // Offsets and sizes were checked in validate(); every record type is
+        // at most 4-byte aligned.
+        unsafe {
+            let base = (self.words.as_ptr() as *const u8).add(offset as usize) as *const T;
+            std::slice::from_raw_parts(base, count as usize)
+        }
+    }
+
+    pub fn as_bytes(&self) -> &[u8] {
+        unsafe { std::slice::from_raw_parts(self.words.as_ptr() as *const u8, self.len) }
+    }
+
+    pub fn header(&self) -> &CLevelHeader {
+        unsafe { &*(self.words.as_ptr() as *const CLevelHeader) }
+    }
+
+    pub fn width(&self) -> usize {
+        self.header().width as usize
+    }
+
+    pub fn height(&self) -> usize {
+        self.header().height as usize
+    }
+
+    /// All cells in row-major order (`y * width + x`).
+    pub fn cells(&self) -> &[CLevelCell] {
+        let hdr = self.header();
+        self.section(hdr.cells_offset, hdr.ncells)
+    }
+
+    pub fn cell(&self, x: usize, y: usize) -> Option<&CLevelCell> {
+        if x >= self.width() || y >= self.height() {
+            return None;
+        }
+        self.cells().get(y * self.width() + x)
+    }
+
+    pub fn rooms(&self) -> &[CLevelRoom] {
+        let hdr = self.header();
+        self.section(hdr.rooms_offset, hdr.nrooms)
+    }
+
+    pub fn stairs(&self) -> &[CLevelStair] {
+        let hdr = self.header();
+        self.section(hdr.stairs_offset, hdr.nstairs)
+    }
+
+    pub fn objects(&self) -> &[CLevelObject] {
+        let hdr = self.header();
+        self.section(hdr.objects_offset, hdr.nobjects)
+    }
+
+    pub fn monsters(&self) -> &[CLevelMonster] {
+        let hdr = self.header();
+        self.section(hdr.monsters_offset, hdr.nmonsters)
+    }
+}
+
+// ============================================================================
+// Binary Level Delta (must match nethack_src/nethack_ffi_types.h)
+// ============================================================================
+
+/// "NLVD" little-endian
+pub const NH_FFI_DELTA_MAGIC: u32 = 0x4456_4C4E;
+pub const NH_FFI_DELTA_VERSION: u16 = 1;
+
+/// The delta is a new baseline listing the whole level
+pub const NH_FFI_DELTA_F_FULL: u16 = 0x0001;
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct CLevelDeltaHeader {
+    pub magic: u32,
+    pub version: u16,
+    pub header_size: u16,
+    pub total_size: u32,
+    pub seq: u32,
+    pub width: u8,
+    pub height: u8,
+    pub dnum: i8,
+    pub dlevel: i8,
+    pub flags: u16,
+    pub ncells: u16,
+    pub nobjects: u16,
+    pub nobjects_gone: u16,
+    pub nmonsters: u16,
+    pub nmonsters_gone: u16,
+    pub cells_offset: u32,
+    pub objects_offset: u32,
+    pub objects_gone_offset: u32,
+    pub monsters_offset: u32,
+    pub monsters_gone_offset: u32,
+}
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct CLevelDeltaCell {
+    /// `y * width + x`
+    pub index: u16,
+    pub reserved: u16,
+    pub cell: CLevelCell,
+}
+
+const _: () = {
+    assert!(std::mem::size_of::<CLevelDeltaHeader>() == 52);
+    assert!(std::mem::size_of::<CLevelDeltaCell>() == 8);
+};
+
+/// Owned, validated copy of a level delta.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct CLevelDelta {
+    words: Vec<u32>,
+    len: usize,
+}
+
+impl CLevelDelta {
+    /// Copy and validate a delta produced by `nh_ffi_export_level_delta`.
+    pub fn from_bytes(bytes: &[u8]) -> Result<Self, String> {
+        let mut words = vec![0u32; bytes.len().div_ceil(4)];
+        unsafe {
+            std::ptr::copy_nonoverlapping(bytes.as_ptr(), words.as_mut_ptr() as *mut u8, bytes.len());
+        }
+        let delta = Self { words, len: bytes.len() };
+        delta.validate()?;
+        Ok(delta)
+    }
+
+    fn validate(&self) -> Result<(), String> {
+        let hdr_size = std::mem::size_of::<CLevelDeltaHeader>();
+        if self.len < hdr_size {
+            return Err(format!("Level delta too short: {} bytes", self.len));
+        }
+        let hdr = self.header();
+        if hdr.magic != NH_FFI_DELTA_MAGIC {
+            return Err(format!("Bad level delta magic: {:#x}", hdr.magic));
+        }
+        if hdr.version != NH_FFI_DELTA_VERSION || hdr.header_size as usize != hdr_size {
+            return Err(format!(
+                "Unsupported level delta version {} (header {} bytes)",
+                hdr.version, hdr.header_size
+            ));
+        }
+        if hdr.total_size as usize > self.len {
+            return Err(format!("Level delta truncated: {} of {} bytes", self.len, hdr.total_size));
+        }
+        let sections = [
+            (hdr.cells_offset, hdr.ncells as usize * std::mem::size_of::<CLevelDeltaCell>()),
+            (hdr.objects_offset, hdr.nobjects as usize * std::mem::size_of::<CLevelObject>()),
+            (hdr.objects_gone_offset, hdr.nobjects_gone as usize * 4),
+            (hdr.monsters_offset, hdr.nmonsters as usize * std::mem::size_of::<CLevelMonster>()),
+            (hdr.monsters_gone_offset, hdr.nmonsters_gone as usize * 4),
+        ];
+        for (offset, size) in sections {
+            if offset % 4 != 0 || offset as usize + size > hdr.total_size as usize {
+                return Err(format!("Bad level delta section at {} ({} bytes)", offset, size));
+            }
+        }
+        let ncells = hdr.width as usize * hdr.height as usize;
+        if let Some(c) = self.cells().iter().find(|c| c.index as usize >= ncells) {
+            return Err(format!("Level delta cell {} outside {}x{}", c.index, hdr.width, hdr.height));
+        }
+        Ok(())
+    }
+
+    fn section<T>(&self, offset: u32, count: u16) -> &[T] {
+        // Checked in validate(), as for CLevelExport
+        unsafe {
+            let base = (self.words.as_ptr() as *const u8).add(offset as usize) as *const T;
+            std::slice::from_raw_parts(base, count as usize)
+        }
+    }
+
+    pub fn as_bytes(&self) -> &[u8] {
+        unsafe { std::slice::from_raw_parts(self.words.as_ptr() as *const u8, self.len) }
+    }
+
+    pub fn header(&self) -> &CLevelDeltaHeader {
+        unsafe { &*(self.words.as_ptr() as *const CLevelDeltaHeader) }
+    }
+
+    /// A baseline: every cell, floor object and monster is listed.
+    pub fn is_full(&self) -> bool {
+        self.header().flags & NH_FFI_DELTA_F_FULL != 0
+    }
+
+    pub fn cells(&self) -> &[CLevelDeltaCell] {
+        let hdr = self.header();
+        self.section(hdr.cells_offset, hdr.ncells)
+    }
+
+    /// Floor objects that are new or changed
+    pub fn objects(&self) -> &[CLevelObject] {
+        let hdr = self.header();
+        self.section(hdr.objects_offset, hdr.nobjects)
+    }
+
+    /// `o_id`s of floor objects that are gone
+    pub fn objects_gone(&self) -> &[u32] {
+        let hdr = self.header();
+        self.section(hdr.objects_gone_offset, hdr.nobjects_gone)
+    }
+
+    /// Monsters that are new or changed
+    pub fn monsters(&self) -> &[CLevelMonster] {
+        let hdr = self.header();
+        self.section(hdr.monsters_offset, hdr.nmonsters)
+    }
+
+    /// `m_id`s of monsters that are gone
+    pub fn monsters_gone(&self) -> &[u32] {
+        let hdr = self.header();
+        self.section(hdr.monsters_gone_offset, hdr.nmonsters_gone)
+    }
+}
+
+// ============================================================================
+// Game Checkpoint (must match nethack_src/nethack_ffi_types.h)
+// ============================================================================
+
+/// "NHCK" little-endian
+pub const NH_FFI_CKPT_MAGIC: u32 = 0x4B43_484E;
+pub const NH_FFI_CKPT_VERSION: u16 = 2;
+
+/// A game was live when the checkpoint was taken
+pub const NH_FFI_CKPT_F_GAME: u32 = 0x0001;
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct CCheckpointHeader {
+    pub magic: u32,
+    pub version: u16,
+    pub header_size: u16,
+    pub total_size: u32,
+    pub flags: u32,
+    pub build_id: u64,
+    pub globals_size: u32,
+    pub nnodes: u32,
+    pub nfixups: u32,
+    pub aux_size: u32,
+    pub rng_size: u32,
+    pub globals_off: u32,
+    pub nodes_off: u32,
+    pub fixups_off: u32,
+    pub aux_off: u32,
+    pub rng_off: u32,
+}
+
+const _: () = assert!(std::mem::size_of::<CCheckpointHeader>() == 64);
+
+impl CCheckpointHeader {
+    /// Header of a checkpoint from `CGameEngine::checkpoint`, if it has one.
+    pub fn read(checkpoint: &[u8]) -> Option<Self> {
+        if checkpoint.len() < std::mem::size_of::<Self>() {
+            return None;
+        }
+        let hdr = unsafe { std::ptr::read_unaligned(checkpoint.as_ptr() as *const Self) };
+        (hdr.magic == NH_FFI_CKPT_MAGIC).then_some(hdr)
+    }
+}
+
+// ============================================================================
+// Section Profiler (must match nethack_src/nethack_ffi_types.h)
+// ============================================================================
+
+/// Number of `ffi_post_command()` phases tracked by the section profiler
+pub const NH_FFI_SECT_COUNT: usize = 17;
+
+pub const NH_FFI_SECTION_NAME_LEN: usize = 16;
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct CSectionProfile {
+    pub name: [c_char; NH_FFI_SECTION_NAME_LEN],
+    pub calls: u64,
+    pub rng_calls: u64,
+    pub nanos: u64,
+    pub total_calls: u64,
+    pub total_rng_calls: u64,
+    pub total_nanos: u64,
+}
+
+const _: () = assert!(std::mem::size_of::<CSectionProfile>() == 64);
+
+impl Default for CSectionProfile {
+    fn default() -> Self {
+        Self {
+            name: [0; NH_FFI_SECTION_NAME_LEN],
+            calls: 0,
+            rng_calls: 0,
+            nanos: 0,
+            total_calls: 0,
+            total_rng_calls: 0,
+            total_nanos: 0,
+        }
+    }
+}
+
+/// Per-phase cost of `ffi_post_command()`.
+///
+/// `calls`, `rng_calls` and `nanos` cover the last command; the `total_*`
+/// fields accumulate until `reset_section_profile()`.
+#[derive(Debug, Clone, Default, PartialEq, Eq, Serialize, Deserialize)]
+pub struct SectionProfile {
+    pub name: String,
+    pub calls: u64,
+    pub rng_calls: u64,
+    pub nanos: u64,
+    pub total_calls: u64,
+    pub total_rng_calls: u64,
+    pub total_nanos: u64,
+}
+
+impl From<&CSectionProfile> for SectionProfile {
+    fn from(p: &CSectionProfile) -> Self {
+        let name = unsafe { CStr::from_ptr(p.name.as_ptr()).to_string_lossy().into_owned() };
+        Self {
+            name,
+            calls: p.calls,
+            rng_calls: p.rng_calls,
+            nanos: p.nanos,
+            total_calls: p.total_calls,
+            total_rng_calls: p.total_rng_calls,
+            total_nanos: p.total_nanos,
+        }
+    }
+}
+
+// ============================================================================
+// Batched Command Execution (must match nethack_src/nethack_ffi_types.h)
+// ============================================================================
+
+/// State after one step of `exec_cmds()`
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Serialize, Deserialize)]
+pub struct CStepDigest {
+    pub rng_calls: u64,
+    pub turn: u32,
+    pub hp: i32,
+    pub hpmax: i32,
+    pub x: u8,
+    pub y: u8,
+    /// `nh_ffi_exec_cmd()` result: 0 ok, -1 unsupported command, -2 died
+    pub status: i8,
+    pub depth: i8,
+    /// Rolling `nh_rng::hash_rng_call` hash of the traced RNG calls
+    pub rng_hash: u64,
+    /// Turn, position, HP, depth and live monsters (see `nh_compare::lockstep`)
+    pub state_hash: u64,
+}
+
+const _: () = assert!(std::mem::size_of::<CStepDigest>() == 40);
+
+/// Outcome of a batched command script.
+#[derive(Debug, Clone, Default, PartialEq, Eq, Serialize, Deserialize)]
+pub struct StepBatch {
+    /// Steps run, including a final failing one
+    pub executed: usize,
+    /// One digest per executed step; empty unless requested
+    pub digests: Vec<CStepDigest>,
+}
+
+// ============================================================================
+// Rollouts (must match nethack_src/nethack_ffi_types.h)
+// ============================================================================
+
+/// Built-in `nh_ffi_rollout()` policies (`NH_FFI_POLICY_*`)
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+#[repr(i32)]
+pub enum RolloutPolicy {
+    /// A random direction every step
+    Random = 0,
+    /// Keep a heading, turn when blocked
+    Explore = 1,
+    /// Explore, rest below a third of max HP
+    Cautious = 2,
+}
+
+const NH_FFI_POLICY_CALLBACK: c_int = 3;
+
+/// How a rollout ended (`NH_FFI_ROLLOUT_*`)
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+pub enum RolloutEnd {
+    /// Played `max_turns` moves
+    Alive,
+    Died,
+    /// The policy returned no command, or a command was rejected
+    Stopped,
+    /// Commands stopped advancing the turn counter
+    Stalled,
+}
+
+pub const NH_FFI_RESULT_LEN: usize = 64;
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct CRolloutOutcome {
+    pub turns: u32,
+    pub steps: u32,
+    pub score: i32,
+    pub hp: i32,
+    pub end: i8,
+    pub depth: i8,
+    pub max_depth: i8,
+    pub reserved: u8,
+    pub result: [c_char; NH_FFI_RESULT_LEN],
+}
+
+const _: () = assert!(std::mem::size_of::<CRolloutOutcome>() == 84);
+
+impl Default for CRolloutOutcome {
+    fn default() -> Self {
+        Self {
+            turns: 0,
+            steps: 0,
+            score: 0,
+            hp: 0,
+            end: 0,
+            depth: 0,
+            max_depth: 0,
+            reserved: 0,
+            result: [0; NH_FFI_RESULT_LEN],
+        }
+    }
+}
+
+/// One game played by `rollout()`
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct RolloutOutcome {
+    /// Moves played
+    pub turns: u32,
+    /// Commands executed
+    pub steps: u32,
+    pub end: RolloutEnd,
+    pub hp: i32,
+    pub depth: i32,
+    /// Deepest level reached
+    pub max_depth: i32,
+    /// Score as the status line would show it
+    pub score: i32,
+    /// `nh_ffi_get_result_message()` at the end, e.g. the death reason
+    pub result: String,
+}
+
+impl From<&CRolloutOutcome> for RolloutOutcome {
+    fn from(o: &CRolloutOutcome) -> Self {
+        let result = unsafe { CStr::from_ptr(o.result.as_ptr()).to_string_lossy().into_owned() };
+        let end = match o.end {
+            0 => RolloutEnd::Alive,
+            1 => RolloutEnd::Died,
+            3 => RolloutEnd::Stalled,
+            _ => RolloutEnd::Stopped,
+        };
+        Self {
+            turns: o.turns,
+            steps: o.steps,
+            end,
+            hp: o.hp,
+            depth: o.depth as i32,
+            max_depth: o.max_depth as i32,
+            score: o.score,
+            result,
+        }
+    }
+}
+
+type CRolloutPolicyFn = unsafe extern "C" fn(*mut c_void, c_int, *const CStepDigest) -> c_int;
+
+/// Calls the `FnMut` behind `user` for `rollout_with()`
+unsafe extern "C" fn rollout_trampoline<F>(user: *mut c_void, rollout: c_int, last: *const CStepDigest) -> c_int
+where
+    F: FnMut(usize, &CStepDigest) -> Option<u8>,
+{
+    let policy = unsafe { &mut *(user as *mut F) };
+    policy(rollout as usize, unsafe { &*last }).map_or(0, c_int::from)
+}
+
+// ============================================================================
+// Weapon Calculator (must match nethack_src/nethack_ffi_types.h)
+// ============================================================================
+
+pub const NH_FFI_DMG_BINS: usize = 32;
+
+/// `CWeaponResult::status` values
+pub const NH_FFI_WEAPON_OK: i32 = 0;
+pub const NH_FFI_WEAPON_UNKNOWN: i32 = -1;
+pub const NH_FFI_WEAPON_RANGE: i32 = -2;
+
+/// One weapon for `calc_weapon_batch()`, wielded against a plain monster
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Serialize, Deserialize)]
+pub struct CWeaponQuery {
+    /// `objects[]` index
+    pub weapon_id: i32,
+    pub enchantment: i32,
+    /// `find_roll_to_hit()` total without the weapon's `hitval()`
+    pub to_hit: i32,
+    /// Attacks to roll from `seed`, 0 for none
+    pub samples: u32,
+    pub seed: u64,
+    /// The target is `bigmonst()`
+    pub large: u8,
+    /// Also fill `exact`
+    pub exact: u8,
+    pub reserved: [u8; 6],
+}
+
+const _: () = assert!(std::mem::size_of::<CWeaponQuery>() == 32);
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Serialize, Deserialize)]
+pub struct CWeaponResult {
+    /// `NH_FFI_WEAPON_*`
+    pub status: i32,
+    /// `hitval()`
+    pub hit_bonus: i32,
+    /// Damage counted by bin 0 of `sampled` and `exact`
+    pub dmg_min: i32,
+    pub dmg_max: i32,
+    /// Sampled attacks that hit
+    pub hits: u32,
+    /// `rnd(20)` results that hit, of 20
+    pub hit_faces: u32,
+    /// Equally likely dice outcomes summed by `exact`
+    pub outcomes: u32,
+    pub reserved: u32,
+    /// Damage of each sampled hit
+    pub sampled: [u32; NH_FFI_DMG_BINS],
+    /// Dice outcomes per damage
+    pub exact: [u32; NH_FFI_DMG_BINS],
+}
+
+const _: () = assert!(std::mem::size_of::<CWeaponResult>() == 288);
+
+impl CWeaponResult {
+    /// Bins in use: one per damage from `dmg_min` to `dmg_max`
+    pub fn bins(&self) -> usize {
+        if self.status == NH_FFI_WEAPON_OK { (self.dmg_max - self.dmg_min + 1) as usize } else { 0 }
+    }
+}
+
+// ============================================================================
+// RNG Trace Stream (must match nethack_src/nethack_ffi_types.h)
+// ============================================================================
+
+pub const NH_FFI_RNG_TRACE_MAGIC: u32 = 0x54524E4E;
+pub const NH_FFI_RNG_TRACE_VERSION: u16 = 1;
+
+/// `CRngTraceRecord::func` values, indexed into `NH_FFI_RNG_FN_NAMES`
+pub const NH_FFI_RNG_FN_RN2: u8 = 0;
+pub const NH_FFI_RNG_FN_RND: u8 = 1;
+pub const NH_FFI_RNG_FN_RNE: u8 = 2;
+pub const NH_FFI_RNG_FN_RNZ: u8 = 3;
+pub const NH_FFI_RNG_FN_RNL: u8 = 4;
+pub const NH_FFI_RNG_FN_NAMES: [&str; 5] = ["rn2", "rnd", "rne", "rnz", "rnl"];
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct CRngTraceHeader {
+    pub magic: u32,
+    pub version: u16,
+    pub record_size: u16,
+}
+
+/// One streamed RNG call
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct CRngTraceRecord {
+    /// Position in the stream; consecutive unless records were lost
+    pub seq: u32,
+    pub func: u8,
+    pub reserved: [u8; 3],
+    pub arg: i32,
+    pub result: i32,
+}
+
+const _: () = {
+    assert!(std::mem::size_of::<CRngTraceHeader>() == 8);
+    assert!(std::mem::size_of::<CRngTraceRecord>() == 16);
+};
+
+impl CRngTraceRecord {
+    fn from_bytes(b: &[u8; 16]) -> Self {
+        Self {
+            seq: u32::from_ne_bytes([b[0], b[1], b[2], b[3]]),
+            func: b[4],
+            reserved: [b[5], b[6], b[7]],
+            arg: i32::from_ne_bytes([b[8], b[9], b[10], b[11]]),
+            result: i32::from_ne_bytes([b[12], b[13], b[14], b[15]]),
+        }
+    }
+
+    pub fn func_name(&self) -> &'static str {
+        NH_FFI_RNG_FN_NAMES.get(self.func as usize).copied().unwrap_or("?")
+    }
+
+    /// View as a Rust-side trace entry for diffing; the stream does not
+    /// carry raw ISAAC64 values.
+    pub fn to_entry(&self) -> nh_rng::RngTraceEntry {
+        nh_rng::RngTraceEntry {
+            seq: self.seq as u64,
+            func: self.func_name(),
+            arg: self.arg as u64,
+            result: self.result as u64,
+            raw: 0,
+        }
+    }
+}
+
+/// Reads a stream written through `start_rng_trace_stream`, one record at a
+/// time, so traces of whole games never have to fit in memory.
+pub struct RngTraceReader<R> {
+    inner: R,
+    next_seq: u32,
+}
+
+impl<R: std::io::Read> RngTraceReader<R> {
+    /// Check the stream header.
+    pub fn new(mut inner: R) -> Result<Self, String> {
+        let mut b = [0u8; 8];
+        inner
+            .read_exact(&mut b)
+            .map_err(|e| format!("RNG trace header unreadable: {}", e))?;
+        let hdr = CRngTraceHeader {
+            magic: u32::from_ne_bytes([b[0], b[1], b[2], b[3]]),
+            version: u16::from_ne_bytes([b[4], b[5]]),
+            record_size: u16::from_ne_bytes([b[6], b[7]]),
+        };
+        if hdr.magic != NH_FFI_RNG_TRACE_MAGIC {
+            return Err(format!("Bad RNG trace magic: {:#x}", hdr.magic));
+        }
+        if hdr.version != NH_FFI_RNG_TRACE_VERSION
+            || hdr.record_size as usize != std::mem::size_of::<CRngTraceRecord>()
+        {
+            return Err(format!(
+                "Unsupported RNG trace version {} ({}-byte records)",
+                hdr.version, hdr.record_size
+            ));
+        }
+        Ok(Self { inner, next_seq: 0 })
+    }
+
+    /// Read every remaining record.
+    pub fn read_all(self) -> Result<Vec<CRngTraceRecord>, String> {
+        self.collect()
+    }
 }
 
+impl<R: std::io::Read> Iterator for RngTraceReader<R> {
+    type Item = Result<CRngTraceRecord, String>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        let mut b = [0u8; 16];
+        let mut got = 0;
+        while got < b.len() {
+            match self.inner.read(&mut b[got..]) {
+                Ok(0) if got == 0 => return None,
+                Ok(0) => return Some(Err(format!("RNG trace truncated after {} records", self.next_seq))),
+                Ok(n) => got += n,
+                Err(e) if e.kind() == std::io::ErrorKind::Interrupted => {}
+                Err(e) => return Some(Err(format!("RNG trace read failed: {}", e))),
+            }
+        }
+        let rec = CRngTraceRecord::from_bytes(&b);
+        if rec.seq != self.next_seq {
+            return Some(Err(format!(
+                "RNG trace lost records: expected seq {}, got {}",
+                self.next_seq, rec.seq
+            )));
+        }
+        self.next_seq = self.next_seq.wrapping_add(1);
+        Some(Ok(rec))
+    }
+}
+
+// ============================================================================
+// Headless Mode (must match nethack_src/nethack_ffi_types.h)
+// ============================================================================
+
+/// The section profiler stops timing
+pub const NH_FFI_HEADLESS_PROFILE: u32 = 0x0001;
+/// bot() formats no status lines
+pub const NH_FFI_HEADLESS_STATUS: u32 = 0x0002;
+/// Messages are not captured; `last_message` keeps the last one seen before
+pub const NH_FFI_HEADLESS_MESSAGES: u32 = 0x0004;
+pub const NH_FFI_HEADLESS_ALL: u32 = 0x0007;
+
+// ============================================================================
+// Diagnostics (must match nethack_src/nethack_ffi_types.h)
+// ============================================================================
+
+/// Init, level generation and terminate messages
+pub const NH_FFI_LOG_LIFECYCLE: u32 = 0x0001;
+/// Per-command start/end positions
+pub const NH_FFI_LOG_EXEC: u32 = 0x0002;
+/// Per-phase RNG counts in the post-command loop
+pub const NH_FFI_LOG_SECTION: u32 = 0x0004;
+/// Per-monster dump after movemon
+pub const NH_FFI_LOG_MONSTER: u32 = 0x0008;
+/// Direct rn2/rnd calls
+pub const NH_FFI_LOG_RNG: u32 = 0x0010;
+/// JSON getters
+pub const NH_FFI_LOG_JSON: u32 = 0x0020;
+pub const NH_FFI_LOG_ALL: u32 = 0xFFFF;
+
 // ============================================================================
 // FFI Function Declarations
 // ============================================================================
@@ -75,6 +1096,17 @@ unsafe extern "C" {
 
     // Command Execution
     pub fn nh_ffi_exec_cmd(cmd: c_char) -> c_int;
+    pub fn nh_ffi_exec_cmds(cmds: *const c_char, n: c_int, digests: *mut CStepDigest) -> c_int;
+    pub fn nh_ffi_get_step_digest(digest: *mut CStepDigest, status: c_int) -> c_int;
+    pub fn nh_ffi_reset_rng_hash();
+    pub fn nh_ffi_rollout(
+        seed: c_ulong,
+        policy: c_int,
+        max_turns: c_int,
+        count: c_int,
+        out: *mut CRolloutOutcome,
+    ) -> c_int;
+    pub fn nh_ffi_set_rollout_policy(policy: Option<CRolloutPolicyFn>, user: *mut c_void);
     pub fn nh_ffi_exec_cmd_dir(cmd: c_char, dx: c_int, dy: c_int) -> c_int;
 
     // State Queries
@@ -106,6 +1138,25 @@ unsafe extern "C" {
     pub fn nh_ffi_get_map_json() -> *mut c_char;
     pub fn nh_ffi_free_string(ptr: *mut c_void);
 
+    // Structured State
+    pub fn nh_ffi_get_game_state(state: *mut CGameState) -> c_int;
+    pub fn nh_ffi_get_inventory(out: *mut CObject, max: c_int) -> c_int;
+    pub fn nh_ffi_get_monsters(out: *mut CMonster, max: c_int) -> c_int;
+    pub fn nh_ffi_get_monsters_in_rect(
+        x1: c_int,
+        y1: c_int,
+        x2: c_int,
+        y2: c_int,
+        out: *mut CMonster,
+        max: c_int,
+    ) -> c_int;
+    pub fn nh_ffi_get_monsters_near(x: c_int, y: c_int, radius: c_int, out: *mut CMonster, max: c_int) -> c_int;
+
+    // Output Arena
+    pub fn nh_ffi_arena_reset();
+    pub fn nh_ffi_arena_generation() -> c_ulong;
+    pub fn nh_ffi_arena_capacity() -> usize;
+
     // Message Log
     pub fn nh_ffi_get_last_message() -> *mut c_char;
 
@@ -127,13 +1178,34 @@ unsafe extern "C" {
 
     // RNG
     pub fn nh_ffi_get_rng_call_count() -> c_ulong;
+    pub fn nh_ffi_rng_skip(n: c_ulong);
+    pub fn nh_ffi_rng_checkpoint(buf: *mut c_void, bufsize: usize) -> usize;
+    pub fn nh_ffi_rng_restore(buf: *const c_void, size: usize) -> c_int;
+
+    // Game checkpoints
+    pub fn nh_ffi_checkpoint(buf: *mut c_void, bufsize: usize) -> c_long;
+    pub fn nh_ffi_restore(buf: *const c_void, size: usize) -> c_int;
+    pub fn nh_ffi_level_checkpoint(buf: *mut c_void, bufsize: usize) -> c_long;
+    pub fn nh_ffi_restore_level(buf: *const c_void, size: usize) -> c_int;
+    pub fn nh_ffi_level_inputs_id() -> u64;
 
     // Monster AI control
     pub fn nh_ffi_set_skip_movemon(skip: c_int);
 
+    // Section profiler
+    pub fn nh_ffi_get_section_profile(out: *mut CSectionProfile, max: c_int) -> c_int;
+    pub fn nh_ffi_reset_section_profile();
+
+    // Diagnostics
+    pub fn nh_ffi_set_log_mask(mask: c_uint) -> c_uint;
+    pub fn nh_ffi_get_log_mask() -> c_uint;
+    pub fn nh_ffi_set_headless(flags: c_uint) -> c_uint;
+    pub fn nh_ffi_get_headless() -> c_uint;
+
     // Logic/Calculation Wrappers
     pub fn nh_ffi_rng_rn2(limit: c_int) -> c_int;
     pub fn nh_ffi_calc_base_damage(weapon_id: c_int, small_monster: c_int) -> c_int;
+    pub fn nh_ffi_calc_weapon_batch(queries: *const CWeaponQuery, count: c_int, out: *mut CWeaponResult) -> c_int;
     pub fn nh_ffi_get_ac() -> c_int;
     pub fn nh_ffi_test_setup_status(hp: c_int, max_hp: c_int, level: c_int, ac: c_int);
     pub fn nh_ffi_wear_item(item_id: c_int) -> c_int;
@@ -145,10 +1217,25 @@ unsafe extern "C" {
     pub fn nh_ffi_get_nutrition() -> c_int;
     pub fn nh_ffi_get_attributes_json() -> *mut c_char;
     pub fn nh_ffi_export_level() -> *mut c_char;
+    pub fn nh_ffi_export_level_bin(buf: *mut c_void, bufsize: usize) -> c_long;
+    pub fn nh_ffi_export_level_delta(buf: *mut c_void, bufsize: usize) -> c_long;
+    pub fn nh_ffi_reset_level_delta();
+    pub fn nh_ffi_export_grid(buf: *mut c_void, bufsize: usize) -> c_long;
+
+    // Static tables (needs no game)
+    pub fn nh_ffi_export_static_tables(buf: *mut c_void, bufsize: usize) -> c_long;
+    pub fn nh_ffi_static_tables_id() -> u64;
+    pub fn nh_ffi_build_id() -> u64;
+
+    // Startup image of the one-time table setup (before the first init)
+    pub fn nh_ffi_set_startup_image(image: *const c_void, size: usize) -> c_int;
+    pub fn nh_ffi_get_startup_image(buf: *mut c_void, bufsize: usize) -> c_long;
+    pub fn nh_ffi_startup_image_used() -> c_int;
 
     // Visibility sync (convergence framework)
     pub fn nh_ffi_get_visibility(out: *mut c_char);
     pub fn nh_ffi_get_couldsee(out: *mut c_char);
+    pub fn nh_ffi_get_glyphs(out: *mut u16, max: c_int) -> c_int;
 
     // Debug: cell state and mfndpos diagnostics (return static buffer pointers)
     pub fn nh_ffi_debug_cell(x: c_int, y: c_int) -> *const c_char;
@@ -159,6 +1246,9 @@ unsafe extern "C" {
     pub fn nh_ffi_disable_rng_tracing();
     pub fn nh_ffi_get_rng_trace() -> *mut c_char;
     pub fn nh_ffi_clear_rng_trace();
+    pub fn nh_ffi_rng_trace_stream_open(fd: c_int) -> c_int;
+    pub fn nh_ffi_rng_trace_stream_flush() -> c_long;
+    pub fn nh_ffi_rng_trace_stream_close() -> c_long;
 
     // Function-level isolation testing (Phase 1)
     pub fn nh_ffi_test_finddpos(xl: c_int, yl: c_int, xh: c_int, yh: c_int, out_x: *mut c_int, out_y: *mut c_int);
@@ -179,6 +1269,19 @@ unsafe extern "C" {
 // Safe Rust Wrapper
 // ============================================================================
 
+/// Copy a string result out of the C output arena and reset the arena.
+/// No wrapper keeps an arena pointer past its own call, so every result
+/// reuses the same chunk.
+///
+/// # Safety
+/// `ptr` must be a non-null string returned by the C engine since the last
+/// arena reset.
+unsafe fn take_arena_string(ptr: *const c_char) -> String {
+    let result = unsafe { CStr::from_ptr(ptr).to_string_lossy().into_owned() };
+    unsafe { nh_ffi_arena_reset() };
+    result
+}
+
 pub struct CGameEngine {
     initialized: bool,
 }
@@ -188,6 +1291,11 @@ impl CGameEngine {
         Self { initialized: false }
     }
 
+    /// Engine view of the game in the live context (see `context.rs`)
+    pub(crate) fn attached(initialized: bool) -> Self {
+        Self { initialized }
+    }
+
     pub fn is_initialized(&self) -> bool {
         self.initialized
     }
@@ -227,14 +1335,107 @@ impl CGameEngine {
         unsafe { nh_ffi_set_dlevel(dnum, dlevel) }
     }
 
+    /// Write the binary level export into `out` (4-byte aligned), e.g. a
+    /// shared memory region. Returns the number of bytes written.
+    pub fn export_level_bin_into(&self, out: &mut [u8]) -> Result<usize, String> {
+        let needed = unsafe { nh_ffi_export_level_bin(std::ptr::null_mut(), 0) };
+        if needed <= 0 {
+            return Err("Failed to size level export".to_string());
+        }
+        if needed as usize > out.len() {
+            return Err(format!("Level export needs {} bytes, have {}", needed, out.len()));
+        }
+        let written = unsafe { nh_ffi_export_level_bin(out.as_mut_ptr() as *mut c_void, out.len()) };
+        if written != needed {
+            return Err(format!("Level export changed size: {} != {}", written, needed));
+        }
+        Ok(needed as usize)
+    }
+
+    /// Export the current level as packed binary records (no JSON round trip).
+    pub fn export_level_bin(&self) -> Result<CLevelExport, String> {
+        let needed = unsafe { nh_ffi_export_level_bin(std::ptr::null_mut(), 0) };
+        if needed <= 0 {
+            return Err("Failed to size level export".to_string());
+        }
+        let mut words = vec![0u32; (needed as usize).div_ceil(4)];
+        let written = unsafe {
+            nh_ffi_export_level_bin(words.as_mut_ptr() as *mut c_void, words.len() * 4)
+        };
+        if written != needed {
+            return Err(format!("Level export changed size: {} != {}", written, needed));
+        }
+        let export = CLevelExport { words, len: needed as usize };
+        export.validate()?;
+        Ok(export)
+    }
+
+    /// Cells, floor objects and monsters that changed since the last delta.
+    pub fn export_level_delta(&self) -> Result<CLevelDelta, String> {
+        // Most deltas are a few records; a call that does not fit writes
+        // nothing, so retry with the size it asked for
+        let mut words = vec![0u32; 256];
+        loop {
+            let needed = unsafe {
+                nh_ffi_export_level_delta(words.as_mut_ptr() as *mut c_void, words.len() * 4)
+            };
+            if needed <= 0 {
+                return Err("Failed to export level delta".to_string());
+            }
+            if needed as usize <= words.len() * 4 {
+                words.truncate((needed as usize).div_ceil(4));
+                let delta = CLevelDelta { words, len: needed as usize };
+                delta.validate()?;
+                return Ok(delta);
+            }
+            words = vec![0u32; (needed as usize).div_ceil(4)];
+        }
+    }
+
+    /// Make the next `export_level_delta` a full baseline.
+    pub fn reset_level_delta(&self) {
+        unsafe { nh_ffi_reset_level_delta() }
+    }
+
+    /// Sight, lit and cell type planes of the current level, in the wire
+    /// format `nh_core::dungeon::GridPlanes` shares with the C engine.
+    /// Fails in the stub build, which has no map to export.
+    pub fn export_grid_bytes(&self) -> Result<Vec<u8>, String> {
+        let mut buf = vec![0u8; nh_core::dungeon::GRID_SIZE];
+        let needed = unsafe { nh_ffi_export_grid(buf.as_mut_ptr() as *mut c_void, buf.len()) };
+        if needed as usize != buf.len() {
+            return Err(format!("Grid export size {} != {}", needed, buf.len()));
+        }
+        Ok(buf)
+    }
+
+    pub fn export_grid(&self) -> Result<nh_core::dungeon::GridPlanes, String> {
+        nh_core::dungeon::GridPlanes::decode(&self.export_grid_bytes()?)
+    }
+
+    /// Live monsters with `x1 <= x <= x2` and `y1 <= y <= y2`, clipped to
+    /// the map, in column-major order. Costs the area, not the monster count.
+    pub fn monsters_in_rect(&self, x1: i32, y1: i32, x2: i32, y2: i32) -> Vec<nh_core::CMonsterSnapshot> {
+        c_records(|out, max| unsafe { nh_ffi_get_monsters_in_rect(x1, y1, x2, y2, out, max) })
+            .iter()
+            .map(Into::into)
+            .collect()
+    }
+
+    /// Live monsters within `radius` moves of `(x, y)`.
+    pub fn monsters_near(&self, x: i32, y: i32, radius: i32) -> Vec<nh_core::CMonsterSnapshot> {
+        c_records(|out, max| unsafe { nh_ffi_get_monsters_near(x, y, radius, out, max) })
+            .iter()
+            .map(Into::into)
+            .collect()
+    }
+
     pub fn map_json(&self) -> String {
         let json_ptr = unsafe { nh_ffi_get_map_json() };
         if json_ptr.is_null() {
             return "{}".to_string();
         }
-        let result = unsafe { CStr::from_ptr(json_ptr).to_string_lossy().into_owned() };
-        unsafe { nh_ffi_free_string(json_ptr as *mut c_void) };
-        result
+        unsafe { take_arena_string(json_ptr) }
     }
 
     pub fn inventory_count(&self) -> i32 {
@@ -246,9 +1447,7 @@ impl CGameEngine {
         if json_ptr.is_null() {
             return "[]".to_string();
         }
-        let result = unsafe { CStr::from_ptr(json_ptr).to_string_lossy().into_owned() };
-        unsafe { nh_ffi_free_string(json_ptr as *mut c_void) };
-        result
+        unsafe { take_arena_string(json_ptr) }
     }
 
     pub fn monster_count(&self) -> i32 {
@@ -260,21 +1459,233 @@ impl CGameEngine {
         if msg_ptr.is_null() {
             return "Unknown".to_string();
         }
-        let result = unsafe { CStr::from_ptr(msg_ptr).to_string_lossy().into_owned() };
-        unsafe { nh_ffi_free_string(msg_ptr as *mut c_void) };
-        result
+        unsafe { take_arena_string(msg_ptr) }
     }
 
     pub fn rng_call_count(&self) -> u64 {
         unsafe { nh_ffi_get_rng_call_count() as u64 }
     }
 
+    /// Advance the RNG by `n` draws without playing them out, e.g. to jump
+    /// to the call where a divergence was reported.
+    pub fn rng_skip(&self, n: u64) {
+        unsafe { nh_ffi_rng_skip(n as c_ulong) }
+    }
+
+    /// Capture the full RNG state, including the call counter.
+    pub fn rng_checkpoint(&self) -> Result<Vec<u8>, String> {
+        let needed = unsafe { nh_ffi_rng_checkpoint(std::ptr::null_mut(), 0) };
+        if needed == 0 {
+            return Err("RNG checkpoints not supported by this build".to_string());
+        }
+        let mut buf = vec![0u8; needed];
+        let written = unsafe { nh_ffi_rng_checkpoint(buf.as_mut_ptr() as *mut c_void, buf.len()) };
+        if written != needed {
+            return Err(format!("RNG checkpoint changed size: {} != {}", written, needed));
+        }
+        Ok(buf)
+    }
+
+    /// Restore a state captured by `rng_checkpoint`.
+    pub fn rng_restore(&self, checkpoint: &[u8]) -> Result<(), String> {
+        let rc = unsafe { nh_ffi_rng_restore(checkpoint.as_ptr() as *const c_void, checkpoint.len()) };
+        if rc != 0 {
+            return Err("RNG checkpoint does not match this build".to_string());
+        }
+        Ok(())
+    }
+
+    /// Capture the live game -- hero, level, object and monster chains, aux
+    /// lists and RNG -- for `restore`. A checkpoint restores in any process
+    /// running the same build.
+    pub fn checkpoint(&self) -> Result<Vec<u8>, String> {
+        let needed = unsafe { nh_ffi_checkpoint(std::ptr::null_mut(), 0) };
+        if needed <= 0 {
+            return Err("Failed to take a checkpoint".to_string());
+        }
+        let mut buf = vec![0u8; needed as usize];
+        let written = unsafe { nh_ffi_checkpoint(buf.as_mut_ptr() as *mut c_void, buf.len()) };
+        if written != needed {
+            return Err(format!("Checkpoint changed size: {} != {}", written, needed));
+        }
+        Ok(buf)
+    }
+
+    /// Replace the live game with one captured by `checkpoint`. The same
+    /// checkpoint can be restored any number of times; on error the live
+    /// game is left alone.
+    pub fn restore(&self, checkpoint: &[u8]) -> Result<(), String> {
+        let rc = unsafe { nh_ffi_restore(checkpoint.as_ptr() as *const c_void, checkpoint.len()) };
+        if rc != 0 {
+            return Err("Checkpoint is malformed or from another build".to_string());
+        }
+        Ok(())
+    }
+
+    /// Capture just the live level, with the monster births and id counter
+    /// its generation advanced, for `restore_level`.
+    pub fn level_checkpoint(&self) -> Result<Vec<u8>, String> {
+        let needed = unsafe { nh_ffi_level_checkpoint(std::ptr::null_mut(), 0) };
+        if needed <= 0 {
+            return Err("Failed to take a level checkpoint".to_string());
+        }
+        let mut buf = vec![0u8; needed as usize];
+        let written = unsafe { nh_ffi_level_checkpoint(buf.as_mut_ptr() as *mut c_void, buf.len()) };
+        if written != needed {
+            return Err(format!("Level checkpoint changed size: {} != {}", written, needed));
+        }
+        Ok(buf)
+    }
+
+    /// Replace the live level with one captured by `level_checkpoint` on the
+    /// same dungeon level. Hero, inventory, turn and RNG are left alone.
+    pub fn restore_level(&self, checkpoint: &[u8]) -> Result<(), String> {
+        let rc = unsafe { nh_ffi_restore_level(checkpoint.as_ptr() as *const c_void, checkpoint.len()) };
+        if rc != 0 {
+            return Err("Level checkpoint is malformed, from another build or another level".to_string());
+        }
+        Ok(())
+    }
+
+    /// Digest of what a generation reads besides the RNG: level place and
+    /// difficulty, hero level and alignment, turn, id counter and monster
+    /// births, extinctions and uniques.
+    pub fn level_inputs_id(&self) -> u64 {
+        unsafe { nh_ffi_level_inputs_id() }
+    }
+
     /// Set skip_movemon flag: when true, ffi_post_command skips movemon()
     /// (monster AI), so only infrastructure RNG calls are made.
     pub fn set_skip_movemon(&self, skip: bool) {
         unsafe { nh_ffi_set_skip_movemon(if skip { 1 } else { 0 }) }
     }
 
+    /// Run a whole command script in one FFI call, stopping after the first
+    /// command that fails. With `record`, a digest is captured after every
+    /// executed step.
+    pub fn exec_cmds(&self, cmds: &[u8], record: bool) -> Result<StepBatch, String> {
+        if !self.initialized {
+            return Err("Game not initialized".to_string());
+        }
+        let n = c_int::try_from(cmds.len()).map_err(|_| "Command script too long".to_string())?;
+
+        let mut digests = if record {
+            vec![CStepDigest::default(); cmds.len()]
+        } else {
+            Vec::new()
+        };
+        let out = if record { digests.as_mut_ptr() } else { std::ptr::null_mut() };
+        let executed = unsafe { nh_ffi_exec_cmds(cmds.as_ptr() as *const c_char, n, out) };
+        if executed < 0 {
+            return Err("Batched command execution failed".to_string());
+        }
+
+        let executed = executed as usize;
+        digests.truncate(executed);
+        Ok(StepBatch { executed, digests })
+    }
+
+    /// Digest of the live game as `exec_cmds()` records it after a step,
+    /// e.g. the baseline of a lockstep run.
+    pub fn step_digest(&self) -> CStepDigest {
+        let mut digest = CStepDigest::default();
+        unsafe { nh_ffi_get_step_digest(&mut digest, 0) };
+        digest
+    }
+
+    /// Restart the digests' rolling RNG hash (`reset()` restarts it too).
+    pub fn reset_rng_hash(&self) {
+        unsafe { nh_ffi_reset_rng_hash() };
+    }
+
+    /// Play `count` games from the current state with a built-in policy,
+    /// up to `max_turns` moves each. Rollout `r` runs with the RNG reset to
+    /// `seed + r`; the current game is left as it was.
+    pub fn rollout(
+        &self,
+        seed: u64,
+        policy: RolloutPolicy,
+        max_turns: u32,
+        count: usize,
+    ) -> Result<Vec<RolloutOutcome>, String> {
+        self.run_rollouts(seed, policy as c_int, max_turns, count)
+    }
+
+    /// `rollout()` with a policy closure, given the rollout index and the
+    /// digest after the last step; it returns the next command, or `None`
+    /// to end that rollout.
+    pub fn rollout_with<F>(
+        &self,
+        seed: u64,
+        max_turns: u32,
+        count: usize,
+        mut policy: F,
+    ) -> Result<Vec<RolloutOutcome>, String>
+    where
+        F: FnMut(usize, &CStepDigest) -> Option<u8>,
+    {
+        let user = &mut policy as *mut F as *mut c_void;
+        unsafe { nh_ffi_set_rollout_policy(Some(rollout_trampoline::<F>), user) };
+        let outcomes = self.run_rollouts(seed, NH_FFI_POLICY_CALLBACK, max_turns, count);
+        unsafe { nh_ffi_set_rollout_policy(None, std::ptr::null_mut()) };
+        outcomes
+    }
+
+    fn run_rollouts(
+        &self,
+        seed: u64,
+        policy: c_int,
+        max_turns: u32,
+        count: usize,
+    ) -> Result<Vec<RolloutOutcome>, String> {
+        if !self.initialized {
+            return Err("Game not initialized".to_string());
+        }
+        let n = c_int::try_from(count).map_err(|_| "Too many rollouts".to_string())?;
+        let max_turns = c_int::try_from(max_turns).map_err(|_| "max_turns out of range".to_string())?;
+
+        let mut raw = vec![CRolloutOutcome::default(); count];
+        let played = unsafe { nh_ffi_rollout(seed as c_ulong, policy, max_turns, n, raw.as_mut_ptr()) };
+        if played != n {
+            return Err("Rollouts failed".to_string());
+        }
+        Ok(raw.iter().map(RolloutOutcome::from).collect())
+    }
+
+    /// Per-phase RNG and time cost of the post-command loop.
+    pub fn section_profile(&self) -> Vec<SectionProfile> {
+        let mut raw = [CSectionProfile::default(); NH_FFI_SECT_COUNT];
+        let n = unsafe { nh_ffi_get_section_profile(raw.as_mut_ptr(), raw.len() as c_int) };
+        raw[..(n.max(0) as usize).min(raw.len())]
+            .iter()
+            .map(SectionProfile::from)
+            .collect()
+    }
+
+    pub fn reset_section_profile(&self) {
+        unsafe { nh_ffi_reset_section_profile() };
+    }
+
+    /// Select the `NH_FFI_LOG_*` categories the C side writes to stderr.
+    /// Returns the previous mask; always 0 when logging is compiled out.
+    pub fn set_log_mask(&self, mask: u32) -> u32 {
+        unsafe { nh_ffi_set_log_mask(mask) }
+    }
+
+    pub fn log_mask(&self) -> u32 {
+        unsafe { nh_ffi_get_log_mask() }
+    }
+
+    /// Set the `NH_FFI_HEADLESS_*` flags for the whole process; returns the
+    /// old ones. None of them changes the RNG stream.
+    pub fn set_headless(&self, flags: u32) -> u32 {
+        unsafe { nh_ffi_set_headless(flags) }
+    }
+
+    pub fn headless(&self) -> u32 {
+        unsafe { nh_ffi_get_headless() }
+    }
+
     pub fn rng_rn2(&self, limit: i32) -> i32 {
         unsafe { nh_ffi_rng_rn2(limit as c_int) as i32 }
     }
@@ -283,6 +1694,18 @@ impl CGameEngine {
         unsafe { nh_ffi_calc_base_damage(weapon_id as c_int, small_monster as c_int) as i32 }
     }
 
+    /// Damage and to-hit for each query in one call.  Needs no `init`, and
+    /// samples come from a stream of their own, not the game RNG.
+    pub fn calc_weapon_batch(&self, queries: &[CWeaponQuery]) -> Result<Vec<CWeaponResult>, String> {
+        let n = c_int::try_from(queries.len()).map_err(|_| "Too many weapon queries".to_string())?;
+        let mut out = vec![CWeaponResult::default(); queries.len()];
+        let done = unsafe { nh_ffi_calc_weapon_batch(queries.as_ptr(), n, out.as_mut_ptr()) };
+        if done != n {
+            return Err(format!("Weapon batch returned {}", done));
+        }
+        Ok(out)
+    }
+
     pub fn ac(&self) -> i32 {
         unsafe { nh_ffi_get_ac() as i32 }
     }
@@ -328,9 +1751,7 @@ impl CGameEngine {
         if json_ptr.is_null() {
             return "{}".to_string();
         }
-        let result = unsafe { CStr::from_ptr(json_ptr).to_string_lossy().into_owned() };
-        unsafe { nh_ffi_free_string(json_ptr as *mut c_void) };
-        result
+        unsafe { take_arena_string(json_ptr) }
     }
 
     pub fn enable_rng_tracing(&self) {
@@ -346,27 +1767,90 @@ impl CGameEngine {
         if json_ptr.is_null() {
             return "[]".to_string();
         }
-        let result = unsafe { CStr::from_ptr(json_ptr).to_string_lossy().into_owned() };
-        unsafe { nh_ffi_free_string(json_ptr as *mut c_void) };
-        result
+        unsafe { take_arena_string(json_ptr) }
     }
 
     pub fn clear_rng_trace(&self) {
         unsafe { nh_ffi_clear_rng_trace() };
     }
 
+    /// Stream every traced RNG call to `fd` in 16-byte records (read them
+    /// back with `RngTraceReader`). Unlike the JSON ring nothing is dropped.
+    /// The fd must stay open until `stop_rng_trace_stream`.
+    pub fn start_rng_trace_stream(&self, fd: RawFd) -> Result<(), String> {
+        if unsafe { nh_ffi_rng_trace_stream_open(fd as c_int) } != 0 {
+            return Err("Failed to start RNG trace stream".to_string());
+        }
+        Ok(())
+    }
+
+    /// Write out buffered records; returns the number streamed so far.
+    pub fn flush_rng_trace_stream(&self) -> Result<u64, String> {
+        let n = unsafe { nh_ffi_rng_trace_stream_flush() };
+        if n < 0 {
+            return Err("RNG trace stream write failed".to_string());
+        }
+        Ok(n as u64)
+    }
+
+    /// Flush and detach the stream; returns the total number of records.
+    pub fn stop_rng_trace_stream(&self) -> Result<u64, String> {
+        let n = unsafe { nh_ffi_rng_trace_stream_close() };
+        if n < 0 {
+            return Err("RNG trace stream write failed".to_string());
+        }
+        Ok(n as u64)
+    }
+
+    /// `IN_SIGHT` flags as a flat `COLNO * ROWNO` array (`x * ROWNO + y`).
+    pub fn visibility_bytes(&self) -> Vec<u8> {
+        let mut buffer = vec![0u8; NH_COLNO * NH_ROWNO];
+        self.visibility_into(&mut buffer);
+        buffer
+    }
+
+    /// `COULD_SEE` flags, laid out like `visibility_bytes`.
+    pub fn couldsee_bytes(&self) -> Vec<u8> {
+        let mut buffer = vec![0u8; NH_COLNO * NH_ROWNO];
+        self.couldsee_into(&mut buffer);
+        buffer
+    }
+
+    /// `visibility_bytes` into a caller buffer of at least `COLNO * ROWNO`.
+    pub fn visibility_into(&self, out: &mut [u8]) {
+        assert!(out.len() >= NH_COLNO * NH_ROWNO);
+        unsafe { nh_ffi_get_visibility(out.as_mut_ptr() as *mut c_char) };
+    }
+
+    pub fn couldsee_into(&self, out: &mut [u8]) {
+        assert!(out.len() >= NH_COLNO * NH_ROWNO);
+        unsafe { nh_ffi_get_couldsee(out.as_mut_ptr() as *mut c_char) };
+    }
+
+    /// Glyph shown at each cell (`glyph_at()`), row-major (`y * COLNO + x`),
+    /// into a caller buffer of at least `COLNO * ROWNO`. Returns false, with
+    /// `out` untouched, in builds without a map.
+    pub fn glyphs_into(&self, out: &mut [u16]) -> bool {
+        assert!(out.len() >= NH_COLNO * NH_ROWNO);
+        let max = c_int::try_from(out.len()).unwrap_or(c_int::MAX);
+        unsafe { nh_ffi_get_glyphs(out.as_mut_ptr(), max) > 0 }
+    }
+
+    /// Hero and dungeon summary in one call.
+    pub fn game_state(&self) -> Result<CGameState, String> {
+        let mut state = CGameState::default();
+        if unsafe { nh_ffi_get_game_state(&mut state) } != 0 {
+            return Err("Cannot read game state".to_string());
+        }
+        Ok(state)
+    }
+
     pub fn get_visibility(&self) -> Vec<Vec<bool>> {
-        let mut buffer = vec![0i8; 16384];
-        unsafe { nh_ffi_get_visibility(buffer.as_mut_ptr()) };
-        let json = unsafe { CStr::from_ptr(buffer.as_ptr()).to_string_lossy().into_owned() };
-        serde_json::from_str(&json).unwrap_or_else(|_| vec![vec![false; 21]; 80])
+        sight_grid(&self.visibility_bytes())
     }
 
     pub fn get_couldsee(&self) -> Vec<Vec<bool>> {
-        let mut buffer = vec![0i8; 16384];
-        unsafe { nh_ffi_get_couldsee(buffer.as_mut_ptr()) };
-        let json = unsafe { CStr::from_ptr(buffer.as_ptr()).to_string_lossy().into_owned() };
-        serde_json::from_str(&json).unwrap_or_else(|_| vec![vec![false; 21]; 80])
+        sight_grid(&self.couldsee_bytes())
     }
 
     pub fn test_finddpos(&self, xl: i32, yl: i32, xh: i32, yh: i32) -> (i32, i32) {
@@ -393,9 +1877,7 @@ impl CGameEngine {
         if ptr.is_null() {
             return String::new();
         }
-        let result = unsafe { CStr::from_ptr(ptr).to_string_lossy().into_owned() };
-        unsafe { nh_ffi_free_string(ptr as *mut c_void) };
-        result
+        unsafe { take_arena_string(ptr) }
     }
 
     pub fn get_doorindex(&self) -> i32 {
@@ -407,9 +1889,7 @@ impl CGameEngine {
         if ptr.is_null() {
             return "[]".to_string();
         }
-        let result = unsafe { CStr::from_ptr(ptr).to_string_lossy().into_owned() };
-        unsafe { nh_ffi_free_string(ptr as *mut c_void) };
-        result
+        unsafe { take_arena_string(ptr) }
     }
 
     pub fn set_cell(&self, x: i32, y: i32, typ: i32) {
@@ -433,9 +1913,7 @@ impl CGameEngine {
         if ptr.is_null() {
             return "[]".to_string();
         }
-        let result = unsafe { CStr::from_ptr(ptr).to_string_lossy().into_owned() };
-        unsafe { nh_ffi_free_string(ptr as *mut c_void) };
-        result
+        unsafe { take_arena_string(ptr) }
     }
 
     pub fn debug_cell(&self, x: i32, y: i32) -> String {
@@ -443,9 +1921,7 @@ impl CGameEngine {
         if ptr.is_null() {
             return String::new();
         }
-        let result = unsafe { CStr::from_ptr(ptr).to_string_lossy().into_owned() };
-        unsafe { nh_ffi_free_string(ptr as *mut c_void) };
-        result
+        unsafe { take_arena_string(ptr) }
     }
 
     pub fn debug_mfndpos(&self, mon_index: i32) -> String {
@@ -453,9 +1929,7 @@ impl CGameEngine {
         if ptr.is_null() {
             return String::new();
         }
-        let result = unsafe { CStr::from_ptr(ptr).to_string_lossy().into_owned() };
-        unsafe { nh_ffi_free_string(ptr as *mut c_void) };
-        result
+        unsafe { take_arena_string(ptr) }
     }
 }
 
@@ -518,9 +1992,7 @@ impl nh_core::CGameEngineTrait for CGameEngine {
         if json_ptr.is_null() {
             return "{}".to_string();
         }
-        let result = unsafe { CStr::from_ptr(json_ptr).to_string_lossy().into_owned() };
-        unsafe { nh_ffi_free_string(json_ptr as *mut c_void) };
-        result
+        unsafe { take_arena_string(json_ptr) }
     }
 
     fn exec_cmd(&self, cmd: char) -> Result<(), String> {
@@ -630,9 +2102,7 @@ impl nh_core::CGameEngineTrait for CGameEngine {
         if json_ptr.is_null() {
             return "{}".to_string();
         }
-        let result = unsafe { CStr::from_ptr(json_ptr).to_string_lossy().into_owned() };
-        unsafe { nh_ffi_free_string(json_ptr as *mut c_void) };
-        result
+        unsafe { take_arena_string(json_ptr) }
     }
 
     fn last_message(&self) -> String {
@@ -640,9 +2110,7 @@ impl nh_core::CGameEngineTrait for CGameEngine {
         if msg_ptr.is_null() {
             return "No message".to_string();
         }
-        let result = unsafe { CStr::from_ptr(msg_ptr).to_string_lossy().into_owned() };
-        unsafe { nh_ffi_free_string(msg_ptr as *mut c_void) };
-        result
+        unsafe { take_arena_string(msg_ptr) }
     }
 
     fn inventory_json(&self) -> String {
@@ -650,9 +2118,7 @@ impl nh_core::CGameEngineTrait for CGameEngine {
         if json_ptr.is_null() {
             return "[]".to_string();
         }
-        let result = unsafe { CStr::from_ptr(json_ptr).to_string_lossy().into_owned() };
-        unsafe { nh_ffi_free_string(json_ptr as *mut c_void) };
-        result
+        unsafe { take_arena_string(json_ptr) }
     }
 
     fn monsters_json(&self) -> String {
@@ -660,9 +2126,7 @@ impl nh_core::CGameEngineTrait for CGameEngine {
         if json_ptr.is_null() {
             return "[]".to_string();
         }
-        let result = unsafe { CStr::from_ptr(json_ptr).to_string_lossy().into_owned() };
-        unsafe { nh_ffi_free_string(json_ptr as *mut c_void) };
-        result
+        unsafe { take_arena_string(json_ptr) }
     }
 
     fn role(&self) -> String {
@@ -695,6 +2159,33 @@ impl nh_core::CGameEngineTrait for CGameEngine {
             _ => "Lawful".to_string(),
         }
     }
+
+    fn snapshot(&self) -> Result<nh_core::CGameSnapshot, String> {
+        let mut state = CGameState::default();
+        if unsafe { nh_ffi_get_game_state(&mut state) } != 0 {
+            return Err("Cannot read game state".to_string());
+        }
+        let mut snapshot = nh_core::CGameSnapshot::from(&state);
+        snapshot.inventory =
+            c_records(|out, max| unsafe { nh_ffi_get_inventory(out, max) }).iter().map(Into::into).collect();
+        snapshot.monsters =
+            c_records(|out, max| unsafe { nh_ffi_get_monsters(out, max) }).iter().map(Into::into).collect();
+        Ok(snapshot)
+    }
+}
+
+/// Read a `(out, max) -> count` array getter, growing the buffer until the
+/// whole array fits.
+fn c_records<T: Default + Clone>(mut get: impl FnMut(*mut T, c_int) -> c_int) -> Vec<T> {
+    let mut records = vec![T::default(); 64];
+    loop {
+        let n = get(records.as_mut_ptr(), records.len() as c_int).max(0) as usize;
+        if n <= records.len() {
+            records.truncate(n);
+            return records;
+        }
+        records.resize(n, T::default());
+    }
 }
 
 
@@ -714,6 +2205,7 @@ impl Drop for CGameEngine {
 #[cfg(test)]
 mod tests {
     use super::*;
+    use nh_core::CGameEngineTrait;
     use serial_test::serial;
 
     #[test]
@@ -781,6 +2273,485 @@ mod tests {
         assert_eq!(engine.turn_count(), 1);
     }
 
+    #[test]
+    #[serial]
+    fn test_export_level_bin() {
+        let mut engine = CGameEngine::new();
+        engine.init("Valkyrie", "Human", 1, 1).unwrap();
+
+        let export = engine.export_level_bin().unwrap();
+        assert_eq!(export.header().magic, NH_FFI_LEVEL_MAGIC);
+        assert_eq!((export.width(), export.height()), (80, 21));
+        assert_eq!(export.as_bytes().len(), export.header().total_size as usize);
+        #[cfg(real_nethack)]
+        {
+            engine.generate_and_place().unwrap();
+            let export = engine.export_level_bin().unwrap();
+            assert_eq!(export.cells().len(), 80 * 21);
+            assert!(!export.rooms().is_empty());
+            assert_eq!(export, CLevelExport::from_bytes(export.as_bytes()).unwrap());
+        }
+    }
+
+    #[test]
+    #[serial]
+    fn test_export_level_delta() {
+        let mut engine = CGameEngine::new();
+        engine.init("Valkyrie", "Human", 1, 1).unwrap();
+        engine.reset_level_delta();
+
+        let delta = engine.export_level_delta().unwrap();
+        assert!(delta.is_full());
+        assert_eq!(delta.header().seq, 0);
+        assert_eq!(delta, CLevelDelta::from_bytes(delta.as_bytes()).unwrap());
+        #[cfg(real_nethack)]
+        {
+            engine.generate_and_place().unwrap();
+            engine.reset_level_delta();
+            let base = engine.export_level_delta().unwrap();
+            let export = engine.export_level_bin().unwrap();
+            assert_eq!(base.cells().len(), 80 * 21);
+            assert_eq!(base.monsters().len(), export.monsters().len());
+
+            // Nothing happened since the baseline
+            let quiet = engine.export_level_delta().unwrap();
+            assert!(!quiet.is_full());
+            assert_eq!(quiet.header().seq, 1);
+            assert!(quiet.cells().is_empty() && quiet.objects().is_empty());
+            assert!(quiet.monsters().is_empty() && quiet.monsters_gone().is_empty());
+        }
+    }
+
+    #[test]
+    #[serial]
+    fn test_snapshot_matches_getters() {
+        let mut engine = CGameEngine::new();
+        engine.init("Valkyrie", "Human", 1, 1).unwrap();
+        #[cfg(real_nethack)]
+        engine.generate_and_place().unwrap();
+
+        let snapshot = engine.snapshot().unwrap();
+        assert_eq!(snapshot.hp, engine.hp());
+        assert_eq!(snapshot.hp_max, engine.max_hp());
+        assert_eq!((snapshot.x, snapshot.y), engine.position());
+        assert_eq!(snapshot.armor_class, engine.armor_class());
+        assert_eq!(snapshot.turn_count, engine.turn_count());
+        assert_eq!(snapshot.dungeon_depth, engine.dungeon_depth());
+        assert_eq!(snapshot.inventory.len() as i32, engine.inventory_count());
+        assert_eq!(snapshot.monsters.len() as i32, snapshot.monster_count);
+        #[cfg(real_nethack)]
+        {
+            // Valkyries start with a long sword and a dagger
+            assert!(snapshot.inventory.iter().any(|o| o.obj_class == ')' && o.damage > 0));
+            assert!(snapshot.inventory.iter().all(|o| o.inv_letter.is_ascii_alphabetic() || o.inv_letter == '$'));
+        }
+    }
+
+    // The stub build exports a grid header with no planes
+    #[cfg(real_nethack)]
+    #[test]
+    #[serial]
+    fn test_grid_matches_byte_exports() {
+        use nh_core::dungeon::GridPlane;
+
+        let mut engine = CGameEngine::new();
+        engine.init("Valkyrie", "Human", 1, 1).unwrap();
+        engine.generate_and_place().unwrap();
+        let _ = engine.exec_cmd('s');
+
+        let grid = engine.export_grid().unwrap();
+        let (sight, could) = (engine.visibility_bytes(), engine.couldsee_bytes());
+        let cells = engine.export_level_bin().map(|l| l.cells().to_vec()).unwrap_or_default();
+        for y in 0..NH_ROWNO {
+            for x in 0..NH_COLNO {
+                assert_eq!(grid.get(GridPlane::InSight, x, y), sight[x * NH_ROWNO + y] != 0, "({},{})", x, y);
+                assert_eq!(grid.get(GridPlane::CouldSee, x, y), could[x * NH_ROWNO + y] != 0, "({},{})", x, y);
+                if let Some(cell) = cells.get(y * NH_COLNO + x) {
+                    assert_eq!(grid.typ(x, y), cell.typ);
+                    assert_eq!(grid.get(GridPlane::Lit, x, y), cell.lit != 0);
+                }
+            }
+        }
+    }
+
+    #[test]
+    #[serial]
+    fn test_checkpoint_branches_replay() {
+        let mut engine = CGameEngine::new();
+        engine.init("Valkyrie", "Human", 1, 1).unwrap();
+        engine.reset(42).unwrap();
+        #[cfg(real_nethack)]
+        engine.generate_and_place().unwrap();
+
+        let checkpoint = engine.checkpoint().unwrap();
+        let hdr = CCheckpointHeader::read(&checkpoint).unwrap();
+        assert_eq!(hdr.total_size as usize, checkpoint.len());
+        assert_ne!(hdr.flags & NH_FFI_CKPT_F_GAME, 0);
+        let before = engine.snapshot().unwrap();
+
+        let play = |engine: &CGameEngine| {
+            "lljjs"
+                .chars()
+                .map(|cmd| {
+                    let _ = engine.exec_cmd(cmd);
+                    engine.snapshot().unwrap()
+                })
+                .collect::<Vec<_>>()
+        };
+        let first = play(&engine);
+
+        // Every branch off the checkpoint plays out the same way
+        for _ in 0..3 {
+            engine.restore(&checkpoint).unwrap();
+            assert_eq!(engine.snapshot().unwrap(), before);
+            assert_eq!(play(&engine), first);
+        }
+
+        let after = engine.snapshot().unwrap();
+        assert!(engine.restore(&checkpoint[..checkpoint.len() - 1]).is_err());
+        let mut corrupt = checkpoint.clone();
+        corrupt[16] ^= 0xFF; // build_id
+        assert!(engine.restore(&corrupt).is_err());
+        assert_eq!(engine.snapshot().unwrap(), after);
+    }
+
+    #[test]
+    #[serial]
+    fn test_string_results_reuse_arena() {
+        let mut engine = CGameEngine::new();
+        engine.init("Valkyrie", "Human", 1, 1).unwrap();
+
+        let generation = unsafe { nh_ffi_arena_generation() };
+        let first = engine.state_json();
+        assert!(first.starts_with('{'));
+        assert_eq!(unsafe { nh_ffi_arena_generation() }, generation + 1);
+
+        let capacity = unsafe { nh_ffi_arena_capacity() };
+        for _ in 0..100 {
+            assert_eq!(engine.state_json(), first);
+            engine.inventory_json();
+            engine.monsters_json();
+        }
+        assert_eq!(unsafe { nh_ffi_arena_capacity() }, capacity);
+
+        // Results of one generation stay valid together
+        unsafe {
+            let message = nh_ffi_get_result_message();
+            let state = nh_ffi_get_state_json();
+            assert_eq!(CStr::from_ptr(message).to_string_lossy(), "Game continues");
+            assert_eq!(CStr::from_ptr(state).to_string_lossy(), first);
+            nh_ffi_arena_reset();
+        }
+    }
+
+    #[test]
+    #[serial]
+    fn test_section_profile() {
+        let mut engine = CGameEngine::new();
+        engine.init("Valkyrie", "Human", 1, 1).unwrap();
+        engine.reset_section_profile();
+
+        let profile = engine.section_profile();
+        assert_eq!(profile.len(), NH_FFI_SECT_COUNT);
+        assert_eq!(profile[0].name, "movemon");
+        assert!(profile.iter().all(|p| p.total_calls == 0));
+    }
+
+    #[test]
+    #[serial]
+    fn test_log_mask_roundtrip() {
+        let engine = CGameEngine::new();
+        let old = engine.set_log_mask(NH_FFI_LOG_LIFECYCLE);
+        if cfg!(debug_assertions) {
+            assert_eq!(engine.log_mask(), NH_FFI_LOG_LIFECYCLE);
+        }
+        engine.set_log_mask(old);
+    }
+
+    #[test]
+    #[serial]
+    fn test_exec_cmds_matches_single_steps() {
+        let script = b"hjkl..";
+
+        let mut engine = CGameEngine::new();
+        engine.init("Valkyrie", "Human", 1, 1).unwrap();
+        engine.reset(42).unwrap();
+        let mut expected = Vec::new();
+        for &cmd in script {
+            let _ = engine.exec_cmd(cmd as char);
+            let (x, y) = engine.position();
+            expected.push((x, y, engine.hp(), engine.rng_call_count()));
+        }
+
+        engine.reset(42).unwrap();
+        let batch = engine.exec_cmds(script, true).unwrap();
+        assert_eq!(batch.digests.len(), batch.executed);
+        for (d, &(x, y, hp, rng)) in batch.digests.iter().zip(&expected) {
+            assert_eq!((d.x as i32, d.y as i32, d.hp, d.rng_calls), (x, y, hp, rng));
+        }
+    }
+
+    #[test]
+    #[serial]
+    fn test_step_digest_rng_hash_matches_nh_rng() {
+        let mut engine = CGameEngine::new();
+        engine.init("Valkyrie", "Human", 1, 1).unwrap();
+        engine.reset(42).unwrap();
+        assert_eq!(engine.step_digest().rng_hash, nh_rng::HASH_SEED);
+
+        let mut expected = nh_rng::HASH_SEED;
+        for limit in [2, 6, 20, 100] {
+            let r = engine.rng_rn2(limit);
+            expected = nh_rng::hash_rng_call(expected, nh_rng::RNG_FN_RN2, limit as u64, r as u64);
+        }
+        assert_eq!(engine.step_digest().rng_hash, expected);
+
+        engine.reset_rng_hash();
+        assert_eq!(engine.step_digest().rng_hash, nh_rng::HASH_SEED);
+    }
+
+    #[test]
+    #[serial]
+    fn test_rollouts_are_repeatable_and_leave_game_alone() {
+        let mut engine = CGameEngine::new();
+        engine.init("Valkyrie", "Human", 1, 1).unwrap();
+        engine.reset(42).unwrap();
+        engine.generate_and_place().unwrap();
+        let before = engine.step_digest();
+
+        let outcomes = engine.rollout(7, RolloutPolicy::Explore, 50, 4).unwrap();
+        assert_eq!(outcomes.len(), 4);
+        for o in &outcomes {
+            assert!(o.max_depth >= o.depth);
+            assert!(o.end != RolloutEnd::Alive || o.turns >= 50);
+        }
+        assert_eq!(engine.rollout(7, RolloutPolicy::Explore, 50, 4).unwrap(), outcomes);
+
+        let after = engine.step_digest();
+        assert_eq!((after.turn, after.x, after.y, after.hp), (before.turn, before.x, before.y, before.hp));
+    }
+
+    #[test]
+    #[serial]
+    fn test_rollout_callback_ends_rollouts() {
+        let mut engine = CGameEngine::new();
+        engine.init("Valkyrie", "Human", 1, 1).unwrap();
+        engine.reset(42).unwrap();
+
+        let mut asked = vec![0u32; 3];
+        let outcomes = engine
+            .rollout_with(1, 100, 3, |r, _last| {
+                asked[r] += 1;
+                (asked[r] <= 5).then_some(b'.')
+            })
+            .unwrap();
+        assert_eq!(asked, vec![6, 6, 6]);
+        for o in &outcomes {
+            assert_eq!((o.steps, o.end), (5, RolloutEnd::Stopped));
+        }
+    }
+
+    #[test]
+    #[serial]
+    fn test_monsters_near_matches_full_list() {
+        let mut engine = CGameEngine::new();
+        engine.init("Valkyrie", "Human", 1, 1).unwrap();
+        engine.reset(42).unwrap();
+        engine.generate_and_place().unwrap();
+
+        let all = CGameEngineTrait::snapshot(&engine).unwrap().monsters;
+        let (ux, uy) = engine.position();
+        for radius in [0, 3, 10, 100] {
+            let mut expected: Vec<_> = all
+                .iter()
+                .filter(|m| (m.x - ux).abs() <= radius && (m.y - uy).abs() <= radius)
+                .cloned()
+                .collect();
+            expected.sort_by_key(|m| (m.x, m.y));
+            assert_eq!(engine.monsters_near(ux, uy, radius), expected, "radius {}", radius);
+        }
+        assert!(engine.monsters_near(ux, uy, -1).is_empty());
+        assert_eq!(engine.monsters_in_rect(100, 100, -5, -5), Vec::new());
+    }
+
+    #[test]
+    #[serial]
+    fn test_headless_keeps_rng_stream() {
+        let script = b"hjkl..s.lh";
+        let run = |engine: &mut CGameEngine| {
+            engine.reset(42).unwrap();
+            engine.generate_and_place().unwrap();
+            script
+                .iter()
+                .map(|&cmd| {
+                    let _ = engine.exec_cmd(cmd as char);
+                    (engine.position(), engine.hp(), engine.rng_call_count())
+                })
+                .collect::<Vec<_>>()
+        };
+
+        let mut engine = CGameEngine::new();
+        engine.init("Valkyrie", "Human", 1, 1).unwrap();
+        let full = run(&mut engine);
+
+        let old = engine.set_headless(NH_FFI_HEADLESS_ALL);
+        assert_eq!(engine.headless(), NH_FFI_HEADLESS_ALL);
+        engine.reset_section_profile();
+        let headless = run(&mut engine);
+        assert!(engine.section_profile().iter().all(|p| p.total_nanos == 0));
+        engine.set_headless(old);
+
+        assert_eq!(headless, full);
+    }
+
+    #[test]
+    #[serial]
+    fn test_rng_skip_and_checkpoint() {
+        let mut engine = CGameEngine::new();
+        engine.init("Valkyrie", "Human", 1, 1).unwrap();
+        engine.reset(42).unwrap();
+
+        let checkpoint = engine.rng_checkpoint().unwrap();
+        let first: Vec<i32> = (0..10).map(|_| engine.rng_rn2(1000)).collect();
+        engine.rng_restore(&checkpoint).unwrap();
+        let again: Vec<i32> = (0..10).map(|_| engine.rng_rn2(1000)).collect();
+        assert_eq!(first, again);
+        assert!(engine.rng_restore(&checkpoint[1..]).is_err());
+
+        let before = engine.rng_call_count();
+        engine.rng_skip(1000);
+        #[cfg(real_nethack)]
+        assert_eq!(engine.rng_call_count(), before + 1000);
+        #[cfg(not(real_nethack))]
+        assert_eq!(engine.rng_call_count(), before);
+    }
+
+    #[test]
+    fn test_rng_trace_reader_detects_gaps() {
+        let mut bytes = Vec::new();
+        bytes.extend_from_slice(&NH_FFI_RNG_TRACE_MAGIC.to_ne_bytes());
+        bytes.extend_from_slice(&NH_FFI_RNG_TRACE_VERSION.to_ne_bytes());
+        bytes.extend_from_slice(&16u16.to_ne_bytes());
+        for seq in [0u32, 1, 3] {
+            bytes.extend_from_slice(&seq.to_ne_bytes());
+            bytes.extend_from_slice(&[NH_FFI_RNG_FN_RND, 0, 0, 0]);
+            bytes.extend_from_slice(&6i32.to_ne_bytes());
+            bytes.extend_from_slice(&4i32.to_ne_bytes());
+        }
+
+        let mut reader = RngTraceReader::new(&bytes[..]).unwrap();
+        let first = reader.next().unwrap().unwrap();
+        assert_eq!((first.func_name(), first.arg, first.result), ("rnd", 6, 4));
+        assert!(reader.next().unwrap().is_ok());
+        assert!(reader.next().unwrap().is_err());
+
+        // A partial record at the end is an error, not a clean EOF
+        let cut = &bytes[..8 + 16 + 5];
+        let records: Vec<_> = RngTraceReader::new(cut).unwrap().collect();
+        assert_eq!(records.len(), 2);
+        assert!(records[1].is_err());
+        assert!(RngTraceReader::new(&bytes[1..]).is_err());
+    }
+
+    #[test]
+    #[serial]
+    #[cfg(real_nethack)]
+    fn test_rng_stream_records_game_draws() {
+        use std::os::fd::AsRawFd;
+
+        let mut engine = CGameEngine::new();
+        engine.init("Valkyrie", "Human", 1, 1).unwrap();
+        engine.reset(42).unwrap();
+        engine.generate_and_place().unwrap();
+
+        let path = std::env::temp_dir().join(format!("nh-rng-stream-{}.bin", std::process::id()));
+        let file = std::fs::File::create(&path).unwrap();
+        engine.start_rng_trace_stream(file.as_raw_fd()).unwrap();
+        let before = engine.rng_call_count();
+        for cmd in "s..s".chars() {
+            let _ = engine.exec_cmd(cmd);
+        }
+        let draws = engine.rng_call_count() - before;
+        let streamed = engine.stop_rng_trace_stream().unwrap();
+        drop(file);
+
+        let records = RngTraceReader::new(std::fs::File::open(&path).unwrap())
+            .unwrap()
+            .read_all()
+            .unwrap();
+        let _ = std::fs::remove_file(&path);
+
+        // The game's own calls, not just the nh_ffi_rng_* wrappers
+        assert!(draws > 0);
+        assert!(!records.is_empty());
+        assert_eq!(records.len() as u64, streamed);
+        for r in records.iter().filter(|r| r.func == NH_FFI_RNG_FN_RN2 && r.arg > 0) {
+            assert!((0..r.arg).contains(&r.result), "{:?}", r);
+        }
+    }
+
+    /// A few turns of play replayed call by call through nh_rng from the
+    /// same position: every draw is in the stream, and both hashes agree.
+    #[test]
+    #[serial]
+    #[cfg(real_nethack)]
+    fn test_rng_hash_matches_nh_rng_after_play() {
+        use std::os::fd::AsRawFd;
+
+        let mut engine = CGameEngine::new();
+        engine.init("Valkyrie", "Human", 1, 1).unwrap();
+        engine.reset(42).unwrap();
+        engine.generate_and_place().unwrap();
+
+        let path = std::env::temp_dir().join(format!("nh-rng-hash-{}.bin", std::process::id()));
+        let file = std::fs::File::create(&path).unwrap();
+        let start = engine.rng_call_count();
+        engine.reset_rng_hash();
+        engine.start_rng_trace_stream(file.as_raw_fd()).unwrap();
+        for cmd in "s.s..".chars() {
+            let _ = engine.exec_cmd(cmd);
+        }
+        engine.stop_rng_trace_stream().unwrap();
+        drop(file);
+        let digest = engine.step_digest();
+        let records = RngTraceReader::new(std::fs::File::open(&path).unwrap())
+            .unwrap()
+            .read_all()
+            .unwrap();
+        let _ = std::fs::remove_file(&path);
+        assert!(!records.is_empty());
+
+        // A fresh hero: Luck 0, experience level 1
+        let mut rust = nh_rng::Isaac64::new(42);
+        rust.skip(start);
+        rust.enable_hashing();
+        for r in &records {
+            let x = r.arg as u32;
+            let got = match r.func {
+                // nh_rng's rn2(1) returns without drawing; next_uint draws
+                // and hashes as rn2 does
+                NH_FFI_RNG_FN_RN2 if x == 1 => rust.next_uint(1) as i32,
+                NH_FFI_RNG_FN_RN2 => rust.rn2(x) as i32,
+                NH_FFI_RNG_FN_RND => rust.rnd(x) as i32,
+                NH_FFI_RNG_FN_RNL => rust.rnl(x, 0) as i32,
+                NH_FFI_RNG_FN_RNE => rust.rne(x, 1) as i32,
+                NH_FFI_RNG_FN_RNZ => rust.rnz(r.arg, 1),
+                _ => panic!("unknown RNG function in {:?}", r),
+            };
+            assert_eq!(got, r.result, "{:?}", r);
+        }
+        assert_eq!(rust.call_count(), engine.rng_call_count());
+        assert_eq!(rust.rng_hash(), digest.rng_hash);
+    }
+
+    #[test]
+    fn test_level_export_rejects_bad_magic() {
+        let mut bytes = vec![0u8; std::mem::size_of::<CLevelHeader>()];
+        bytes[0] = 0xff;
+        assert!(CLevelExport::from_bytes(&bytes).is_err());
+        assert!(CLevelExport::from_bytes(&bytes[..8]).is_err());
+    }
+
     #[test]
     #[serial]
     fn test_unknown_command() {
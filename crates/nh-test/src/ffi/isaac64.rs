@@ -7,6 +7,7 @@ pub const ISAAC64_SZ: usize = 256;
 
 /// ISAAC64 context - matches struct isaac64_ctx from isaac64.h
 #[repr(C)]
+#[derive(Clone)]
 pub struct Isaac64Ctx {
     pub n: c_uint,
     pub r: [u64; ISAAC64_SZ],
@@ -28,6 +29,27 @@ unsafe extern "C" {
 
     /// Get next random value in [0, n)
     pub fn isaac64_next_uint(ctx: *mut Isaac64Ctx, n: u64) -> u64;
+
+    /// Copy the next `n` values into `out`, in `isaac64_next_uint64` order
+    pub fn isaac64_fill(ctx: *mut Isaac64Ctx, out: *mut u64, n: usize);
+
+    /// `n` draws of `isaac64_next_uint(ctx, limit)`; zeros if `limit <= 0`.
+    /// Returns the raw values taken, rejected ones included.
+    pub fn isaac64_rn2_bulk(ctx: *mut Isaac64Ctx, limit: c_int, out: *mut c_int, n: usize)
+    -> usize;
+
+    /// `rn2(limit)` on the game RNG
+    pub fn rn2(limit: c_int) -> c_int;
+
+    /// `n` draws of `rn2(limit)` on the game RNG
+    pub fn rn2_bulk(limit: c_int, out: *mut c_int, n: usize);
+}
+
+/// Saved position of a `CIsaac64` stream
+#[derive(Clone)]
+pub struct CIsaac64Checkpoint {
+    ctx: Box<Isaac64Ctx>,
+    call_count: u64,
 }
 
 /// Safe wrapper around the C ISAAC64 implementation
@@ -76,6 +98,107 @@ impl CIsaac64 {
         val
     }
 
+    /// Fill `out` with the next values of the stream, in `next_u64` order,
+    /// with one `isaac64_fill` call.
+    pub fn fill(&mut self, out: &mut [u64]) {
+        self.call_count += out.len() as u64;
+        unsafe { isaac64_fill(&mut self.ctx, out.as_mut_ptr(), out.len()) };
+    }
+
+    /// `next_uint(limit)` for every slot of `out`, with one
+    /// `isaac64_rn2_bulk` call. Rejected raw values are counted, as
+    /// `next_uint` counts them.
+    pub fn next_uint_bulk(&mut self, limit: i32, out: &mut [i32]) {
+        let drawn = unsafe { isaac64_rn2_bulk(&mut self.ctx, limit, out.as_mut_ptr(), out.len()) };
+        self.call_count += drawn as u64;
+    }
+
+    /// The raw context, e.g. to plant values in the result buffer
+    pub fn ctx_mut(&mut self) -> &mut Isaac64Ctx {
+        &mut self.ctx
+    }
+
+    /// `next_uint(x)` for every slot of `out`, drawn in blocks with
+    /// `fill`. Rejected raw values are dropped as `isaac64_next_uint` drops
+    /// them, and no more are drawn than slots are still empty, so the
+    /// stream stops where per-call draws would. Apart from those values
+    /// this is `rn2(x)`, and it is traced as such.
+    pub fn rn2_fill(&mut self, x: u32, out: &mut [u32]) {
+        if x == 0 {
+            out.fill(0);
+            return;
+        }
+        let n = x as u64;
+        let mut raw = [0u64; ISAAC64_SZ];
+        let mut done = 0;
+        while done < out.len() {
+            let raw = &mut raw[..(out.len() - done).min(ISAAC64_SZ)];
+            self.fill(raw);
+            let seq = self.call_count - raw.len() as u64;
+            for (i, &r) in raw.iter().enumerate() {
+                let v = r % n;
+                let d = r - v;
+                if d.wrapping_add(n - 1) < d {
+                    continue;
+                }
+                if self.tracing {
+                    self.trace.push(nh_rng::RngTraceEntry {
+                        seq: seq + i as u64,
+                        func: "rn2",
+                        arg: n,
+                        result: v,
+                        raw: r,
+                    });
+                }
+                out[done] = v as u32;
+                done += 1;
+            }
+        }
+    }
+
+    /// Discard the next `n` values, regenerating whole blocks in C.
+    ///
+    /// Neither the standalone nor the NetHack isaac64.c exports
+    /// `isaac64_update`, so a block refill is forced by emptying the result
+    /// buffer and drawing once, as `nh_rng_skip` does on the game RNG.
+    pub fn skip(&mut self, n: u64) {
+        self.call_count += n;
+        let avail = self.ctx.n as u64;
+        if n <= avail {
+            self.ctx.n -= n as c_uint;
+            return;
+        }
+        let mut left = n - avail;
+        while left > ISAAC64_SZ as u64 {
+            self.ctx.n = 0;
+            unsafe { isaac64_next_uint64(&mut self.ctx) };
+            left -= ISAAC64_SZ as u64;
+        }
+        self.ctx.n = 0;
+        unsafe { isaac64_next_uint64(&mut self.ctx) };
+        // The refill draw above already consumed one value
+        self.ctx.n = (ISAAC64_SZ as u64 - left) as c_uint;
+    }
+
+    /// Save the current stream position.
+    pub fn checkpoint(&self) -> CIsaac64Checkpoint {
+        CIsaac64Checkpoint {
+            ctx: Box::new(self.ctx.clone()),
+            call_count: self.call_count,
+        }
+    }
+
+    /// Rewind or fast-forward to a saved position.
+    pub fn restore(&mut self, checkpoint: &CIsaac64Checkpoint) {
+        self.ctx = (*checkpoint.ctx).clone();
+        self.call_count = checkpoint.call_count;
+    }
+
+    /// Total number of raw u64 values consumed
+    pub fn call_count(&self) -> u64 {
+        self.call_count
+    }
+
     /// Enable RNG tracing
     pub fn start_tracing(&mut self) {
         self.tracing = true;
@@ -89,7 +212,17 @@ impl CIsaac64 {
 
     /// Get a random value in [0, n)
     pub fn next_uint(&mut self, n: u64) -> u64 {
-        unsafe { isaac64_next_uint(&mut self.ctx, n) }
+        let before = self.ctx.n as u64;
+        let v = unsafe { isaac64_next_uint(&mut self.ctx, n) };
+        // Every raw value counts, rejected ones too. A refill leaves `n`
+        // above where it was; one call never rejects a whole block.
+        let after = self.ctx.n as u64;
+        self.call_count += if after < before {
+            before - after
+        } else {
+            before + ISAAC64_SZ as u64 - after
+        };
+        v
     }
 
     /// Returns a random value in [0, x) - matches rn2(x)
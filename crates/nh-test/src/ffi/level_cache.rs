@@ -0,0 +1,480 @@
+//! Cache of generated levels
+//!
+//! Reference levels are regenerated with the same seeds over and over, and
+//! every generation runs a full mklev(). `LevelCache` generates each key
+//! once and replays the result afterwards:
+//!
+//! - an entry keeps a level checkpoint, so a hit puts the live level, and
+//!   the monster births and id counter mklev() advanced, where the
+//!   generation left them. Hero, inventory and turn belong to the caller's
+//!   game and are never touched;
+//! - it also keeps the binary export and the RNG checkpoint taken after
+//!   mklev. Once its level checkpoint is evicted, or cannot be restored by
+//!   this build, a hit restores the RNG and returns the export but leaves
+//!   the live level alone. `with_live_level` regenerates instead.
+//!
+//! `LevelCache::persistent` writes entries to disk as well. Level
+//! checkpoints restore in any process running the same build, so disk hits
+//! in a later run replay the live level too.
+//!
+//! Keys cover the seed, dungeon level, character, everything else mklev()
+//! reads (`nh_ffi_level_inputs_id()`: difficulty, hero level, turn, id
+//! counter, monster births and uniques) and the C library build, so a hit
+//! is what generating would have made in the caller's game, and a rebuilt
+//! library never reads levels another build generated.
+
+use std::collections::{HashMap, VecDeque};
+use std::path::{Path, PathBuf};
+
+use nh_core::CGameEngineTrait;
+use nh_core::data::static_tables::fnv1a64;
+
+use super::game_engine::{CGameEngine, CLevelExport, nh_ffi_build_id};
+use super::static_tables::{cache_dir, write_atomic};
+
+/// "NHLC" little-endian
+const LEVEL_CACHE_MAGIC: u32 = 0x434C_484E;
+const LEVEL_CACHE_VERSION: u16 = 3;
+/// magic, version, reserved, key digest, export, RNG and level checkpoint
+/// sizes, reserved
+const LEVEL_CACHE_HEADER_SIZE: usize = 32;
+
+/// Level checkpoints kept in memory by default; older entries fall back to
+/// export plus RNG.
+pub const LEVEL_CACHE_DEFAULT_CHECKPOINTS: usize = 64;
+
+/// Everything a generation depends on.
+#[derive(Debug, Clone, PartialEq, Eq, Hash)]
+pub struct LevelKey {
+    pub seed: u64,
+    pub dnum: i32,
+    pub dlevel: i32,
+    pub role: String,
+    pub race: String,
+    pub gender: String,
+    pub alignment: String,
+    /// `nh_ffi_level_inputs_id()` when mklev() starts
+    pub inputs: u64,
+    /// `nh_ffi_build_id()` of the library that generated it
+    pub library: u64,
+}
+
+impl LevelKey {
+    /// The key `engine` would generate `dnum:dlevel` under after reseeding
+    /// with `seed`; the engine must already be on `dnum:dlevel`.
+    pub fn for_engine(engine: &CGameEngine, seed: u64, dnum: i32, dlevel: i32) -> Self {
+        Self {
+            seed,
+            dnum,
+            dlevel,
+            role: engine.role(),
+            race: engine.race(),
+            gender: engine.gender_string(),
+            alignment: engine.alignment_string(),
+            inputs: engine.level_inputs_id(),
+            library: unsafe { nh_ffi_build_id() },
+        }
+    }
+
+    /// Stable 64-bit digest, also the file name of the disk entry.
+    pub fn digest(&self) -> u64 {
+        let mut bytes = Vec::with_capacity(96);
+        bytes.extend_from_slice(&self.seed.to_le_bytes());
+        bytes.extend_from_slice(&self.dnum.to_le_bytes());
+        bytes.extend_from_slice(&self.dlevel.to_le_bytes());
+        for s in [&self.role, &self.race, &self.gender, &self.alignment] {
+            bytes.extend_from_slice(s.as_bytes());
+            bytes.push(0);
+        }
+        bytes.extend_from_slice(&self.inputs.to_le_bytes());
+        bytes.extend_from_slice(&self.library.to_le_bytes());
+        fnv1a64(&bytes)
+    }
+}
+
+struct CachedLevel {
+    export: CLevelExport,
+    /// RNG checkpoint after mklev()
+    rng: Vec<u8>,
+    /// Level checkpoint after mklev(), valid for this build
+    level: Option<Vec<u8>>,
+}
+
+/// Where a `LevelCache::generate` result came from
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum LevelSource {
+    Generated,
+    /// Live level and RNG restored from a level checkpoint
+    Checkpoint,
+    /// Export and RNG only; the live level is unchanged
+    ExportOnly,
+}
+
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct LevelCacheStats {
+    pub generated: u64,
+    pub memory_hits: u64,
+    pub disk_hits: u64,
+}
+
+pub struct LevelCache {
+    entries: HashMap<LevelKey, CachedLevel>,
+    /// Keys holding a level checkpoint, oldest first
+    checkpointed: VecDeque<LevelKey>,
+    max_checkpoints: usize,
+    /// Regenerate rather than serve an export-only hit
+    live: bool,
+    dir: Option<PathBuf>,
+    stats: LevelCacheStats,
+}
+
+impl Default for LevelCache {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl LevelCache {
+    /// In-memory cache for this process.
+    pub fn new() -> Self {
+        Self {
+            entries: HashMap::new(),
+            checkpointed: VecDeque::new(),
+            max_checkpoints: LEVEL_CACHE_DEFAULT_CHECKPOINTS,
+            live: false,
+            dir: None,
+            stats: LevelCacheStats::default(),
+        }
+    }
+
+    /// Cache that also reads and writes entries under `dir`.
+    pub fn persistent(dir: impl Into<PathBuf>) -> Self {
+        Self { dir: Some(dir.into()), ..Self::new() }
+    }
+
+    /// `$NH_LEVEL_CACHE`, or `levels/` in the static tables cache directory.
+    pub fn default_dir() -> PathBuf {
+        std::env::var_os("NH_LEVEL_CACHE").map_or_else(|| cache_dir().join("levels"), PathBuf::from)
+    }
+
+    /// Keep at most `n` level checkpoints in memory.
+    pub fn with_max_checkpoints(mut self, n: usize) -> Self {
+        self.max_checkpoints = n;
+        self
+    }
+
+    /// Only serve hits that leave the live level as the generation did, for
+    /// callers that keep playing it. Export-only hits are regenerated
+    /// instead.
+    pub fn with_live_level(mut self) -> Self {
+        self.live = true;
+        self
+    }
+
+    pub fn stats(&self) -> LevelCacheStats {
+        self.stats
+    }
+
+    pub fn len(&self) -> usize {
+        self.entries.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.entries.is_empty()
+    }
+
+    /// Generate dungeon level `dnum:dlevel` from a fresh RNG seeded with
+    /// `seed` and export it, like the worker's `GenerateLevelBin`, unless
+    /// the cache already holds it. Either way the RNG ends where mklev()
+    /// left it.
+    pub fn generate(
+        &mut self,
+        engine: &CGameEngine,
+        seed: u64,
+        dnum: i32,
+        dlevel: i32,
+    ) -> Result<(CLevelExport, LevelSource), String> {
+        engine.set_dlevel(dnum, dlevel);
+        engine.reset_rng(seed)?;
+        let key = LevelKey::for_engine(engine, seed, dnum, dlevel);
+
+        if let Some(entry) = self.entries.get(&key)
+            && let Some(source) = replay(engine, entry, self.live)
+        {
+            self.stats.memory_hits += 1;
+            return Ok((entry.export.clone(), source));
+        }
+        // The disk copy may still hold a level checkpoint evicted from
+        // memory; an entry this build cannot replay is regenerated
+        if let Some(entry) = self.load(&key)
+            && let Some(source) = replay(engine, &entry, self.live)
+        {
+            let export = entry.export.clone();
+            self.insert(key, entry);
+            self.stats.disk_hits += 1;
+            return Ok((export, source));
+        }
+
+        engine.generate_level()?;
+        let export = engine.export_level_bin()?;
+        self.stats.generated += 1;
+        // Without its RNG state an entry could not be replayed at all
+        if let Ok(rng) = engine.rng_checkpoint() {
+            let keep_level = self.max_checkpoints > 0 || self.dir.is_some();
+            let entry = CachedLevel {
+                export: export.clone(),
+                rng,
+                level: if keep_level { engine.level_checkpoint().ok() } else { None },
+            };
+            self.store(&key, &entry);
+            self.insert(key, entry);
+        }
+        Ok((export, LevelSource::Generated))
+    }
+
+    fn insert(&mut self, key: LevelKey, entry: CachedLevel) {
+        self.checkpointed.retain(|k| *k != key);
+        if entry.level.is_some() {
+            self.checkpointed.push_back(key.clone());
+        }
+        self.entries.insert(key, entry);
+        self.evict_checkpoints();
+    }
+
+    fn evict_checkpoints(&mut self) {
+        while self.checkpointed.len() > self.max_checkpoints {
+            let Some(key) = self.checkpointed.pop_front() else { break };
+            if let Some(entry) = self.entries.get_mut(&key) {
+                entry.level = None;
+            }
+        }
+    }
+
+    /// None without a disk cache, or for a build that cannot be told
+    /// apart from others.
+    fn entry_path(&self, key: &LevelKey) -> Option<PathBuf> {
+        if key.library == 0 {
+            return None;
+        }
+        Some(self.dir.as_ref()?.join(format!("{:016x}.lvl", key.digest())))
+    }
+
+    fn load(&self, key: &LevelKey) -> Option<CachedLevel> {
+        let bytes = std::fs::read(self.entry_path(key)?).ok()?;
+        decode_entry(&bytes, key.digest())
+    }
+
+    fn store(&self, key: &LevelKey, entry: &CachedLevel) {
+        let Some(path) = self.entry_path(key) else { return };
+        let (export, rng) = (entry.export.as_bytes(), &entry.rng);
+        let level = entry.level.as_deref().unwrap_or_default();
+        let mut bytes = Vec::with_capacity(
+            LEVEL_CACHE_HEADER_SIZE + export.len() + rng.len() + level.len() + 8,
+        );
+        bytes.extend_from_slice(&LEVEL_CACHE_MAGIC.to_le_bytes());
+        bytes.extend_from_slice(&LEVEL_CACHE_VERSION.to_le_bytes());
+        bytes.extend_from_slice(&0u16.to_le_bytes());
+        bytes.extend_from_slice(&key.digest().to_le_bytes());
+        bytes.extend_from_slice(&(export.len() as u32).to_le_bytes());
+        bytes.extend_from_slice(&(rng.len() as u32).to_le_bytes());
+        bytes.extend_from_slice(&(level.len() as u32).to_le_bytes());
+        bytes.extend_from_slice(&0u32.to_le_bytes());
+        bytes.extend_from_slice(export);
+        bytes.extend_from_slice(rng);
+        bytes.extend_from_slice(level);
+        let hash = fnv1a64(&bytes);
+        bytes.extend_from_slice(&hash.to_le_bytes());
+        // Losing an entry only costs a regeneration
+        if let Err(e) = write_atomic(&path, &bytes) {
+            eprintln!("Cannot write level cache entry {}: {}", path.display(), e);
+        }
+    }
+
+    /// Drop every disk entry under `dir`.
+    pub fn clear_dir(dir: &Path) -> std::io::Result<()> {
+        for entry in std::fs::read_dir(dir)? {
+            let path = entry?.path();
+            if path.extension().is_some_and(|ext| ext == "lvl") {
+                std::fs::remove_file(path)?;
+            }
+        }
+        Ok(())
+    }
+}
+
+/// Put `engine` where the generation of `entry` left it, as far as the
+/// entry can: the level from its level checkpoint and the RNG, else
+/// (unless `live`) the RNG alone. None if neither applies. A failed level
+/// restore leaves the level alone, and the RNG is restored last, so on
+/// None the caller can still generate from the reseeded RNG.
+fn replay(engine: &CGameEngine, entry: &CachedLevel, live: bool) -> Option<LevelSource> {
+    let level = entry.level.as_ref().is_some_and(|level| engine.restore_level(level).is_ok());
+    if !level && live {
+        return None;
+    }
+    engine.rng_restore(&entry.rng).ok()?;
+    Some(if level { LevelSource::Checkpoint } else { LevelSource::ExportOnly })
+}
+
+fn decode_entry(bytes: &[u8], digest: u64) -> Option<CachedLevel> {
+    let u32_at = |off: usize| u32::from_le_bytes(bytes[off..off + 4].try_into().unwrap());
+    let u64_at = |off: usize| u64::from_le_bytes(bytes[off..off + 8].try_into().unwrap());
+
+    if bytes.len() < LEVEL_CACHE_HEADER_SIZE + 8
+        || u32_at(0) != LEVEL_CACHE_MAGIC
+        || u16::from_le_bytes([bytes[4], bytes[5]]) != LEVEL_CACHE_VERSION
+        || u64_at(8) != digest
+    {
+        return None;
+    }
+    let body = bytes.len() - 8;
+    if fnv1a64(&bytes[..body]) != u64_at(body) {
+        return None;
+    }
+    let (export_len, rng_len) = (u32_at(16) as usize, u32_at(20) as usize);
+    let export_end = LEVEL_CACHE_HEADER_SIZE.checked_add(export_len)?;
+    let rng_end = export_end.checked_add(rng_len)?;
+    if rng_end.checked_add(u32_at(24) as usize)? != body {
+        return None;
+    }
+    Some(CachedLevel {
+        export: CLevelExport::from_bytes(&bytes[LEVEL_CACHE_HEADER_SIZE..export_end]).ok()?,
+        rng: bytes[export_end..rng_end].to_vec(),
+        level: (rng_end < body).then(|| bytes[rng_end..body].to_vec()),
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use nh_core::CGameEngineTrait;
+    use serial_test::serial;
+
+    fn engine() -> CGameEngine {
+        let mut engine = CGameEngine::new();
+        engine.init("Valkyrie", "Human", 1, 1).unwrap();
+        engine
+    }
+
+    #[test]
+    #[serial]
+    fn test_memory_hit_replays_generation() {
+        let engine = engine();
+        let start = engine.checkpoint().unwrap();
+        let mut cache = LevelCache::new();
+
+        let (first, source) = cache.generate(&engine, 42, 0, 1).unwrap();
+        assert_eq!(source, LevelSource::Generated);
+        let rng_after = engine.rng_call_count();
+
+        // mklev() moved births and ids on, which would key a repeat apart;
+        // go back to the game it was generated in, then move the RNG on so
+        // a hit has to put it back
+        engine.restore(&start).unwrap();
+        engine.rng_rn2(10);
+        let (again, _) = cache.generate(&engine, 42, 0, 1).unwrap();
+        assert_eq!(again, first);
+        assert_eq!(engine.rng_call_count(), rng_after);
+
+        engine.restore(&start).unwrap();
+        let (other, source) = cache.generate(&engine, 43, 0, 1).unwrap();
+        assert_eq!(source, LevelSource::Generated);
+        assert_eq!(cache.stats().generated, 2);
+        assert_eq!(cache.stats().memory_hits + cache.stats().disk_hits, 1);
+        #[cfg(real_nethack)]
+        assert_ne!(other, first);
+        let _ = other;
+    }
+
+    #[test]
+    #[serial]
+    fn test_hit_leaves_the_hero_alone() {
+        let engine = engine();
+        let start = engine.checkpoint().unwrap();
+        let mut cache = LevelCache::new();
+        let (first, _) = cache.generate(&engine, 42, 0, 1).unwrap();
+
+        // Same generation inputs, but a hero the entry never saw
+        engine.restore(&start).unwrap();
+        engine.test_setup_status(3, 40, 1, 2);
+        let (again, source) = cache.generate(&engine, 42, 0, 1).unwrap();
+        assert_eq!(source, LevelSource::Checkpoint);
+        assert_eq!(again, first);
+        assert_eq!((engine.hp(), engine.max_hp()), (3, 40));
+    }
+
+    #[test]
+    #[serial]
+    fn test_disk_entries_survive_the_cache() {
+        let dir = std::env::temp_dir().join(format!("nh-level-cache-{}", std::process::id()));
+        let engine = engine();
+        let start = engine.checkpoint().unwrap();
+
+        let mut writer = LevelCache::persistent(&dir);
+        let (export, _) = writer.generate(&engine, 7, 0, 2).unwrap();
+        let rng_after = engine.rng_call_count();
+        drop(writer);
+
+        // Back to the game it was generated in, whose own level 1 is live
+        // when the entry is read back
+        engine.restore(&start).unwrap();
+
+        let mut reader = LevelCache::persistent(&dir).with_live_level();
+        let (again, source) = reader.generate(&engine, 7, 0, 2).unwrap();
+        assert_eq!(source, LevelSource::Checkpoint);
+        assert_eq!(reader.stats().disk_hits, 1);
+        assert_eq!(again, export);
+        assert_eq!(engine.export_level_bin().unwrap(), export);
+        assert_eq!(engine.rng_call_count(), rng_after);
+
+        let _ = std::fs::remove_dir_all(&dir);
+    }
+
+    #[test]
+    #[serial]
+    fn test_live_level_regenerates_export_only_hits() {
+        let engine = engine();
+        let start = engine.checkpoint().unwrap();
+        let mut cache = LevelCache::new().with_max_checkpoints(0);
+        let (first, _) = cache.generate(&engine, 42, 0, 1).unwrap();
+        engine.restore(&start).unwrap();
+        cache.generate(&engine, 43, 0, 1).unwrap();
+
+        // Without a level checkpoint a plain hit leaves level 43 live
+        engine.restore(&start).unwrap();
+        let (again, source) = cache.generate(&engine, 42, 0, 1).unwrap();
+        assert_eq!((again, source), (first.clone(), LevelSource::ExportOnly));
+
+        engine.restore(&start).unwrap();
+        let mut cache = cache.with_live_level();
+        let (again, source) = cache.generate(&engine, 42, 0, 1).unwrap();
+        assert_eq!((again, source), (first.clone(), LevelSource::Generated));
+        assert_eq!(engine.export_level_bin().unwrap(), first);
+    }
+
+    #[test]
+    fn test_key_digest_covers_every_field() {
+        let base = LevelKey {
+            seed: 1,
+            dnum: 0,
+            dlevel: 1,
+            role: "Valkyrie".into(),
+            race: "Human".into(),
+            gender: "Female".into(),
+            alignment: "Lawful".into(),
+            inputs: 0,
+            library: 9,
+        };
+        let variants = [
+            LevelKey { seed: 2, ..base.clone() },
+            LevelKey { dlevel: 2, ..base.clone() },
+            LevelKey { role: "Wizard".into(), ..base.clone() },
+            LevelKey { inputs: 1, ..base.clone() },
+            LevelKey { library: 10, ..base.clone() },
+        ];
+        for key in &variants {
+            assert_ne!(key.digest(), base.digest(), "{:?}", key);
+        }
+        assert!(decode_entry(&[0; 16], base.digest()).is_none());
+    }
+}
@@ -2,11 +2,34 @@
 //!
 //! - `isaac64`: ISAAC64 RNG bindings for comparison testing
 //! - `game_engine`: Game engine FFI (init, commands, state queries, calculations)
+//! - `level_cache`: Generated levels kept in memory and on disk by seed and dlevel
+//! - `recorder`: Columnar, chunked recordings of worker episodes
+//! - `pipeline`: Several worker commands in flight at once, answered as futures
+//! - `pool`: Pre-initialized subprocess workers for seed sweeps
+//! - `context`: Parked games for running several C games in one process
+//! - `wire`: Binary framing for the worker protocol
+//! - `shm`: Shared memory for bulk data between harness and worker
+//! - `static_tables`: Memory-mapped cache of the C monster, object and role tables
+//! - `startup_image`: Cached result of the C engine's one-time table setup
 
+pub mod context;
 pub mod game_engine;
 pub mod isaac64;
+pub mod level_cache;
+pub mod pipeline;
+pub mod pool;
+pub mod recorder;
+pub mod shm;
+pub mod startup_image;
+pub mod static_tables;
 pub mod subprocess;
+pub mod wire;
 
+pub use context::CGameContext;
 pub use game_engine::CGameEngine;
-pub use isaac64::CIsaac64;
+pub use isaac64::{CIsaac64, CIsaac64Checkpoint};
+pub use level_cache::LevelCache;
+pub use pipeline::{Pipeline, Reply};
+pub use pool::{WorkerPool, WorkerSpec};
+pub use recorder::{EpisodeReader, EpisodeRecorder};
 pub use subprocess::CGameEngineSubprocess;
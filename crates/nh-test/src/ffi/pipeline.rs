@@ -0,0 +1,446 @@
+//! Pipelined commands to a subprocess worker.
+//!
+//! `CGameEngineSubprocess` waits for every reply before sending the next
+//! command, so `exec_cmd`, `hp`, `position`, `export_level_bin` cost four
+//! pipe round trips. A `Pipeline` queues commands instead and hands back a
+//! `Reply` future for each; queued frames go out in one write when a reply
+//! is first awaited (or on `flush`), and a reader thread completes the
+//! replies as responses arrive.
+//!
+//! The worker answers strictly in order, so a reply is matched to its
+//! request by sequence number (`Reply::id`) and the wire protocol is
+//! unchanged. Replies only use `std::task` wakers, so they can be awaited
+//! on tokio or any other executor, or blocked on with `Reply::wait`.
+
+use std::collections::VecDeque;
+use std::fs::File;
+use std::future::Future;
+use std::io::{BufReader, BufWriter, Write};
+use std::marker::PhantomData;
+use std::pin::{Pin, pin};
+use std::sync::{Arc, Mutex};
+use std::task::{Context, Poll, Wake, Waker};
+use std::thread::{self, JoinHandle, Thread};
+
+use anyhow::{Result, anyhow};
+
+use super::game_engine::{CLevelExport, CStepDigest, StepBatch};
+use super::subprocess::{CGameEngineSubprocess, CommandMsg, ResponseMsg};
+use super::wire;
+
+enum SlotState {
+    Waiting(Option<Waker>),
+    Ready(std::result::Result<ResponseMsg, String>),
+    Taken,
+}
+
+/// Where the reader thread leaves one response
+struct Slot {
+    state: Mutex<SlotState>,
+}
+
+impl Slot {
+    fn complete(&self, response: std::result::Result<ResponseMsg, String>) {
+        let prev = std::mem::replace(&mut *self.state.lock().unwrap(), SlotState::Ready(response));
+        if let SlotState::Waiting(Some(waker)) = prev {
+            waker.wake();
+        }
+    }
+}
+
+struct Pending {
+    /// Requests sent and not yet answered, oldest first; `true` marks the
+    /// fence after which the reader thread stops
+    slots: VecDeque<(Arc<Slot>, bool)>,
+    next_id: u64,
+    /// Set once the pipes fail; later requests fail immediately
+    closed: Option<String>,
+}
+
+struct Outgoing {
+    out: BufWriter<File>,
+    /// Frames queued since the last flush
+    dirty: bool,
+}
+
+struct Shared {
+    outgoing: Mutex<Outgoing>,
+    pending: Mutex<Pending>,
+}
+
+impl Shared {
+    fn fail_all(&self, reason: String) {
+        let slots = {
+            let mut pending = self.pending.lock().unwrap();
+            pending.closed.get_or_insert(reason.clone());
+            std::mem::take(&mut pending.slots)
+        };
+        for (slot, _) in slots {
+            slot.complete(Err(reason.clone()));
+        }
+    }
+
+    fn flush(&self) -> Result<()> {
+        let mut outgoing = self.outgoing.lock().unwrap();
+        if !outgoing.dirty {
+            return Ok(());
+        }
+        outgoing.dirty = false;
+        if let Err(e) = outgoing.out.flush() {
+            drop(outgoing);
+            let reason = format!("Failed to write to worker: {}", e);
+            self.fail_all(reason.clone());
+            return Err(anyhow!(reason));
+        }
+        Ok(())
+    }
+}
+
+fn read_responses(shared: Arc<Shared>, reader: File) {
+    let mut reader = BufReader::new(reader);
+    let mut frame = Vec::new();
+    loop {
+        let response = match wire::read_frame(&mut reader, &mut frame) {
+            Ok(Some(())) => wire::from_slice::<ResponseMsg>(&frame).map_err(|e| format!("Failed to decode worker response: {}", e)),
+            Ok(None) => return shared.fail_all("Worker process exited unexpectedly".to_string()),
+            Err(e) => return shared.fail_all(format!("Failed to read from worker: {}", e)),
+        };
+        let Some((slot, fence)) = shared.pending.lock().unwrap().slots.pop_front() else {
+            return shared.fail_all("Worker sent a response nobody asked for".to_string());
+        };
+        slot.complete(response);
+        if fence {
+            return;
+        }
+    }
+}
+
+/// A response on its way back from the worker.
+///
+/// Awaiting it (or calling `wait`) first flushes the commands queued so far.
+#[must_use = "a reply does nothing unless awaited"]
+pub struct Reply<T> {
+    id: u64,
+    slot: Arc<Slot>,
+    shared: Arc<Shared>,
+    decode: fn(ResponseMsg) -> Result<T>,
+}
+
+impl<T> Reply<T> {
+    /// Position of the request in the pipeline
+    pub fn id(&self) -> u64 {
+        self.id
+    }
+
+    /// Whether the response has arrived
+    pub fn is_ready(&self) -> bool {
+        matches!(*self.slot.state.lock().unwrap(), SlotState::Ready(_))
+    }
+
+    /// Block the current thread until the response arrives.
+    pub fn wait(self) -> Result<T> {
+        block_on(self)
+    }
+}
+
+impl<T> Future for Reply<T> {
+    type Output = Result<T>;
+
+    fn poll(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<Result<T>> {
+        let mut state = self.slot.state.lock().unwrap();
+        match std::mem::replace(&mut *state, SlotState::Taken) {
+            SlotState::Ready(response) => Poll::Ready(response.map_err(|e| anyhow!(e)).and_then(self.decode)),
+            SlotState::Waiting(_) => {
+                *state = SlotState::Waiting(Some(cx.waker().clone()));
+                drop(state);
+                // The response cannot come before the request has gone out
+                if let Err(e) = self.shared.flush() {
+                    return Poll::Ready(Err(e));
+                }
+                Poll::Pending
+            }
+            SlotState::Taken => panic!("Reply polled after it completed"),
+        }
+    }
+}
+
+struct ThreadWaker(Thread);
+
+impl Wake for ThreadWaker {
+    fn wake(self: Arc<Self>) {
+        self.0.unpark();
+    }
+}
+
+fn block_on<F: Future>(future: F) -> F::Output {
+    let waker = Waker::from(Arc::new(ThreadWaker(thread::current())));
+    let mut cx = Context::from_waker(&waker);
+    let mut future = pin!(future);
+    loop {
+        if let Poll::Ready(value) = future.as_mut().poll(&mut cx) {
+            return value;
+        }
+        thread::park();
+    }
+}
+
+fn unexpected<T>(response: ResponseMsg) -> Result<T> {
+    match response {
+        ResponseMsg::Error(e) => Err(anyhow!(e)),
+        other => Err(anyhow!("Unexpected response: {:?}", other)),
+    }
+}
+
+fn ok(response: ResponseMsg) -> Result<()> {
+    match response {
+        ResponseMsg::Ok => Ok(()),
+        other => unexpected(other),
+    }
+}
+
+fn int(response: ResponseMsg) -> Result<i32> {
+    match response {
+        ResponseMsg::Int(v) => Ok(v),
+        other => unexpected(other),
+    }
+}
+
+fn long(response: ResponseMsg) -> Result<u64> {
+    match response {
+        ResponseMsg::Long(v) => Ok(v),
+        other => unexpected(other),
+    }
+}
+
+/// Commands in flight to one worker.
+///
+/// Borrowing the worker keeps its blocking methods from reading the
+/// pipeline's responses. Dropping the pipeline waits for every reply still
+/// outstanding, so the worker is back in lockstep afterwards.
+///
+/// There is deliberately no `fork_session` or `end_fork_session`: the
+/// forked child shares the worker's buffered input, so nothing may be
+/// queued behind either (see `ForkSession` in nh-test-worker).
+pub struct Pipeline<'a> {
+    shared: Arc<Shared>,
+    reader: Option<JoinHandle<()>>,
+    _worker: PhantomData<&'a mut ()>,
+}
+
+impl<'a> Pipeline<'a> {
+    pub(super) fn new(worker: &'a mut CGameEngineSubprocess) -> Result<Self> {
+        if !worker.is_binary() {
+            return Err(anyhow!("Pipelining needs the binary worker protocol"));
+        }
+        let (writer, reader) = worker.dup_pipes()?;
+        let shared = Arc::new(Shared {
+            outgoing: Mutex::new(Outgoing { out: BufWriter::new(writer), dirty: false }),
+            pending: Mutex::new(Pending { slots: VecDeque::new(), next_id: 0, closed: None }),
+        });
+        let thread_shared = Arc::clone(&shared);
+        let reader = thread::Builder::new()
+            .name("nh-pipeline".to_string())
+            .spawn(move || read_responses(thread_shared, reader))?;
+        Ok(Self { shared, reader: Some(reader), _worker: PhantomData })
+    }
+
+    fn submit<T>(&self, cmd: CommandMsg, fence: bool, decode: fn(ResponseMsg) -> Result<T>) -> Reply<T> {
+        let slot = Arc::new(Slot { state: Mutex::new(SlotState::Waiting(None)) });
+        let payload = wire::to_vec(&cmd).map_err(|e| format!("Failed to encode command: {}", e));
+        // Holding the writer while queueing keeps slots in frame order
+        let mut outgoing = self.shared.outgoing.lock().unwrap();
+        let (id, queued) = {
+            let mut guard = self.shared.pending.lock().unwrap();
+            let pending = &mut *guard;
+            let id = pending.next_id;
+            pending.next_id += 1;
+            let queued = match (&pending.closed, &payload) {
+                (Some(reason), _) | (None, Err(reason)) => {
+                    slot.complete(Err(reason.clone()));
+                    None
+                }
+                (None, Ok(payload)) => {
+                    pending.slots.push_back((Arc::clone(&slot), fence));
+                    Some(payload)
+                }
+            };
+            (id, queued)
+        };
+        if let Some(payload) = queued {
+            match wire::queue_frame(&mut outgoing.out, payload) {
+                Ok(()) => outgoing.dirty = true,
+                Err(e) => {
+                    drop(outgoing);
+                    self.shared.fail_all(format!("Failed to write to worker: {}", e));
+                }
+            }
+        }
+        Reply { id, slot, shared: Arc::clone(&self.shared), decode }
+    }
+
+    /// Send every queued command now.
+    pub fn flush(&self) -> Result<()> {
+        self.shared.flush()
+    }
+
+    /// Requests sent or queued that have no response yet
+    pub fn in_flight(&self) -> usize {
+        self.shared.pending.lock().unwrap().slots.len()
+    }
+
+    pub fn reset(&self, seed: u64) -> Reply<()> {
+        self.submit(CommandMsg::Reset { seed }, false, ok)
+    }
+
+    pub fn exec_cmd(&self, cmd: char) -> Reply<()> {
+        self.submit(CommandMsg::ExecCmd { cmd }, false, ok)
+    }
+
+    pub fn exec_cmd_dir(&self, cmd: char, dx: i32, dy: i32) -> Reply<()> {
+        self.submit(CommandMsg::ExecCmdDir { cmd, dx, dy }, false, ok)
+    }
+
+    pub fn exec_cmds(&self, cmds: &str, record: bool) -> Reply<StepBatch> {
+        self.submit(CommandMsg::ExecCmds { cmds: cmds.to_string(), record }, false, |response| match response {
+            ResponseMsg::StepBatch(batch) => Ok(batch),
+            other => unexpected(other),
+        })
+    }
+
+    pub fn hp(&self) -> Reply<i32> {
+        self.submit(CommandMsg::GetHp, false, int)
+    }
+
+    pub fn max_hp(&self) -> Reply<i32> {
+        self.submit(CommandMsg::GetMaxHp, false, int)
+    }
+
+    pub fn position(&self) -> Reply<(i32, i32)> {
+        self.submit(CommandMsg::GetPosition, false, |response| match response {
+            ResponseMsg::Pos(x, y) => Ok((x, y)),
+            other => unexpected(other),
+        })
+    }
+
+    pub fn turn_count(&self) -> Reply<u64> {
+        self.submit(CommandMsg::GetTurnCount, false, long)
+    }
+
+    pub fn rng_call_count(&self) -> Reply<u64> {
+        self.submit(CommandMsg::GetRngCallCount, false, |response| int(response).map(|n| n as u64))
+    }
+
+    pub fn is_dead(&self) -> Reply<bool> {
+        self.submit(CommandMsg::IsDead, false, |response| match response {
+            ResponseMsg::Bool(b) => Ok(b),
+            other => unexpected(other),
+        })
+    }
+
+    pub fn last_message(&self) -> Reply<String> {
+        self.submit(CommandMsg::GetLastMessage, false, |response| match response {
+            ResponseMsg::String(s) => Ok(s),
+            other => unexpected(other),
+        })
+    }
+
+    pub fn snapshot(&self) -> Reply<nh_core::CGameSnapshot> {
+        self.submit(CommandMsg::GetSnapshot, false, |response| match response {
+            ResponseMsg::Snapshot(snapshot) => Ok(snapshot),
+            other => unexpected(other),
+        })
+    }
+
+    pub fn step_digest(&self) -> Reply<CStepDigest> {
+        self.submit(CommandMsg::GetStepDigest, false, |response| match response {
+            ResponseMsg::StepDigest(digest) => Ok(digest),
+            other => unexpected(other),
+        })
+    }
+
+    /// Binary level export through the pipe (shared memory is not used).
+    pub fn export_level_bin(&self) -> Reply<CLevelExport> {
+        self.submit(CommandMsg::ExportLevelBin, false, |response| match response {
+            ResponseMsg::Bytes(bytes) => CLevelExport::from_bytes(&bytes).map_err(|e| anyhow!(e)),
+            other => unexpected(other),
+        })
+    }
+}
+
+impl Drop for Pipeline<'_> {
+    fn drop(&mut self) {
+        // A harmless command whose response tells the reader thread that
+        // every earlier one has been delivered
+        let fence = self.submit(CommandMsg::GetTurnCount, true, long);
+        let _ = self.flush();
+        drop(fence);
+        if let Some(reader) = self.reader.take() {
+            let _ = reader.join();
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::subprocess::worker_command;
+    use nh_core::CGameEngineTrait;
+
+    fn worker(seed: u64) -> CGameEngineSubprocess {
+        let mut worker = CGameEngineSubprocess::spawn(worker_command()).unwrap();
+        worker.init("Valkyrie", "Human", 1, 1).unwrap();
+        worker.reset(seed).unwrap();
+        worker
+    }
+
+    #[test]
+    fn test_pipelined_replies_match_blocking_calls() {
+        let script = "hjkl.s";
+        let expected = {
+            let worker = worker(42);
+            let mut rows = Vec::new();
+            for cmd in script.chars() {
+                let _ = worker.exec_cmd(cmd);
+                rows.push((worker.hp(), worker.position(), worker.turn_count()));
+            }
+            rows
+        };
+
+        let mut worker = worker(42);
+        {
+            let pipeline = worker.pipeline().unwrap();
+            let replies: Vec<_> = script
+                .chars()
+                .map(|cmd| (pipeline.exec_cmd(cmd), pipeline.hp(), pipeline.position(), pipeline.turn_count()))
+                .collect();
+            assert_eq!(pipeline.in_flight(), script.len() * 4);
+            assert_eq!(replies.last().unwrap().3.id(), script.len() as u64 * 4 - 1);
+
+            let rows: Vec<_> = replies
+                .into_iter()
+                .map(|(exec, hp, pos, turn)| {
+                    let _ = exec.wait();
+                    (hp.wait().unwrap(), pos.wait().unwrap(), turn.wait().unwrap())
+                })
+                .collect();
+            assert_eq!(rows, expected);
+        }
+        // Back in lockstep once the pipeline is gone
+        assert_eq!(worker.position(), expected.last().unwrap().1);
+    }
+
+    #[test]
+    fn test_replies_await_in_any_order_and_outlive_errors() {
+        let mut worker = worker(7);
+        let pipeline = worker.pipeline().unwrap();
+        let first = pipeline.position();
+        let bad = pipeline.exec_cmds("zzz", false);
+        let last = pipeline.turn_count();
+
+        // Awaiting the last reply first still completes the earlier ones
+        assert!(last.wait().is_ok());
+        assert!(first.is_ready());
+        let _ = bad.wait();
+        assert!(block_on(first).is_ok());
+    }
+}
@@ -0,0 +1,399 @@
+//! Pool of pre-initialized `nh-test-worker` processes.
+//!
+//! Every worker runs `nh_ffi_init` (and with it the one-time
+//! `dlb_init`/`init_objects`/`init_dungeons`/`monst_init` sequence) once
+//! when it is spawned. A checkout only reseeds it with `nh_ffi_reset`.
+//! Workers that die, e.g. through `ffi_crash_handler`, are dropped and
+//! replaced on the next checkout.
+//!
+//! With `WorkerSpec::snapshot` a checkout forks a session from the
+//! worker's post-init image instead, so no state leaks between seeds.
+
+use std::ops::{Deref, DerefMut};
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::{Condvar, Mutex};
+
+use anyhow::{Result, anyhow};
+use nh_core::CGameEngineTrait;
+
+use super::shm::SHM_DEFAULT_SIZE;
+use super::subprocess::{CGameEngineSubprocess, worker_command};
+
+/// Character every pooled worker is initialized with
+#[derive(Debug, Clone)]
+pub struct WorkerSpec {
+    pub role: String,
+    pub race: String,
+    pub gender: i32,
+    pub align: i32,
+    /// Run each checkout in a forked session (see `fork_session`)
+    pub snapshot: bool,
+    /// Attach a shared region for level exports and sight grids
+    pub shared_memory: bool,
+    /// `NH_FFI_HEADLESS_*` flags, for rollouts that only read outcomes
+    pub headless: u32,
+}
+
+impl Default for WorkerSpec {
+    fn default() -> Self {
+        Self {
+            role: "Valkyrie".to_string(),
+            race: "Human".to_string(),
+            gender: 1,
+            align: 1,
+            snapshot: false,
+            shared_memory: false,
+            headless: 0,
+        }
+    }
+}
+
+struct PoolState {
+    idle: Vec<CGameEngineSubprocess>,
+    /// Workers alive, idle or checked out
+    live: usize,
+}
+
+pub struct WorkerPool {
+    spec: WorkerSpec,
+    size: usize,
+    state: Mutex<PoolState>,
+    returned: Condvar,
+    /// Workers replaced after dying
+    respawns: AtomicUsize,
+}
+
+impl WorkerPool {
+    /// Spawn and initialize `size` workers.
+    pub fn new(size: usize, spec: WorkerSpec) -> Result<Self> {
+        let size = size.max(1);
+        let workers = std::thread::scope(|s| {
+            let handles: Vec<_> = (0..size).map(|_| s.spawn(|| Self::spawn_worker(&spec))).collect();
+            handles
+                .into_iter()
+                .map(|h| h.join().unwrap_or_else(|_| Err(anyhow!("Worker spawn panicked"))))
+                .collect::<Result<Vec<_>>>()
+        })?;
+
+        Ok(Self {
+            spec,
+            size,
+            state: Mutex::new(PoolState { idle: workers, live: size }),
+            returned: Condvar::new(),
+            respawns: AtomicUsize::new(0),
+        })
+    }
+
+    /// One worker per available core.
+    pub fn with_default_size(spec: WorkerSpec) -> Result<Self> {
+        let size = std::thread::available_parallelism().map_or(1, |n| n.get());
+        Self::new(size, spec)
+    }
+
+    pub fn size(&self) -> usize {
+        self.size
+    }
+
+    /// Number of workers that had to be replaced so far.
+    pub fn respawns(&self) -> usize {
+        self.respawns.load(Ordering::Relaxed)
+    }
+
+    fn spawn_worker(spec: &WorkerSpec) -> Result<CGameEngineSubprocess> {
+        let mut worker = CGameEngineSubprocess::spawn(worker_command())?;
+        if spec.shared_memory {
+            worker.attach_shared_memory(SHM_DEFAULT_SIZE)?;
+        }
+        worker
+            .init(&spec.role, &spec.race, spec.gender, spec.align)
+            .map_err(|e| anyhow!("Worker init failed: {}", e))?;
+        if spec.headless != 0 {
+            worker.set_headless(spec.headless)?;
+        }
+        Ok(worker)
+    }
+
+    /// Block until a worker is free, reseed it and hand it out.
+    pub fn checkout(&self, seed: u64) -> Result<PooledWorker<'_>> {
+        let mut dead = 0;
+        loop {
+            let mut worker = {
+                let mut state = self.state.lock().unwrap_or_else(|e| e.into_inner());
+                loop {
+                    if let Some(worker) = state.idle.pop() {
+                        break Some(worker);
+                    }
+                    if state.live < self.size {
+                        // Reserve the slot, spawn outside the lock
+                        state.live += 1;
+                        break None;
+                    }
+                    state = self.returned.wait(state).unwrap_or_else(|e| e.into_inner());
+                }
+            };
+
+            if worker.is_none() {
+                match Self::spawn_worker(&self.spec) {
+                    Ok(w) => {
+                        self.respawns.fetch_add(1, Ordering::Relaxed);
+                        worker = Some(w);
+                    }
+                    Err(e) => {
+                        self.release_slot();
+                        return Err(e);
+                    }
+                }
+            }
+
+            let mut worker = worker.unwrap();
+            let started = if self.spec.snapshot {
+                worker.fork_session(seed).map_err(|e| e.to_string())
+            } else {
+                worker.reset(seed)
+            };
+            match started {
+                Ok(()) => {
+                    return Ok(PooledWorker { pool: self, worker: Some(worker) });
+                }
+                Err(e) if !worker.is_alive() => {
+                    // Died while idle; replace it and try again
+                    drop(worker);
+                    self.release_slot();
+                    dead += 1;
+                    if dead > self.size {
+                        return Err(anyhow!("Workers keep dying on reset: {}", e));
+                    }
+                }
+                Err(e) => {
+                    self.checkin(worker);
+                    return Err(anyhow!("Worker reset failed: {}", e));
+                }
+            }
+        }
+    }
+
+    /// Run `f` once per seed, spreading seeds across the pool. A seed whose
+    /// worker dies is retried once on a replacement worker; results come
+    /// back in seed order.
+    pub fn run<T, F>(&self, seeds: &[u64], f: F) -> Vec<Result<T>>
+    where
+        T: Send,
+        F: Fn(&mut CGameEngineSubprocess, u64) -> Result<T> + Sync,
+    {
+        let next = AtomicUsize::new(0);
+        let results: Mutex<Vec<Option<Result<T>>>> =
+            Mutex::new((0..seeds.len()).map(|_| None).collect());
+
+        std::thread::scope(|s| {
+            for _ in 0..self.size.min(seeds.len()) {
+                s.spawn(|| {
+                    loop {
+                        let i = next.fetch_add(1, Ordering::Relaxed);
+                        let Some(&seed) = seeds.get(i) else { break };
+                        let result = self.run_one(seed, &f);
+                        results.lock().unwrap_or_else(|e| e.into_inner())[i] = Some(result);
+                    }
+                });
+            }
+        });
+
+        results
+            .into_inner()
+            .unwrap_or_else(|e| e.into_inner())
+            .into_iter()
+            .map(|r| r.unwrap_or_else(|| Err(anyhow!("Seed was not run"))))
+            .collect()
+    }
+
+    fn run_one<T, F>(&self, seed: u64, f: &F) -> Result<T>
+    where
+        F: Fn(&mut CGameEngineSubprocess, u64) -> Result<T>,
+    {
+        let mut attempt = 0;
+        loop {
+            let mut worker = self.checkout(seed)?;
+            match f(&mut worker, seed) {
+                Err(_) if attempt == 0 && !worker.is_alive() => attempt += 1,
+                result => return result,
+            }
+        }
+    }
+
+    fn checkin(&self, mut worker: CGameEngineSubprocess) {
+        if !worker.is_alive() {
+            drop(worker);
+            self.release_slot();
+            return;
+        }
+        let mut state = self.state.lock().unwrap_or_else(|e| e.into_inner());
+        state.idle.push(worker);
+        self.returned.notify_one();
+    }
+
+    fn release_slot(&self) {
+        let mut state = self.state.lock().unwrap_or_else(|e| e.into_inner());
+        state.live -= 1;
+        self.returned.notify_one();
+    }
+}
+
+/// A checked-out worker; returns to the pool when dropped.
+pub struct PooledWorker<'a> {
+    pool: &'a WorkerPool,
+    worker: Option<CGameEngineSubprocess>,
+}
+
+impl Deref for PooledWorker<'_> {
+    type Target = CGameEngineSubprocess;
+
+    fn deref(&self) -> &Self::Target {
+        self.worker.as_ref().unwrap()
+    }
+}
+
+impl DerefMut for PooledWorker<'_> {
+    fn deref_mut(&mut self) -> &mut Self::Target {
+        self.worker.as_mut().unwrap()
+    }
+}
+
+impl Drop for PooledWorker<'_> {
+    fn drop(&mut self) {
+        if let Some(worker) = self.worker.take() {
+            if self.pool.spec.snapshot {
+                // A failure here means the session died; checkin notices
+                let _ = worker.end_fork_session();
+            }
+            self.pool.checkin(worker);
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_pool_runs_seeds_in_order() {
+        let pool = WorkerPool::new(2, WorkerSpec::default()).unwrap();
+        let seeds = [1, 2, 3, 4, 5];
+        let results = pool.run(&seeds, |worker, _seed| Ok(worker.hp()));
+        assert_eq!(results.len(), seeds.len());
+        assert!(results.iter().all(|r| r.is_ok()));
+        assert_eq!(pool.respawns(), 0);
+    }
+
+    #[test]
+    fn test_shared_memory_exports_match_pipe() {
+        let spec = WorkerSpec { shared_memory: true, ..WorkerSpec::default() };
+        let shm_pool = WorkerPool::new(1, spec).unwrap();
+        let pipe_pool = WorkerPool::new(1, WorkerSpec::default()).unwrap();
+        let shm_worker = shm_pool.checkout(3).unwrap();
+        let pipe_worker = pipe_pool.checkout(3).unwrap();
+        assert!(shm_worker.has_shared_memory());
+        assert!(!pipe_worker.has_shared_memory());
+
+        let (visible, couldsee) = shm_worker.sight().unwrap();
+        assert_eq!(visible.len(), 80);
+        assert_eq!(couldsee[0].len(), 21);
+
+        // Same seed, same level: only the transport differs
+        let shm_export = shm_worker.export_level_bin().unwrap();
+        let pipe_export = pipe_worker.export_level_bin().unwrap();
+        assert_eq!(shm_export.as_bytes().len(), shm_export.header().total_size as usize);
+        assert_eq!(shm_export.as_bytes(), pipe_export.as_bytes());
+    }
+
+    #[test]
+    fn test_worker_records_executed_commands() {
+        use crate::ffi::EpisodeReader;
+
+        let path = std::env::temp_dir().join(format!("nh-worker-episode-{}.rec", std::process::id()));
+        let pool = WorkerPool::new(1, WorkerSpec::default()).unwrap();
+        let worker = pool.checkout(5).unwrap();
+
+        let cmds = "hjkl.s";
+        worker.start_recording(&path, 4, false).unwrap();
+        let batch = worker.exec_cmds(cmds, true).unwrap();
+        let rows = worker.stop_recording().unwrap();
+        assert_eq!(rows, batch.executed as u64);
+        assert!(worker.stop_recording().is_err());
+
+        // One row per executed command, in order, with its status
+        let mut reader = EpisodeReader::open(&path).unwrap();
+        assert_eq!(reader.rows(), rows);
+        assert_eq!(reader.column::<u8>("action").unwrap(), cmds.as_bytes()[..batch.executed].to_vec());
+        let statuses: Vec<i8> = batch.digests.iter().map(|d| d.status).collect();
+        assert_eq!(reader.column::<i8>("status").unwrap(), statuses);
+        let _ = std::fs::remove_file(&path);
+    }
+
+    #[test]
+    fn test_rollouts_across_snapshot_sessions() {
+        use crate::ffi::game_engine::RolloutPolicy;
+
+        let spec = WorkerSpec { snapshot: true, ..WorkerSpec::default() };
+        let pool = WorkerPool::new(2, spec).unwrap();
+        let seeds = [1, 2, 3];
+        let results = pool.run(&seeds, |worker, seed| worker.rollout(seed, RolloutPolicy::Random, 20, 8));
+        for outcomes in results {
+            assert_eq!(outcomes.unwrap().len(), 8);
+        }
+    }
+
+    #[test]
+    fn test_checkpoint_restores_in_another_worker() {
+        let pool = WorkerPool::new(2, WorkerSpec::default()).unwrap();
+        let first = pool.checkout(7).unwrap();
+        let second = pool.checkout(9).unwrap();
+
+        // The two workers are separate processes, each with its own layout
+        let checkpoint = first.checkpoint().unwrap();
+        second.restore(&checkpoint).unwrap();
+        assert_eq!(second.position(), first.position());
+        assert_eq!(second.hp(), first.hp());
+
+        for cmd in "lljjs".chars() {
+            let _ = first.exec_cmd(cmd);
+            let _ = second.exec_cmd(cmd);
+            assert_eq!(second.position(), first.position());
+        }
+    }
+
+    #[test]
+    fn test_snapshot_sessions_start_from_same_image() {
+        let spec = WorkerSpec { snapshot: true, ..WorkerSpec::default() };
+        let pool = WorkerPool::new(1, spec).unwrap();
+
+        let first = {
+            let worker = pool.checkout(7).unwrap();
+            let start = worker.position();
+            let _ = worker.exec_cmd('l');
+            start
+        };
+        // The move above happened in a discarded child
+        let mut worker = pool.checkout(7).unwrap();
+        assert_eq!(worker.position(), first);
+
+        // A nested session starts from the state it forked from, and the
+        // two sides move on without seeing each other
+        let at_fork = worker.snapshot().unwrap();
+        let in_child = {
+            let child = worker.forked(7).unwrap();
+            assert_eq!(child.snapshot().unwrap(), at_fork);
+            for cmd in "ls".chars() {
+                let _ = child.exec_cmd(cmd);
+            }
+            let moved = child.snapshot().unwrap();
+            assert_ne!(moved, at_fork);
+            moved
+        };
+        assert_eq!(worker.snapshot().unwrap(), at_fork);
+        for cmd in "sss".chars() {
+            let _ = worker.exec_cmd(cmd);
+        }
+        let in_parent = worker.snapshot().unwrap();
+        assert_ne!(in_parent, at_fork);
+        assert_ne!(in_parent, in_child);
+    }
+}
@@ -0,0 +1,678 @@
+//! Columnar episode recordings
+//!
+//! `EpisodeRecorder` logs one row per executed command -- the command and
+//! its status, the turn, RNG position, hero stats, last message and glyph
+//! map -- and stores them column by column in zlib-compressed chunks. A
+//! recording is a header followed by self-contained chunks, so recording
+//! only ever appends, and `EpisodeReader` (over a file or a memory map)
+//! decompresses just the columns it is asked for.
+//!
+//! Layout, integers little-endian:
+//!
+//! ```text
+//! header  "NHEPREC\0" version:u32 columns:u32
+//!         per column: type:u8 width:u32 name_len:u8 name
+//! chunk   "NHCK" rows:u32 first_message:u32 body_len:u32
+//!         per column, then the message dictionary: raw_len:u32 packed_len:u32
+//!         the packed blobs, in the same order
+//! ```
+//!
+//! `width` is the number of values per row (the glyph map has
+//! `COLNO * ROWNO`). The `message` column holds the id of the last message
+//! when it changed that step, else 0; a chunk's dictionary blob lists the
+//! messages it introduced, ids `first_message + 1..`, as `len:u16 bytes`.
+//! A chunk cut short by a crash is ignored by readers and dropped when the
+//! recording is reopened with `EpisodeRecorder::append`.
+
+use std::collections::HashMap;
+use std::fs::{File, OpenOptions};
+use std::io::{Cursor, Read, Seek, SeekFrom, Write};
+use std::path::Path;
+
+use flate2::Compression;
+use flate2::read::ZlibDecoder;
+use flate2::write::ZlibEncoder;
+use nh_core::CGameEngineTrait;
+
+use super::game_engine::{CGameEngine, NH_COLNO, NH_ROWNO};
+
+pub const RECORDING_MAGIC: &[u8; 8] = b"NHEPREC\0";
+pub const RECORDING_VERSION: u32 = 1;
+const CHUNK_MAGIC: &[u8; 4] = b"NHCK";
+const CHUNK_HEADER_LEN: u64 = 16;
+
+/// Rows per chunk when the caller does not choose
+pub const DEFAULT_CHUNK_ROWS: usize = 1024;
+
+/// Element type of a column
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[repr(u8)]
+pub enum ColumnType {
+    U8 = 0,
+    I8 = 1,
+    U16 = 2,
+    I32 = 3,
+    U32 = 4,
+    U64 = 5,
+}
+
+impl ColumnType {
+    pub fn size(self) -> usize {
+        match self {
+            ColumnType::U8 | ColumnType::I8 => 1,
+            ColumnType::U16 => 2,
+            ColumnType::I32 | ColumnType::U32 => 4,
+            ColumnType::U64 => 8,
+        }
+    }
+
+    fn from_u8(v: u8) -> Option<Self> {
+        Some(match v {
+            0 => ColumnType::U8,
+            1 => ColumnType::I8,
+            2 => ColumnType::U16,
+            3 => ColumnType::I32,
+            4 => ColumnType::U32,
+            5 => ColumnType::U64,
+            _ => return None,
+        })
+    }
+}
+
+/// Columns written by `EpisodeRecorder`, in file order: name, type and
+/// values per row.
+pub const COLUMNS: &[(&str, ColumnType, usize)] = &[
+    ("turn", ColumnType::U32, 1),
+    ("action", ColumnType::U8, 1),
+    ("status", ColumnType::I8, 1),
+    ("rng_calls", ColumnType::U64, 1),
+    ("hp", ColumnType::I32, 1),
+    ("hp_max", ColumnType::I32, 1),
+    ("energy", ColumnType::I32, 1),
+    ("energy_max", ColumnType::I32, 1),
+    ("x", ColumnType::U8, 1),
+    ("y", ColumnType::U8, 1),
+    ("depth", ColumnType::I32, 1),
+    ("experience_level", ColumnType::I32, 1),
+    ("armor_class", ColumnType::I32, 1),
+    ("gold", ColumnType::I32, 1),
+    ("hunger_state", ColumnType::I32, 1),
+    ("message", ColumnType::U32, 1),
+    ("glyphs", ColumnType::U16, NH_COLNO * NH_ROWNO),
+];
+
+/// A column as described by a recording's header
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct ColumnInfo {
+    pub name: String,
+    pub ty: ColumnType,
+    /// Values per row
+    pub width: usize,
+}
+
+/// Fixed-size little-endian column value
+pub trait ColumnValue: Copy {
+    const TYPE: ColumnType;
+    fn put(self, out: &mut Vec<u8>);
+    fn get(bytes: &[u8]) -> Self;
+}
+
+macro_rules! column_value {
+    ($t:ty, $ty:ident) => {
+        impl ColumnValue for $t {
+            const TYPE: ColumnType = ColumnType::$ty;
+            fn put(self, out: &mut Vec<u8>) {
+                out.extend_from_slice(&self.to_le_bytes());
+            }
+            fn get(bytes: &[u8]) -> Self {
+                <$t>::from_le_bytes(bytes.try_into().unwrap())
+            }
+        }
+    };
+}
+
+column_value!(u8, U8);
+column_value!(i8, I8);
+column_value!(u16, U16);
+column_value!(i32, I32);
+column_value!(u32, U32);
+column_value!(u64, U64);
+
+/// One recorded step.
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub struct EpisodeRow {
+    pub turn: u32,
+    pub action: u8,
+    /// `nh_ffi_exec_cmd()` result: 0 ok, -1 unsupported command, -2 died
+    pub status: i8,
+    pub rng_calls: u64,
+    pub hp: i32,
+    pub hp_max: i32,
+    pub energy: i32,
+    pub energy_max: i32,
+    pub x: u8,
+    pub y: u8,
+    pub depth: i32,
+    pub experience_level: i32,
+    pub armor_class: i32,
+    pub gold: i32,
+    pub hunger_state: i32,
+    /// Last message shown; only recorded when it differs from the previous row's
+    pub message: String,
+    /// `COLNO * ROWNO` glyphs, row-major; zeros in builds without a map
+    pub glyphs: Vec<u16>,
+}
+
+impl EpisodeRow {
+    /// Read the live game after `action` ran with `status`.
+    pub fn capture(engine: &CGameEngine, action: u8, status: i8) -> Result<Self, String> {
+        let state = engine.game_state()?;
+        let mut glyphs = vec![0u16; NH_COLNO * NH_ROWNO];
+        engine.glyphs_into(&mut glyphs);
+        Ok(Self {
+            turn: state.turn_count as u32,
+            action,
+            status,
+            rng_calls: engine.rng_call_count(),
+            hp: state.hp,
+            hp_max: state.hp_max,
+            energy: state.energy,
+            energy_max: state.energy_max,
+            x: state.x as u8,
+            y: state.y as u8,
+            depth: state.dungeon_depth,
+            experience_level: state.experience_level,
+            armor_class: state.armor_class,
+            gold: state.gold,
+            hunger_state: state.hunger_state,
+            message: engine.last_message(),
+            glyphs,
+        })
+    }
+}
+
+fn io_err(path: &Path) -> impl Fn(std::io::Error) -> String + '_ {
+    move |e| format!("{}: {}", path.display(), e)
+}
+
+fn put_u32(out: &mut Vec<u8>, v: u32) {
+    out.extend_from_slice(&v.to_le_bytes());
+}
+
+fn u32_at(bytes: &[u8], at: usize) -> u32 {
+    u32::from_le_bytes(bytes[at..at + 4].try_into().unwrap())
+}
+
+fn header_bytes() -> Vec<u8> {
+    let mut out = RECORDING_MAGIC.to_vec();
+    put_u32(&mut out, RECORDING_VERSION);
+    put_u32(&mut out, COLUMNS.len() as u32);
+    for &(name, ty, width) in COLUMNS {
+        out.push(ty as u8);
+        put_u32(&mut out, width as u32);
+        out.push(name.len() as u8);
+        out.extend_from_slice(name.as_bytes());
+    }
+    out
+}
+
+/// Writes a recording one chunk at a time.
+///
+/// Rows are buffered per column and flushed as a chunk every `chunk_rows`
+/// rows, by `finish`, and on drop.
+pub struct EpisodeRecorder {
+    file: File,
+    chunk_rows: usize,
+    rows: usize,
+    total_rows: u64,
+    columns: Vec<Vec<u8>>,
+    message_ids: HashMap<String, u32>,
+    chunk_first_message: u32,
+    chunk_messages: Vec<u8>,
+    last_message: String,
+}
+
+impl EpisodeRecorder {
+    /// Start a new recording at `path`, replacing any file there.
+    pub fn create(path: &Path, chunk_rows: usize) -> Result<Self, String> {
+        let mut file = File::create(path).map_err(io_err(path))?;
+        file.write_all(&header_bytes()).map_err(io_err(path))?;
+        Ok(Self::with_file(file, chunk_rows, HashMap::new()))
+    }
+
+    /// Add chunks to the recording at `path`, creating it if needed. A torn
+    /// trailing chunk is cut off first; message ids continue from the
+    /// existing dictionary.
+    pub fn append(path: &Path, chunk_rows: usize) -> Result<Self, String> {
+        let mut file = OpenOptions::new()
+            .read(true)
+            .write(true)
+            .create(true)
+            .truncate(false)
+            .open(path)
+            .map_err(io_err(path))?;
+        if file.metadata().map_err(io_err(path))?.len() == 0 {
+            file.write_all(&header_bytes()).map_err(io_err(path))?;
+            return Ok(Self::with_file(file, chunk_rows, HashMap::new()));
+        }
+
+        let mut reader = EpisodeReader::new(file.try_clone().map_err(io_err(path))?)?;
+        let found: Vec<_> = reader.columns().iter().map(|c| (c.name.as_str(), c.ty, c.width)).collect();
+        if found != COLUMNS {
+            return Err(format!("{}: recorded with different columns", path.display()));
+        }
+        let message_ids = reader.messages()?.into_iter().zip(1u32..).collect();
+        let total_rows = reader.rows();
+        file.set_len(reader.valid_len).map_err(io_err(path))?;
+        file.seek(SeekFrom::End(0)).map_err(io_err(path))?;
+
+        let mut recorder = Self::with_file(file, chunk_rows, message_ids);
+        recorder.total_rows = total_rows;
+        Ok(recorder)
+    }
+
+    fn with_file(file: File, chunk_rows: usize, message_ids: HashMap<String, u32>) -> Self {
+        Self {
+            file,
+            chunk_rows: chunk_rows.max(1),
+            rows: 0,
+            total_rows: 0,
+            columns: vec![Vec::new(); COLUMNS.len()],
+            chunk_first_message: message_ids.len() as u32,
+            message_ids,
+            chunk_messages: Vec::new(),
+            last_message: String::new(),
+        }
+    }
+
+    /// Rows recorded so far, including those not yet flushed
+    pub fn rows(&self) -> u64 {
+        self.total_rows + self.rows as u64
+    }
+
+    /// Capture the live game after a step and record it.
+    pub fn record_step(&mut self, engine: &CGameEngine, action: u8, status: i8) -> Result<(), String> {
+        let row = EpisodeRow::capture(engine, action, status)?;
+        self.push(&row)
+    }
+
+    pub fn push(&mut self, row: &EpisodeRow) -> Result<(), String> {
+        if row.glyphs.len() != NH_COLNO * NH_ROWNO {
+            return Err(format!("Glyph map has {} cells, expected {}", row.glyphs.len(), NH_COLNO * NH_ROWNO));
+        }
+        let message = self.message_id(&row.message);
+        let c = &mut self.columns;
+        row.turn.put(&mut c[0]);
+        row.action.put(&mut c[1]);
+        row.status.put(&mut c[2]);
+        row.rng_calls.put(&mut c[3]);
+        row.hp.put(&mut c[4]);
+        row.hp_max.put(&mut c[5]);
+        row.energy.put(&mut c[6]);
+        row.energy_max.put(&mut c[7]);
+        row.x.put(&mut c[8]);
+        row.y.put(&mut c[9]);
+        row.depth.put(&mut c[10]);
+        row.experience_level.put(&mut c[11]);
+        row.armor_class.put(&mut c[12]);
+        row.gold.put(&mut c[13]);
+        row.hunger_state.put(&mut c[14]);
+        message.put(&mut c[15]);
+        for &g in &row.glyphs {
+            g.put(&mut c[16]);
+        }
+
+        self.rows += 1;
+        if self.rows >= self.chunk_rows {
+            self.flush_chunk()?;
+        }
+        Ok(())
+    }
+
+    /// 0 for an empty or repeated message, else its dictionary id. A
+    /// message shown again after a blank turn is not a repeat.
+    fn message_id(&mut self, message: &str) -> u32 {
+        if message.is_empty() {
+            self.last_message.clear();
+            return 0;
+        }
+        if message == self.last_message {
+            return 0;
+        }
+        self.last_message.clear();
+        self.last_message.push_str(message);
+        if let Some(&id) = self.message_ids.get(message) {
+            return id;
+        }
+        let id = self.message_ids.len() as u32 + 1;
+        // Messages are short; anything past u16::MAX is cut at a char boundary
+        let mut len = message.len().min(u16::MAX as usize);
+        while !message.is_char_boundary(len) {
+            len -= 1;
+        }
+        self.chunk_messages.extend_from_slice(&(len as u16).to_le_bytes());
+        self.chunk_messages.extend_from_slice(&message.as_bytes()[..len]);
+        self.message_ids.insert(message.to_string(), id);
+        id
+    }
+
+    /// Write the buffered rows as one chunk.
+    pub fn flush_chunk(&mut self) -> Result<(), String> {
+        if self.rows == 0 {
+            return Ok(());
+        }
+        let blobs = self.columns.iter().chain(std::iter::once(&self.chunk_messages));
+        let mut table = Vec::new();
+        let mut packed = Vec::new();
+        for raw in blobs {
+            let mut encoder = ZlibEncoder::new(Vec::new(), Compression::fast());
+            encoder.write_all(raw).map_err(|e| e.to_string())?;
+            let blob = encoder.finish().map_err(|e| e.to_string())?;
+            put_u32(&mut table, raw.len() as u32);
+            put_u32(&mut table, blob.len() as u32);
+            packed.extend_from_slice(&blob);
+        }
+
+        let mut chunk = CHUNK_MAGIC.to_vec();
+        put_u32(&mut chunk, self.rows as u32);
+        put_u32(&mut chunk, self.chunk_first_message);
+        put_u32(&mut chunk, (table.len() + packed.len()) as u32);
+        chunk.extend_from_slice(&table);
+        chunk.extend_from_slice(&packed);
+        self.file.write_all(&chunk).map_err(|e| format!("Recording write failed: {}", e))?;
+
+        self.total_rows += self.rows as u64;
+        self.rows = 0;
+        for column in &mut self.columns {
+            column.clear();
+        }
+        self.chunk_messages.clear();
+        self.chunk_first_message = self.message_ids.len() as u32;
+        Ok(())
+    }
+
+    /// Flush the last chunk and close the recording. Returns the rows recorded.
+    pub fn finish(mut self) -> Result<u64, String> {
+        self.flush_chunk()?;
+        self.file.sync_data().map_err(|e| format!("Recording sync failed: {}", e))?;
+        Ok(self.total_rows)
+    }
+}
+
+impl Drop for EpisodeRecorder {
+    fn drop(&mut self) {
+        let _ = self.flush_chunk();
+    }
+}
+
+/// Where one chunk's blobs sit in the recording
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct ChunkInfo {
+    pub rows: usize,
+    /// Messages defined by earlier chunks
+    pub first_message: u32,
+    /// `(offset, raw_len, packed_len)` per column, then the message dictionary
+    pub blobs: Vec<(u64, usize, usize)>,
+}
+
+/// Reads recordings written by `EpisodeRecorder`.
+///
+/// The header and chunk table are read up front; column data is read and
+/// decompressed on demand. Over a memory map, wrap the bytes in a
+/// `Cursor` (`EpisodeReader::from_bytes`).
+pub struct EpisodeReader<R> {
+    source: R,
+    columns: Vec<ColumnInfo>,
+    chunks: Vec<ChunkInfo>,
+    /// End of the last complete chunk
+    valid_len: u64,
+}
+
+impl EpisodeReader<File> {
+    pub fn open(path: &Path) -> Result<Self, String> {
+        EpisodeReader::new(File::open(path).map_err(io_err(path))?)
+    }
+}
+
+impl<'a> EpisodeReader<Cursor<&'a [u8]>> {
+    pub fn from_bytes(bytes: &'a [u8]) -> Result<Self, String> {
+        EpisodeReader::new(Cursor::new(bytes))
+    }
+}
+
+impl<R: Read + Seek> EpisodeReader<R> {
+    pub fn new(mut source: R) -> Result<Self, String> {
+        let len = source.seek(SeekFrom::End(0)).map_err(|e| e.to_string())?;
+        source.seek(SeekFrom::Start(0)).map_err(|e| e.to_string())?;
+
+        let mut head = [0u8; 16];
+        source.read_exact(&mut head).map_err(|_| "Recording header is truncated".to_string())?;
+        if &head[..8] != RECORDING_MAGIC {
+            return Err("Not an episode recording".to_string());
+        }
+        let version = u32_at(&head, 8);
+        if version != RECORDING_VERSION {
+            return Err(format!("Recording version {} (expected {})", version, RECORDING_VERSION));
+        }
+        let mut columns = Vec::new();
+        for _ in 0..u32_at(&head, 12) {
+            let mut desc = [0u8; 6];
+            source.read_exact(&mut desc).map_err(|_| "Recording header is truncated".to_string())?;
+            let ty = ColumnType::from_u8(desc[0]).ok_or_else(|| format!("Unknown column type {}", desc[0]))?;
+            let mut name = vec![0u8; desc[5] as usize];
+            source.read_exact(&mut name).map_err(|_| "Recording header is truncated".to_string())?;
+            let name = String::from_utf8(name).map_err(|_| "Column name is not UTF-8".to_string())?;
+            columns.push(ColumnInfo { name, ty, width: u32_at(&desc, 1) as usize });
+        }
+
+        // Chunks, up to the first one that is incomplete
+        let mut chunks = Vec::new();
+        let mut offset = source.stream_position().map_err(|e| e.to_string())?;
+        let table_len = (columns.len() + 1) * 8;
+        loop {
+            let mut header = [0u8; CHUNK_HEADER_LEN as usize];
+            if offset + CHUNK_HEADER_LEN > len || source.read_exact(&mut header).is_err() {
+                break;
+            }
+            let body_len = u32_at(&header, 12) as u64;
+            if &header[..4] != CHUNK_MAGIC || body_len < table_len as u64 || offset + CHUNK_HEADER_LEN + body_len > len {
+                break;
+            }
+            let mut table = vec![0u8; table_len];
+            source.read_exact(&mut table).map_err(|e| e.to_string())?;
+            let mut at = offset + CHUNK_HEADER_LEN + table_len as u64;
+            let mut blobs = Vec::with_capacity(columns.len() + 1);
+            for entry in table.chunks(8) {
+                let (raw, packed) = (u32_at(entry, 0) as usize, u32_at(entry, 4) as usize);
+                blobs.push((at, raw, packed));
+                at += packed as u64;
+            }
+            if at != offset + CHUNK_HEADER_LEN + body_len {
+                break;
+            }
+            chunks.push(ChunkInfo { rows: u32_at(&header, 4) as usize, first_message: u32_at(&header, 8), blobs });
+            offset = at;
+            source.seek(SeekFrom::Start(offset)).map_err(|e| e.to_string())?;
+        }
+
+        Ok(Self { source, columns, chunks, valid_len: offset })
+    }
+
+    pub fn columns(&self) -> &[ColumnInfo] {
+        &self.columns
+    }
+
+    pub fn chunks(&self) -> &[ChunkInfo] {
+        &self.chunks
+    }
+
+    /// Rows in complete chunks
+    pub fn rows(&self) -> u64 {
+        self.chunks.iter().map(|c| c.rows as u64).sum()
+    }
+
+    fn column_index(&self, name: &str) -> Result<usize, String> {
+        self.columns.iter().position(|c| c.name == name).ok_or_else(|| format!("No column named {}", name))
+    }
+
+    fn blob(&mut self, chunk: usize, index: usize) -> Result<Vec<u8>, String> {
+        let (offset, raw_len, packed_len) = self.chunks[chunk].blobs[index];
+        let mut packed = vec![0u8; packed_len];
+        self.source.seek(SeekFrom::Start(offset)).map_err(|e| e.to_string())?;
+        self.source.read_exact(&mut packed).map_err(|e| e.to_string())?;
+        let mut raw = Vec::with_capacity(raw_len);
+        ZlibDecoder::new(&packed[..]).read_to_end(&mut raw).map_err(|e| format!("Corrupt chunk {}: {}", chunk, e))?;
+        if raw.len() != raw_len {
+            return Err(format!("Corrupt chunk {}: {} bytes, expected {}", chunk, raw.len(), raw_len));
+        }
+        Ok(raw)
+    }
+
+    /// Values of column `name` in one chunk, `width` per row.
+    pub fn chunk_column<T: ColumnValue>(&mut self, chunk: usize, name: &str) -> Result<Vec<T>, String> {
+        let index = self.column_index(name)?;
+        let info = &self.columns[index];
+        if info.ty != T::TYPE {
+            return Err(format!("Column {} is {:?}, not {:?}", name, info.ty, T::TYPE));
+        }
+        let expected = self.chunks[chunk].rows * info.width * T::TYPE.size();
+        let raw = self.blob(chunk, index)?;
+        if raw.len() != expected {
+            return Err(format!("Corrupt chunk {}: column {} has {} bytes, expected {}", chunk, name, raw.len(), expected));
+        }
+        Ok(raw.chunks_exact(T::TYPE.size()).map(T::get).collect())
+    }
+
+    /// Values of column `name` across the recording.
+    pub fn column<T: ColumnValue>(&mut self, name: &str) -> Result<Vec<T>, String> {
+        let mut values = Vec::new();
+        for chunk in 0..self.chunks.len() {
+            values.extend(self.chunk_column::<T>(chunk, name)?);
+        }
+        Ok(values)
+    }
+
+    /// The message dictionary: message id `i` is entry `i - 1`.
+    pub fn messages(&mut self) -> Result<Vec<String>, String> {
+        let dictionary = self.columns.len();
+        let mut messages = Vec::new();
+        for chunk in 0..self.chunks.len() {
+            if self.chunks[chunk].first_message as usize != messages.len() {
+                return Err(format!("Chunk {} does not continue the message dictionary", chunk));
+            }
+            let raw = self.blob(chunk, dictionary)?;
+            let mut at = 0;
+            while at + 2 <= raw.len() {
+                let len = u16::from_le_bytes([raw[at], raw[at + 1]]) as usize;
+                let bytes = raw.get(at + 2..at + 2 + len).ok_or_else(|| format!("Corrupt chunk {}: message dictionary", chunk))?;
+                messages.push(String::from_utf8_lossy(bytes).into_owned());
+                at += 2 + len;
+            }
+        }
+        Ok(messages)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn temp_path(name: &str) -> std::path::PathBuf {
+        std::env::temp_dir().join(format!("nh-episode-{}-{}.rec", name, std::process::id()))
+    }
+
+    fn row(turn: u32, message: &str) -> EpisodeRow {
+        let mut glyphs = vec![2359u16; NH_COLNO * NH_ROWNO];
+        glyphs[turn as usize] = 333;
+        EpisodeRow {
+            turn,
+            action: b'l',
+            status: if turn == 9 { -2 } else { 0 },
+            rng_calls: 100 + turn as u64 * 7,
+            hp: 16 - turn as i32,
+            hp_max: 16,
+            x: 10 + turn as u8,
+            y: 5,
+            depth: 1,
+            message: message.to_string(),
+            glyphs,
+            ..Default::default()
+        }
+    }
+
+    #[test]
+    fn test_recording_roundtrip_across_chunks() {
+        let path = temp_path("roundtrip");
+        let messages = ["Hello", "Hello", "You hit the newt.", "Hello", "", "You die..."];
+        let mut recorder = EpisodeRecorder::create(&path, 4).unwrap();
+        for turn in 0..10 {
+            recorder.push(&row(turn, messages[turn as usize % messages.len()])).unwrap();
+        }
+        assert_eq!(recorder.finish().unwrap(), 10);
+
+        let mut reader = EpisodeReader::open(&path).unwrap();
+        assert_eq!(reader.rows(), 10);
+        assert_eq!(reader.chunks().len(), 3);
+        assert_eq!(reader.column::<u32>("turn").unwrap(), (0..10).collect::<Vec<_>>());
+        assert_eq!(reader.column::<i8>("status").unwrap()[9], -2);
+        assert_eq!(reader.column::<u64>("rng_calls").unwrap()[3], 121);
+        assert_eq!(reader.column::<u8>("x").unwrap()[2], 12);
+
+        let glyphs = reader.column::<u16>("glyphs").unwrap();
+        assert_eq!(glyphs.len(), 10 * NH_COLNO * NH_ROWNO);
+        let third = &glyphs[3 * NH_COLNO * NH_ROWNO..4 * NH_COLNO * NH_ROWNO];
+        assert_eq!((third[3], third[4]), (333, 2359));
+
+        // Repeats and blanks are 0; a message seen in an earlier chunk keeps its id
+        assert_eq!(reader.column::<u32>("message").unwrap(), vec![1, 0, 2, 1, 0, 3, 1, 0, 2, 1]);
+        assert_eq!(reader.messages().unwrap(), vec!["Hello", "You hit the newt.", "You die..."]);
+        assert!(reader.column::<i32>("turn").is_err());
+        assert!(reader.column::<u32>("nope").is_err());
+        let _ = std::fs::remove_file(&path);
+    }
+
+    #[test]
+    fn test_message_after_blank_turn_is_restated() {
+        let path = temp_path("blank");
+        let mut recorder = EpisodeRecorder::create(&path, 8).unwrap();
+        for (turn, message) in [(0, "Hello"), (1, ""), (2, "Hello"), (3, "Hello")] {
+            recorder.push(&row(turn, message)).unwrap();
+        }
+        recorder.finish().unwrap();
+
+        let mut reader = EpisodeReader::open(&path).unwrap();
+        assert_eq!(reader.column::<u32>("message").unwrap(), vec![1, 0, 1, 0]);
+        let _ = std::fs::remove_file(&path);
+    }
+
+    #[test]
+    fn test_append_drops_torn_chunk_and_continues_dictionary() {
+        let path = temp_path("append");
+        let mut recorder = EpisodeRecorder::create(&path, 2).unwrap();
+        for (turn, message) in [(0, "Hello"), (1, "Ouch"), (2, "Hello")] {
+            recorder.push(&row(turn, message)).unwrap();
+        }
+        recorder.finish().unwrap();
+
+        // Simulate a crash halfway through writing the last chunk
+        let len = std::fs::metadata(&path).unwrap().len();
+        let file = OpenOptions::new().write(true).open(&path).unwrap();
+        file.set_len(len - 10).unwrap();
+        drop(file);
+        let torn = std::fs::read(&path).unwrap();
+        assert_eq!(EpisodeReader::from_bytes(&torn).unwrap().rows(), 2);
+
+        let mut recorder = EpisodeRecorder::append(&path, 2).unwrap();
+        assert_eq!(recorder.rows(), 2);
+        recorder.push(&row(3, "Ouch")).unwrap();
+        recorder.push(&row(4, "Welcome")).unwrap();
+        drop(recorder);
+
+        let mut reader = EpisodeReader::open(&path).unwrap();
+        assert_eq!(reader.column::<u32>("turn").unwrap(), vec![0, 1, 3, 4]);
+        // A reopened recording restates its first message
+        assert_eq!(reader.column::<u32>("message").unwrap(), vec![1, 2, 2, 3]);
+        assert_eq!(reader.messages().unwrap(), vec!["Hello", "Ouch", "Welcome"]);
+        let _ = std::fs::remove_file(&path);
+    }
+}
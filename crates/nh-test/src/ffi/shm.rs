@@ -0,0 +1,141 @@
+//! Shared memory between a harness and its worker.
+//!
+//! The client creates a file-backed region (under `/dev/shm` when there is
+//! one), maps it and hands the path to the worker, which maps the same
+//! pages. Bulk results are then written by the worker's C code straight
+//! into the region; the pipe only carries the "ready" reply. The file is
+//! unlinked once both sides have it mapped.
+
+use std::fs::{File, OpenOptions};
+use std::io;
+use std::path::{Path, PathBuf};
+use std::ptr::NonNull;
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+use super::game_engine::{NH_COLNO, NH_ROWNO};
+
+/// `nh_ffi_get_visibility` output
+pub const SHM_VISIBILITY_OFFSET: usize = 0;
+/// `nh_ffi_get_couldsee` output
+pub const SHM_COULDSEE_OFFSET: usize = NH_COLNO * NH_ROWNO;
+/// `nh_ffi_export_level_bin` output, up to the end of the region
+pub const SHM_LEVEL_OFFSET: usize = 4096;
+/// Room for the largest level export (the JSON export buffer is 1 MB)
+pub const SHM_DEFAULT_SIZE: usize = SHM_LEVEL_OFFSET + (1 << 20);
+
+static NEXT_REGION: AtomicUsize = AtomicUsize::new(0);
+
+/// A `MAP_SHARED` mapping of a region file
+pub struct SharedRegion {
+    ptr: NonNull<u8>,
+    len: usize,
+}
+
+// The mapping is plain memory; access is ordered by the request/reply
+// protocol on the pipe.
+unsafe impl Send for SharedRegion {}
+
+impl SharedRegion {
+    /// Create and map a new region file of `len` bytes.
+    pub fn create(len: usize) -> io::Result<(Self, PathBuf)> {
+        let dir = Path::new("/dev/shm");
+        let dir = if dir.is_dir() { dir.to_path_buf() } else { std::env::temp_dir() };
+        let path = dir.join(format!(
+            "nh-test-shm-{}-{}",
+            std::process::id(),
+            NEXT_REGION.fetch_add(1, Ordering::Relaxed)
+        ));
+        let file = OpenOptions::new().read(true).write(true).create_new(true).open(&path)?;
+        let region = file.set_len(len as u64).and_then(|()| Self::map(&file, len));
+        match region {
+            Ok(region) => Ok((region, path)),
+            Err(e) => {
+                let _ = std::fs::remove_file(&path);
+                Err(e)
+            }
+        }
+    }
+
+    /// Map an existing region file created by the other side.
+    pub fn open(path: &Path, len: usize) -> io::Result<Self> {
+        let file = OpenOptions::new().read(true).write(true).open(path)?;
+        if file.metadata()?.len() < len as u64 {
+            return Err(io::Error::new(io::ErrorKind::InvalidInput, "Shared region is too small"));
+        }
+        Self::map(&file, len)
+    }
+
+    fn map(file: &File, len: usize) -> io::Result<Self> {
+        use std::os::fd::AsRawFd;
+
+        if len == 0 {
+            return Err(io::Error::new(io::ErrorKind::InvalidInput, "Empty shared region"));
+        }
+        let ptr = unsafe {
+            libc::mmap(
+                std::ptr::null_mut(),
+                len,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_SHARED,
+                file.as_raw_fd(),
+                0,
+            )
+        };
+        if ptr == libc::MAP_FAILED {
+            return Err(io::Error::last_os_error());
+        }
+        // The mapping outlives the file descriptor
+        Ok(Self { ptr: NonNull::new(ptr as *mut u8).unwrap(), len })
+    }
+
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    /// Start of the region, for C functions that fill it.
+    pub fn as_mut_ptr(&self) -> *mut u8 {
+        self.ptr.as_ptr()
+    }
+
+    /// `len` bytes at `offset`, or `None` past the end. The other process
+    /// may rewrite them on its next command.
+    pub fn bytes(&self, offset: usize, len: usize) -> Option<&[u8]> {
+        let end = offset.checked_add(len)?;
+        if end > self.len {
+            return None;
+        }
+        Some(unsafe { std::slice::from_raw_parts(self.ptr.as_ptr().add(offset), len) })
+    }
+
+    /// Writable view for the side that fills the region.
+    pub fn bytes_mut(&mut self, offset: usize, len: usize) -> Option<&mut [u8]> {
+        let end = offset.checked_add(len)?;
+        if end > self.len {
+            return None;
+        }
+        Some(unsafe { std::slice::from_raw_parts_mut(self.ptr.as_ptr().add(offset), len) })
+    }
+}
+
+impl Drop for SharedRegion {
+    fn drop(&mut self) {
+        unsafe { libc::munmap(self.ptr.as_ptr() as *mut libc::c_void, self.len) };
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_two_mappings_share_pages() {
+        let (a, path) = SharedRegion::create(8192).unwrap();
+        let b = SharedRegion::open(&path, 8192).unwrap();
+        std::fs::remove_file(&path).unwrap();
+
+        unsafe { a.as_mut_ptr().add(5000).write(0xAB) };
+        assert_eq!(b.bytes(5000, 1).unwrap(), &[0xAB]);
+        assert!(b.bytes(8000, 193).is_none());
+        assert!(SharedRegion::open(&path, 8192).is_err());
+    }
+}
@@ -0,0 +1,149 @@
+//! Startup image of the C engine's one-time table setup
+//!
+//! The first `nh_ffi_init` in a process shuffles the object descriptions
+//! and reads and lays out the dungeon, always from the same seed, so the
+//! result only changes when the C library does. A worker records it once
+//! to `target/nh-cache/startup-v1.img` (or `$NH_STARTUP_IMAGE`) and later
+//! workers map that file before their first init, which then restores the
+//! tables instead of rebuilding them. The C library checks an image against
+//! itself and refuses one from another build, so a stale file is simply
+//! recorded again; `NH_STARTUP_IMAGE=off` turns images off.
+
+use std::path::{Path, PathBuf};
+use std::ptr::NonNull;
+
+use libc::c_void;
+
+use super::game_engine::{nh_ffi_get_startup_image, nh_ffi_set_startup_image, nh_ffi_startup_image_used};
+use super::static_tables::{cache_dir, map_readonly, write_atomic};
+
+pub const STARTUP_IMAGE_VERSION: u32 = 1;
+
+/// How the next `init` sets up the C tables.
+pub enum StartupImage {
+    /// Restored from a mapped image, kept mapped until init has read it
+    Mapped { ptr: NonNull<u8>, len: usize, path: PathBuf },
+    /// Full setup, recording a new image to store at `path`
+    Recording { path: PathBuf },
+    /// Full setup without an image
+    Off,
+}
+
+// The mapping is read-only and owned
+unsafe impl Send for StartupImage {}
+unsafe impl Sync for StartupImage {}
+
+impl StartupImage {
+    /// Prepare the C library before its first `init`: hand it the image at
+    /// `path` if it accepts it, else ask it to record a new one.
+    pub fn attach(path: &Path) -> Self {
+        if let Ok((ptr, len)) = map_readonly(path) {
+            if unsafe { nh_ffi_set_startup_image(ptr.as_ptr() as *const c_void, len) } == 0 {
+                return StartupImage::Mapped { ptr, len, path: path.to_path_buf() };
+            }
+            unsafe { libc::munmap(ptr.as_ptr() as *mut c_void, len) };
+        }
+        if unsafe { nh_ffi_set_startup_image(std::ptr::null(), 0) } == 0 {
+            StartupImage::Recording { path: path.to_path_buf() }
+        } else {
+            StartupImage::Off
+        }
+    }
+
+    /// `attach` at `cache_path()`, unless `$NH_STARTUP_IMAGE` is `off`.
+    pub fn attach_default() -> Self {
+        match cache_path() {
+            Some(path) => Self::attach(&path),
+            None => StartupImage::Off,
+        }
+    }
+
+    /// After the first `init`, write the image it recorded, if any.
+    /// Returns whether a file was written.
+    pub fn store(&mut self) -> Result<bool, String> {
+        let StartupImage::Recording { path } = self else {
+            return Ok(false);
+        };
+        let needed = unsafe { nh_ffi_get_startup_image(std::ptr::null_mut(), 0) };
+        if needed <= 0 {
+            // Nothing recorded (stub build, or init has not run yet)
+            return Ok(false);
+        }
+        let mut buf = vec![0u8; needed as usize];
+        let written = unsafe { nh_ffi_get_startup_image(buf.as_mut_ptr() as *mut c_void, buf.len()) };
+        if written != needed {
+            return Err(format!("Startup image size {} != {}", written, needed));
+        }
+        write_atomic(path, &buf).map_err(|e| format!("Cannot write {}: {}", path.display(), e))?;
+        *self = StartupImage::Off;
+        Ok(true)
+    }
+
+    /// Whether the first `init` restored its tables from an image
+    pub fn used() -> bool {
+        unsafe { nh_ffi_startup_image_used() != 0 }
+    }
+}
+
+impl Drop for StartupImage {
+    fn drop(&mut self) {
+        if let StartupImage::Mapped { ptr, len, .. } = self {
+            unsafe { libc::munmap(ptr.as_ptr() as *mut c_void, *len) };
+        }
+    }
+}
+
+/// `$NH_STARTUP_IMAGE`, or `startup-v1.img` in `cache_dir()`; `None` when
+/// the variable is `off`.
+pub fn cache_path() -> Option<PathBuf> {
+    match std::env::var_os("NH_STARTUP_IMAGE") {
+        Some(v) if v == "off" => None,
+        Some(path) => Some(PathBuf::from(path)),
+        None => Some(cache_dir().join(format!("startup-v{}.img", STARTUP_IMAGE_VERSION))),
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use crate::ffi::subprocess::{CGameEngineSubprocess, worker_command};
+    use nh_core::CGameEngineTrait;
+
+    /// A level and a few moves in a worker started with `NH_STARTUP_IMAGE=image`
+    fn play(image: &std::path::Path) -> String {
+        let mut cmd = worker_command();
+        cmd.env("NH_STARTUP_IMAGE", image);
+        let mut worker = CGameEngineSubprocess::spawn(cmd).unwrap();
+        worker.init("Valkyrie", "Human", 1, 1).unwrap();
+        worker.reset(42).unwrap();
+        let _ = worker.generate_and_place();
+        for cmd in "hjkl".chars() {
+            let _ = worker.exec_cmd(cmd);
+        }
+        serde_json::to_string(&worker.snapshot().unwrap()).unwrap()
+    }
+
+    #[test]
+    fn test_image_restores_same_game_as_full_setup() {
+        let path = std::env::temp_dir().join(format!("nh-startup-{}.img", std::process::id()));
+        let _ = std::fs::remove_file(&path);
+
+        let full = play(std::path::Path::new("off"));
+        let recorded = play(&path);
+        // Only real builds have tables to image
+        assert_eq!(path.exists(), cfg!(real_nethack));
+        let restored = play(&path);
+        assert_eq!(recorded, full);
+        assert_eq!(restored, full);
+
+        // A corrupt image is refused and recorded again
+        if path.exists() {
+            let mut bytes = std::fs::read(&path).unwrap();
+            let last = bytes.len() - 1;
+            bytes[last] ^= 0xff;
+            std::fs::write(&path, &bytes).unwrap();
+            assert_eq!(play(&path), full);
+            assert_ne!(std::fs::read(&path).unwrap(), bytes);
+        }
+        let _ = std::fs::remove_file(&path);
+    }
+}
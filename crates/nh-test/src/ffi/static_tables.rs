@@ -0,0 +1,237 @@
+//! On-disk cache of the C engine's static tables
+//!
+//! `nh_ffi_export_static_tables` is written once to
+//! `target/nh-cache/static_tables-v1.bin` (or `$NH_STATIC_TABLES`) and
+//! mapped read-only by every later process. A cached file is used when its
+//! header and content hash check out and its source id matches the linked
+//! library; otherwise it is regenerated and replaced atomically.
+
+use std::fs::File;
+use std::io::{self, Write};
+use std::path::{Path, PathBuf};
+use std::ptr::NonNull;
+use std::sync::OnceLock;
+
+use nh_core::data::StaticTables;
+use nh_core::data::static_tables::STATIC_VERSION;
+
+use super::game_engine::{nh_ffi_export_static_tables, nh_ffi_static_tables_id};
+
+/// A read-only private mapping of a static tables file.
+pub struct StaticTablesFile {
+    ptr: NonNull<u8>,
+    len: usize,
+    path: PathBuf,
+    /// True when the file was written by this process
+    generated: bool,
+}
+
+// The mapping is read-only and owned
+unsafe impl Send for StaticTablesFile {}
+unsafe impl Sync for StaticTablesFile {}
+
+impl StaticTablesFile {
+    /// Map `path` and validate it as a static tables blob.
+    pub fn open(path: &Path) -> Result<Self, String> {
+        let (ptr, len) = map_readonly(path)?;
+        let mapped = Self { ptr, len, path: path.to_path_buf(), generated: false };
+        StaticTables::parse(mapped.bytes()).map_err(|e| format!("{}: {}", path.display(), e))?;
+        Ok(mapped)
+    }
+
+    /// Map the cache at `path`, regenerating it from the linked C library
+    /// when it is missing, invalid or stale.
+    pub fn load_or_generate(path: &Path) -> Result<Self, String> {
+        let id = unsafe { nh_ffi_static_tables_id() };
+        if let Ok(cached) = Self::open(path)
+            && cached.tables().source_id() == id
+        {
+            return Ok(cached);
+        }
+
+        let bytes = export_static_tables()?;
+        StaticTables::parse(&bytes)?;
+        write_atomic(path, &bytes).map_err(|e| format!("Cannot write {}: {}", path.display(), e))?;
+        let mut mapped = Self::open(path)?;
+        mapped.generated = true;
+        Ok(mapped)
+    }
+
+    pub fn tables(&self) -> StaticTables<'_> {
+        // Validated by open()
+        StaticTables::parse(self.bytes()).unwrap()
+    }
+
+    pub fn bytes(&self) -> &[u8] {
+        unsafe { std::slice::from_raw_parts(self.ptr.as_ptr(), self.len) }
+    }
+
+    pub fn path(&self) -> &Path {
+        &self.path
+    }
+
+    /// Whether loading had to regenerate the file.
+    pub fn was_generated(&self) -> bool {
+        self.generated
+    }
+}
+
+impl Drop for StaticTablesFile {
+    fn drop(&mut self) {
+        unsafe { libc::munmap(self.ptr.as_ptr() as *mut libc::c_void, self.len) };
+    }
+}
+
+/// Map a whole file read-only. The mapping outlives the file descriptor;
+/// the caller unmaps it.
+pub(crate) fn map_readonly(path: &Path) -> Result<(NonNull<u8>, usize), String> {
+    use std::os::fd::AsRawFd;
+
+    let file = File::open(path).map_err(|e| format!("Cannot open {}: {}", path.display(), e))?;
+    let len = file.metadata().map_err(|e| e.to_string())?.len() as usize;
+    if len == 0 {
+        return Err(format!("{} is empty", path.display()));
+    }
+    let ptr = unsafe {
+        libc::mmap(std::ptr::null_mut(), len, libc::PROT_READ, libc::MAP_PRIVATE, file.as_raw_fd(), 0)
+    };
+    if ptr == libc::MAP_FAILED {
+        return Err(format!("Cannot map {}: {}", path.display(), io::Error::last_os_error()));
+    }
+    Ok((NonNull::new(ptr as *mut u8).unwrap(), len))
+}
+
+/// Run the C export into a fresh buffer.
+pub fn export_static_tables() -> Result<Vec<u8>, String> {
+    let needed = unsafe { nh_ffi_export_static_tables(std::ptr::null_mut(), 0) };
+    if needed <= 0 {
+        return Err("Static tables export failed".to_string());
+    }
+    let mut buf = vec![0u8; needed as usize];
+    let written = unsafe { nh_ffi_export_static_tables(buf.as_mut_ptr() as *mut libc::c_void, buf.len()) };
+    if written as usize != buf.len() {
+        return Err(format!("Static tables export size {} != {}", written, buf.len()));
+    }
+    Ok(buf)
+}
+
+/// `$NH_STATIC_TABLES`, or `static_tables-v1.bin` in `cache_dir()`.
+pub fn cache_path() -> PathBuf {
+    if let Some(path) = std::env::var_os("NH_STATIC_TABLES") {
+        return PathBuf::from(path);
+    }
+    cache_dir().join(format!("static_tables-v{}.bin", STATIC_VERSION))
+}
+
+/// `target/nh-cache/` above the running binary, else the temp directory.
+pub fn cache_dir() -> PathBuf {
+    // target/<profile>/deps/<test binary> or target/<profile>/<binary>
+    let target = std::env::current_exe().ok().and_then(|exe| {
+        exe.ancestors()
+            .skip(1)
+            .find(|dir| dir.file_name().is_some_and(|name| name == "target"))
+            .map(Path::to_path_buf)
+    });
+    match target {
+        Some(target) => target.join("nh-cache"),
+        None => std::env::temp_dir().join("nh-cache"),
+    }
+}
+
+/// The process-wide cache, loaded on first use. `None` when the linked
+/// library exports no tables (stub builds) or the cache cannot be written.
+pub fn cached() -> Option<&'static StaticTablesFile> {
+    static CACHE: OnceLock<Option<StaticTablesFile>> = OnceLock::new();
+    CACHE
+        .get_or_init(|| {
+            let loaded = StaticTablesFile::load_or_generate(&cache_path())
+                .inspect_err(|e| eprintln!("Static tables unavailable: {}", e))
+                .ok()?;
+            let exported = loaded.tables().monsters().len() > 0;
+            exported.then_some(loaded)
+        })
+        .as_ref()
+}
+
+/// Write through a temporary file in the same directory so concurrent
+/// readers only ever map a complete file.
+pub(crate) fn write_atomic(path: &Path, bytes: &[u8]) -> io::Result<()> {
+    if let Some(dir) = path.parent() {
+        std::fs::create_dir_all(dir)?;
+    }
+    let tmp = path.with_extension(format!("tmp.{}", std::process::id()));
+    let result = File::create(&tmp)
+        .and_then(|mut file| file.write_all(bytes))
+        .and_then(|()| std::fs::rename(&tmp, path));
+    if result.is_err() {
+        let _ = std::fs::remove_file(&tmp);
+    }
+    result
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn scratch_path(name: &str) -> PathBuf {
+        std::env::temp_dir().join(format!("nh-static-{}-{}.bin", name, std::process::id()))
+    }
+
+    #[test]
+    fn test_cache_round_trip() {
+        let path = scratch_path("round-trip");
+        let _ = std::fs::remove_file(&path);
+
+        let first = StaticTablesFile::load_or_generate(&path).unwrap();
+        assert!(first.was_generated());
+        let live = export_static_tables().unwrap();
+        assert_eq!(first.bytes(), &live[..]);
+
+        let second = StaticTablesFile::load_or_generate(&path).unwrap();
+        assert!(!second.was_generated());
+        assert_eq!(second.tables().content_hash(), first.tables().content_hash());
+        assert_eq!(second.tables().monsters().len(), first.tables().monsters().len());
+        assert_eq!(second.tables().objects().len(), first.tables().objects().len());
+        drop((first, second));
+        let _ = std::fs::remove_file(&path);
+    }
+
+    #[test]
+    fn test_source_id_hashes_the_tables() {
+        let mut bytes = export_static_tables().unwrap();
+        let id = unsafe { nh_ffi_static_tables_id() };
+        assert_eq!(StaticTables::parse(&bytes).unwrap().source_id(), id);
+
+        // The id is the hash of the export written with source_id 0
+        bytes[24..32].fill(0);
+        assert_eq!(nh_core::data::static_tables::fnv1a64(&bytes), id);
+    }
+
+    #[test]
+    fn test_corrupt_cache_is_regenerated() {
+        let path = scratch_path("corrupt");
+        let mut bytes = export_static_tables().unwrap();
+        let last = bytes.len() - 1;
+        bytes[last] ^= 0xff;
+        std::fs::write(&path, &bytes).unwrap();
+        assert!(StaticTablesFile::open(&path).is_err());
+
+        let loaded = StaticTablesFile::load_or_generate(&path).unwrap();
+        assert!(loaded.was_generated());
+        assert!(StaticTables::parse(loaded.bytes()).is_ok());
+        drop(loaded);
+        let _ = std::fs::remove_file(&path);
+    }
+
+    #[cfg(real_nethack)]
+    #[test]
+    fn test_cached_tables_match_c() {
+        let tables = cached().expect("real builds export static tables").tables();
+        let monsters: Vec<_> = tables.monsters().collect();
+        assert_eq!(monsters[0].name, "giant ant");
+        assert!(tables.objects().any(|o| o.name == Some("long sword")));
+        assert!(tables.artifacts().any(|a| a.name == Some("Excalibur")));
+        assert_eq!(tables.roles().next().unwrap().name, "Archeologist");
+        assert_eq!(tables.races().next().unwrap().noun, "human");
+    }
+}
@@ -2,12 +2,29 @@ use std::process::{Command, Child, Stdio};
 use std::io::{Write, BufReader, BufRead, BufWriter};
 use serde::{Serialize, Deserialize};
 use anyhow::{Result, anyhow, Context};
-use std::cell::RefCell;
-
+use std::cell::{Cell, RefCell};
+use std::fs::File;
+use std::os::fd::AsFd;
+use nh_core::dungeon::GridPlanes;
+
+use super::game_engine::{
+    CLevelDelta, CLevelExport, CStepDigest, CWeaponQuery, CWeaponResult, NH_COLNO, NH_ROWNO, RolloutOutcome,
+    RolloutPolicy, SectionProfile, StepBatch, sight_grid,
+};
+use super::shm::{SHM_COULDSEE_OFFSET, SHM_LEVEL_OFFSET, SHM_VISIBILITY_OFFSET, SharedRegion};
+use super::pipeline::Pipeline;
+use super::wire;
+use crate::maps::isolation::{CaseResult, IsolationCase};
+
+// Variant order is part of the binary protocol and must match
+// Command/Response in src/bin/nh-test-worker.rs.
 #[derive(Serialize, Deserialize, Debug)]
-enum CommandMsg {
+pub(super) enum CommandMsg {
+    SetProtocol { binary: bool },
     Init { role: String, race: String, gender: i32, align: i32 },
     Reset { seed: u64 },
+    ForkSession { seed: u64 },
+    EndForkSession,
     ResetRng { seed: u64 },
     GenerateLevel,
     GenerateAndPlace,
@@ -19,9 +36,14 @@ enum CommandMsg {
     GetPosition,
     GetTurnCount,
     GetStateJson,
+    GetSnapshot,
+    GetMonstersNear { x: i32, y: i32, radius: i32 },
     GetMapJson,
     ExecCmd { cmd: char },
     ExecCmdDir { cmd: char, dx: i32, dy: i32 },
+    ExecCmds { cmds: String, record: bool },
+    GetStepDigest,
+    Rollout { seed: u64, policy: RolloutPolicy, max_turns: u32, count: u32 },
     SetDLevel { dnum: i32, dlevel: i32 },
     SetState { hp: i32, hpmax: i32, x: i32, y: i32, ac: i32, moves: i64 },
     GetArmorClass,
@@ -34,6 +56,7 @@ enum CommandMsg {
     GetInventoryCount,
     GetInventoryJson,
     GetObjectTableJson,
+    GetStaticTables,
     GetMonstersJson,
     SetWizardMode { enable: bool },
     AddItemToInv { item_id: i32, weight: i32 },
@@ -46,18 +69,38 @@ enum CommandMsg {
     GetResultMessage,
     GetRngCallCount,
     SetSkipMovemon { skip: bool },
+    GetSectionProfile,
+    ResetSectionProfile,
+    SetLogMask { mask: u32 },
+    SetHeadless { flags: u32 },
     RngRn2 { limit: i32 },
     CalcBaseDamage { weapon_id: i32, small_monster: bool },
+    CalcWeaponBatch { queries: Vec<CWeaponQuery> },
     GetAc,
     TestSetupStatus { hp: i32, max_hp: i32, level: i32, ac: i32 },
     WearItem { item_id: i32 },
     GetNutrition,
     GetAttributesJson,
     ExportLevel,
+    ExportLevelBin,
+    ExportLevelDelta,
+    ResetLevelDelta,
+    ExportGrid,
+    GenerateLevelBin { seed: u64, dnum: i32, dlevel: i32 },
+    Checkpoint,
+    Restore { checkpoint: Vec<u8> },
+    AttachShm { path: String, size: u64 },
+    ShmExportLevelBin,
+    ShmSight,
     EnableRngTracing,
     DisableRngTracing,
     GetRngTrace,
     ClearRngTrace,
+    ResetRngHash,
+    StartRngTraceStream { path: String },
+    StopRngTraceStream,
+    StartRecording { path: String, chunk_rows: u32, append: bool },
+    StopRecording,
     GetVisibility,
     GetCouldsee,
     // Function-level isolation testing (Phase 1)
@@ -72,6 +115,7 @@ enum CommandMsg {
     ClearLevel,
     AddRoom { lx: i32, ly: i32, hx: i32, hy: i32, rtype: i32 },
     CarveRoom { lx: i32, ly: i32, hx: i32, hy: i32 },
+    RunIsolationCase { case: IsolationCase },
     GetRectJson,
     DebugCell { x: i32, y: i32 },
     DebugMfndpos { mon_index: i32 },
@@ -79,20 +123,55 @@ enum CommandMsg {
 }
 
 #[derive(Serialize, Deserialize, Debug)]
-enum ResponseMsg {
+pub(super) enum ResponseMsg {
     Ok,
     Int(i32),
     Pos(i32, i32),
     Long(u64),
     String(String),
     Bool(bool),
+    Bytes(Vec<u8>),
+    SectionProfile(Vec<SectionProfile>),
+    StepBatch(StepBatch),
+    StepDigest(CStepDigest),
+    Rollouts(Vec<RolloutOutcome>),
+    WeaponResults(Vec<CWeaponResult>),
+    IsolationResult(CaseResult),
+    Snapshot(nh_core::CGameSnapshot),
+    Monsters(Vec<nh_core::CMonsterSnapshot>),
     Error(String),
 }
 
+/// Command that starts a worker without going through cargo when possible:
+/// `$NH_TEST_WORKER`, then an `nh-test-worker` binary next to the current
+/// executable (or one directory up, for test binaries in `deps/`), and
+/// finally `cargo run`.
+pub fn worker_command() -> Command {
+    if let Some(path) = std::env::var_os("NH_TEST_WORKER") {
+        return Command::new(path);
+    }
+    let name = format!("nh-test-worker{}", std::env::consts::EXE_SUFFIX);
+    if let Ok(exe) = std::env::current_exe() {
+        for dir in exe.ancestors().skip(1).take(2) {
+            let candidate = dir.join(&name);
+            if candidate.is_file() {
+                return Command::new(candidate);
+            }
+        }
+    }
+    let mut cmd = Command::new("cargo");
+    cmd.args(&["run", "--bin", "nh-test-worker", "-q", "-p", "nh-test"]);
+    cmd
+}
+
 pub struct CGameEngineSubprocess {
     child: Child,
     writer: RefCell<BufWriter<std::process::ChildStdin>>,
     reader: RefCell<BufReader<std::process::ChildStdout>>,
+    /// Framed binary messages instead of JSON lines (see `wire`)
+    binary: Cell<bool>,
+    /// Region shared with the worker, once attached
+    shm: Option<SharedRegion>,
 }
 
 impl nh_core::CGameEngineTrait for CGameEngineSubprocess {
@@ -299,28 +378,421 @@ impl nh_core::CGameEngineTrait for CGameEngineSubprocess {
             _ => panic!("Unexpected response"),
         }
     }
+
+    fn snapshot(&self) -> Result<nh_core::CGameSnapshot, String> {
+        match self.send_command(CommandMsg::GetSnapshot).map_err(|e| e.to_string())? {
+            ResponseMsg::Snapshot(snapshot) => Ok(snapshot),
+            ResponseMsg::Error(e) => Err(e),
+            _ => Err("Unexpected response".to_string()),
+        }
+    }
 }
 
 impl CGameEngineSubprocess {
     pub fn new() -> Self {
-        let mut child = Command::new("cargo")
-            .args(&["run", "--bin", "nh-test-worker", "-q", "-p", "nh-test"])
+        let mut cmd = Command::new("cargo");
+        cmd.args(&["run", "--bin", "nh-test-worker", "-q", "-p", "nh-test"]);
+        Self::spawn(cmd).expect("Failed to spawn worker via cargo")
+    }
+
+    /// Spawn a worker from an explicit command line (see `worker_command`).
+    pub fn spawn(mut cmd: Command) -> Result<Self> {
+        let mut child = cmd
             .stdin(Stdio::piped())
             .stdout(Stdio::piped())
             .stderr(Stdio::inherit())
-            .spawn().expect("Failed to spawn worker via cargo");
+            .spawn()
+            .context("Failed to spawn worker")?;
 
-        let stdin = child.stdin.take().expect("Failed to open stdin");
-        let stdout = child.stdout.take().expect("Failed to open stdout");
+        let stdin = child.stdin.take().context("Failed to open stdin")?;
+        let stdout = child.stdout.take().context("Failed to open stdout")?;
 
-        Self {
+        let worker = Self {
             child,
             writer: RefCell::new(BufWriter::new(stdin)),
             reader: RefCell::new(BufReader::new(stdout)),
+            binary: Cell::new(false),
+            shm: None,
+        };
+        // NH_TEST_WIRE=json keeps the readable protocol for debugging
+        if std::env::var("NH_TEST_WIRE").map_or(true, |v| v != "json") {
+            worker.negotiate_binary()?;
+        }
+        Ok(worker)
+    }
+
+    /// Ask the worker to switch to binary frames. A worker that predates
+    /// the binary protocol rejects the command and the client stays on JSON.
+    fn negotiate_binary(&self) -> Result<()> {
+        match self.send_command(CommandMsg::SetProtocol { binary: true })? {
+            ResponseMsg::Ok => self.binary.set(true),
+            _ => self.binary.set(false),
+        }
+        Ok(())
+    }
+
+    /// Whether messages travel as binary frames.
+    pub fn is_binary(&self) -> bool {
+        self.binary.get()
+    }
+
+    /// Issue commands without waiting for each reply (see `Pipeline`). The
+    /// worker is borrowed until the pipeline is dropped.
+    pub fn pipeline(&mut self) -> Result<Pipeline<'_>> {
+        Pipeline::new(self)
+    }
+
+    /// Duplicates of the command and response pipes, for `Pipeline`.
+    pub(super) fn dup_pipes(&self) -> Result<(File, File)> {
+        let reader = self.reader.borrow();
+        if !reader.buffer().is_empty() {
+            return Err(anyhow!("Unread worker output"));
+        }
+        let writer = self.writer.borrow().get_ref().as_fd().try_clone_to_owned()?;
+        let reader = reader.get_ref().as_fd().try_clone_to_owned()?;
+        Ok((File::from(writer), File::from(reader)))
+    }
+
+    /// Whether the worker process is still running; false after a crash.
+    pub fn is_alive(&mut self) -> bool {
+        matches!(self.child.try_wait(), Ok(None))
+    }
+
+    /// Start a forked session: the worker forks a copy-on-write child from
+    /// its current (post-init) image and reseeds it. Every command until
+    /// `end_fork_session` runs in the child; afterwards the worker is back
+    /// to the pristine image. Sessions can nest. Both calls wait for their
+    /// reply before anything else is sent, as the fork requires.
+    pub fn fork_session(&self, seed: u64) -> Result<()> {
+        match self.send_command(CommandMsg::ForkSession { seed })? {
+            ResponseMsg::Ok => Ok(()),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    pub fn end_fork_session(&self) -> Result<()> {
+        match self.send_command(CommandMsg::EndForkSession)? {
+            ResponseMsg::Ok => Ok(()),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// `fork_session` wrapped in a guard that ends the session on drop.
+    pub fn forked(&mut self, seed: u64) -> Result<ForkedSession<'_>> {
+        self.fork_session(seed)?;
+        Ok(ForkedSession { worker: self })
+    }
+
+    /// Map a shared region into the worker. From then on level exports and
+    /// sight grids are written there by the worker's C code and the pipe
+    /// only carries the ready reply.
+    pub fn attach_shared_memory(&mut self, size: usize) -> Result<()> {
+        let size = size.max(SHM_LEVEL_OFFSET + 1);
+        let (region, path) = SharedRegion::create(size).context("Failed to create shared region")?;
+        let resp = self.send_command(CommandMsg::AttachShm {
+            path: path.to_string_lossy().into_owned(),
+            size: size as u64,
+        });
+        // Both sides have it mapped (or the attach failed); drop the name
+        let _ = std::fs::remove_file(&path);
+        match resp? {
+            ResponseMsg::Ok => {
+                self.shm = Some(region);
+                Ok(())
+            }
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    pub fn has_shared_memory(&self) -> bool {
+        self.shm.is_some()
+    }
+
+    /// Binary level export; the worker ships the packed records unchanged.
+    pub fn export_level_bin(&self) -> Result<CLevelExport> {
+        if let Some(region) = &self.shm {
+            return match self.send_command(CommandMsg::ShmExportLevelBin)? {
+                ResponseMsg::Long(len) => {
+                    let bytes = region
+                        .bytes(SHM_LEVEL_OFFSET, len as usize)
+                        .ok_or_else(|| anyhow!("Level export of {} bytes overruns shared region", len))?;
+                    CLevelExport::from_bytes(bytes).map_err(|e| anyhow!(e))
+                }
+                ResponseMsg::Error(e) => Err(anyhow!(e)),
+                other => Err(anyhow!("Unexpected response: {:?}", other)),
+            };
+        }
+        match self.send_command(CommandMsg::ExportLevelBin)? {
+            ResponseMsg::Bytes(bytes) => CLevelExport::from_bytes(&bytes).map_err(|e| anyhow!(e)),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// Level changes since the last delta (see `CGameEngine::export_level_delta`).
+    pub fn export_level_delta(&self) -> Result<CLevelDelta> {
+        match self.send_command(CommandMsg::ExportLevelDelta)? {
+            ResponseMsg::Bytes(bytes) => CLevelDelta::from_bytes(&bytes).map_err(|e| anyhow!(e)),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    pub fn reset_level_delta(&self) -> Result<()> {
+        match self.send_command(CommandMsg::ResetLevelDelta)? {
+            ResponseMsg::Ok => Ok(()),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// Live monsters within `radius` moves of `(x, y)` (see
+    /// `CGameEngine::monsters_near`).
+    pub fn monsters_near(&self, x: i32, y: i32, radius: i32) -> Result<Vec<nh_core::CMonsterSnapshot>> {
+        match self.send_command(CommandMsg::GetMonstersNear { x, y, radius })? {
+            ResponseMsg::Monsters(monsters) => Ok(monsters),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// Sight, lit and cell type planes of the worker's current level.
+    pub fn export_grid(&self) -> Result<GridPlanes> {
+        match self.send_command(CommandMsg::ExportGrid)? {
+            ResponseMsg::Bytes(bytes) => GridPlanes::decode(&bytes).map_err(|e| anyhow!(e)),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// The worker library's static tables blob; parse it with
+    /// `nh_core::data::StaticTables::parse`.
+    pub fn static_tables_bytes(&self) -> Result<Vec<u8>> {
+        match self.send_command(CommandMsg::GetStaticTables)? {
+            ResponseMsg::Bytes(bytes) => Ok(bytes),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// Generate dungeon level `dnum:dlevel` from a fresh RNG seeded with
+    /// `seed` and export it, in one round trip.
+    pub fn generate_level_bin(&self, seed: u64, dnum: i32, dlevel: i32) -> Result<CLevelExport> {
+        match self.send_command(CommandMsg::GenerateLevelBin { seed, dnum, dlevel })? {
+            ResponseMsg::Bytes(bytes) => CLevelExport::from_bytes(&bytes).map_err(|e| anyhow!(e)),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// Checkpoint the worker's game. Any worker running the same build can
+    /// restore it.
+    pub fn checkpoint(&self) -> Result<Vec<u8>> {
+        match self.send_command(CommandMsg::Checkpoint)? {
+            ResponseMsg::Bytes(bytes) => Ok(bytes),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// Replace the worker's game with a checkpoint.
+    pub fn restore(&self, checkpoint: &[u8]) -> Result<()> {
+        match self.send_command(CommandMsg::Restore { checkpoint: checkpoint.to_vec() })? {
+            ResponseMsg::Ok => Ok(()),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// Run a command script in the worker with a single round trip.
+    pub fn exec_cmds(&self, cmds: &str, record: bool) -> Result<StepBatch> {
+        match self.send_command(CommandMsg::ExecCmds { cmds: cmds.to_string(), record })? {
+            ResponseMsg::StepBatch(batch) => Ok(batch),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// The worker's current step digest, as `exec_cmds` records it.
+    pub fn step_digest(&self) -> Result<CStepDigest> {
+        match self.send_command(CommandMsg::GetStepDigest)? {
+            ResponseMsg::StepDigest(digest) => Ok(digest),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// Play `count` games from the worker's current state (see
+    /// `CGameEngine::rollout`); only their outcomes cross the pipe.
+    pub fn rollout(
+        &self,
+        seed: u64,
+        policy: RolloutPolicy,
+        max_turns: u32,
+        count: u32,
+    ) -> Result<Vec<RolloutOutcome>> {
+        match self.send_command(CommandMsg::Rollout { seed, policy, max_turns, count })? {
+            ResponseMsg::Rollouts(outcomes) => Ok(outcomes),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// Answer a whole batch of weapon queries in one round trip (see
+    /// `CGameEngine::calc_weapon_batch`).
+    pub fn calc_weapon_batch(&self, queries: &[CWeaponQuery]) -> Result<Vec<CWeaponResult>> {
+        match self.send_command(CommandMsg::CalcWeaponBatch { queries: queries.to_vec() })? {
+            ResponseMsg::WeaponResults(results) => Ok(results),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// Run one corridor isolation case on a fresh isolation level
+    /// (see `maps::isolation::run_c_case`).
+    pub fn run_isolation_case(&self, case: &IsolationCase) -> Result<CaseResult> {
+        match self.send_command(CommandMsg::RunIsolationCase { case: case.clone() })? {
+            ResponseMsg::IsolationResult(result) => Ok(result),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// Restart the worker's rolling RNG hash.
+    pub fn reset_rng_hash(&self) -> Result<()> {
+        match self.send_command(CommandMsg::ResetRngHash)? {
+            ResponseMsg::Ok => Ok(()),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// Per-phase RNG and time cost of the worker's last command.
+    pub fn section_profile(&self) -> Result<Vec<SectionProfile>> {
+        match self.send_command(CommandMsg::GetSectionProfile)? {
+            ResponseMsg::SectionProfile(profile) => Ok(profile),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    pub fn reset_section_profile(&self) -> Result<()> {
+        match self.send_command(CommandMsg::ResetSectionProfile)? {
+            ResponseMsg::Ok => Ok(()),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// Set the worker's C log mask; returns the previous one.
+    pub fn set_log_mask(&self, mask: u32) -> Result<u32> {
+        match self.send_command(CommandMsg::SetLogMask { mask })? {
+            ResponseMsg::Int(old) => Ok(old as u32),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// See `CGameEngine::set_headless`.
+    pub fn set_headless(&self, flags: u32) -> Result<u32> {
+        match self.send_command(CommandMsg::SetHeadless { flags })? {
+            ResponseMsg::Int(old) => Ok(old as u32),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// Stream the worker's RNG trace to a file, read back with
+    /// `RngTraceReader`. A stream started in a forked session belongs to it.
+    pub fn start_rng_trace_stream(&self, path: &std::path::Path) -> Result<()> {
+        let path = path.to_string_lossy().into_owned();
+        match self.send_command(CommandMsg::StartRngTraceStream { path })? {
+            ResponseMsg::Ok => Ok(()),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// Close the trace stream; returns the number of records written.
+    pub fn stop_rng_trace_stream(&self) -> Result<u64> {
+        match self.send_command(CommandMsg::StopRngTraceStream)? {
+            ResponseMsg::Long(n) => Ok(n),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// Record every command the worker executes from now on into a
+    /// columnar episode file (see `ffi::recorder`), `chunk_rows` rows per
+    /// compressed chunk. With `append`, an existing recording is extended.
+    pub fn start_recording(&self, path: &std::path::Path, chunk_rows: u32, append: bool) -> Result<()> {
+        let path = path.to_string_lossy().into_owned();
+        match self.send_command(CommandMsg::StartRecording { path, chunk_rows, append })? {
+            ResponseMsg::Ok => Ok(()),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// Flush and close the recording; returns the rows it holds.
+    pub fn stop_recording(&self) -> Result<u64> {
+        match self.send_command(CommandMsg::StopRecording)? {
+            ResponseMsg::Long(n) => Ok(n),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// `IN_SIGHT` and `COULD_SEE` grids in a single round trip through the
+    /// shared region.
+    pub fn sight(&self) -> Result<(Vec<Vec<bool>>, Vec<Vec<bool>>)> {
+        let Some(region) = &self.shm else {
+            return Ok((self.visibility()?, self.couldsee()?));
+        };
+        match self.send_command(CommandMsg::ShmSight)? {
+            ResponseMsg::Ok => {
+                let n = NH_COLNO * NH_ROWNO;
+                Ok((
+                    sight_grid(region.bytes(SHM_VISIBILITY_OFFSET, n).unwrap()),
+                    sight_grid(region.bytes(SHM_COULDSEE_OFFSET, n).unwrap()),
+                ))
+            }
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// `IN_SIGHT` grid, `[x][y]`; shipped as raw bytes.
+    pub fn visibility(&self) -> Result<Vec<Vec<bool>>> {
+        if self.shm.is_some() {
+            return Ok(self.sight()?.0);
+        }
+        match self.send_command(CommandMsg::GetVisibility)? {
+            ResponseMsg::Bytes(bytes) => Ok(sight_grid(&bytes)),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
+        }
+    }
+
+    /// `COULD_SEE` grid, `[x][y]`.
+    pub fn couldsee(&self) -> Result<Vec<Vec<bool>>> {
+        if self.shm.is_some() {
+            return Ok(self.sight()?.1);
+        }
+        match self.send_command(CommandMsg::GetCouldsee)? {
+            ResponseMsg::Bytes(bytes) => Ok(sight_grid(&bytes)),
+            ResponseMsg::Error(e) => Err(anyhow!(e)),
+            other => Err(anyhow!("Unexpected response: {:?}", other)),
         }
     }
 
     fn send_command(&self, cmd: CommandMsg) -> Result<ResponseMsg> {
+        if self.binary.get() {
+            return self.send_frame(&cmd);
+        }
         let json = serde_json::to_string(&cmd)?;
         let mut writer = self.writer.borrow_mut();
         writer.write_all(json.as_bytes())?;
@@ -340,4 +812,48 @@ impl CGameEngineSubprocess {
             }
         }
     }
+
+    fn send_frame(&self, cmd: &CommandMsg) -> Result<ResponseMsg> {
+        let payload = wire::to_vec(cmd)?;
+        wire::write_frame(&mut *self.writer.borrow_mut(), &payload)?;
+
+        let mut frame = Vec::new();
+        match wire::read_frame(&mut *self.reader.borrow_mut(), &mut frame).context("Failed to read from worker")? {
+            Some(()) => Ok(wire::from_slice(&frame).context("Failed to decode worker response")?),
+            None => Err(anyhow!("Worker process exited unexpectedly")),
+        }
+    }
+}
+
+/// A forked worker session; the worker returns to its snapshot on drop.
+pub struct ForkedSession<'a> {
+    worker: &'a mut CGameEngineSubprocess,
+}
+
+impl std::ops::Deref for ForkedSession<'_> {
+    type Target = CGameEngineSubprocess;
+
+    fn deref(&self) -> &Self::Target {
+        self.worker
+    }
+}
+
+impl std::ops::DerefMut for ForkedSession<'_> {
+    fn deref_mut(&mut self) -> &mut Self::Target {
+        self.worker
+    }
+}
+
+impl Drop for ForkedSession<'_> {
+    fn drop(&mut self) {
+        let _ = self.worker.end_fork_session();
+    }
+}
+
+impl Drop for CGameEngineSubprocess {
+    fn drop(&mut self) {
+        // Reap the child so crashed or discarded workers don't linger
+        let _ = self.child.kill();
+        let _ = self.child.wait();
+    }
 }
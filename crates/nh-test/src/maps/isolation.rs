@@ -0,0 +1,624 @@
+//! Property-based corridor isolation runs
+//!
+//! Generates random room layouts with one corridor operation each and runs
+//! every case through the C isolation entry points (`nh_ffi_clear_level`,
+//! `nh_ffi_add_room`/`nh_ffi_carve_room`, then `nh_ffi_test_finddpos`,
+//! `nh_ffi_test_dig_corridor`, `nh_ffi_test_join` or
+//! `nh_ffi_test_makecorridors`) and through nh-core's `dungeon::corridor`.
+//! The result and the whole cell grid are compared. Cases are sharded over
+//! a `WorkerPool`, one `RunIsolationCase` round trip per case, and the Rust
+//! side runs on the thread that drives the worker, as in `sweep`.
+//!
+//! A case is a pure function of its id, so a failure is reproduced by
+//! `IsolationCase::generate(id)`. The first few failures are shrunk:
+//! rooms the operation does not need are dropped, rooms and wall segments
+//! made smaller and corridor ends moved closer for as long as the two
+//! engines still disagree.
+
+use std::collections::BTreeMap;
+use std::time::{Duration, Instant};
+
+use nh_core::dungeon::corridor::{
+    ConnectivityTracker, dig_corridor_inner_public, finddpos, generate_corridors, join_rooms,
+};
+use nh_core::dungeon::generation::carve_room;
+use nh_core::dungeon::room::Room;
+use nh_core::dungeon::{CellType, DLevel, Level};
+use nh_core::{COLNO, GameRng, ROWNO};
+use serde::{Deserialize, Serialize};
+
+use super::sweep::{CellDivergence, compare_cell_types, level_cell_types};
+use crate::ffi::{CGameEngine, CGameEngineSubprocess, WorkerPool};
+
+/// Room interior, inclusive (C `lx..=hx`, `ly..=hy`)
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+pub struct RoomRect {
+    pub lx: i32,
+    pub ly: i32,
+    pub hx: i32,
+    pub hy: i32,
+}
+
+impl RoomRect {
+    fn room(&self) -> Room {
+        Room::new(
+            self.lx as usize,
+            self.ly as usize,
+            (self.hx - self.lx + 1) as usize,
+            (self.hy - self.ly + 1) as usize,
+        )
+    }
+
+    /// At least one stone cell between the two rooms' walls
+    fn apart(&self, other: &RoomRect) -> bool {
+        self.hx + 4 <= other.lx
+            || other.hx + 4 <= self.lx
+            || self.hy + 4 <= other.ly
+            || other.hy + 4 <= self.ly
+    }
+}
+
+/// Function under test, run once the rooms are carved
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+pub enum IsolationOp {
+    Finddpos { xl: i32, yl: i32, xh: i32, yh: i32 },
+    DigCorridor { sx: i32, sy: i32, dx: i32, dy: i32, nxcor: bool },
+    Join { a: usize, b: usize, nxcor: bool },
+    Makecorridors,
+}
+
+impl IsolationOp {
+    pub fn name(&self) -> &'static str {
+        match self {
+            IsolationOp::Finddpos { .. } => "finddpos",
+            IsolationOp::DigCorridor { .. } => "dig_corridor",
+            IsolationOp::Join { .. } => "join",
+            IsolationOp::Makecorridors => "makecorridors",
+        }
+    }
+}
+
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct IsolationCase {
+    /// RNG seed both engines are reset to right before `op`
+    pub seed: u64,
+    pub dlevel: i32,
+    /// Rooms in creation order, which `Join` indexes
+    pub rooms: Vec<RoomRect>,
+    pub op: IsolationOp,
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+pub enum OpResult {
+    Pos(i32, i32),
+    Dug(bool),
+    Done,
+}
+
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct CaseResult {
+    pub result: OpResult,
+    /// Cell types after the operation, row-major
+    pub cells: Vec<u8>,
+}
+
+/// Largest room interior `IsolationCase::generate` places
+const MAX_ROOM_WIDTH: u32 = 13;
+const MAX_ROOM_HEIGHT: u32 = 5;
+/// Placement attempts per room before settling for fewer rooms
+const PLACE_TRIES: usize = 50;
+
+fn random_rooms(rng: &mut GameRng, wanted: usize) -> Vec<RoomRect> {
+    let mut rooms: Vec<RoomRect> = Vec::with_capacity(wanted);
+    for _ in 0..wanted * PLACE_TRIES {
+        if rooms.len() == wanted {
+            break;
+        }
+        let w = 2 + rng.rn2(MAX_ROOM_WIDTH - 1) as i32;
+        let h = 2 + rng.rn2(MAX_ROOM_HEIGHT - 1) as i32;
+        // Walls stay at least two cells inside the map edge
+        let lx = 3 + rng.rn2((COLNO as i32 - 6 - w) as u32) as i32;
+        let ly = 2 + rng.rn2((ROWNO as i32 - 5 - h) as u32) as i32;
+        let room = RoomRect { lx, ly, hx: lx + w - 1, hy: ly + h - 1 };
+        if rooms.iter().all(|r| r.apart(&room)) {
+            rooms.push(room);
+        }
+    }
+    // makerooms() leaves rooms sorted left to right
+    rooms.sort_by_key(|r| r.lx);
+    rooms
+}
+
+impl IsolationCase {
+    /// The case with this id; the same id always gives the same case.
+    pub fn generate(id: u64) -> Self {
+        let mut rng = GameRng::new(id);
+        let dlevel = 1 + rng.rn2(30) as i32;
+        let kind = rng.rn2(6);
+        let wanted = if kind < 3 { 1 + rng.rn2(3) } else { 2 + rng.rn2(5) };
+        let rooms = random_rooms(&mut rng, wanted as usize);
+
+        let op = match kind {
+            3 | 4 if rooms.len() >= 2 => {
+                let a = rng.rn2(rooms.len() as u32) as usize;
+                let mut b = rng.rn2(rooms.len() as u32 - 1) as usize;
+                if b >= a {
+                    b += 1;
+                }
+                IsolationOp::Join { a, b, nxcor: rng.one_in(4) }
+            }
+            5 => IsolationOp::Makecorridors,
+            1 | 2 => IsolationOp::DigCorridor {
+                sx: 1 + rng.rn2(COLNO as u32 - 2) as i32,
+                sy: 1 + rng.rn2(ROWNO as u32 - 2) as i32,
+                dx: 1 + rng.rn2(COLNO as u32 - 2) as i32,
+                dy: 1 + rng.rn2(ROWNO as u32 - 2) as i32,
+                nxcor: rng.one_in(4),
+            },
+            // One of the room's walls, as join() passes to finddpos()
+            _ => {
+                let r = rooms[rng.rn2(rooms.len() as u32) as usize];
+                match rng.rn2(4) {
+                    0 => IsolationOp::Finddpos { xl: r.lx - 1, yl: r.ly, xh: r.lx - 1, yh: r.hy },
+                    1 => IsolationOp::Finddpos { xl: r.hx + 1, yl: r.ly, xh: r.hx + 1, yh: r.hy },
+                    2 => IsolationOp::Finddpos { xl: r.lx, yl: r.ly - 1, xh: r.hx, yh: r.ly - 1 },
+                    _ => IsolationOp::Finddpos { xl: r.lx, yl: r.hy + 1, xh: r.hx, yh: r.hy + 1 },
+                }
+            }
+        };
+        Self { seed: id, dlevel, rooms, op }
+    }
+}
+
+/// Run a case on the C engine. Leaves the isolation level in place.
+pub fn run_c_case(engine: &CGameEngine, case: &IsolationCase) -> Result<CaseResult, String> {
+    engine.set_dlevel(0, case.dlevel);
+    engine.clear_level();
+    for r in &case.rooms {
+        if engine.add_room(r.lx, r.ly, r.hx, r.hy, 0) < 0 {
+            return Err(format!("Cannot add room {:?}", r));
+        }
+        engine.carve_room(r.lx, r.ly, r.hx, r.hy);
+    }
+    engine.reset_rng(case.seed)?;
+
+    let result = match case.op {
+        IsolationOp::Finddpos { xl, yl, xh, yh } => {
+            let (x, y) = engine.test_finddpos(xl, yl, xh, yh);
+            OpResult::Pos(x, y)
+        }
+        IsolationOp::DigCorridor { sx, sy, dx, dy, nxcor } => {
+            OpResult::Dug(engine.test_dig_corridor(sx, sy, dx, dy, nxcor))
+        }
+        IsolationOp::Join { a, b, nxcor } => {
+            engine.test_join(a as i32, b as i32, nxcor);
+            OpResult::Done
+        }
+        IsolationOp::Makecorridors => {
+            engine.test_makecorridors();
+            OpResult::Done
+        }
+    };
+    let export = engine.export_level_bin()?;
+    let cells = export.cells().iter().map(|cell| cell.typ).collect();
+    Ok(CaseResult { result, cells })
+}
+
+/// Run a case through nh-core.
+pub fn run_rust_case(case: &IsolationCase) -> CaseResult {
+    let mut level = Level::new(DLevel::new(0, case.dlevel as i8));
+    let rooms: Vec<Room> = case.rooms.iter().map(RoomRect::room).collect();
+    for room in &rooms {
+        carve_room(&mut level, room);
+    }
+    let mut rng = GameRng::new(case.seed);
+
+    let result = match case.op {
+        IsolationOp::Finddpos { xl, yl, xh, yh } => {
+            let (x, y) =
+                finddpos(&level, xl as usize, yl as usize, xh as usize, yh as usize, &mut rng);
+            OpResult::Pos(x as i32, y as i32)
+        }
+        IsolationOp::DigCorridor { sx, sy, dx, dy, nxcor } => OpResult::Dug(dig_corridor_inner_public(
+            &mut level,
+            sx,
+            sy,
+            dx,
+            dy,
+            nxcor,
+            CellType::Corridor,
+            CellType::Stone,
+            &mut rng,
+        )),
+        IsolationOp::Join { a, b, nxcor } => {
+            let mut tracker = ConnectivityTracker::new(rooms.len());
+            join_rooms(&mut level, &rooms, a, b, &mut tracker, &mut rng, nxcor);
+            OpResult::Done
+        }
+        IsolationOp::Makecorridors => {
+            generate_corridors(&mut level, &rooms, &mut rng);
+            OpResult::Done
+        }
+    };
+    CaseResult { result, cells: level_cell_types(&level) }
+}
+
+/// How the two engines disagreed on a case
+#[derive(Debug, Clone, Serialize)]
+pub struct CaseMismatch {
+    pub rust: OpResult,
+    pub c: OpResult,
+    pub first_divergence: Option<CellDivergence>,
+    pub mismatched_cells: usize,
+}
+
+impl std::fmt::Display for CaseMismatch {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        if self.rust != self.c {
+            write!(f, "rust {:?}, c {:?}; ", self.rust, self.c)?;
+        }
+        write!(f, "{} cells differ", self.mismatched_cells)?;
+        if let Some(d) = self.first_divergence {
+            write!(f, ", first at ({},{}) rust={} c={}", d.x, d.y, d.rust, d.c)?;
+        }
+        Ok(())
+    }
+}
+
+pub fn compare_results(rust: &CaseResult, c: &CaseResult) -> Option<CaseMismatch> {
+    let (first_divergence, mismatched_cells) = compare_cell_types(&rust.cells, &c.cells, COLNO);
+    if rust.result == c.result && mismatched_cells == 0 {
+        return None;
+    }
+    Some(CaseMismatch { rust: rust.result, c: c.result, first_divergence, mismatched_cells })
+}
+
+/// Run a case in both engines and compare.
+pub fn check_case(
+    worker: &CGameEngineSubprocess,
+    case: &IsolationCase,
+) -> anyhow::Result<Option<CaseMismatch>> {
+    let c = worker.run_isolation_case(case)?;
+    Ok(compare_results(&run_rust_case(case), &c))
+}
+
+/// Smaller variants of a case, the most aggressive first.
+fn shrink_candidates(case: &IsolationCase) -> Vec<IsolationCase> {
+    let mut out = Vec::new();
+    let with_op = |op: IsolationOp| IsolationCase { op, ..case.clone() };
+
+    // Drop a room, keeping Join's indices pointing at the same rooms
+    for i in 0..case.rooms.len() {
+        let op = match case.op {
+            IsolationOp::Join { a, b, .. } if i == a || i == b => continue,
+            IsolationOp::Join { a, b, nxcor } => IsolationOp::Join {
+                a: a - (i < a) as usize,
+                b: b - (i < b) as usize,
+                nxcor,
+            },
+            IsolationOp::Makecorridors if case.rooms.len() <= 2 => continue,
+            op => op,
+        };
+        let mut rooms = case.rooms.clone();
+        rooms.remove(i);
+        out.push(IsolationCase { rooms, op, ..case.clone() });
+    }
+
+    // Shrink a room from each side
+    for i in 0..case.rooms.len() {
+        let r = case.rooms[i];
+        let mut smaller = Vec::new();
+        if r.hx > r.lx {
+            smaller.push(RoomRect { hx: r.hx - 1, ..r });
+            smaller.push(RoomRect { lx: r.lx + 1, ..r });
+        }
+        if r.hy > r.ly {
+            smaller.push(RoomRect { hy: r.hy - 1, ..r });
+            smaller.push(RoomRect { ly: r.ly + 1, ..r });
+        }
+        for room in smaller {
+            let mut rooms = case.rooms.clone();
+            rooms[i] = room;
+            out.push(IsolationCase { rooms, ..case.clone() });
+        }
+    }
+
+    match case.op {
+        IsolationOp::Finddpos { xl, yl, xh, yh } => {
+            if xh > xl {
+                out.push(with_op(IsolationOp::Finddpos { xl, yl, xh: xh - 1, yh }));
+                out.push(with_op(IsolationOp::Finddpos { xl: xl + 1, yl, xh, yh }));
+            }
+            if yh > yl {
+                out.push(with_op(IsolationOp::Finddpos { xl, yl, xh, yh: yh - 1 }));
+                out.push(with_op(IsolationOp::Finddpos { xl, yl: yl + 1, xh, yh }));
+            }
+        }
+        IsolationOp::DigCorridor { sx, sy, dx, dy, nxcor } => {
+            let step = |from: i32, to: i32| from + (to - from).signum();
+            if nxcor {
+                out.push(with_op(IsolationOp::DigCorridor { sx, sy, dx, dy, nxcor: false }));
+            }
+            if dx != sx {
+                out.push(with_op(IsolationOp::DigCorridor { sx, sy, dx: step(dx, sx), dy, nxcor }));
+                out.push(with_op(IsolationOp::DigCorridor { sx: step(sx, dx), sy, dx, dy, nxcor }));
+            }
+            if dy != sy {
+                out.push(with_op(IsolationOp::DigCorridor { sx, sy, dx, dy: step(dy, sy), nxcor }));
+                out.push(with_op(IsolationOp::DigCorridor { sx, sy: step(sy, dy), dx, dy, nxcor }));
+            }
+        }
+        IsolationOp::Join { a, b, nxcor: true } => {
+            out.push(with_op(IsolationOp::Join { a, b, nxcor: false }));
+        }
+        _ => {}
+    }
+
+    for seed in [1, case.seed / 2] {
+        if seed > 0 && seed < case.seed {
+            out.push(IsolationCase { seed, ..case.clone() });
+        }
+    }
+    out
+}
+
+/// Greedily shrink a failing case: take the first candidate that still
+/// fails and start over from it, until none does or `max_steps` candidates
+/// have been tried. Returns the smallest failing case and the steps used.
+pub fn shrink_case(
+    case: IsolationCase,
+    max_steps: usize,
+    mut fails: impl FnMut(&IsolationCase) -> bool,
+) -> (IsolationCase, usize) {
+    let mut case = case;
+    let mut steps = 0;
+    'shrink: while steps < max_steps {
+        for candidate in shrink_candidates(&case) {
+            if steps == max_steps {
+                break 'shrink;
+            }
+            steps += 1;
+            if fails(&candidate) {
+                case = candidate;
+                continue 'shrink;
+            }
+        }
+        break;
+    }
+    (case, steps)
+}
+
+/// Case ids `first_case..first_case + cases`, `shard_size` per pool item
+#[derive(Debug, Clone)]
+pub struct IsolationConfig {
+    pub first_case: u64,
+    pub cases: u64,
+    pub shard_size: u64,
+    /// Candidates tried per shrunk failure
+    pub max_shrink_steps: usize,
+}
+
+impl Default for IsolationConfig {
+    fn default() -> Self {
+        Self { first_case: 1, cases: 5000, shard_size: 100, max_shrink_steps: 200 }
+    }
+}
+
+/// Parity counts for one operation
+#[derive(Debug, Clone, Copy, Default, Serialize)]
+pub struct OpStats {
+    pub cases: usize,
+    pub matched: usize,
+}
+
+/// A failing case reduced by `shrink_case`
+#[derive(Debug, Clone, Serialize)]
+pub struct ShrunkFailure {
+    pub id: u64,
+    pub original_rooms: usize,
+    pub case: IsolationCase,
+    pub mismatch: CaseMismatch,
+    pub shrink_steps: usize,
+}
+
+#[derive(Debug, Clone, Default, Serialize)]
+pub struct IsolationReport {
+    pub cases: usize,
+    pub matched: usize,
+    /// First case id of each shard the C side could not run, with the error
+    pub failed: Vec<(u64, String)>,
+    /// Cases in the failed shards
+    pub failed_cases: usize,
+    pub by_op: BTreeMap<&'static str, OpStats>,
+    /// Ids of every diverged case, in order
+    pub diverged: Vec<u64>,
+    /// The first few diverged cases, shrunk
+    pub shrunk: Vec<ShrunkFailure>,
+    #[serde(serialize_with = "serialize_secs")]
+    pub elapsed: Duration,
+}
+
+fn serialize_secs<S: serde::Serializer>(d: &Duration, s: S) -> Result<S::Ok, S::Error> {
+    s.serialize_f64(d.as_secs_f64())
+}
+
+/// Diverged cases shrunk into `IsolationReport::shrunk`
+const MAX_SHRUNK: usize = 10;
+
+impl IsolationReport {
+    pub fn cases_per_sec(&self) -> f64 {
+        let secs = self.elapsed.as_secs_f64();
+        if secs > 0.0 { self.cases as f64 / secs } else { 0.0 }
+    }
+}
+
+impl std::fmt::Display for IsolationReport {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        writeln!(
+            f,
+            "{} cases in {:.2}s ({:.0} cases/sec), {} matched ({:.1}%), {} cases in failed shards",
+            self.cases,
+            self.elapsed.as_secs_f64(),
+            self.cases_per_sec(),
+            self.matched,
+            100.0 * self.matched as f64 / self.cases.max(1) as f64,
+            self.failed_cases
+        )?;
+        for (op, stats) in &self.by_op {
+            writeln!(f, "  {:13}: {}/{} matched", op, stats.matched, stats.cases)?;
+        }
+        for failure in &self.shrunk {
+            writeln!(
+                f,
+                "  case {} ({} rooms, shrunk in {} steps): {}",
+                failure.id, failure.original_rooms, failure.shrink_steps, failure.mismatch
+            )?;
+            writeln!(
+                f,
+                "    seed {} dlevel {} {:?} rooms {:?}",
+                failure.case.seed, failure.case.dlevel, failure.case.op, failure.case.rooms
+            )?;
+        }
+        Ok(())
+    }
+}
+
+/// Run every case of the config and shrink the first failures.
+pub fn run_isolation(pool: &WorkerPool, config: &IsolationConfig) -> IsolationReport {
+    let end = config.first_case + config.cases;
+    let shard_size = config.shard_size.max(1);
+    let shards: Vec<u64> = (config.first_case..end).step_by(shard_size as usize).collect();
+    let start = Instant::now();
+
+    let results = pool.run(&shards, |worker, first| {
+        (first..(first + shard_size).min(end))
+            .map(|id| {
+                let case = IsolationCase::generate(id);
+                Ok((id, case.op.name(), check_case(worker, &case)?.is_none()))
+            })
+            .collect::<anyhow::Result<Vec<_>>>()
+    });
+
+    let mut report = IsolationReport::default();
+    for (first, result) in shards.iter().zip(results) {
+        match result {
+            Ok(outcomes) => {
+                for (id, op, matched) in outcomes {
+                    let stats = report.by_op.entry(op).or_default();
+                    stats.cases += 1;
+                    report.cases += 1;
+                    if matched {
+                        stats.matched += 1;
+                        report.matched += 1;
+                    } else {
+                        report.diverged.push(id);
+                    }
+                }
+            }
+            Err(e) => {
+                report.failed_cases += ((first + shard_size).min(end) - first) as usize;
+                report.failed.push((*first, e.to_string()));
+            }
+        }
+    }
+
+    // Shrink on the worker that reruns the failure, one case per item
+    let to_shrink: Vec<u64> = report.diverged.iter().copied().take(MAX_SHRUNK).collect();
+    let shrunk = pool.run(&to_shrink, |worker, id| {
+        let original = IsolationCase::generate(id);
+        let original_rooms = original.rooms.len();
+        let (case, shrink_steps) = shrink_case(original.clone(), config.max_shrink_steps, |c| {
+            matches!(check_case(worker, c), Ok(Some(_)))
+        });
+        let mismatch = match check_case(worker, &case)? {
+            Some(mismatch) => mismatch,
+            None => return Err(anyhow::anyhow!("Case {} no longer diverges", id)),
+        };
+        Ok(ShrunkFailure { id, original_rooms, case, mismatch, shrink_steps })
+    });
+    report.shrunk = shrunk.into_iter().filter_map(Result::ok).collect();
+    report.elapsed = start.elapsed();
+    report
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::WorkerSpec;
+
+    #[test]
+    fn test_generated_cases_are_deterministic_and_valid() {
+        for id in 1..200 {
+            let case = IsolationCase::generate(id);
+            assert_eq!(case, IsolationCase::generate(id));
+            assert!(!case.rooms.is_empty());
+            for (i, a) in case.rooms.iter().enumerate() {
+                assert!(a.lx >= 3 && a.hx < COLNO as i32 - 2 && a.ly >= 2 && a.hy < ROWNO as i32 - 2);
+                assert!(case.rooms[i + 1..].iter().all(|b| a.apart(b)));
+            }
+            if let IsolationOp::Join { a, b, .. } = case.op {
+                assert!(a != b && a < case.rooms.len() && b < case.rooms.len());
+            }
+        }
+    }
+
+    #[test]
+    fn test_rust_case_digs_between_rooms() {
+        let case = IsolationCase {
+            seed: 42,
+            dlevel: 14,
+            rooms: vec![
+                RoomRect { lx: 5, ly: 5, hx: 10, hy: 9 },
+                RoomRect { lx: 20, ly: 5, hx: 25, hy: 9 },
+            ],
+            op: IsolationOp::Join { a: 0, b: 1, nxcor: false },
+        };
+        let result = run_rust_case(&case);
+        assert_eq!(result.cells.len(), COLNO * ROWNO);
+        let corridors = result.cells.iter().filter(|&&t| t == CellType::Corridor as u8).count();
+        assert!(corridors > 0);
+    }
+
+    #[test]
+    fn test_shrink_keeps_failure_and_join_rooms() {
+        let case = IsolationCase {
+            seed: 40,
+            dlevel: 3,
+            rooms: vec![
+                RoomRect { lx: 3, ly: 2, hx: 8, hy: 5 },
+                RoomRect { lx: 20, ly: 3, hx: 26, hy: 6 },
+                RoomRect { lx: 40, ly: 10, hx: 45, hy: 14 },
+                RoomRect { lx: 60, ly: 4, hx: 62, hy: 7 },
+            ],
+            op: IsolationOp::Join { a: 1, b: 3, nxcor: true },
+        };
+        // Pretend the bug needs the two joined rooms to be at least 3 wide
+        let joined = |c: &IsolationCase| match c.op {
+            IsolationOp::Join { a, b, .. } => (c.rooms[a], c.rooms[b]),
+            _ => unreachable!(),
+        };
+        let fails = |c: &IsolationCase| {
+            let (a, b) = joined(c);
+            a.hx - a.lx >= 2 && b.hx - b.lx >= 2
+        };
+        let (shrunk, steps) = shrink_case(case.clone(), 1000, fails);
+        assert!(steps < 1000);
+        assert!(fails(&shrunk));
+        assert_eq!(shrunk.rooms.len(), 2);
+        assert_eq!(shrunk.seed, 1);
+        assert_eq!(shrunk.op, IsolationOp::Join { a: 0, b: 1, nxcor: false });
+        let (a, b) = joined(&shrunk);
+        assert_eq!((a.hx - a.lx, a.hy - a.ly, b.hx - b.lx, b.hy - b.ly), (2, 0, 2, 0));
+    }
+
+    #[test]
+    fn test_isolation_run_covers_every_case() {
+        let pool = WorkerPool::new(2, WorkerSpec::default()).unwrap();
+        let config = IsolationConfig { first_case: 1, cases: 25, shard_size: 10, max_shrink_steps: 20 };
+        let report = run_isolation(&pool, &config);
+        assert_eq!(report.cases + report.failed_cases, 25);
+        assert_eq!(report.by_op.values().map(|s| s.cases).sum::<usize>(), report.cases);
+        assert_eq!(report.matched + report.diverged.len(), report.cases);
+        assert!(report.shrunk.len() <= MAX_SHRUNK.min(report.diverged.len()));
+    }
+}
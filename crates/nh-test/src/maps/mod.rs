@@ -17,7 +17,9 @@
 //! - Shops: General, Armor, Scroll, Potion, Weapon, etc.
 
 pub mod generation;
+pub mod isolation;
 pub mod room_types;
 pub mod rooms;
+pub mod sweep;
 
 pub use room_types::{CRoomType, c_door_constants, c_room_constants};
@@ -0,0 +1,252 @@
+//! Seed sweeps over level generation
+//!
+//! Generates every (seed, dungeon level) pair of a sweep in both engines
+//! and compares the cell grids. C levels come from a `WorkerPool`, one
+//! `generate_level_bin` round trip per level; the Rust level is generated
+//! on the thread that drives the worker, so both sides scale with the pool.
+//!
+//! C cell types (`levltyp`) and `nh_core::dungeon::CellType` share their
+//! numbering, so cells are compared as raw type bytes.
+
+use std::collections::BTreeMap;
+use std::time::{Duration, Instant};
+
+use serde::Serialize;
+
+use crate::ffi::WorkerPool;
+use crate::ffi::game_engine::CLevelCell;
+
+/// Seeds `first_seed..first_seed + seeds`, dungeon levels `1..=max_dlevel`
+#[derive(Debug, Clone)]
+pub struct SweepConfig {
+    pub first_seed: u64,
+    pub seeds: u64,
+    pub dnum: i32,
+    pub max_dlevel: i32,
+}
+
+/// First cell, in row-major order, where the two levels differ
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize)]
+pub struct CellDivergence {
+    pub x: usize,
+    pub y: usize,
+    pub rust: u8,
+    pub c: u8,
+}
+
+#[derive(Debug, Clone, Serialize)]
+pub struct LevelOutcome {
+    pub seed: u64,
+    pub dlevel: i32,
+    pub first_divergence: Option<CellDivergence>,
+    pub mismatched_cells: usize,
+}
+
+/// Parity counts for one dungeon level
+#[derive(Debug, Clone, Copy, Default, Serialize)]
+pub struct DlevelStats {
+    pub levels: usize,
+    pub matched: usize,
+}
+
+#[derive(Debug, Clone, Default, Serialize)]
+pub struct SweepReport {
+    pub levels: usize,
+    pub matched: usize,
+    /// Seeds the C side could not generate, with the error
+    pub failed: Vec<(u64, String)>,
+    pub by_dlevel: BTreeMap<i32, DlevelStats>,
+    /// (rust type, c type, levels) at the first divergent cell, most common first
+    pub first_divergence_types: Vec<(u8, u8, usize)>,
+    /// Row-major index of the earliest first divergence seen
+    pub earliest_divergence: Option<usize>,
+    /// Mean mismatched cells over diverged levels
+    pub mean_mismatched_cells: f64,
+    /// The first few diverged levels, in seed order
+    pub examples: Vec<LevelOutcome>,
+    #[serde(serialize_with = "serialize_secs")]
+    pub elapsed: Duration,
+}
+
+fn serialize_secs<S: serde::Serializer>(d: &Duration, s: S) -> Result<S::Ok, S::Error> {
+    s.serialize_f64(d.as_secs_f64())
+}
+
+/// Diverged levels kept in `SweepReport::examples`
+const MAX_EXAMPLES: usize = 20;
+
+impl SweepReport {
+    pub fn levels_per_sec(&self) -> f64 {
+        let secs = self.elapsed.as_secs_f64();
+        if secs > 0.0 { self.levels as f64 / secs } else { 0.0 }
+    }
+
+    fn add(&mut self, outcomes: &[LevelOutcome]) {
+        for outcome in outcomes {
+            let stats = self.by_dlevel.entry(outcome.dlevel).or_default();
+            stats.levels += 1;
+            self.levels += 1;
+            if outcome.first_divergence.is_none() {
+                stats.matched += 1;
+                self.matched += 1;
+            } else if self.examples.len() < MAX_EXAMPLES {
+                self.examples.push(outcome.clone());
+            }
+        }
+    }
+}
+
+impl std::fmt::Display for SweepReport {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        writeln!(
+            f,
+            "{} levels in {:.2}s ({:.0} levels/sec), {} matched ({:.1}%), {} seeds failed",
+            self.levels,
+            self.elapsed.as_secs_f64(),
+            self.levels_per_sec(),
+            self.matched,
+            100.0 * self.matched as f64 / self.levels.max(1) as f64,
+            self.failed.len()
+        )?;
+        for (dlevel, stats) in &self.by_dlevel {
+            writeln!(f, "  dlevel {:2}: {}/{} matched", dlevel, stats.matched, stats.levels)?;
+        }
+        if let Some(index) = self.earliest_divergence {
+            writeln!(
+                f,
+                "  earliest divergence at ({},{}), {:.1} mismatched cells on average",
+                index % nh_core::COLNO,
+                index / nh_core::COLNO,
+                self.mean_mismatched_cells
+            )?;
+        }
+        for (rust, c, levels) in self.first_divergence_types.iter().take(10) {
+            writeln!(f, "  first divergence rust={} c={}: {} levels", rust, c, levels)?;
+        }
+        Ok(())
+    }
+}
+
+/// Rust cell types of one generated level, row-major
+pub fn rust_level_cells(seed: u64, dnum: i32, dlevel: i32) -> Vec<u8> {
+    use nh_core::GameRng;
+    use nh_core::dungeon::{DLevel, Level, generate_rooms_and_corridors};
+    use nh_core::magic::MonsterVitals;
+
+    let mut rng = GameRng::new(seed);
+    let mut level = Level::new(DLevel::new(dnum as i8, dlevel as i8));
+    generate_rooms_and_corridors(&mut level, &mut rng, &MonsterVitals::new());
+    level_cell_types(&level)
+}
+
+/// Cell types of a Rust level, row-major like the C exports
+pub fn level_cell_types(level: &nh_core::dungeon::Level) -> Vec<u8> {
+    let mut cells = vec![0u8; nh_core::COLNO * nh_core::ROWNO];
+    for (x, col) in level.cells.iter().enumerate().take(nh_core::COLNO) {
+        for (y, cell) in col.iter().enumerate().take(nh_core::ROWNO) {
+            cells[y * nh_core::COLNO + x] = cell.typ as u8;
+        }
+    }
+    cells
+}
+
+/// Compare row-major cell types; returns the first divergence and the
+/// number of mismatched cells.
+pub fn compare_cells(rust: &[u8], c: &[CLevelCell], width: usize) -> (Option<CellDivergence>, usize) {
+    let c: Vec<u8> = c.iter().map(|cell| cell.typ).collect();
+    compare_cell_types(rust, &c, width)
+}
+
+/// `compare_cells` over raw C cell types
+pub fn compare_cell_types(rust: &[u8], c: &[u8], width: usize) -> (Option<CellDivergence>, usize) {
+    let mut first = None;
+    let mut mismatched = 0;
+    for (i, (&r, &typ)) in rust.iter().zip(c).enumerate() {
+        if r != typ {
+            mismatched += 1;
+            first.get_or_insert(CellDivergence { x: i % width, y: i / width, rust: r, c: typ });
+        }
+    }
+    // A missing C grid counts as diverging at the first cell
+    if c.len() < rust.len() {
+        mismatched += rust.len() - c.len();
+        let i = c.len();
+        first.get_or_insert(CellDivergence { x: i % width, y: i / width, rust: rust[i], c: 0 });
+    }
+    (first, mismatched)
+}
+
+/// Generate and compare every level of the sweep.
+pub fn run_sweep(pool: &WorkerPool, config: &SweepConfig) -> SweepReport {
+    let seeds: Vec<u64> = (config.first_seed..config.first_seed + config.seeds).collect();
+    let start = Instant::now();
+
+    let results = pool.run(&seeds, |worker, seed| {
+        (1..=config.max_dlevel)
+            .map(|dlevel| {
+                let export = worker.generate_level_bin(seed, config.dnum, dlevel)?;
+                let rust = rust_level_cells(seed, config.dnum, dlevel);
+                let (first_divergence, mismatched_cells) =
+                    compare_cells(&rust, export.cells(), export.width().max(1));
+                Ok(LevelOutcome { seed, dlevel, first_divergence, mismatched_cells })
+            })
+            .collect::<anyhow::Result<Vec<_>>>()
+    });
+
+    let mut report = SweepReport::default();
+    let mut pairs: BTreeMap<(u8, u8), usize> = BTreeMap::new();
+    let (mut diverged, mut mismatched) = (0usize, 0usize);
+    for (seed, result) in seeds.iter().zip(results) {
+        match result {
+            Ok(outcomes) => {
+                report.add(&outcomes);
+                for (outcome, d) in outcomes.iter().filter_map(|o| o.first_divergence.map(|d| (o, d))) {
+                    *pairs.entry((d.rust, d.c)).or_default() += 1;
+                    let index = d.y * nh_core::COLNO + d.x;
+                    report.earliest_divergence =
+                        Some(report.earliest_divergence.map_or(index, |e| e.min(index)));
+                    diverged += 1;
+                    mismatched += outcome.mismatched_cells;
+                }
+            }
+            Err(e) => report.failed.push((*seed, e.to_string())),
+        }
+    }
+    report.elapsed = start.elapsed();
+
+    let mut pairs: Vec<_> = pairs.into_iter().map(|((r, c), n)| (r, c, n)).collect();
+    pairs.sort_by(|a, b| b.2.cmp(&a.2));
+    report.first_divergence_types = pairs;
+    if diverged > 0 {
+        report.mean_mismatched_cells = mismatched as f64 / diverged as f64;
+    }
+    report
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::WorkerSpec;
+
+    #[test]
+    fn test_compare_cells_finds_first_divergence() {
+        let c: Vec<CLevelCell> = [0u8, 24, 24, 23]
+            .iter()
+            .map(|&typ| CLevelCell { typ, ..CLevelCell::default() })
+            .collect();
+        assert_eq!(compare_cells(&[0, 24, 24, 23], &c, 2), (None, 0));
+
+        let (first, mismatched) = compare_cells(&[0, 24, 23, 24], &c, 2);
+        assert_eq!(first, Some(CellDivergence { x: 0, y: 1, rust: 23, c: 24 }));
+        assert_eq!(mismatched, 2);
+    }
+
+    #[test]
+    fn test_sweep_covers_every_level() {
+        let pool = WorkerPool::new(2, WorkerSpec::default()).unwrap();
+        let config = SweepConfig { first_seed: 1, seeds: 3, dnum: 0, max_dlevel: 2 };
+        let report = run_sweep(&pool, &config);
+        assert_eq!(report.levels + 2 * report.failed.len(), 6);
+        assert_eq!(report.by_dlevel.values().map(|s| s.levels).sum::<usize>(), report.levels);
+    }
+}
@@ -6,6 +6,8 @@
 
 use nh_test::rng::isaac64::Isaac64;
 use nh_test::ffi::CIsaac64;
+use nh_test::ffi::game_engine::{nh_ffi_rng_checkpoint, nh_ffi_rng_restore};
+use nh_test::ffi::isaac64::{ISAAC64_SZ, rn2, rn2_bulk};
 
 /// Test 100 different seeds, 10,000 values each, bitwise equality.
 #[test]
@@ -204,3 +206,170 @@ fn test_reseed_consistency() {
         }
     }
 }
+
+/// Skipping must land on the same value as drawing one by one, across
+/// block boundaries, in both implementations.
+#[test]
+fn test_skip_parity() {
+    for skip in [0u64, 1, 255, 256, 257, 511, 512, 1000, 10_000] {
+        for pre in [0u64, 1, 100, 255] {
+            let mut drawn = Isaac64::new(2718);
+            let mut rust = Isaac64::new(2718);
+            let mut c = CIsaac64::new(2718);
+            for _ in 0..pre {
+                drawn.next_u64();
+                rust.next_u64();
+                c.next_u64();
+            }
+
+            for _ in 0..skip {
+                drawn.next_u64();
+            }
+            rust.skip(skip);
+            c.skip(skip);
+            assert_eq!(rust.call_count(), drawn.call_count());
+            assert_eq!(c.call_count(), drawn.call_count());
+
+            for i in 0..300 {
+                let expected = drawn.next_u64();
+                assert_eq!(rust.next_u64(), expected, "Rust skip={} pre={} pos={}", skip, pre, i);
+                assert_eq!(c.next_u64(), expected, "C skip={} pre={} pos={}", skip, pre, i);
+            }
+        }
+    }
+}
+
+/// A restored checkpoint replays the same stream.
+#[test]
+fn test_checkpoint_restore() {
+    let mut rust = Isaac64::new(99);
+    let mut c = CIsaac64::new(99);
+    rust.skip(700);
+    c.skip(700);
+
+    let rust_cp = rust.clone();
+    let c_cp = c.checkpoint();
+    let first: Vec<u64> = (0..500).map(|_| c.next_u64()).collect();
+
+    c.restore(&c_cp);
+    assert_eq!(c.call_count(), 700);
+    let mut rust = rust_cp;
+    for (i, &v) in first.iter().enumerate() {
+        assert_eq!(c.next_u64(), v, "C replay mismatch at {}", i);
+        assert_eq!(rust.next_u64(), v, "Rust replay mismatch at {}", i);
+    }
+}
+
+/// Bulk fills must return exactly the values of per-call draws.
+#[test]
+fn test_fill_parity() {
+    for len in [0usize, 1, 7, 255, 256, 257, 1000, 5000] {
+        for pre in [0u64, 1, 100, 255] {
+            let mut single = Isaac64::new(1618);
+            let mut rust = Isaac64::new(1618);
+            let mut c = CIsaac64::new(1618);
+            single.skip(pre);
+            rust.skip(pre);
+            c.skip(pre);
+
+            let expected: Vec<u64> = (0..len).map(|_| single.next_u64()).collect();
+            let mut rust_out = vec![0u64; len];
+            let mut c_out = vec![0u64; len];
+            rust.fill(&mut rust_out);
+            c.fill(&mut c_out);
+            assert_eq!(rust_out, expected, "Rust fill len={} pre={}", len, pre);
+            assert_eq!(c_out, expected, "C fill len={} pre={}", len, pre);
+
+            // The stream continues where the fill stopped
+            let next = single.next_u64();
+            assert_eq!(rust.next_u64(), next);
+            assert_eq!(c.next_u64(), next);
+        }
+    }
+}
+
+#[test]
+fn test_rn2_fill_parity() {
+    for limit in [0u32, 1, 2, 6, 20, 1000] {
+        let mut rust = Isaac64::new(4242);
+        let mut c = CIsaac64::new(4242);
+        let expected: Vec<u32> = (0..1000).map(|_| rust.rn2(limit)).collect();
+        let mut out = vec![0u32; 1000];
+        c.rn2_fill(limit, &mut out);
+        assert_eq!(out, expected, "rn2_fill mismatch for limit={}", limit);
+    }
+}
+
+/// C isaac64_rn2_bulk() against per-call isaac64_next_uint(), with raw
+/// values planted where the rejection test throws them away.
+#[test]
+fn test_rn2_bulk_parity() {
+    // u64::MAX is rejected for every limit that is not a power of two
+    let plant = |c: &mut CIsaac64| {
+        for k in [1, 2, 50] {
+            c.ctx_mut().r[ISAAC64_SZ - k] = u64::MAX;
+        }
+    };
+    for limit in [0i32, 1, 3, 6, 1000, i32::MAX] {
+        for len in [0usize, 1, 2, 255, 600] {
+            let mut single = CIsaac64::new(777);
+            let mut bulk = CIsaac64::new(777);
+            plant(&mut single);
+            plant(&mut bulk);
+
+            let expected: Vec<i32> = (0..len)
+                .map(|_| if limit <= 0 { 0 } else { single.next_uint(limit as u64) as i32 })
+                .collect();
+            let mut out = vec![-1i32; len];
+            bulk.next_uint_bulk(limit, &mut out);
+            assert_eq!(out, expected, "rn2_bulk limit={} len={}", limit, len);
+            assert_eq!(bulk.call_count(), single.call_count(), "limit={} len={}", limit, len);
+
+            // rn2_fill() drops the same values
+            if limit > 0 {
+                let mut fill = CIsaac64::new(777);
+                plant(&mut fill);
+                let mut out = vec![0u32; len];
+                fill.rn2_fill(limit as u32, &mut out);
+                let expected: Vec<u32> = expected.iter().map(|&v| v as u32).collect();
+                assert_eq!(out, expected, "rn2_fill limit={} len={}", limit, len);
+                assert_eq!(fill.call_count(), single.call_count());
+            }
+
+            // The stream continues where the per-call draws stopped
+            assert_eq!(bulk.next_u64(), single.next_u64(), "limit={} len={}", limit, len);
+        }
+    }
+
+    // The planted values really were dropped: the first two draws come
+    // from the third and fourth raw values
+    let mut c = CIsaac64::new(777);
+    plant(&mut c);
+    let mut raw = [0u64; 4];
+    c.fill(&mut raw);
+    assert_eq!(&raw[..2], &[u64::MAX, u64::MAX]);
+    let mut bulk = CIsaac64::new(777);
+    plant(&mut bulk);
+    let mut out = [0i32; 2];
+    bulk.next_uint_bulk(3, &mut out);
+    assert_eq!(out, [(raw[2] % 3) as i32, (raw[3] % 3) as i32]);
+}
+
+/// rn2_bulk() on the game RNG against as many rn2() calls from the same
+/// position.
+#[test]
+fn test_game_rn2_bulk_parity() {
+    let size = unsafe { nh_ffi_rng_checkpoint(std::ptr::null_mut(), 0) };
+    assert!(size > 0);
+    let mut saved = vec![0u8; size];
+    unsafe { nh_ffi_rng_checkpoint(saved.as_mut_ptr().cast(), size) };
+
+    let mut out = vec![-1; 600];
+    unsafe { rn2_bulk(20, out.as_mut_ptr(), out.len()) };
+    let after = unsafe { rn2(1000) };
+
+    assert_eq!(unsafe { nh_ffi_rng_restore(saved.as_ptr().cast(), size) }, 0);
+    let expected: Vec<i32> = (0..out.len()).map(|_| unsafe { rn2(20) }).collect();
+    assert_eq!(out, expected);
+    assert_eq!(unsafe { rn2(1000) }, after);
+}
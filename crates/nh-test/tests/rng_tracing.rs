@@ -3,6 +3,12 @@
 //! Tests the RNG tracing mode that logs every call for diffing
 //! between C and Rust implementations.
 
+use std::fs::File;
+use std::os::fd::AsRawFd;
+
+use nh_core::CGameEngineTrait;
+use nh_test::ffi::CGameEngine;
+use nh_test::ffi::game_engine::{NH_FFI_RNG_FN_RN2, RngTraceReader};
 use nh_test::rng::isaac64::Isaac64;
 
 /// Test that tracing mode records calls correctly.
@@ -152,3 +158,29 @@ fn test_print_sample_trace() {
     }
     println!("Total raw u64 calls: {}", rng.call_count());
 }
+
+/// The C trace stream keeps every call, well past the 4096-entry ring.
+#[test]
+fn test_c_trace_stream_is_lossless() {
+    let path = std::env::temp_dir().join(format!("nh-rng-trace-{}.bin", std::process::id()));
+    let file = File::create(&path).unwrap();
+
+    let mut engine = CGameEngine::new();
+    engine.init("Valkyrie", "Human", 1, 1).unwrap();
+    engine.start_rng_trace_stream(file.as_raw_fd()).unwrap();
+    let results: Vec<i32> = (0..10_000).map(|i| engine.rng_rn2(i % 50 + 1)).collect();
+    assert_eq!(engine.stop_rng_trace_stream().unwrap(), 10_000);
+    drop(file);
+
+    let reader = RngTraceReader::new(File::open(&path).unwrap()).unwrap();
+    let records = reader.read_all().unwrap();
+    let _ = std::fs::remove_file(&path);
+
+    assert_eq!(records.len(), results.len());
+    for (i, (rec, &result)) in records.iter().zip(&results).enumerate() {
+        assert_eq!(rec.seq as usize, i);
+        assert_eq!(rec.func, NH_FFI_RNG_FN_RN2);
+        assert_eq!(rec.arg, i as i32 % 50 + 1);
+        assert_eq!(rec.result, result, "result mismatch at {}", i);
+    }
+}